@@ -11,6 +11,7 @@
 #include "Camera.h"
 #include "World.h"
 #include "ZoneCull.h"
+#include "Debug.h"
 
 cAudioManager AudioManager;
 
@@ -562,13 +563,93 @@ cAudioManager::RandomDisplacement(uint32 seed) const
 	return value;
 }
 
+#ifdef AUDIO_ENTITY_CULLING
+// Nothing on the ground emits further than a siren (110), so a car, bike or boat past
+// this distance without pending events can't be heard. It still goes through ProcessEntity
+// every few frames to keep its gas pedal and velocity change current for when it comes back.
+// Peds only make sound from events, so without any there is nothing to process at all.
+#define AUDIO_ENTITY_CULL_DISTANCE 120.0f
+#define AUDIO_FAR_ENTITY_INTERVAL 8 // frames between updates of an inaudible vehicle
+#define AUDIO_FAR_ENTITY_BUDGET 16  // inaudible vehicles processed per frame at most
+
+bool gbShowAudioEntityStats;
+int32 gnAudioEntitiesProcessed;
+int32 gnAudioEntitiesFar;
+int32 gnAudioEntitiesCulled;
+
+// squared distance past which the entity can't be heard, negative if it always has to be processed
+float
+cAudioManager::GetEntityCullDistanceSquared(int32 id)
+{
+	tAudioEntity &entity = m_asAudioEntities[id];
+
+	// everything else is either global or does its own distance checks
+	if (entity.m_nType != AUDIOTYPE_PHYSICAL || entity.m_pEntity == nil || entity.m_AudioEvents != 0)
+		return -1.0f;
+
+	CPhysical *physical = (CPhysical *)entity.m_pEntity;
+	if (physical->IsPed())
+		return 0.0f;
+	if (!physical->IsVehicle())
+		return -1.0f;
+
+	CVehicle *veh = (CVehicle *)physical;
+	if (veh == FindVehicleOfPlayer())
+		return -1.0f;
+	switch (veh->m_vehType) {
+	case VEHICLE_TYPE_CAR:
+		if (veh->GetVehicleAppearance() == VEHICLE_APPEARANCE_HELI || veh->GetVehicleAppearance() == VEHICLE_APPEARANCE_PLANE)
+			return -1.0f;
+		break;
+	case VEHICLE_TYPE_BOAT:
+		if (veh->m_modelIndex == MI_SKIMMER)
+			return -1.0f;
+		break;
+	case VEHICLE_TYPE_BIKE:
+		break;
+	default:
+		// aircraft and trains are heard from hundreds of metres away and there are only a few of them
+		return -1.0f;
+	}
+	return SQR(AUDIO_ENTITY_CULL_DISTANCE);
+}
+#endif
+
 void
 cAudioManager::InterrogateAudioEntities()
 {
+#ifdef AUDIO_ENTITY_CULLING
+	int32 farBudget = AUDIO_FAR_ENTITY_BUDGET;
+	gnAudioEntitiesProcessed = 0;
+	gnAudioEntitiesFar = 0;
+	gnAudioEntitiesCulled = 0;
+#endif
 	for (int32 i = 0; i < m_nAudioEntitiesTotal; i++) {
+#ifdef AUDIO_ENTITY_CULLING
+		int32 id = m_anAudioEntityIndices[i];
+		float cullDist = GetEntityCullDistanceSquared(id);
+		if (cullDist >= 0.0f && GetDistanceSquared(((CEntity *)m_asAudioEntities[id].m_pEntity)->GetPosition()) >= cullDist) {
+			// staggered by id so the far ones don't all come up on the same frame
+			if (cullDist == 0.0f || (m_FrameCounter + id) % AUDIO_FAR_ENTITY_INTERVAL != 0 || farBudget == 0) {
+				gnAudioEntitiesCulled++;
+				continue;
+			}
+			farBudget--;
+			gnAudioEntitiesFar++;
+		} else
+			gnAudioEntitiesProcessed++;
+#endif
 		ProcessEntity(m_anAudioEntityIndices[i]);
 		m_asAudioEntities[m_anAudioEntityIndices[i]].m_AudioEvents = 0;
 	}
+#ifdef AUDIO_ENTITY_CULLING
+	if (gbShowAudioEntityStats) {
+		char str[128];
+		sprintf(str, "AUDIO ENTITIES %d PROCESSED %d FAR %d CULLED %d", m_nAudioEntitiesTotal, gnAudioEntitiesProcessed, gnAudioEntitiesFar,
+		        gnAudioEntitiesCulled);
+		CDebug::PrintAt(str, 2, 22);
+	}
+#endif
 }
 
 void
@@ -402,6 +402,9 @@ public:
 	void InitialisePoliceRadio();                  // done
 	void InitialisePoliceRadioZones();             // done
 	void InterrogateAudioEntities();               // done (inlined)
+#ifdef AUDIO_ENTITY_CULLING
+	float GetEntityCullDistanceSquared(int32 id);
+#endif
 	bool IsAudioInitialised() const;               // done
 	bool IsMissionAudioSampleFinished(uint8 slot); // done
 	bool IsMP3RadioChannelAvailable() const;       // done
@@ -549,3 +552,7 @@ static_assert(sizeof(cAudioManager) == 0x5558, "cAudioManager: error");
 #endif
 
 extern cAudioManager AudioManager;
+
+#ifdef AUDIO_ENTITY_CULLING
+extern bool gbShowAudioEntityStats;
+#endif
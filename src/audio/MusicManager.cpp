@@ -862,12 +862,36 @@ cMusicManager::ServiceAnnouncement()
 	return true;
 }
 
+#ifdef AUDIO_STREAM_PREFETCH
+// keep the stations the player is most likely to tune to next decoded in the background,
+// so retuning doesn't have to open and seek a file on the spot
+static void
+PrefetchNextStations(CVehicle *veh)
+{
+	if (veh->m_nRadioStation > RADIO_OFF)
+		return;
+
+	int32 station = veh->m_nRadioStation + gNumRetunePresses;
+	if (gRetuneCounter == 0)
+		station++;
+	for (uint8 slot = 0; slot < MAX_PREFETCH_STREAMS; slot++, station++) {
+		while (station >= RADIO_OFF) station -= RADIO_OFF;
+		if (station < USERTRACK)
+			SampleManager.PrefetchStreamedFile(station, MusicManager.GetTrackStartPos(station), slot);
+	}
+}
+#endif
+
 void
 cMusicManager::ServiceTrack(CVehicle *veh, CPed *ped)
 {
 	static bool bRadioStatsRecorded = false;
 	static bool bRadioStatsRecorded2 = false;
 	uint8 volume;
+#ifdef AUDIO_STREAM_PREFETCH
+	if (veh && !UsesPoliceRadio(veh) && !UsesTaxiRadio(veh) && !(AudioManager.m_FrameCounter & 3))
+		PrefetchNextStations(veh);
+#endif
 	if (!field_398F)
 		m_nStreamedTrack = m_nFrontendTrack;
 	if (gRetuneCounter != 0 || field_2) {
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifdef AUDIO_MIXER_THREAD
+#include <atomic>
+
+/*
+The game thread never talks to OpenAL directly when the mixer thread is running.
+Every cSampleManager call that changes channel or stream state is packed into a
+tAudioCommand and pushed into a single-producer/single-consumer ring; the mixer
+thread pops them in order, executes them and services the CStreams.
+Queries (channel used, stream playing/position) are answered from a shadow state
+the mixer thread publishes after each pass.
+*/
+
+enum eAudioCommand
+{
+	AUDIOCMD_NONE,
+
+	// channels
+	AUDIOCMD_CHANNEL_INIT,
+	AUDIOCMD_CHANNEL_START,
+	AUDIOCMD_CHANNEL_STOP,
+	AUDIOCMD_CHANNEL_VOLUME,
+	AUDIOCMD_CHANNEL_PAN,
+	AUDIOCMD_CHANNEL_POSITION,
+	AUDIOCMD_CHANNEL_DISTANCES,
+	AUDIOCMD_CHANNEL_FREQUENCY,
+	AUDIOCMD_CHANNEL_LOOP_POINTS,
+	AUDIOCMD_CHANNEL_LOOP_COUNT,
+	AUDIOCMD_CHANNEL_REVERB_MIX,
+
+	// streams
+	AUDIOCMD_STREAM_PRELOAD,
+	AUDIOCMD_STREAM_START_PRELOADED,
+	AUDIOCMD_STREAM_START,
+	AUDIOCMD_STREAM_STOP,
+	AUDIOCMD_STREAM_PAUSE,
+	AUDIOCMD_STREAM_VOLUME_PAN,
+#ifdef AUDIO_STREAM_PREFETCH
+	AUDIOCMD_STREAM_PREFETCH,
+#endif
+
+	// global
+	AUDIOCMD_REVERB,
+};
+
+struct tAudioCommand
+{
+	uint8 nCommand;
+	uint8 nIndex;		// channel or stream
+	uint32 nSequence;
+	uint32 nSubmitTime;
+	union {
+		int32 nParam[3];
+		float fParam[3];
+	};
+	uintptr pData;
+};
+
+#define AUDIO_COMMAND_QUEUE_SIZE 1024	// must be a power of two
+
+class CAudioCommandQueue
+{
+	tAudioCommand m_aCommands[AUDIO_COMMAND_QUEUE_SIZE];
+	std::atomic<uint32> m_nHead;	// next slot to pop, only written by the consumer
+	std::atomic<uint32> m_nTail;	// next slot to push, only written by the producer
+public:
+	CAudioCommandQueue() : m_nHead(0), m_nTail(0) {}
+
+	void Reset(void) { m_nHead = 0; m_nTail = 0; }
+
+	uint32 GetSize(void) const { return m_nTail.load(std::memory_order_acquire) - m_nHead.load(std::memory_order_acquire); }
+	bool IsEmpty(void) const { return GetSize() == 0; }
+
+	bool Push(const tAudioCommand &cmd)
+	{
+		uint32 tail = m_nTail.load(std::memory_order_relaxed);
+		if (tail - m_nHead.load(std::memory_order_acquire) >= AUDIO_COMMAND_QUEUE_SIZE)
+			return false;
+		m_aCommands[tail & (AUDIO_COMMAND_QUEUE_SIZE-1)] = cmd;
+		m_nTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(tAudioCommand &cmd)
+	{
+		uint32 head = m_nHead.load(std::memory_order_relaxed);
+		if (head == m_nTail.load(std::memory_order_acquire))
+			return false;
+		cmd = m_aCommands[head & (AUDIO_COMMAND_QUEUE_SIZE-1)];
+		m_nHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+};
+
+#endif
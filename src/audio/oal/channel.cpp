@@ -15,6 +15,95 @@ ALuint alFilters[MAXCHANNELS+MAX2DCHANNELS];
 ALuint alBuffers[MAXCHANNELS+MAX2DCHANNELS];
 bool bChannelsCreated = false;
 
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+/*
+Samples stay in their OpenAL buffer after they've been played, keyed by sample id
+and loop points, so a sound or ped comment that comes up again is only attached to
+the source instead of being copied into the channel's buffer on every Start.
+Once the cache is full the least recently used buffer that no source holds goes.
+*/
+#define SAMPLE_BUFFER_CACHE_SIZE  256
+#define SAMPLE_BUFFER_CACHE_BYTES (16 * 1024 * 1024)
+
+struct tSampleBuffer
+{
+	ALuint buffer; // AL_NONE if the entry is free
+	int32  nSfx;
+	ALint  LoopPoints[2];
+	uint32 nSize;
+	uint32 nLastUsed;
+	int32  nUsers;
+};
+
+tSampleBuffer aSampleBuffers[SAMPLE_BUFFER_CACHE_SIZE];
+uint32 nSampleBufferBytes;
+uint32 nSampleBufferClock;
+
+static void
+FreeSampleBuffer(int32 i)
+{
+	alDeleteBuffers(1, &aSampleBuffers[i].buffer);
+	aSampleBuffers[i].buffer = AL_NONE;
+	aSampleBuffers[i].nUsers = 0;
+	nSampleBufferBytes -= aSampleBuffers[i].nSize;
+}
+
+static int32
+AcquireSampleBuffer(int32 sfx, void *data, size_t size, int32 freq, ALint *loopPoints)
+{
+	int32 slot = -1;
+	for ( int32 i = 0; i < SAMPLE_BUFFER_CACHE_SIZE; i++ )
+	{
+		tSampleBuffer &entry = aSampleBuffers[i];
+		if ( entry.buffer == AL_NONE )
+		{
+			if ( slot == -1 )
+				slot = i;
+		}
+		else if ( entry.nSfx == sfx && entry.LoopPoints[0] == loopPoints[0] && entry.LoopPoints[1] == loopPoints[1] )
+		{
+			entry.nUsers++;
+			entry.nLastUsed = ++nSampleBufferClock;
+			return i;
+		}
+	}
+
+	while ( slot == -1 || nSampleBufferBytes + size > SAMPLE_BUFFER_CACHE_BYTES )
+	{
+		int32 lru = -1;
+		for ( int32 i = 0; i < SAMPLE_BUFFER_CACHE_SIZE; i++ )
+		{
+			tSampleBuffer &entry = aSampleBuffers[i];
+			if ( entry.buffer != AL_NONE && entry.nUsers == 0 && (lru == -1 || entry.nLastUsed < aSampleBuffers[lru].nLastUsed) )
+				lru = i;
+		}
+		// everything is playing, the caller falls back to the channel's own buffer
+		if ( lru == -1 )
+			return -1;
+		FreeSampleBuffer(lru);
+		if ( slot == -1 )
+			slot = lru;
+	}
+
+	tSampleBuffer &entry = aSampleBuffers[slot];
+	alGenBuffers(1, &entry.buffer);
+	if ( entry.buffer == AL_NONE )
+		return -1;
+	alBufferData(entry.buffer, AL_FORMAT_MONO16, data, size, freq);
+	if ( loopPoints[0] != 0 && loopPoints[0] != -1 )
+		alBufferiv(entry.buffer, AL_LOOP_POINTS_SOFT, loopPoints);
+
+	entry.nSfx          = sfx;
+	entry.LoopPoints[0] = loopPoints[0];
+	entry.LoopPoints[1] = loopPoints[1];
+	entry.nSize         = size;
+	entry.nLastUsed     = ++nSampleBufferClock;
+	entry.nUsers        = 1;
+	nSampleBufferBytes += size;
+	return slot;
+}
+#endif
+
 void
 CChannel::InitChannels()
 {
@@ -34,6 +123,13 @@ CChannel::DestroyChannels()
 		memset(alSources, 0, sizeof(alSources));
 		alDeleteBuffers(MAXCHANNELS + MAX2DCHANNELS, alBuffers);
 		memset(alBuffers, 0, sizeof(alBuffers));
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+		for ( int32 i = 0; i < SAMPLE_BUFFER_CACHE_SIZE; i++ )
+		{
+			if ( aSampleBuffers[i].buffer != AL_NONE )
+				FreeSampleBuffer(i);
+		}
+#endif
 		if (IsFXSupported())
 		{
 			alDeleteFilters(MAXCHANNELS + MAX2DCHANNELS, alFilters);
@@ -48,6 +144,10 @@ CChannel::CChannel()
 {
 	Data = nil;
 	DataSize = 0;
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+	Sfx = -1;
+	BufferSlot = -1;
+#endif
 	SetDefault();
 }
 
@@ -105,6 +205,17 @@ void CChannel::Start()
 	if ( !HasSource() ) return;
 	if ( !Data ) return;
 
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+	if ( BufferSlot == -1 && Sfx != -1 )
+		BufferSlot = AcquireSampleBuffer(Sfx, Data, DataSize, Frequency, LoopPoints);
+	if ( BufferSlot != -1 )
+	{
+		alSourcei(alSources[id], AL_BUFFER, aSampleBuffers[BufferSlot].buffer);
+		alSourcePlay(alSources[id]);
+		return;
+	}
+#endif
+
 	alBufferData(alBuffers[id], AL_FORMAT_MONO16, Data, DataSize, Frequency);
 	if ( LoopPoints[0] != 0 && LoopPoints[0] != -1 )
 		alBufferiv(alBuffers[id], AL_LOOP_POINTS_SOFT, LoopPoints);
@@ -203,6 +314,14 @@ void CChannel::ClearBuffer()
 	alSourcei(alSources[id], AL_BUFFER, AL_NONE);
 	Data = nil;
 	DataSize = 0;
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+	if ( BufferSlot != -1 )
+	{
+		aSampleBuffers[BufferSlot].nUsers--;
+		BufferSlot = -1;
+	}
+	Sfx = -1;
+#endif
 }
 
 void CChannel::SetReverbMix(ALuint slot, float mix)
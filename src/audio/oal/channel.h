@@ -19,6 +19,10 @@ class CChannel
 	float  Distances[2];
 	int32  LoopCount;
 	ALint  LoopPoints[2];
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+	int32  Sfx;
+	int32  BufferSlot;
+#endif
 public:
 	static void InitChannels();
 	static void DestroyChannels();
@@ -36,6 +40,9 @@ public:
 	void SetGain(float gain);
 	void SetVolume(int32 vol);
 	void SetSampleData(void *_data, size_t _DataSize, int32 freq);
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+	void SetSampleId(int32 sfx) { Sfx = sfx; }
+#endif
 	void SetCurrentFreq(uint32 freq);
 	void SetLoopCount(int32 loopCount); // fake
 	void SetLoopPoints(ALint start, ALint end);
@@ -25,6 +25,12 @@
 #ifndef _WIN32
 #include "crossplatform.h"
 #endif
+#ifdef AUDIO_STREAM_PREFETCH
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
 
 /*
 As we ran onto an issue of having different volume levels for mono streams
@@ -956,15 +962,231 @@ public:
 };
 #endif
 
+#ifdef AUDIO_STREAM_PREFETCH
+/*
+Every stream that has been set up gets a ring of decoded blocks that a worker
+thread keeps filled ahead of what has been queued to OpenAL, so CStream::Update
+only copies PCM into AL buffers and never waits for the decoder.
+Seeks are handed over too: if the requested position is already decoded the
+blocks in front of it are dropped, otherwise the ring is flushed by bumping
+its generation and the worker seeks the decoder on its next pass.
+All decoding happens on the worker, which also keeps SortStereoBuffer safe.
+*/
+
+#define STREAM_PREFETCH_BLOCKS 8 // 2 seconds with 250ms blocks
+#define MAX_PREFETCH_DECODERS  8
+
+class CStreamPrefetch
+{
+	IDecoder *m_pDecoder;
+	uint8    *m_pBlocks;
+	uint32    m_nBlockSize;
+	uint32    m_aDataSize  [STREAM_PREFETCH_BLOCKS];
+	uint32    m_aStartPos  [STREAM_PREFETCH_BLOCKS];
+	uint32    m_aEndPos    [STREAM_PREFETCH_BLOCKS];
+	uint32    m_aGeneration[STREAM_PREFETCH_BLOCKS];
+
+	std::atomic<uint32> m_nHead;       // written by the stream
+	std::atomic<uint32> m_nTail;       // written by the worker
+	std::atomic<uint32> m_nGeneration; // bumped by the stream on every flushing seek
+	std::atomic<uint32> m_nSeekPos;
+	std::atomic<uint32> m_nFinishedGeneration;
+	uint32    m_nDecoderGeneration;    // worker only
+	bool      m_bOnWorker;             // false if every worker slot was taken, the stream decodes itself then
+
+	bool IsCurrent(uint32 i) { return m_aGeneration[i % STREAM_PREFETCH_BLOCKS] == m_nGeneration.load(std::memory_order_relaxed); }
+public:
+	CStreamPrefetch(IDecoder *pDecoder);
+	~CStreamPrefetch();
+
+	// worker side
+	bool DecodeBlock();
+
+	// stream side
+	void  Seek(uint32 nPos);
+	void *Peek(uint32 &nSize, uint32 &nEndPos);
+	void  Pop();
+	bool  IsFinished();
+};
+
+std::thread AudioDecoderThread;
+std::mutex AudioDecoderMutex; // guards the list, held by the worker while it decodes a block
+std::condition_variable AudioDecoderWakeUp;
+bool bAudioDecoderQuit;
+CStreamPrefetch *aPrefetchDecoders[MAX_PREFETCH_DECODERS];
+int32 nNumPrefetchDecoders;
+
+CStreamPrefetch::CStreamPrefetch(IDecoder *pDecoder) :
+	m_pDecoder(pDecoder),
+	m_nHead(0),
+	m_nTail(0),
+	m_nGeneration(0),
+	m_nSeekPos(0),
+	m_nFinishedGeneration(~0u),
+	m_nDecoderGeneration(~0u),
+	m_bOnWorker(false)
+{
+	m_nBlockSize = m_pDecoder->GetBufferSize();
+	m_pBlocks = (uint8*)malloc(m_nBlockSize * STREAM_PREFETCH_BLOCKS);
+	ASSERT(m_pBlocks != nil);
+
+	std::lock_guard<std::mutex> lock(AudioDecoderMutex);
+	if ( nNumPrefetchDecoders < MAX_PREFETCH_DECODERS )
+	{
+		aPrefetchDecoders[nNumPrefetchDecoders++] = this;
+		m_bOnWorker = true;
+	}
+}
+
+CStreamPrefetch::~CStreamPrefetch()
+{
+	if ( m_bOnWorker )
+	{
+		std::lock_guard<std::mutex> lock(AudioDecoderMutex);
+		for ( int32 i = 0; i < nNumPrefetchDecoders; i++ )
+		{
+			if ( aPrefetchDecoders[i] == this )
+			{
+				aPrefetchDecoders[i] = aPrefetchDecoders[--nNumPrefetchDecoders];
+				break;
+			}
+		}
+	}
+
+	free(m_pBlocks);
+}
+
+bool CStreamPrefetch::DecodeBlock()
+{
+	uint32 generation = m_nGeneration.load(std::memory_order_acquire);
+	if ( generation != m_nDecoderGeneration )
+	{
+		m_pDecoder->Seek(m_nSeekPos.load(std::memory_order_relaxed));
+		m_nDecoderGeneration = generation;
+	}
+
+	if ( m_nFinishedGeneration.load(std::memory_order_relaxed) == generation )
+		return false;
+
+	uint32 tail = m_nTail.load(std::memory_order_relaxed);
+	if ( tail - m_nHead.load(std::memory_order_acquire) >= STREAM_PREFETCH_BLOCKS )
+		return false;
+
+	uint32 i = tail % STREAM_PREFETCH_BLOCKS;
+	m_aStartPos[i]   = m_pDecoder->Tell();
+	m_aDataSize[i]   = m_pDecoder->Decode(m_pBlocks + i * m_nBlockSize);
+	m_aEndPos[i]     = m_pDecoder->Tell();
+	m_aGeneration[i] = generation;
+
+	if ( m_aDataSize[i] == 0 )
+	{
+		m_nFinishedGeneration.store(generation, std::memory_order_release);
+		return false;
+	}
+
+	m_nTail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+void CStreamPrefetch::Seek(uint32 nPos)
+{
+	uint32 head = m_nHead.load(std::memory_order_relaxed);
+	uint32 tail = m_nTail.load(std::memory_order_acquire);
+
+	for ( ; head != tail; head++ )
+	{
+		uint32 i = head % STREAM_PREFETCH_BLOCKS;
+		if ( IsCurrent(head) && nPos >= m_aStartPos[i] && nPos < m_aEndPos[i] )
+		{
+			m_nHead.store(head, std::memory_order_release);
+			return;
+		}
+	}
+
+	m_nHead.store(tail, std::memory_order_release);
+	m_nSeekPos.store(nPos, std::memory_order_relaxed);
+	m_nGeneration.fetch_add(1, std::memory_order_release);
+	AudioDecoderWakeUp.notify_one();
+}
+
+void *CStreamPrefetch::Peek(uint32 &nSize, uint32 &nEndPos)
+{
+	uint32 head = m_nHead.load(std::memory_order_relaxed);
+	uint32 tail = m_nTail.load(std::memory_order_acquire);
+
+	// skip whatever the worker decoded before it noticed the last seek
+	while ( head != tail && !IsCurrent(head) )
+		head++;
+	m_nHead.store(head, std::memory_order_release);
+
+	if ( head == tail )
+	{
+		// not prefetched, decode the next block right here like streams used to
+		if ( m_bOnWorker || !DecodeBlock() )
+			return nil;
+	}
+
+	uint32 i = head % STREAM_PREFETCH_BLOCKS;
+	nSize   = m_aDataSize[i];
+	nEndPos = m_aEndPos[i];
+	return m_pBlocks + i * m_nBlockSize;
+}
+
+void CStreamPrefetch::Pop()
+{
+	m_nHead.fetch_add(1, std::memory_order_release);
+	AudioDecoderWakeUp.notify_one();
+}
+
+bool CStreamPrefetch::IsFinished()
+{
+	uint32 size, pos;
+	return m_nFinishedGeneration.load(std::memory_order_acquire) == m_nGeneration.load(std::memory_order_relaxed) && Peek(size, pos) == nil;
+}
+
+static void
+AudioDecoderThreadProc()
+{
+	std::unique_lock<std::mutex> lock(AudioDecoderMutex);
+	while ( !bAudioDecoderQuit )
+	{
+		// one block per stream per round, so nobody waits long for the list
+		bool bDecoded = false;
+		for ( int32 i = 0; i < nNumPrefetchDecoders; i++ )
+		{
+			bDecoded |= aPrefetchDecoders[i]->DecodeBlock();
+			lock.unlock();
+			lock.lock();
+		}
+
+		if ( !bDecoded )
+			AudioDecoderWakeUp.wait_for(lock, std::chrono::milliseconds(10));
+	}
+}
+#endif
+
 void CStream::Initialise()
 {
 #ifdef AUDIO_OAL_USE_MPG123
 	mpg123_init();
 #endif
+#ifdef AUDIO_STREAM_PREFETCH
+	bAudioDecoderQuit = false;
+	AudioDecoderThread = std::thread(AudioDecoderThreadProc);
+#endif
 }
 
 void CStream::Terminate()
 {
+#ifdef AUDIO_STREAM_PREFETCH
+	{
+		std::lock_guard<std::mutex> lock(AudioDecoderMutex);
+		bAudioDecoderQuit = true;
+	}
+	AudioDecoderWakeUp.notify_one();
+	if ( AudioDecoderThread.joinable() )
+		AudioDecoderThread.join();
+#endif
 #ifdef AUDIO_OAL_USE_MPG123
 	mpg123_exit();
 #endif
@@ -981,6 +1203,10 @@ CStream::CStream(char *filename, ALuint *sources, ALuint (&buffers)[NUM_STREAMBU
 	m_nVolume(0),
 	m_nPan(0),
 	m_nPosBeforeReset(0)
+#ifdef AUDIO_STREAM_PREFETCH
+	, m_pPrefetch(nil),
+	m_nQueuedPos(0)
+#endif
 	
 {
 // Be case-insensitive on linux (from https://github.com/OneSadCookie/fcaseopen/)
@@ -1019,6 +1245,10 @@ CStream::CStream(char *filename, ALuint *sources, ALuint (&buffers)[NUM_STREAMBU
 	else 
 		m_pSoundFile = nil;
 
+#ifdef AUDIO_STREAM_PREFETCH
+	ResetFreeBuffers();
+#endif
+
 	if ( IsOpened() )
 	{
 		m_pBuffer            = malloc(m_pSoundFile->GetBufferSize());
@@ -1045,6 +1275,15 @@ void CStream::Delete()
 {
 	Stop();
 	ClearBuffers();
+
+#ifdef AUDIO_STREAM_PREFETCH
+	// has to go before the decoder, the worker may still be using it
+	if ( m_pPrefetch )
+	{
+		delete m_pPrefetch;
+		m_pPrefetch = nil;
+	}
+#endif
 	
 	if ( m_pSoundFile )
 	{
@@ -1153,8 +1392,13 @@ void CStream::SetPan(uint8 nPan)
 void CStream::SetPosMS(uint32 nPos)
 {
 	if ( !IsOpened() ) return;
+#ifdef AUDIO_STREAM_PREFETCH
+	ClearBuffers();
+	PrefetchSeek(nPos);
+#else
 	m_pSoundFile->Seek(nPos);
 	ClearBuffers();
+#endif
 }
 
 uint32 CStream::GetPosMS()
@@ -1166,7 +1410,11 @@ uint32 CStream::GetPosMS()
 	//alGetSourcei(m_alSource, AL_SAMPLE_OFFSET, &offset);
 	alGetSourcei(m_pAlSources[0], AL_BYTE_OFFSET, &offset);
 
+#ifdef AUDIO_STREAM_PREFETCH
+	return m_nQueuedPos
+#else
 	return m_pSoundFile->Tell()
+#endif
 		- m_pSoundFile->samples2ms(m_pSoundFile->GetBufferSamples() * (NUM_STREAMBUFFERS/2-1)) / m_pSoundFile->GetChannels()
 		+ m_pSoundFile->samples2ms(offset/m_pSoundFile->GetSampleSize()) / m_pSoundFile->GetChannels();
 }
@@ -1188,24 +1436,53 @@ bool CStream::FillBuffer(ALuint *alBuffer)
 	if ( !(alBuffer[1] != AL_NONE && alIsBuffer(alBuffer[1])) )
 		return false;
 	
-	uint32 size = m_pSoundFile->Decode(m_pBuffer);
+#ifdef AUDIO_STREAM_PREFETCH
+	if ( !m_pPrefetch )
+		return false;
+
+	uint32 size, endPos;
+	void *pBuffer = m_pPrefetch->Peek(size, endPos);
+	if ( pBuffer == nil )
+		return false;
+#else
+	void *pBuffer = m_pBuffer;
+	uint32 size = m_pSoundFile->Decode(pBuffer);
 	if( size == 0 )
 		return false;
+#endif
 	
 	uint32 channelSize = size / m_pSoundFile->GetChannels();
 
-	alBufferData(alBuffer[0], AL_FORMAT_MONO16, m_pBuffer, channelSize, m_pSoundFile->GetSampleRate());
+	alBufferData(alBuffer[0], AL_FORMAT_MONO16, pBuffer, channelSize, m_pSoundFile->GetSampleRate());
 	// TODO: use just one buffer if we play mono
 	if (m_pSoundFile->GetChannels() == 1)
-		alBufferData(alBuffer[1], AL_FORMAT_MONO16, m_pBuffer, channelSize, m_pSoundFile->GetSampleRate());
+		alBufferData(alBuffer[1], AL_FORMAT_MONO16, pBuffer, channelSize, m_pSoundFile->GetSampleRate());
 	else
-		alBufferData(alBuffer[1], AL_FORMAT_MONO16, (uint8*)m_pBuffer + channelSize, channelSize, m_pSoundFile->GetSampleRate());
+		alBufferData(alBuffer[1], AL_FORMAT_MONO16, (uint8*)pBuffer + channelSize, channelSize, m_pSoundFile->GetSampleRate());
+
+#ifdef AUDIO_STREAM_PREFETCH
+	m_pPrefetch->Pop();
+	m_nQueuedPos = endPos;
+#endif
 	return true;
 }
 
 int32 CStream::FillBuffers()
 {
 	int32 i = 0;
+#ifdef AUDIO_STREAM_PREFETCH
+	// queue whatever the worker has ready into the buffers that aren't queued yet
+	while ( m_nNumFreeBuffers >= 2 )
+	{
+		ALuint *buffer = &m_aFreeBuffers[m_nNumFreeBuffers-2];
+		if ( !FillBuffer(buffer) )
+			break;
+		alSourceQueueBuffers(m_pAlSources[0], 1, &buffer[0]);
+		alSourceQueueBuffers(m_pAlSources[1], 1, &buffer[1]);
+		m_nNumFreeBuffers -= 2;
+		i++;
+	}
+#else
 	for ( i = 0; i < NUM_STREAMBUFFERS/2; i++ )
 	{
 		if ( !FillBuffer(&m_alBuffers[i*2]) )
@@ -1213,12 +1490,48 @@ int32 CStream::FillBuffers()
 		alSourceQueueBuffers(m_pAlSources[0], 1, &m_alBuffers[i*2]);
 		alSourceQueueBuffers(m_pAlSources[1], 1, &m_alBuffers[i*2+1]);
 	}
+#endif
 	
 	return i;
 }
 
+#ifdef AUDIO_STREAM_PREFETCH
+void CStream::ResetFreeBuffers()
+{
+	for ( int32 i = 0; i < NUM_STREAMBUFFERS; i++ )
+		m_aFreeBuffers[i] = m_alBuffers[i];
+	m_nNumFreeBuffers = NUM_STREAMBUFFERS;
+}
+
+void CStream::PrefetchSeek(uint32 nPos)
+{
+	if ( !m_pPrefetch )
+		m_pPrefetch = new CStreamPrefetch(m_pSoundFile);
+	m_pPrefetch->Seek(nPos);
+	m_nQueuedPos = nPos;
+}
+
+void CStream::AttachSources(ALuint *sources, ALuint (&buffers)[NUM_STREAMBUFFERS])
+{
+	ClearBuffers();
+	m_pAlSources = sources;
+	m_alBuffers = buffers;
+	ResetFreeBuffers();
+}
+#endif
+
 void CStream::ClearBuffers()
 {
+#ifdef AUDIO_STREAM_PREFETCH
+	ResetFreeBuffers();
+	if ( !HasSource() ) return;
+
+	// buffers that are still pending can't be unqueued, so detach everything from stopped sources
+	alSourceStop(m_pAlSources[0]);
+	alSourceStop(m_pAlSources[1]);
+	alSourcei(m_pAlSources[0], AL_BUFFER, AL_NONE);
+	alSourcei(m_pAlSources[1], AL_BUFFER, AL_NONE);
+#else
 	if ( !HasSource() ) return;
 	
 	ALint buffersQueued[2];
@@ -1230,13 +1543,18 @@ void CStream::ClearBuffers()
 		alSourceUnqueueBuffers(m_pAlSources[0], 1, &value);
 	while (buffersQueued[1]--)
 		alSourceUnqueueBuffers(m_pAlSources[1], 1, &value);
+#endif
 }
 
 bool CStream::Setup()
 {
 	if ( IsOpened() )
 	{
+#ifdef AUDIO_STREAM_PREFETCH
+		PrefetchSeek(0);
+#else
 		m_pSoundFile->Seek(0);
+#endif
 		//SetPosition(0.0f, 0.0f, 0.0f);
 		SetPitch(1.0f);
 		//SetPan(m_nPan);
@@ -1282,8 +1600,14 @@ void CStream::SetPlay(bool state)
 void CStream::Start()
 {
 	if ( !HasSource() ) return;
+#ifdef AUDIO_STREAM_PREFETCH
+	// if the worker is still catching up after a seek Update starts the sources once data arrives
+	FillBuffers();
+	SetPlay(true);
+#else
 	if ( FillBuffers() != 0 )
 		SetPlay(true);
+#endif
 }
 
 void CStream::Stop()
@@ -1339,6 +1663,25 @@ void CStream::Update()
 			alSourceUnqueueBuffers(m_pAlSources[0], 1, &buffer[0]);
 			alSourceUnqueueBuffers(m_pAlSources[1], 1, &buffer[1]);
 			
+#ifdef AUDIO_STREAM_PREFETCH
+			m_aFreeBuffers[m_nNumFreeBuffers++] = buffer[0];
+			m_aFreeBuffers[m_nNumFreeBuffers++] = buffer[1];
+		}
+
+		if ( m_bActive )
+			FillBuffers();
+
+		if ( sourceState[0] != AL_PLAYING && m_bActive )
+		{
+			// an empty queue is only the end of the track if the decoder ran out, otherwise wait for the worker
+			ALint buffersQueued;
+			alGetSourcei(m_pAlSources[0], AL_BUFFERS_QUEUED, &buffersQueued);
+			if ( buffersQueued != 0 )
+				SetPlay(true);
+			else if ( m_pPrefetch == nil || m_pPrefetch->IsFinished() )
+				SetPlay(false);
+		}
+#else
 			if (m_bActive && FillBuffer(buffer))
 			{
 				alSourceQueueBuffers(m_pAlSources[0], 1, &buffer[0]);
@@ -1351,6 +1694,7 @@ void CStream::Update()
 			alGetSourcei(m_pAlSources[0], AL_BUFFERS_PROCESSED, &buffersProcessed[0]);
 			SetPlay(buffersProcessed[0]!=0);
 		}
+#endif
 	}
 }
 
@@ -54,11 +54,15 @@ public:
 	virtual uint32 Decode(void *buffer) = 0;
 };
 
+#ifdef AUDIO_STREAM_PREFETCH
+class CStreamPrefetch;
+#endif
+
 class CStream
 {
 	char     m_aFilename[128];
 	ALuint  *m_pAlSources;
-	ALuint (&m_alBuffers)[NUM_STREAMBUFFERS];
+	ALuint  *m_alBuffers;
 	
 	bool     m_bPaused;
 	bool     m_bActive;
@@ -71,6 +75,16 @@ class CStream
 	uint32   m_nPosBeforeReset;
 	
 	IDecoder *m_pSoundFile;
+
+#ifdef AUDIO_STREAM_PREFETCH
+	CStreamPrefetch *m_pPrefetch;
+	uint32   m_nQueuedPos;  // decoder position at the end of the last buffer handed to OpenAL
+	ALuint   m_aFreeBuffers[NUM_STREAMBUFFERS];
+	int32    m_nNumFreeBuffers;
+
+	void   PrefetchSeek(uint32 nPos);
+	void   ResetFreeBuffers();
+#endif
 	
 	bool HasSource();
 	void SetPosition(int i, float x, float y, float z);
@@ -106,6 +120,10 @@ public:
 	
 	void ProviderInit();
 	void ProviderTerm();
+
+#ifdef AUDIO_STREAM_PREFETCH
+	void AttachSources(ALuint *sources, ALuint (&buffers)[NUM_STREAMBUFFERS]);
+#endif
 };
 
 #endif
@@ -122,6 +122,9 @@ enum
 #define CHANNEL2D                  MAXCHANNELS
 
 #define MAX_STREAMS                3
+#ifdef AUDIO_STREAM_PREFETCH
+#define MAX_PREFETCH_STREAMS       2
+#endif
 
 #ifdef PSP2
 #define DIGITALRATE                48000
@@ -232,6 +235,9 @@ public:
 	void  SetStreamedVolumeAndPan(uint8 nVolume, uint8 nPan, uint8 nEffectFlag, uint8 nStream);
 	int32 GetStreamedFileLength                                                (uint8 nStream);
 	bool  IsStreamPlaying                                                      (uint8 nStream);
+#ifdef AUDIO_STREAM_PREFETCH
+	void  PrefetchStreamedFile                    (uint32 nFile, uint32 nPos, uint8 nSlot);
+#endif
 #ifdef AUDIO_OAL
 	void  Service(void);
 #endif
@@ -243,6 +249,9 @@ public:
 
 extern cSampleManager SampleManager;
 extern uint32 BankStartOffset[MAX_SFX_BANKS];
+#ifdef AUDIO_MIXER_THREAD
+extern bool gbShowAudioThreadStats;
+#endif
 
 #if defined(OPUS_AUDIO_PATHS)
 static char StreamedNameTable[][25] = {
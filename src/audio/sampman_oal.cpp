@@ -25,14 +25,28 @@
 #include "oal/aldlist.h"
 #include "oal/channel.h"
 #include "oal/stream.h"
+#include "oal/audiothread.h"
 
 #include "AudioManager.h"
 #include "MusicManager.h"
 #include "Frontend.h"
 #include "Timer.h"
+#ifdef AUDIO_MIXER_THREAD
+#include "Debug.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 #ifdef AUDIO_OAL_USE_OPUS
 #include <opusfile.h>
 #endif
+#if defined AUDIO_MAPPED_SFX && !defined _WIN32
+#include <sys/mman.h>
+#endif
+#ifdef AUDIO_CACHE
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 
 //TODO: fix eax3 reverb
 //TODO: max channels
@@ -98,9 +112,149 @@ int32 nPedSlotSfx    [MAX_PEDSFX];
 int32 nPedSlotSfxAddr[MAX_PEDSFX];
 uint8 nCurrentPedSlot;
 
+#ifdef AUDIO_MAPPED_SFX
+// sfx.RAW is plain PCM, so with the whole file mapped the banks and ped comments
+// are addressed in place and loading one never has to touch the disk
+uint8 *pSampleDataMapping;
+size_t nSampleDataMappingSize;
+#ifdef _WIN32
+HANDLE hSampleDataMapping;
+#endif
+
+static bool
+MapSampleData(FILE *fp, size_t size)
+{
+	if ( size == 0 )
+		return false;
+#ifdef _WIN32
+	hSampleDataMapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(fp)), NULL, PAGE_READONLY, 0, 0, NULL);
+	if ( hSampleDataMapping == NULL )
+		return false;
+	pSampleDataMapping = (uint8*)MapViewOfFile(hSampleDataMapping, FILE_MAP_READ, 0, 0, size);
+	if ( pSampleDataMapping == NULL )
+	{
+		CloseHandle(hSampleDataMapping);
+		hSampleDataMapping = NULL;
+		return false;
+	}
+#else
+	void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if ( mapping == MAP_FAILED )
+		return false;
+	pSampleDataMapping = (uint8*)mapping;
+#endif
+	nSampleDataMappingSize = size;
+	return true;
+}
+
+static void
+UnmapSampleData(void)
+{
+	if ( pSampleDataMapping == NULL )
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(pSampleDataMapping);
+	CloseHandle(hSampleDataMapping);
+	hSampleDataMapping = NULL;
+#else
+	munmap(pSampleDataMapping, nSampleDataMappingSize);
+#endif
+	pSampleDataMapping = NULL;
+	nSampleDataMappingSize = 0;
+}
+#endif
+
 CChannel aChannel[MAXCHANNELS+MAX2DCHANNELS];
 uint8 nChannelVolume[MAXCHANNELS+MAX2DCHANNELS];
 
+#ifdef AUDIO_CACHE
+/*
+audio/sound.cache holds everything Initialise would otherwise have to get out of the audio files:
+the length of every stream (which means opening it with its decoder) and the sfx.SDT sample table.
+Every source is stamped with its size and modification time, on a warm start only the stamps are
+checked and just the files that changed are opened again.
+*/
+#define AUDIO_CACHE_MAGIC   0x41334552 // "RE3A"
+#define AUDIO_CACHE_VERSION 2          // 1 was the bare nStreamLength array
+
+char AudioCacheFilename[] = "audio\\sound.cache";
+
+struct tAudioFileStamp
+{
+	uint32 nSize;
+	uint32 nTime;
+
+	bool operator==(const tAudioFileStamp &other) const { return nSize == other.nSize && nTime == other.nTime; }
+	bool operator!=(const tAudioFileStamp &other) const { return !(*this == other); }
+};
+
+struct tAudioCache
+{
+	uint32 nMagic;
+	uint32 nVersion;
+	uint32 nNumStreams;
+	uint32 nNumSamples;
+	tAudioFileStamp sampleDescStamp;
+	tAudioFileStamp aStreamStamps[TOTAL_STREAMED_SOUNDS];
+	uint32 nStreamLength[TOTAL_STREAMED_SOUNDS];
+	tSample aSamples[TOTAL_AUDIO_SAMPLES];
+};
+
+bool bSampleDescCached;
+
+// Returns false if the file doesn't exist, which never matches a cached stamp
+static bool
+GetAudioFileStamp(const char *path, tAudioFileStamp &stamp)
+{
+	struct stat sb;
+	stamp.nSize = 0;
+	stamp.nTime = 0;
+#ifdef _WIN32
+	int result = stat(path, &sb);
+#else
+	char *real = casepath(path);
+	int result = stat(real ? real : path, &sb);
+	free(real);
+#endif
+	if ( result == 0 )
+	{
+		stamp.nSize = (uint32)sb.st_size;
+		stamp.nTime = (uint32)sb.st_mtime;
+	}
+	return result == 0;
+}
+
+static bool
+LoadAudioCache(tAudioCache *cache)
+{
+	FILE *cacheFile = fcaseopen(AudioCacheFilename, "rb");
+	if ( cacheFile == NULL )
+		return false;
+	bool result = fread(cache, sizeof(tAudioCache), 1, cacheFile) == 1
+		&& cache->nMagic == AUDIO_CACHE_MAGIC
+		&& cache->nVersion == AUDIO_CACHE_VERSION
+		&& cache->nNumStreams == TOTAL_STREAMED_SOUNDS
+		&& cache->nNumSamples == TOTAL_AUDIO_SAMPLES;
+	fclose(cacheFile);
+	return result;
+}
+
+static void
+SaveAudioCache(tAudioCache *cache)
+{
+	cache->nMagic = AUDIO_CACHE_MAGIC;
+	cache->nVersion = AUDIO_CACHE_VERSION;
+	cache->nNumStreams = TOTAL_STREAMED_SOUNDS;
+	cache->nNumSamples = TOTAL_AUDIO_SAMPLES;
+
+	FILE *cacheFile = fcaseopen(AudioCacheFilename, "wb");
+	if ( cacheFile == NULL )
+		return;
+	fwrite(cache, sizeof(tAudioCache), 1, cacheFile);
+	fclose(cacheFile);
+}
+#endif
+
 uint32 nStreamLength[TOTAL_STREAMED_SOUNDS];
 ALuint ALStreamSources[MAX_STREAMS][2];
 ALuint ALStreamBuffers[MAX_STREAMS][NUM_STREAMBUFFERS];
@@ -123,6 +277,13 @@ CStream    *aStream[MAX_STREAMS];
 uint8      nStreamPan   [MAX_STREAMS];
 uint8      nStreamVolume[MAX_STREAMS];
 uint8      nStreamLoopedFlag[MAX_STREAMS];
+#ifdef AUDIO_STREAM_PREFETCH
+CStream    *aPrefetchStream[MAX_PREFETCH_STREAMS];
+uint32     nPrefetchFile[MAX_PREFETCH_STREAMS];
+// never generated, prefetched streams only decode until they're moved into a real stream slot
+ALuint     ALPrefetchSources[2];
+ALuint     ALPrefetchBuffers[NUM_STREAMBUFFERS];
+#endif
 uint32 _CurMP3Index;
 int32 _CurMP3Pos;
 bool _bIsMp3Active;
@@ -399,6 +560,368 @@ IsThisTrackAt16KHz(uint32 track)
 	return track == STREAMED_SOUND_RADIO_KCHAT || track == STREAMED_SOUND_RADIO_VCPR || track == STREAMED_SOUND_RADIO_POLICE;
 }
 
+static bool _StartStreamedFile(uint32 nFile, uint32 nPos, uint8 nStream);
+static void _PreloadStreamedFile(uint32 nFile, uint8 nStream);
+#ifdef AUDIO_STREAM_PREFETCH
+static void _PrefetchStreamedFile(uint32 nFile, uint32 nPos, uint8 nSlot);
+#endif
+
+#ifdef AUDIO_MIXER_THREAD
+#define AUDIO_THREAD_SLEEP_MS 5
+
+bool gbShowAudioThreadStats;
+
+CAudioCommandQueue AudioCommandQueue;
+std::thread AudioThread;
+std::recursive_mutex AudioThreadMutex; // held by whoever executes commands
+std::condition_variable_any AudioThreadWakeUp;
+std::atomic<bool> bAudioThreadRunning(false);
+std::atomic<bool> bAudioThreadQuit(false);
+
+// written by the game thread only
+uint32 nAudioCommandSequence;
+uint32 nChannelPendingSequence[MAXCHANNELS+MAX2DCHANNELS];
+bool   bChannelPendingUsed    [MAXCHANNELS+MAX2DCHANNELS];
+uint32 nStreamPendingSequence[MAX_STREAMS];
+bool   bStreamPendingPlaying [MAX_STREAMS];
+int32  nStreamPendingPosition[MAX_STREAMS];
+
+// published after every pass of the mixer
+std::atomic<uint32> nExecutedAudioSequence(0);
+std::atomic<uint32> nChannelUsedMask(0);
+std::atomic<uint32> nStreamPlayingMask(0);
+std::atomic<int32>  nStreamPosition[MAX_STREAMS];
+
+// stats
+uint32 nAudioCommandsSubmitted;
+uint32 nAudioQueueOverflows;
+uint32 nAudioMaxQueueSize;
+std::atomic<uint32> nAudioCommandsExecuted(0);
+std::atomic<uint32> nAudioLastLatency(0);
+std::atomic<uint32> nAudioMaxLatency(0);
+std::atomic<uint32> nAudioThreadPasses(0);
+
+EAXLISTENERPROPERTIES EAX3MixerParams;
+
+static bool
+IsAudioThreadActive(void)
+{
+	return bAudioThreadRunning && std::this_thread::get_id() != AudioThread.get_id();
+}
+
+static void
+ExecuteAudioCommand(const tAudioCommand &cmd)
+{
+	CChannel &channel = aChannel[cmd.nIndex];
+	CStream *stream = cmd.nIndex < MAX_STREAMS ? aStream[cmd.nIndex] : NULL;
+
+	switch ( cmd.nCommand )
+	{
+	case AUDIOCMD_CHANNEL_INIT:
+		if ( channel.IsUsed() )
+			channel.Stop();
+		channel.Reset();
+		if ( channel.HasSource() )
+		{
+			channel.SetSampleData((void*)cmd.pData, cmd.nParam[0], cmd.nParam[1]);
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+			channel.SetSampleId(cmd.nParam[2]);
+#endif
+			channel.SetLoopPoints(0, -1);
+			channel.SetPitch(1.0f);
+		}
+		break;
+	case AUDIOCMD_CHANNEL_START:        channel.Start(); break;
+	case AUDIOCMD_CHANNEL_STOP:         channel.Stop(); break;
+	case AUDIOCMD_CHANNEL_VOLUME:       channel.SetVolume(cmd.nParam[0]); break;
+	case AUDIOCMD_CHANNEL_PAN:          channel.SetPan(cmd.nParam[0]); break;
+	case AUDIOCMD_CHANNEL_POSITION:     channel.SetPosition(cmd.fParam[0], cmd.fParam[1], cmd.fParam[2]); break;
+	case AUDIOCMD_CHANNEL_DISTANCES:    channel.SetDistances(cmd.fParam[0], cmd.fParam[1]); break;
+	case AUDIOCMD_CHANNEL_FREQUENCY:    channel.SetCurrentFreq(cmd.nParam[0]); break;
+	case AUDIOCMD_CHANNEL_LOOP_POINTS:  channel.SetLoopPoints(cmd.nParam[0], cmd.nParam[1]); break;
+	case AUDIOCMD_CHANNEL_LOOP_COUNT:   channel.SetLoopCount(cmd.nParam[0]); break;
+	case AUDIOCMD_CHANNEL_REVERB_MIX:
+		alAuxiliaryEffectSloti(ALEffectSlot, AL_EFFECTSLOT_EFFECT, ALEffect);
+		channel.SetReverbMix(ALEffectSlot, cmd.fParam[0]);
+		break;
+
+	case AUDIOCMD_STREAM_PRELOAD:
+		_PreloadStreamedFile(cmd.nParam[0], cmd.nIndex);
+		break;
+	case AUDIOCMD_STREAM_START_PRELOADED:
+		if ( stream && stream->Setup() )
+			stream->Start();
+		break;
+	case AUDIOCMD_STREAM_START:
+		_StartStreamedFile(cmd.nParam[0], cmd.nParam[1], cmd.nIndex);
+		break;
+	case AUDIOCMD_STREAM_STOP:
+		delete stream;
+		aStream[cmd.nIndex] = NULL;
+		break;
+	case AUDIOCMD_STREAM_PAUSE:
+		if ( stream )
+			stream->SetPause(cmd.nParam[0] != 0);
+		break;
+	case AUDIOCMD_STREAM_VOLUME_PAN:
+		if ( stream )
+		{
+			stream->SetVolume(cmd.nParam[0]);
+			stream->SetPan(cmd.nParam[1]);
+		}
+		break;
+#ifdef AUDIO_STREAM_PREFETCH
+	case AUDIOCMD_STREAM_PREFETCH:
+		_PrefetchStreamedFile(cmd.nParam[0], cmd.nParam[1], cmd.nIndex);
+		break;
+#endif
+
+	case AUDIOCMD_REVERB:
+		if ( EAX3ListenerInterpolate(&StartEAX3, &FinishEAX3, cmd.fParam[0], &EAX3MixerParams, false) )
+			EAX_SetAll(&EAX3MixerParams);
+		break;
+	}
+}
+
+static void
+PublishAudioThreadState(void)
+{
+	uint32 mask = 0;
+	for ( int32 i = 0; i < MAXCHANNELS+MAX2DCHANNELS; i++ )
+	{
+		if ( aChannel[i].IsUsed() )
+			mask |= 1 << i;
+	}
+	nChannelUsedMask.store(mask, std::memory_order_release);
+
+	mask = 0;
+	for ( int32 i = 0; i < MAX_STREAMS; i++ )
+	{
+		CStream *stream = aStream[i];
+		if ( stream && stream->IsPlaying() )
+			mask |= 1 << i;
+		nStreamPosition[i].store(stream ? stream->GetPosMS() : 0, std::memory_order_release);
+	}
+	nStreamPlayingMask.store(mask, std::memory_order_release);
+}
+
+// must be called with AudioThreadMutex held
+static void
+ProcessAudioCommands(void)
+{
+	tAudioCommand cmd;
+	bool bExecuted = false;
+	uint32 nLastSequence = 0;
+
+	while ( AudioCommandQueue.Pop(cmd) )
+	{
+		ExecuteAudioCommand(cmd);
+
+		uint32 latency = (CTimer::GetCurrentTimeInCycles() - cmd.nSubmitTime) / CTimer::GetCyclesPerMillisecond();
+		nAudioLastLatency = latency;
+		if ( latency > nAudioMaxLatency )
+			nAudioMaxLatency = latency;
+		nAudioCommandsExecuted++;
+
+		nLastSequence = cmd.nSequence;
+		bExecuted = true;
+	}
+
+	for ( int32 i = 0; i < MAX_STREAMS; i++ )
+	{
+		if ( aStream[i] )
+			aStream[i]->Update();
+	}
+
+	PublishAudioThreadState();
+	if ( bExecuted )
+		nExecutedAudioSequence.store(nLastSequence, std::memory_order_release);
+}
+
+static void
+AudioThreadProc(void)
+{
+	std::unique_lock<std::recursive_mutex> lock(AudioThreadMutex);
+	while ( !bAudioThreadQuit )
+	{
+		ProcessAudioCommands();
+		nAudioThreadPasses++;
+		AudioThreadWakeUp.wait_for(lock, std::chrono::milliseconds(AUDIO_THREAD_SLEEP_MS),
+			[]() { return bAudioThreadQuit || !AudioCommandQueue.IsEmpty(); });
+	}
+}
+
+static void
+StartAudioThread(void)
+{
+	if ( bAudioThreadRunning )
+		return;
+
+	AudioCommandQueue.Reset();
+	nAudioCommandSequence = 0;
+	nExecutedAudioSequence = 0;
+	for ( int32 i = 0; i < MAXCHANNELS+MAX2DCHANNELS; i++ )
+		nChannelPendingSequence[i] = 0;
+	for ( int32 i = 0; i < MAX_STREAMS; i++ )
+		nStreamPendingSequence[i] = 0;
+	PublishAudioThreadState();
+
+	bAudioThreadQuit = false;
+	AudioThread = std::thread(AudioThreadProc);
+	bAudioThreadRunning = true;
+}
+
+static void
+StopAudioThread(void)
+{
+	if ( !bAudioThreadRunning )
+		return;
+
+	bAudioThreadQuit = true;
+	AudioThreadWakeUp.notify_one();
+	AudioThread.join();
+	bAudioThreadRunning = false;
+
+	// whatever was still queued goes through on this thread
+	std::lock_guard<std::recursive_mutex> lock(AudioThreadMutex);
+	ProcessAudioCommands();
+}
+
+// Commands that change the result of a query are remembered until the mixer
+// has executed them, so the game sees its own requests immediately.
+static void
+RecordPendingState(const tAudioCommand &cmd)
+{
+	switch ( cmd.nCommand )
+	{
+	case AUDIOCMD_CHANNEL_INIT:
+	case AUDIOCMD_CHANNEL_STOP:
+		nChannelPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bChannelPendingUsed[cmd.nIndex] = false;
+		break;
+	case AUDIOCMD_CHANNEL_START:
+		nChannelPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bChannelPendingUsed[cmd.nIndex] = true;
+		break;
+	case AUDIOCMD_STREAM_PRELOAD:
+	case AUDIOCMD_STREAM_STOP:
+		nStreamPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bStreamPendingPlaying[cmd.nIndex] = false;
+		nStreamPendingPosition[cmd.nIndex] = 0;
+		break;
+	case AUDIOCMD_STREAM_START_PRELOADED:
+		nStreamPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bStreamPendingPlaying[cmd.nIndex] = true;
+		nStreamPendingPosition[cmd.nIndex] = 0;
+		break;
+	case AUDIOCMD_STREAM_START:
+		nStreamPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bStreamPendingPlaying[cmd.nIndex] = true;
+		nStreamPendingPosition[cmd.nIndex] = cmd.nParam[1];
+		break;
+	case AUDIOCMD_STREAM_PAUSE:
+		if ( (int32)(nStreamPendingSequence[cmd.nIndex] - nExecutedAudioSequence.load(std::memory_order_acquire)) <= 0 )
+			nStreamPendingPosition[cmd.nIndex] = nStreamPosition[cmd.nIndex].load(std::memory_order_acquire);
+		nStreamPendingSequence[cmd.nIndex] = cmd.nSequence;
+		bStreamPendingPlaying[cmd.nIndex] = cmd.nParam[0] == 0;
+		break;
+	}
+}
+
+static bool
+IsChannelCommandPending(uint32 nChannel)
+{
+	return (int32)(nChannelPendingSequence[nChannel] - nExecutedAudioSequence.load(std::memory_order_acquire)) > 0;
+}
+
+static bool
+IsStreamCommandPending(uint8 nStream)
+{
+	return (int32)(nStreamPendingSequence[nStream] - nExecutedAudioSequence.load(std::memory_order_acquire)) > 0;
+}
+
+// Returns false if the mixer thread isn't running, in which case the caller does the work itself.
+static bool
+QueueAudioCommand(tAudioCommand &cmd)
+{
+	if ( !IsAudioThreadActive() )
+		return false;
+
+	cmd.nSequence = ++nAudioCommandSequence;
+	cmd.nSubmitTime = CTimer::GetCurrentTimeInCycles();
+	if ( !AudioCommandQueue.Push(cmd) )
+	{
+		// Waiting for the mixer to drain the queue could deadlock if this thread holds
+		// a CAudioThreadLock, so empty it here instead. The mutex is recursive.
+		nAudioQueueOverflows++;
+		std::lock_guard<std::recursive_mutex> lock(AudioThreadMutex);
+		ProcessAudioCommands();
+		AudioCommandQueue.Push(cmd);
+	}
+	RecordPendingState(cmd);
+
+	nAudioCommandsSubmitted++;
+	nAudioMaxQueueSize = Max(nAudioMaxQueueSize, AudioCommandQueue.GetSize());
+	return true;
+}
+
+static bool
+QueueAudioCommand(uint8 nCommand, uint8 nIndex, int32 nParam0 = 0, int32 nParam1 = 0, int32 nParam2 = 0, uintptr pData = 0)
+{
+	tAudioCommand cmd;
+	cmd.nCommand = nCommand;
+	cmd.nIndex = nIndex;
+	cmd.nParam[0] = nParam0;
+	cmd.nParam[1] = nParam1;
+	cmd.nParam[2] = nParam2;
+	cmd.pData = pData;
+	return QueueAudioCommand(cmd);
+}
+
+static bool
+QueueAudioCommandf(uint8 nCommand, uint8 nIndex, float fParam0, float fParam1 = 0.0f, float fParam2 = 0.0f)
+{
+	tAudioCommand cmd;
+	cmd.nCommand = nCommand;
+	cmd.nIndex = nIndex;
+	cmd.fParam[0] = fParam0;
+	cmd.fParam[1] = fParam1;
+	cmd.fParam[2] = fParam2;
+	cmd.pData = 0;
+	return QueueAudioCommand(cmd);
+}
+
+// Takes the mixer over for code that has to touch OpenAL synchronously (provider changes).
+// Everything queued before is executed first.
+class CAudioThreadLock
+{
+public:
+	CAudioThreadLock()
+	{
+		AudioThreadMutex.lock();
+		if ( bAudioThreadRunning )
+			ProcessAudioCommands();
+	}
+	~CAudioThreadLock()
+	{
+		if ( bAudioThreadRunning )
+			PublishAudioThreadState();
+		AudioThreadMutex.unlock();
+	}
+};
+
+static void
+PrintAudioThreadStats(void)
+{
+	char str[128];
+	sprintf(str, "AUDIO CMDS %d/%d QUEUED %d MAX %d OVERFLOWS %d", nAudioCommandsExecuted.load(), nAudioCommandsSubmitted,
+		AudioCommandQueue.GetSize(), nAudioMaxQueueSize, nAudioQueueOverflows);
+	CDebug::PrintAt(str, 2, 20);
+	sprintf(str, "AUDIO LATENCY %dMS MAX %dMS PASSES %d", nAudioLastLatency.load(), nAudioMaxLatency.load(), nAudioThreadPasses.load());
+	CDebug::PrintAt(str, 2, 21);
+}
+#endif
+
 cSampleManager::cSampleManager(void)
 {
 	;
@@ -449,6 +972,9 @@ int8 cSampleManager::GetCurrent3DProviderIndex(void)
 
 int8 cSampleManager::SetCurrent3DProvider(uint8 nProvider)
 {
+#ifdef AUDIO_MIXER_THREAD
+	CAudioThreadLock lock;
+#endif
 	int savedprovider = curprovider;
 
 	nProvider = clamp(nProvider, 0, m_nNumberOfProviders - 1);
@@ -467,6 +993,9 @@ cSampleManager::AutoDetect3DProviders()
 	if (!AudioManager.IsAudioInitialised())
 		return -1;
 
+#ifdef AUDIO_MIXER_THREAD
+	CAudioThreadLock lock;
+#endif
 	if (defaultProvider >= 0 && defaultProvider < m_nNumberOfProviders) {
 		if (set_new_provider(defaultProvider))
 			return defaultProvider;
@@ -898,6 +1427,9 @@ cSampleManager::IsMP3RadioChannelAvailable(void)
 
 void cSampleManager::ReleaseDigitalHandle(void)
 {
+#ifdef AUDIO_MIXER_THREAD
+	CAudioThreadLock lock;
+#endif
 	if ( ALDevice )
 	{
 		prevprovider = curprovider;
@@ -908,6 +1440,9 @@ void cSampleManager::ReleaseDigitalHandle(void)
 
 void cSampleManager::ReacquireDigitalHandle(void)
 {
+#ifdef AUDIO_MIXER_THREAD
+	CAudioThreadLock lock;
+#endif
 	if ( ALDevice )
 	{
 		if ( prevprovider != -1 )
@@ -991,19 +1526,36 @@ cSampleManager::Initialise(void)
 			nStreamLength[i] = 0;
 	}
 	
+#ifdef AUDIO_CACHE
+	uint32 nInitStartTime = CTimer::GetCurrentTimeInCycles();
+#endif
+
 		add_providers();
 
 #ifdef AUDIO_CACHE
-	FILE *cacheFile = fcaseopen("audio\\sound.cache", "rb");
-	if (cacheFile) {
-		fread(nStreamLength, sizeof(uint32), TOTAL_STREAMED_SOUNDS, cacheFile);
-		fclose(cacheFile);
-	} else
+	uint32 nProvidersTime = CTimer::GetCurrentTimeInCycles();
+
+	tAudioCache *cache = new tAudioCache;
+	bool bCacheLoaded = LoadAudioCache(cache);
+	bool bCacheChanged = !bCacheLoaded;
+	int32 nStreamsMeasured = 0;
 #endif
 	{
 	
 		for ( int32 i = 0; i < TOTAL_STREAMED_SOUNDS; i++ )
 		{	
+#ifdef AUDIO_CACHE
+			tAudioFileStamp stamp;
+			bool bFound = GetAudioFileStamp(StreamedNameTable[i], stamp);
+			if ( bCacheLoaded && bFound && cache->aStreamStamps[i] == stamp )
+			{
+				nStreamLength[i] = cache->nStreamLength[i];
+				continue;
+			}
+			cache->aStreamStamps[i] = stamp;
+			bCacheChanged = true;
+			nStreamsMeasured++;
+#endif
 			aStream[0] = new CStream(StreamedNameTable[i], ALStreamSources[0], ALStreamBuffers[0], IsThisTrackAt16KHz(i) ? 16000 : 32000);
 			
 			if ( aStream[0] && aStream[0]->IsOpened() )
@@ -1016,35 +1568,80 @@ cSampleManager::Initialise(void)
 			}
 			else
 				USERERROR("Can't open '%s'\n", StreamedNameTable[i]);
-		}
 #ifdef AUDIO_CACHE
-		cacheFile = fcaseopen("audio\\sound.cache", "wb");
-		fwrite(nStreamLength, sizeof(uint32), TOTAL_STREAMED_SOUNDS, cacheFile);
-		fclose(cacheFile);
+			cache->nStreamLength[i] = nStreamLength[i];
 #endif
+		}
 	}
 
+#ifdef AUDIO_CACHE
+	uint32 nStreamsTime = CTimer::GetCurrentTimeInCycles();
+
+	tAudioFileStamp descStamp;
+	bool bDescFound = GetAudioFileStamp(SampleBankDescFilename, descStamp);
+	bSampleDescCached = bCacheLoaded && bDescFound && cache->sampleDescStamp == descStamp;
+	if ( bSampleDescCached )
+		memcpy(m_aSamples, cache->aSamples, sizeof(m_aSamples));
+#endif
+
 	{
 		if ( !InitialiseSampleBanks() )
 		{
+#ifdef AUDIO_CACHE
+			delete cache;
+#endif
 			Terminate();
 			return false;
 		}
 		
-		nSampleBankMemoryStartAddress[SFX_BANK_0] = (uintptr)malloc(nSampleBankSize[SFX_BANK_0]);
-		ASSERT(nSampleBankMemoryStartAddress[SFX_BANK_0] != 0);
-		
-		if ( nSampleBankMemoryStartAddress[SFX_BANK_0] == 0 )
+#ifdef AUDIO_CACHE
+		if ( !bSampleDescCached )
 		{
-			Terminate();
-			return false;
+			cache->sampleDescStamp = descStamp;
+			memcpy(cache->aSamples, m_aSamples, sizeof(m_aSamples));
+			bCacheChanged = true;
 		}
+		if ( bCacheChanged )
+			SaveAudioCache(cache);
+		delete cache;
+#endif
+
+#ifdef AUDIO_MAPPED_SFX
+		if ( pSampleDataMapping )
+		{
+			nSampleBankMemoryStartAddress[SFX_BANK_0]            = (uintptr)(pSampleDataMapping + nSampleBankDiscStartOffset[SFX_BANK_0]);
+			nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] = (uintptr)(pSampleDataMapping + nSampleBankDiscStartOffset[SFX_BANK_PED_COMMENTS]);
+		}
+		else
+#endif
+		{
+			nSampleBankMemoryStartAddress[SFX_BANK_0] = (uintptr)malloc(nSampleBankSize[SFX_BANK_0]);
+			ASSERT(nSampleBankMemoryStartAddress[SFX_BANK_0] != 0);
 		
-		nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] = (uintptr)malloc(PED_BLOCKSIZE*MAX_PEDSFX);
-		ASSERT(nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] != 0);
+			if ( nSampleBankMemoryStartAddress[SFX_BANK_0] == 0 )
+			{
+				Terminate();
+				return false;
+			}
+		
+			nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] = (uintptr)malloc(PED_BLOCKSIZE*MAX_PEDSFX);
+			ASSERT(nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] != 0);
+		}
 	
 		LoadSampleBank(SFX_BANK_0);
 	}
+
+#ifdef AUDIO_CACHE
+	{
+		uint32 nSampleBanksTime = CTimer::GetCurrentTimeInCycles();
+		uint32 cyclesPerMs = Max(CTimer::GetCyclesPerMillisecond(), 1u);
+		debug("Audio init: providers %dms, streams %dms (%d of %d measured), sample banks %dms (sfx.SDT %s), total %dms\n",
+			(nProvidersTime - nInitStartTime) / cyclesPerMs,
+			(nStreamsTime - nProvidersTime) / cyclesPerMs, nStreamsMeasured, TOTAL_STREAMED_SOUNDS,
+			(nSampleBanksTime - nStreamsTime) / cyclesPerMs, bSampleDescCached ? "cached" : "read",
+			(nSampleBanksTime - nInitStartTime) / cyclesPerMs);
+	}
+#endif
 	
 	{
 		for ( int32 i = 0; i < MAX_STREAMS; i++ )
@@ -1053,6 +1650,13 @@ cSampleManager::Initialise(void)
 			nStreamVolume[i] = 100;
 			nStreamPan[i]    = 63;
 		}
+#ifdef AUDIO_STREAM_PREFETCH
+		for ( int32 i = 0; i < MAX_PREFETCH_STREAMS; i++ )
+		{
+			aPrefetchStream[i] = NULL;
+			nPrefetchFile[i]   = NO_TRACK;
+		}
+#endif
 	}
 	
 	{
@@ -1128,6 +1732,10 @@ cSampleManager::Initialise(void)
 		
 		_bIsMp3Active = false;
 	}
+
+#ifdef AUDIO_MIXER_THREAD
+	StartAudioThread();
+#endif
 	
 	return true;
 }
@@ -1135,6 +1743,10 @@ cSampleManager::Initialise(void)
 void
 cSampleManager::Terminate(void)
 {
+#ifdef AUDIO_MIXER_THREAD
+	StopAudioThread();
+#endif
+
 	for (int32 i = 0; i < MAX_STREAMS; i++)
 	{
 		CStream *stream = aStream[i];
@@ -1145,12 +1757,30 @@ cSampleManager::Terminate(void)
 		}
 	}
 
+#ifdef AUDIO_STREAM_PREFETCH
+	for (int32 i = 0; i < MAX_PREFETCH_STREAMS; i++)
+	{
+		delete aPrefetchStream[i];
+		aPrefetchStream[i] = NULL;
+	}
+#endif
+
 	release_existing();
 
 	_DeleteMP3Entries();
 
 	CStream::Terminate();
 
+#ifdef AUDIO_MAPPED_SFX
+	if ( pSampleDataMapping )
+	{
+		// the banks point into the mapping, there's nothing to free
+		nSampleBankMemoryStartAddress[SFX_BANK_0] = 0;
+		nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] = 0;
+		UnmapSampleData();
+	}
+#endif
+
 	if ( nSampleBankMemoryStartAddress[SFX_BANK_0] != 0 )
 	{
 		free((void *)nSampleBankMemoryStartAddress[SFX_BANK_0]);
@@ -1186,7 +1816,14 @@ cSampleManager::UpdateEffectsVolume(void)
 			if ( GetChannelUsedFlag(i) )
 			{
 				if ( nChannelVolume[i] != 0 )
-					aChannel[i].SetVolume(m_nEffectsFadeVolume*nChannelVolume[i]*m_nEffectsVolume >> 14);
+				{
+					uint32 vol = m_nEffectsFadeVolume*nChannelVolume[i]*m_nEffectsVolume >> 14;
+#ifdef AUDIO_MIXER_THREAD
+					if ( QueueAudioCommand(AUDIOCMD_CHANNEL_VOLUME, i, vol) )
+						continue;
+#endif
+					aChannel[i].SetVolume(vol);
+				}
 			}
 		}
 	}
@@ -1245,6 +1882,14 @@ cSampleManager::LoadSampleBank(uint8 nBank)
 		return false;
 	}
 	
+#ifdef AUDIO_MAPPED_SFX
+	if ( pSampleDataMapping )
+	{
+		bSampleBankLoaded[nBank] = true;
+		return true;
+	}
+#endif
+
 #ifdef OPUS_SFX
 	int samplesRead = 0;
 	int samplesSize = nSampleBankSize[nBank] / 2;
@@ -1364,11 +2009,17 @@ cSampleManager::LoadPedComment(uint32 nComment)
 		samplesSize -= size;
 	}
 #else
-	if ( fseek(fpSampleDataHandle, m_aSamples[nComment].nOffset, SEEK_SET) != 0 )
-		return false;
-	
-	if ( fread((void *)(nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] + PED_BLOCKSIZE*nCurrentPedSlot), 1, m_aSamples[nComment].nSize, fpSampleDataHandle) != m_aSamples[nComment].nSize )
-		return false;
+#ifdef AUDIO_MAPPED_SFX
+	// the comment is read straight from the mapping, only remember which one is "loaded"
+	if ( pSampleDataMapping == NULL )
+#endif
+	{
+		if ( fseek(fpSampleDataHandle, m_aSamples[nComment].nOffset, SEEK_SET) != 0 )
+			return false;
+		
+		if ( fread((void *)(nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] + PED_BLOCKSIZE*nCurrentPedSlot), 1, m_aSamples[nComment].nSize, fpSampleDataHandle) != m_aSamples[nComment].nSize )
+			return false;
+	}
 
 #endif
 	nPedSlotSfx[nCurrentPedSlot] = nComment;
@@ -1457,6 +2108,9 @@ bool cSampleManager::UpdateReverb(void)
 		fRatio = Min(fRatio * 1.67f, 1.0f);
 		if ( EAX3ListenerInterpolate(&StartEAX3, &FinishEAX3, fRatio, &EAX3Params, false) )
 		{
+#ifdef AUDIO_MIXER_THREAD
+			if ( !QueueAudioCommandf(AUDIOCMD_REVERB, 0, fRatio) )
+#endif
 			EAX_SetAll(&EAX3Params);
 			
 			/*
@@ -1495,6 +2149,10 @@ cSampleManager::SetChannelReverbFlag(uint32 nChannel, uint8 nReverbFlag)
 	{
 		if ( IsFXSupported() )
 		{
+#ifdef AUDIO_MIXER_THREAD
+			if ( QueueAudioCommandf(AUDIOCMD_CHANNEL_REVERB_MIX, nChannel, nReverbFlag != 0 ? _fEffectsLevel : 0.0f) )
+				return;
+#endif
 			alAuxiliaryEffectSloti(ALEffectSlot, AL_EFFECTSLOT_EFFECT, ALEffect);
 			
 			if ( nReverbFlag != 0 )
@@ -1524,8 +2182,15 @@ cSampleManager::InitialiseChannel(uint32 nChannel, uint32 nSfx, uint8 nBank)
 		if ( !IsPedCommentLoaded(nSfx) )
 			return false;
 		
-		int32 slot = _GetPedCommentSlot(nSfx);
-		addr = (nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] + PED_BLOCKSIZE * slot);
+#ifdef AUDIO_MAPPED_SFX
+		if ( pSampleDataMapping )
+			addr = (uintptr)(pSampleDataMapping + m_aSamples[nSfx].nOffset);
+		else
+#endif
+		{
+			int32 slot = _GetPedCommentSlot(nSfx);
+			addr = (nSampleBankMemoryStartAddress[SFX_BANK_PED_COMMENTS] + PED_BLOCKSIZE * slot);
+		}
 	}
 	
 	if ( GetChannelUsedFlag(nChannel) )
@@ -1533,11 +2198,25 @@ cSampleManager::InitialiseChannel(uint32 nChannel, uint32 nSfx, uint8 nBank)
 		TRACE("Stopping channel %d - really!!!", nChannel);
 		StopChannel(nChannel);
 	}
+
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		// sources are only created/destroyed under CAudioThreadLock, so this is safe to ask from here
+		if ( !aChannel[nChannel].HasSource() )
+			return false;
+		QueueAudioCommand(AUDIOCMD_CHANNEL_INIT, nChannel, m_aSamples[nSfx].nSize, m_aSamples[nSfx].nFrequency, nSfx, addr);
+		return true;
+	}
+#endif
 	
 	aChannel[nChannel].Reset();
 	if ( aChannel[nChannel].HasSource() )
 	{	
 		aChannel[nChannel].SetSampleData   ((void*)addr, m_aSamples[nSfx].nSize, m_aSamples[nSfx].nFrequency);
+#ifdef AUDIO_SAMPLE_BUFFER_CACHE
+		aChannel[nChannel].SetSampleId     (nSfx);
+#endif
 		aChannel[nChannel].SetLoopPoints   (0, -1);
 		aChannel[nChannel].SetPitch        (1.0f);
 		return true;
@@ -1565,6 +2244,10 @@ cSampleManager::SetChannelEmittingVolume(uint32 nChannel, uint32 nVolume)
 	}
 
 	// no idea, does this one looks like a bug or it's SetChannelVolume ?
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_VOLUME, nChannel, m_nEffectsFadeVolume*nChannelVolume[nChannel]*m_nEffectsVolume >> 14) )
+		return;
+#endif
 	aChannel[nChannel].SetVolume(m_nEffectsFadeVolume*nChannelVolume[nChannel]*m_nEffectsVolume >> 14);
 }
 
@@ -1574,6 +2257,10 @@ cSampleManager::SetChannel3DPosition(uint32 nChannel, float fX, float fY, float
 	ASSERT( nChannel != CHANNEL2D );
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommandf(AUDIOCMD_CHANNEL_POSITION, nChannel, -fX, fY, fZ) )
+		return;
+#endif
 	aChannel[nChannel].SetPosition(-fX, fY, fZ);
 }
 
@@ -1582,6 +2269,10 @@ cSampleManager::SetChannel3DDistances(uint32 nChannel, float fMax, float fMin)
 {
 	ASSERT( nChannel != CHANNEL2D );
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommandf(AUDIOCMD_CHANNEL_DISTANCES, nChannel, fMax, fMin) )
+		return;
+#endif
 	aChannel[nChannel].SetDistances(fMax, fMin);
 }
 
@@ -1606,6 +2297,10 @@ cSampleManager::SetChannelVolume(uint32 nChannel, uint32 nVolume)
 				nChannelVolume[nChannel] >>= 2;
 		}
 
+#ifdef AUDIO_MIXER_THREAD
+		if ( QueueAudioCommand(AUDIOCMD_CHANNEL_VOLUME, nChannel, m_nEffectsFadeVolume*vol*m_nEffectsVolume >> 14) )
+			return;
+#endif
 		aChannel[nChannel].SetVolume(m_nEffectsFadeVolume*vol*m_nEffectsVolume >> 14);
 	}
 }
@@ -1618,6 +2313,10 @@ cSampleManager::SetChannelPan(uint32 nChannel, uint32 nPan)
 	
 	if ( nChannel == CHANNEL2D )
 	{
+#ifdef AUDIO_MIXER_THREAD
+		if ( QueueAudioCommand(AUDIOCMD_CHANNEL_PAN, nChannel, nPan) )
+			return;
+#endif
 		aChannel[nChannel].SetPan(nPan);
 	}
 }
@@ -1627,6 +2326,10 @@ cSampleManager::SetChannelFrequency(uint32 nChannel, uint32 nFreq)
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_FREQUENCY, nChannel, nFreq) )
+		return;
+#endif
 	aChannel[nChannel].SetCurrentFreq(nFreq);
 }
 
@@ -1635,6 +2338,10 @@ cSampleManager::SetChannelLoopPoints(uint32 nChannel, uint32 nLoopStart, int32 n
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_LOOP_POINTS, nChannel, nLoopStart / (DIGITALBITS / 8), nLoopEnd / (DIGITALBITS / 8)) )
+		return;
+#endif
 	aChannel[nChannel].SetLoopPoints(nLoopStart / (DIGITALBITS / 8), nLoopEnd / (DIGITALBITS / 8));
 }
 
@@ -1643,6 +2350,10 @@ cSampleManager::SetChannelLoopCount(uint32 nChannel, uint32 nLoopCount)
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_LOOP_COUNT, nChannel, nLoopCount) )
+		return;
+#endif
 	aChannel[nChannel].SetLoopCount(nLoopCount);
 }
 
@@ -1651,6 +2362,14 @@ cSampleManager::GetChannelUsedFlag(uint32 nChannel)
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		if ( IsChannelCommandPending(nChannel) )
+			return bChannelPendingUsed[nChannel];
+		return !!(nChannelUsedMask.load(std::memory_order_acquire) & (1 << nChannel));
+	}
+#endif
 	return aChannel[nChannel].IsUsed();
 }
 
@@ -1659,6 +2378,10 @@ cSampleManager::StartChannel(uint32 nChannel)
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_START, nChannel) )
+		return;
+#endif
 	aChannel[nChannel].Start();
 }
 
@@ -1667,43 +2390,103 @@ cSampleManager::StopChannel(uint32 nChannel)
 {
 	ASSERT( nChannel < MAXCHANNELS+MAX2DCHANNELS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_CHANNEL_STOP, nChannel) )
+		return;
+#endif
 	aChannel[nChannel].Stop();
 }
 
 void
 cSampleManager::PreloadStreamedFile(uint32 nFile, uint8 nStream)
+{
+	ASSERT( nStream < MAX_STREAMS );
+
+	if ( nFile < TOTAL_STREAMED_SOUNDS )
+	{
+#ifdef AUDIO_MIXER_THREAD
+		if ( QueueAudioCommand(AUDIOCMD_STREAM_PRELOAD, nStream, nFile) )
+			return;
+#endif
+		_PreloadStreamedFile(nFile, nStream);
+	}
+}
+
+static void
+_PreloadStreamedFile(uint32 nFile, uint8 nStream)
 {
 	char filename[MAX_PATH];
 	
-	ASSERT( nStream < MAX_STREAMS );
+	if ( aStream[nStream] )
+	{
+		delete aStream[nStream];
+		aStream[nStream] = NULL;
+	}
+	
+	strcpy(filename, StreamedNameTable[nFile]);
+	
+	CStream *stream = new CStream(filename, ALStreamSources[nStream], ALStreamBuffers[nStream], IsThisTrackAt16KHz(nFile) ? 16000 : 32000);
+	ASSERT(stream != NULL);
+	
+	aStream[nStream] = stream;
+	if ( !stream->IsOpened() )
+	{
+		delete stream;
+		aStream[nStream] = NULL;
+	}
+}
+
+#ifdef AUDIO_STREAM_PREFETCH
+void
+cSampleManager::PrefetchStreamedFile(uint32 nFile, uint32 nPos, uint8 nSlot)
+{
+	ASSERT( nSlot < MAX_PREFETCH_STREAMS );
 
 	if ( nFile < TOTAL_STREAMED_SOUNDS )
 	{
-		if ( aStream[nStream] )
-		{
-			delete aStream[nStream];
-			aStream[nStream] = NULL;
-		}
-		
-		strcpy(filename, StreamedNameTable[nFile]);
-		
-		CStream *stream = new CStream(filename, ALStreamSources[nStream], ALStreamBuffers[nStream], IsThisTrackAt16KHz(nFile) ? 16000 : 32000);
+#ifdef AUDIO_MIXER_THREAD
+		if ( QueueAudioCommand(AUDIOCMD_STREAM_PREFETCH, nSlot, nFile, nPos) )
+			return;
+#endif
+		_PrefetchStreamedFile(nFile, nPos, nSlot);
+	}
+}
+
+static void
+_PrefetchStreamedFile(uint32 nFile, uint32 nPos, uint8 nSlot)
+{
+	if ( aPrefetchStream[nSlot] == NULL || nPrefetchFile[nSlot] != nFile )
+	{
+		delete aPrefetchStream[nSlot];
+		aPrefetchStream[nSlot] = NULL;
+		nPrefetchFile[nSlot] = NO_TRACK;
+
+		CStream *stream = new CStream(StreamedNameTable[nFile], ALPrefetchSources, ALPrefetchBuffers, IsThisTrackAt16KHz(nFile) ? 16000 : 32000);
 		ASSERT(stream != NULL);
-		
-		aStream[nStream] = stream;
 		if ( !stream->IsOpened() )
 		{
 			delete stream;
-			aStream[nStream] = NULL;
+			return;
 		}
+
+		aPrefetchStream[nSlot] = stream;
+		nPrefetchFile[nSlot] = nFile;
 	}
+
+	// keeps the decoded window sliding along with the station's clock
+	aPrefetchStream[nSlot]->SetPosMS(nPos);
 }
+#endif
 
 void
 cSampleManager::PauseStream(uint8 nPauseFlag, uint8 nStream)
 {
 	ASSERT( nStream < MAX_STREAMS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_STREAM_PAUSE, nStream, nPauseFlag) )
+		return;
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1717,6 +2500,10 @@ cSampleManager::StartPreloadedStreamedFile(uint8 nStream)
 {
 	ASSERT( nStream < MAX_STREAMS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_STREAM_START_PRELOADED, nStream) )
+		return;
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1730,12 +2517,23 @@ cSampleManager::StartPreloadedStreamedFile(uint8 nStream)
 
 bool
 cSampleManager::StartStreamedFile(uint32 nFile, uint32 nPos, uint8 nStream)
+{
+	ASSERT( nStream < MAX_STREAMS );
+
+#ifdef AUDIO_MIXER_THREAD
+	// the file is opened on the mixer thread, so a missing file can't be reported here anymore
+	if ( nFile < TOTAL_STREAMED_SOUNDS && QueueAudioCommand(AUDIOCMD_STREAM_START, nStream, nFile, nPos) )
+		return true;
+#endif
+	return _StartStreamedFile(nFile, nPos, nStream);
+}
+
+static bool
+_StartStreamedFile(uint32 nFile, uint32 nPos, uint8 nStream)
 {
 	uint32 position = nPos;
 	char filename[256];
 	
-	ASSERT( nStream < MAX_STREAMS );
-	
 	if ( nFile < TOTAL_STREAMED_SOUNDS )
 	{
 		if ( aStream[nStream] )
@@ -1873,6 +2671,25 @@ cSampleManager::StartStreamedFile(uint32 nFile, uint32 nPos, uint8 nStream)
 			nFile = 0;
 		}
 
+#ifdef AUDIO_STREAM_PREFETCH
+		for ( int32 i = 0; i < MAX_PREFETCH_STREAMS; i++ )
+		{
+			if ( aPrefetchStream[i] && nPrefetchFile[i] == nFile )
+			{
+				// already open and most likely decoded around position, SetPosMS keeps what it can
+				CStream *stream = aPrefetchStream[i];
+				aPrefetchStream[i] = NULL;
+				nPrefetchFile[i] = NO_TRACK;
+
+				stream->AttachSources(ALStreamSources[nStream], ALStreamBuffers[nStream]);
+				aStream[nStream] = stream;
+				stream->SetPosMS(position);
+				stream->Start();
+				return true;
+			}
+		}
+#endif
+
 		strcpy(filename, StreamedNameTable[nFile]);
 		
 		CStream *stream = new CStream(filename, ALStreamSources[nStream], ALStreamBuffers[nStream], IsThisTrackAt16KHz(nFile) ? 16000 : 32000);
@@ -1903,6 +2720,10 @@ cSampleManager::StopStreamedFile(uint8 nStream)
 {
 	ASSERT( nStream < MAX_STREAMS );
 
+#ifdef AUDIO_MIXER_THREAD
+	if ( QueueAudioCommand(AUDIOCMD_STREAM_STOP, nStream) )
+		return;
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1917,6 +2738,14 @@ cSampleManager::GetStreamedFilePosition(uint8 nStream)
 {
 	ASSERT( nStream < MAX_STREAMS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		if ( IsStreamCommandPending(nStream) )
+			return nStreamPendingPosition[nStream];
+		return nStreamPosition[nStream].load(std::memory_order_acquire);
+	}
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1946,6 +2775,23 @@ cSampleManager::SetStreamedVolumeAndPan(uint8 nVolume, uint8 nPan, uint8 nEffect
 	nStreamVolume[nStream] = nVolume;
 	nStreamPan   [nStream] = nPan;
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		uint32 vol;
+		if ( nEffectFlag ) {
+			if ( nStream == 1 || nStream == 2 )
+				vol = 128*nVolume*m_nEffectsVolume >> 14;
+			else
+				vol = m_nEffectsFadeVolume*nVolume*m_nEffectsVolume >> 14;
+		}
+		else
+			vol = (m_nMusicFadeVolume*nVolume*(uint32)(m_nMusicVolume * boostMult + m_nMusicVolume)) >> 14;
+
+		QueueAudioCommand(AUDIOCMD_STREAM_VOLUME_PAN, nStream, vol, nPan);
+		return;
+	}
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1976,6 +2822,14 @@ cSampleManager::IsStreamPlaying(uint8 nStream)
 {
 	ASSERT( nStream < MAX_STREAMS );
 	
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		if ( IsStreamCommandPending(nStream) )
+			return bStreamPendingPlaying[nStream];
+		return !!(nStreamPlayingMask.load(std::memory_order_acquire) & (1 << nStream));
+	}
+#endif
 	CStream *stream = aStream[nStream];
 	
 	if ( stream )
@@ -1990,6 +2844,16 @@ cSampleManager::IsStreamPlaying(uint8 nStream)
 void
 cSampleManager::Service(void)
 {
+#ifdef AUDIO_MIXER_THREAD
+	if ( IsAudioThreadActive() )
+	{
+		// streams are serviced by the mixer, just make sure it doesn't sleep on a full frame of commands
+		AudioThreadWakeUp.notify_one();
+		if ( gbShowAudioThreadStats )
+			PrintAudioThreadStats();
+		return;
+	}
+#endif
 	for ( int32 i = 0; i < MAX_STREAMS; i++ )
 	{
 		CStream *stream = aStream[i];
@@ -2004,14 +2868,21 @@ cSampleManager::InitialiseSampleBanks(void)
 {
 	int32 nBank = SFX_BANK_0;
 	
-	fpSampleDescHandle = fcaseopen(SampleBankDescFilename, "rb");
-	if ( fpSampleDescHandle == NULL )
-		return false;
+#ifdef AUDIO_CACHE
+	// the sample table came from sound.cache, sfx.SDT doesn't have to be opened
+	if ( !bSampleDescCached )
+#endif
+	{
+		fpSampleDescHandle = fcaseopen(SampleBankDescFilename, "rb");
+		if ( fpSampleDescHandle == NULL )
+			return false;
+	}
 #ifndef OPUS_SFX
 	fpSampleDataHandle = fcaseopen(SampleBankDataFilename, "rb");
 	if ( fpSampleDataHandle == NULL )
 	{
-		fclose(fpSampleDescHandle);
+		if ( fpSampleDescHandle )
+			fclose(fpSampleDescHandle);
 		fpSampleDescHandle = NULL;
 		
 		return false;
@@ -2024,12 +2895,15 @@ cSampleManager::InitialiseSampleBanks(void)
 	int e;
 	fpSampleDataHandle = op_open_file(SampleBankDataFilename, &e);
 #endif
-	fread(m_aSamples, sizeof(tSample), TOTAL_AUDIO_SAMPLES, fpSampleDescHandle);
+	if ( fpSampleDescHandle )
+	{
+		fread(m_aSamples, sizeof(tSample), TOTAL_AUDIO_SAMPLES, fpSampleDescHandle);
+		fclose(fpSampleDescHandle);
+		fpSampleDescHandle = NULL;
+	}
 #ifdef OPUS_SFX
 	int32 _nSampleDataEndOffset = m_aSamples[TOTAL_AUDIO_SAMPLES - 1].nOffset + m_aSamples[TOTAL_AUDIO_SAMPLES - 1].nSize;
 #endif
-	fclose(fpSampleDescHandle);
-	fpSampleDescHandle = NULL;
 	
 	for ( int32 i = 0; i < TOTAL_AUDIO_SAMPLES; i++ )
 	{
@@ -2046,6 +2920,11 @@ cSampleManager::InitialiseSampleBanks(void)
 	nSampleBankSize[SFX_BANK_0] = nSampleBankDiscStartOffset[SFX_BANK_PED_COMMENTS] - nSampleBankDiscStartOffset[SFX_BANK_0];
 	nSampleBankSize[SFX_BANK_PED_COMMENTS]  = _nSampleDataEndOffset                      - nSampleBankDiscStartOffset[SFX_BANK_PED_COMMENTS];
 
+#ifdef AUDIO_MAPPED_SFX
+	// if this fails we just read the banks into memory like before
+	MapSampleData(fpSampleDataHandle, _nSampleDataEndOffset);
+#endif
+
 	return true;
 }
 
@@ -28,6 +28,8 @@
 #include "RoadBlocks.h"
 #include "Timer.h"
 #include "TrafficLights.h"
+#include "TrafficLod.h"
+#include "TrafficSnapshot.h"
 #include "Streaming.h"
 #include "VisibilityPlugins.h"
 #include "Vehicle.h"
@@ -161,6 +163,10 @@ CCarCtrl::GenerateOneRandomCar()
 		carClass = COPS;
 		carModel = ChoosePoliceCarModel();
 	}else{
+#ifdef TRAFFIC_LOD
+		if (CTrafficLod::PromoteCar())
+			return;
+#endif
 		carModel = ChooseModel(&zone, &carClass);
 		if (carModel == -1 || (carClass == COPS && pWanted->m_nWantedLevel >= 1))
 			/* All cop spawns with wanted level are handled by condition above. */
@@ -910,6 +916,10 @@ CCarCtrl::RemoveDistantCars()
 		if (!pVehicle)
 			continue;
 		PossiblyRemoveVehicle(pVehicle);
+#ifdef TRAFFIC_LOD
+		if (CPools::GetVehiclePool()->GetSlot(i))
+			CTrafficLod::PossiblySwitchToSimple(pVehicle);
+#endif
 		if (pVehicle->bCreateRoadBlockPeds){
 			if ((pVehicle->GetPosition() - FindPlayerCentreOfWorld(CWorld::PlayerInFocus)).Magnitude2D() < DISTANCE_TO_SPAWN_ROADBLOCK_PEDS) {
 				CRoadBlocks::GenerateRoadBlockCopsForCar(pVehicle, pVehicle->m_nRoadblockType);
@@ -961,6 +971,9 @@ CCarCtrl::PossiblyRemoveVehicle(CVehicle* pVehicle)
 	if (!IsThisVehicleInteresting(pVehicle) && !pVehicle->bIsLocked &&
 		pVehicle->CanBeDeleted() && !CCranes::IsThisCarBeingTargettedByAnyCrane(pVehicle)){
 		if (pVehicle->bFadeOut && CVisibilityPlugins::GetClumpAlpha(pVehicle->GetClump()) == 0){
+#ifdef TRAFFIC_LOD
+			CTrafficLod::StoreVehicle(pVehicle);
+#endif
 			CWorld::Remove(pVehicle);
 			delete pVehicle;
 			return;
@@ -989,6 +1002,9 @@ CCarCtrl::PossiblyRemoveVehicle(CVehicle* pVehicle)
 			if (pVehicle->GetIsOnScreen()){
 				pVehicle->bFadeOut = true;
 			}else{
+#ifdef TRAFFIC_LOD
+				CTrafficLod::StoreVehicle(pVehicle);
+#endif
 				CWorld::Remove(pVehicle);
 				delete pVehicle;
 			}
@@ -1006,6 +1022,9 @@ CCarCtrl::PossiblyRemoveVehicle(CVehicle* pVehicle)
 		!CTrafficLights::ShouldCarStopForLight(pVehicle, true) &&
 		!CTrafficLights::ShouldCarStopForBridge(pVehicle) &&
 		!CGarages::IsPointWithinHideOutGarage(pVehicle->GetPosition())){
+#ifdef TRAFFIC_LOD
+		CTrafficLod::StoreVehicle(pVehicle);
+#endif
 		CWorld::Remove(pVehicle);
 		delete pVehicle;
 		return;
@@ -1121,13 +1140,29 @@ CCarCtrl::FindMaximumSpeedForThisCarInTraffic(CVehicle* pVehicle)
 
 	float maxSpeed = pVehicle->AutoPilot.GetCruiseSpeed();
 
+#ifdef TRAFFIC_SNAPSHOT
+	tTrafficNeighbours* pNeighbours = CTrafficSnapshot::GetNeighbours(pVehicle);
+	int32 neighbour = 0;
+	if (pNeighbours && CTrafficSnapshot::bCheck)
+		CTrafficSnapshot::CheckNeighbours(pNeighbours, pVehicle, nil, left, top, right, bottom);
+#endif
+
 	CWorld::AdvanceCurrentScanCode();
 
 	for (int y = ystart; y <= yend; y++){
 		for (int x = xstart; x <= xend; x++){
 			CSector* s = CWorld::GetSector(x, y);
-			SlowCarDownForCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
-			SlowCarDownForCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES_OVERLAP], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
+#ifdef TRAFFIC_SNAPSHOT
+			if (pNeighbours){
+				for (neighbour = pNeighbours->SkipToSector(neighbour, y * NUMSECTORS_X + x);
+					neighbour < pNeighbours->nNumNeighbours && pNeighbours->aNeighbours[neighbour].nSector == y * NUMSECTORS_X + x; neighbour++)
+					SlowCarDownForCar(pNeighbours->aNeighbours[neighbour].pVehicle, pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
+			}else
+#endif
+			{
+				SlowCarDownForCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
+				SlowCarDownForCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES_OVERLAP], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
+			}
 			SlowCarDownForPedsSectorList(s->m_lists[ENTITYLIST_PEDS], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
 			SlowCarDownForPedsSectorList(s->m_lists[ENTITYLIST_PEDS_OVERLAP], pVehicle, left, top, right, bottom, &maxSpeed, pVehicle->AutoPilot.GetCruiseSpeed());
 		}
@@ -1300,23 +1335,26 @@ void CCarCtrl::SlowCarDownForPedsSectorList(CPtrList& lst, CVehicle* pVehicle, f
 
 void CCarCtrl::SlowCarDownForCarsSectorList(CPtrList& lst, CVehicle* pVehicle, float x_inf, float y_inf, float x_sup, float y_sup, float* pSpeed, float curSpeed)
 {
-	for (CPtrNode* pNode = lst.first; pNode != nil; pNode = pNode->next){
-		CVehicle* pTestVehicle = (CVehicle*)pNode->item;
-		if (pVehicle == pTestVehicle)
-			continue;
-		if (pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode())
-			continue;
-		if (!pTestVehicle->bUsesCollision)
-			continue;
-		pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
-		CVector boundCenter = pTestVehicle->GetBoundCentre();
-		if (boundCenter.x < x_inf || boundCenter.x > x_sup)
-			continue;
-		if (boundCenter.y < y_inf || boundCenter.y > y_sup)
-			continue;
-		if (Abs(boundCenter.z - pVehicle->GetPosition().z) < 5.0f)
-			SlowCarDownForOtherCar(pTestVehicle, pVehicle, pSpeed, curSpeed);
-	}
+	for (CPtrNode* pNode = lst.first; pNode != nil; pNode = pNode->next)
+		SlowCarDownForCar((CVehicle*)pNode->item, pVehicle, x_inf, y_inf, x_sup, y_sup, pSpeed, curSpeed);
+}
+
+void CCarCtrl::SlowCarDownForCar(CVehicle* pTestVehicle, CVehicle* pVehicle, float x_inf, float y_inf, float x_sup, float y_sup, float* pSpeed, float curSpeed)
+{
+	if (pVehicle == pTestVehicle)
+		return;
+	if (pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode())
+		return;
+	if (!pTestVehicle->bUsesCollision)
+		return;
+	pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
+	CVector boundCenter = pTestVehicle->GetBoundCentre();
+	if (boundCenter.x < x_inf || boundCenter.x > x_sup)
+		return;
+	if (boundCenter.y < y_inf || boundCenter.y > y_sup)
+		return;
+	if (Abs(boundCenter.z - pVehicle->GetPosition().z) < 5.0f)
+		SlowCarDownForOtherCar(pTestVehicle, pVehicle, pSpeed, curSpeed);
 }
 
 void CCarCtrl::SlowCarDownForOtherCar(CEntity* pOtherEntity, CVehicle* pVehicle, float* pSpeed, float curSpeed)
@@ -1500,6 +1538,12 @@ float CCarCtrl::FindAngleToWeaveThroughTraffic(CVehicle* pVehicle, CPhysical* pT
 	float angleToWeaveLeft = angleToTarget;
 	float angleToWeaveRight = angleToTarget;
 
+#ifdef TRAFFIC_SNAPSHOT
+	tTrafficNeighbours* pNeighbours = CTrafficSnapshot::GetNeighbours(pVehicle);
+	if (pNeighbours && CTrafficSnapshot::bCheck)
+		CTrafficSnapshot::CheckNeighbours(pNeighbours, pVehicle, pTarget, left, top, right, bottom);
+#endif
+
 	CWorld::AdvanceCurrentScanCode();
 
 	float angleToWeaveLeftLastIteration = -9999.9f;
@@ -1509,13 +1553,26 @@ float CCarCtrl::FindAngleToWeaveThroughTraffic(CVehicle* pVehicle, CPhysical* pT
 		   angleToWeaveRight != angleToWeaveRightLastIteration){
 		angleToWeaveLeftLastIteration = angleToWeaveLeft;
 		angleToWeaveRightLastIteration = angleToWeaveRight;
+#ifdef TRAFFIC_SNAPSHOT
+		int32 neighbour = 0;
+#endif
 		for (int y = ystart; y <= yend; y++) {
 			for (int x = xstart; x <= xend; x++) {
 				CSector* s = CWorld::GetSector(x, y);
-				WeaveThroughCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES], pVehicle, pTarget,
-					left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
-				WeaveThroughCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES_OVERLAP], pVehicle, pTarget,
-					left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
+#ifdef TRAFFIC_SNAPSHOT
+				if (pNeighbours) {
+					for (neighbour = pNeighbours->SkipToSector(neighbour, y * NUMSECTORS_X + x);
+						neighbour < pNeighbours->nNumNeighbours && pNeighbours->aNeighbours[neighbour].nSector == y * NUMSECTORS_X + x; neighbour++)
+						WeaveThroughCar(pNeighbours->aNeighbours[neighbour].pVehicle, pVehicle, pTarget,
+							left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
+				} else
+#endif
+				{
+					WeaveThroughCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES], pVehicle, pTarget,
+						left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
+					WeaveThroughCarsSectorList(s->m_lists[ENTITYLIST_VEHICLES_OVERLAP], pVehicle, pTarget,
+						left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
+				}
 				WeaveThroughPedsSectorList(s->m_lists[ENTITYLIST_PEDS], pVehicle, pTarget,
 					left, top, right, bottom, &angleToWeaveLeft, &angleToWeaveRight);
 				WeaveThroughPedsSectorList(s->m_lists[ENTITYLIST_PEDS_OVERLAP], pVehicle, pTarget,
@@ -1542,24 +1599,27 @@ float CCarCtrl::FindAngleToWeaveThroughTraffic(CVehicle* pVehicle, CPhysical* pT
 
 void CCarCtrl::WeaveThroughCarsSectorList(CPtrList& lst, CVehicle* pVehicle, CPhysical* pTarget, float x_inf, float y_inf, float x_sup, float y_sup, float* pAngleToWeaveLeft, float* pAngleToWeaveRight)
 {
-	for (CPtrNode* pNode = lst.first; pNode != nil; pNode = pNode->next) {
-		CVehicle* pTestVehicle = (CVehicle*)pNode->item;
-		if (pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode())
-			continue;
-		if (!pTestVehicle->bUsesCollision)
-			continue;
-		if (pTestVehicle == pTarget)
-			continue;
-		pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
-		if (pTestVehicle->GetBoundCentre().x < x_inf || pTestVehicle->GetBoundCentre().x > x_sup)
-			continue;
-		if (pTestVehicle->GetBoundCentre().y < y_inf || pTestVehicle->GetBoundCentre().y > y_sup)
-			continue;
-		if (Abs(pTestVehicle->GetPosition().z - pVehicle->GetPosition().z) >= VEHICLE_HEIGHT_DIFF_TO_CONSIDER_WEAVING)
-			continue;
-		if (pTestVehicle != pVehicle)
-			WeaveForOtherCar(pTestVehicle, pVehicle, pAngleToWeaveLeft, pAngleToWeaveRight);
-	}
+	for (CPtrNode* pNode = lst.first; pNode != nil; pNode = pNode->next)
+		WeaveThroughCar((CVehicle*)pNode->item, pVehicle, pTarget, x_inf, y_inf, x_sup, y_sup, pAngleToWeaveLeft, pAngleToWeaveRight);
+}
+
+void CCarCtrl::WeaveThroughCar(CVehicle* pTestVehicle, CVehicle* pVehicle, CPhysical* pTarget, float x_inf, float y_inf, float x_sup, float y_sup, float* pAngleToWeaveLeft, float* pAngleToWeaveRight)
+{
+	if (pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode())
+		return;
+	if (!pTestVehicle->bUsesCollision)
+		return;
+	if (pTestVehicle == pTarget)
+		return;
+	pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
+	if (pTestVehicle->GetBoundCentre().x < x_inf || pTestVehicle->GetBoundCentre().x > x_sup)
+		return;
+	if (pTestVehicle->GetBoundCentre().y < y_inf || pTestVehicle->GetBoundCentre().y > y_sup)
+		return;
+	if (Abs(pTestVehicle->GetPosition().z - pVehicle->GetPosition().z) >= VEHICLE_HEIGHT_DIFF_TO_CONSIDER_WEAVING)
+		return;
+	if (pTestVehicle != pVehicle)
+		WeaveForOtherCar(pTestVehicle, pVehicle, pAngleToWeaveLeft, pAngleToWeaveRight);
 }
 
 void CCarCtrl::WeaveForOtherCar(CEntity* pOtherEntity, CVehicle* pVehicle, float* pAngleToWeaveLeft, float* pAngleToWeaveRight)
@@ -2205,6 +2265,9 @@ void CCarCtrl::Init(void)
 		NumRequestsOfCarRating[i] = 0;
 		TotalNumOfCarsOfRating[i] = 0;
 	}
+#ifdef TRAFFIC_LOD
+	CTrafficLod::Init();
+#endif
 }
 
 void CCarCtrl::ReInit(void)
@@ -2228,6 +2291,9 @@ void CCarCtrl::ReInit(void)
 		apCarsToKeep[i] = nil;
 	for (int i = 0; i < TOTAL_CUSTOM_CLASSES; i++)
 		NumRequestsOfCarRating[i] = 0;
+#ifdef TRAFFIC_LOD
+	CTrafficLod::Init();
+#endif
 }
 
 void CCarCtrl::DragCarToPoint(CVehicle* pVehicle, CVector* pPoint)
@@ -83,11 +83,13 @@ public:
 	static void DragCarToPoint(CVehicle*, CVector*);
 	static float FindMaximumSpeedForThisCarInTraffic(CVehicle*);
 	static void SlowCarDownForCarsSectorList(CPtrList&, CVehicle*, float, float, float, float, float*, float);
+	static void SlowCarDownForCar(CVehicle*, CVehicle*, float, float, float, float, float*, float);
 	static void SlowCarDownForPedsSectorList(CPtrList&, CVehicle*, float, float, float, float, float*, float);
 	static void SlowCarDownForOtherCar(CEntity*, CVehicle*, float*, float);
 	static float TestCollisionBetween2MovingRects(CVehicle*, CVehicle*, float, float, CVector*, CVector*, uint8);
 	static float FindAngleToWeaveThroughTraffic(CVehicle*, CPhysical*, float, float);
 	static void WeaveThroughCarsSectorList(CPtrList&, CVehicle*, CPhysical*, float, float, float, float, float*, float*);
+	static void WeaveThroughCar(CVehicle*, CVehicle*, CPhysical*, float, float, float, float, float*, float*);
 	static void WeaveForOtherCar(CEntity*, CVehicle*, float*, float*);
 	static void WeaveThroughPedsSectorList(CPtrList&, CVehicle*, CPhysical*, float, float, float, float, float*, float*);
 	static void WeaveForPed(CEntity*, CVehicle*, float*, float*);
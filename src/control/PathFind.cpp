@@ -6,6 +6,8 @@
 #include "Vehicle.h"
 #include "World.h"
 #include "Lines.h"	// for debug
+#include "Timer.h"
+#include "Debug.h"
 #include "PathFind.h"
 
 //--MIAMI: file done except mobile unused function
@@ -35,6 +37,142 @@ int32 NumTempExternalNodes;
 int32 NumDetachedPedNodeGroups;
 int32 NumDetachedCarNodeGroups;
 
+#ifdef PATHFIND_NODE_INDEX
+// Nodes of each type bucketed into a coarse grid, in ascending index order within a cell.
+// Searching the cells nearest first with the same distance and tie break as the linear
+// scans gives exactly the same node. Only positions are indexed, the disabled/between levels
+// flags are still tested per node so switching roads on and off doesn't touch the index.
+#define NODEINDEX_CELL_SIZE 50.0f
+#define NODEINDEX_MAX_CELLS 128		// per axis
+#define NODEINDEX_SLACK 0.1f		// cell bounds are only a lower bound, don't let rounding drop a tie
+
+struct tPathNodeIndex
+{
+	float minX;
+	float minY;
+	float cellSize;
+	int32 numCellsX;
+	int32 numCellsY;
+	int16 cellStart[NODEINDEX_MAX_CELLS*NODEINDEX_MAX_CELLS + 1];
+
+	int32 GetCellX(float x) { return clamp((int32)((x - minX) / cellSize), 0, numCellsX - 1); }
+	int32 GetCellY(float y) { return clamp((int32)((y - minY) / cellSize), 0, numCellsY - 1); }
+};
+
+tPathNodeIndex PathNodeIndex[2];
+int16 aIndexedPathNodes[NUM_PATHNODES];
+bool bPathNodeIndexBuilt;
+bool gbUsePathNodeIndex = true;
+
+#ifdef DEBUGMENU
+// the last queries are kept around so the index can be checked against the linear scans
+#define NUM_RECORDED_NODE_QUERIES 1024
+
+struct tRecordedNodeQuery
+{
+	CVector coors;
+	float distLimit;
+	float minDist;		// pair queries only
+	uint8 type;
+	bool bPair;
+	bool ignoreDisabled;
+	bool ignoreBetweenLevels;
+	bool ignoreSelected;
+	bool bWaterPath;
+};
+
+tRecordedNodeQuery aRecordedNodeQueries[NUM_RECORDED_NODE_QUERIES];
+int32 NumRecordedNodeQueries;
+bool bRecordNodeQueries = true;
+
+static void
+RecordNodeQuery(CVector coors, uint8 type, bool bPair, float distLimit, float minDist, bool ignoreDisabled, bool ignoreBetweenLevels, bool ignoreSelected, bool bWaterPath)
+{
+	if(!bRecordNodeQueries)
+		return;
+	tRecordedNodeQuery &query = aRecordedNodeQueries[NumRecordedNodeQueries++ % NUM_RECORDED_NODE_QUERIES];
+	query.coors = coors;
+	query.distLimit = distLimit;
+	query.minDist = minDist;
+	query.type = type;
+	query.bPair = bPair;
+	query.ignoreDisabled = ignoreDisabled;
+	query.ignoreBetweenLevels = ignoreBetweenLevels;
+	query.ignoreSelected = ignoreSelected;
+	query.bWaterPath = bWaterPath;
+}
+#endif
+#endif
+
+#ifdef PATHFIND_ASTAR
+// Goal directed search with landmark (ALT) lower bounds: graph distances from a handful of
+// nodes spread over each type are computed once the paths are prepared. |d(L,start) - d(L,n)|
+// never overestimates the route from n to start and, unlike the straight line distance, stays
+// consistent with the truncated and clamped integer link lengths, so the bucket lists still
+// pop every node with its final distance.
+#define NUM_PATH_LANDMARKS 8
+
+int16 aLandmarkDistances[NUM_PATH_LANDMARKS][NUM_PATHNODES];	// both types share the arrays, their nodes don't overlap
+int32 NumPathLandmarks[2];
+bool gbUsePathSearchHeuristic = true;
+#endif
+
+#ifdef PATHFIND_ROUTE_CACHE
+// The last few routes by start and target node. Switching roads on or off drops all of them.
+#define NUM_CACHED_ROUTES 16
+#define CACHED_ROUTE_MAX_NODES 32
+
+struct tCachedRoute
+{
+	int32 startNode;
+	int32 targetNode;
+	uint32 nGeneration;	// entries from an older generation are free
+	uint32 nLastUsed;
+	float fDist;
+	int16 numNodes;
+	bool bComplete;		// otherwise the route was cut short at the caller's maxNumNodes
+	int16 aNodes[CACHED_ROUTE_MAX_NODES];
+};
+
+tCachedRoute aCachedRoutes[NUM_CACHED_ROUTES];
+uint32 nRouteCacheGeneration;
+uint32 nRouteCacheClock;
+#endif
+
+#ifdef PATHFIND_CACHE
+/*
+data\paths.cache holds the graph PreparePathData builds: nodes, car path links, connections and
+the flood fill groups. It's keyed by a hash of the path info the IDE and IPL files were parsed
+into and of the map objects the tile nodes are placed relative to, so any change to those makes
+it build the graph again and rewrite the cache.
+*/
+#define PATHFIND_CACHE_MAGIC 0x50334552 // "RE3P"
+#define PATHFIND_CACHE_VERSION 1
+
+char PathFindCacheFilename[] = "data\\paths.cache";
+
+struct tPathFindCacheHeader
+{
+	uint32 nMagic;
+	uint32 nVersion;
+	uint32 nSourceHash;
+	uint16 nNodeSize;
+	uint16 nCarPathLinkSize;
+	int32 numPathNodes;
+	int32 numCarPathNodes;
+	int32 numConnections;
+	int32 numCarPathLinks;
+	uint8 numGroups[2];
+};
+
+uint32 nPathSourceHash;
+#endif
+
+int32 gnPathSearches;
+int32 gnPathSearchCacheHits;
+int32 gnPathSearchNodesExpanded;	// by the last search that wasn't a cache hit
+bool gbShowPathSearchStats;
+
 bool 
 CPedPath::CalcPedRoute(int8 pathType, CVector position, CVector destination, CVector *pointPoses, int16 *pointsFound, int16 maxPoints)
 {
@@ -258,6 +396,16 @@ CPathFind::Init(void)
 	m_numCarPathLinks = 0;
 	unk = 0;
 	NumTempExternalNodes = 0;
+#ifdef PATHFIND_NODE_INDEX
+	bPathNodeIndexBuilt = false;
+#endif
+#ifdef PATHFIND_ASTAR
+	NumPathLandmarks[PATH_CAR] = 0;
+	NumPathLandmarks[PATH_PED] = 0;
+#endif
+#ifdef PATHFIND_ROUTE_CACHE
+	nRouteCacheGeneration++;
+#endif
 
 	for(i = 0; i < NUM_PATHNODES; i++)
 		m_pathNodes[i].distance = MAX_DIST;
@@ -432,12 +580,121 @@ CPathFind::CalcNodeCoors(float x, float y, float z, int id, CVector *out)
 	*out = m_mapObjects[id]->GetMatrix() * pos;
 }
 
+#ifdef PATHFIND_CACHE
+static uint32
+HashPathSourceData(uint32 hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const uint8 *bytes = (const uint8*)data;
+	for(size_t i = 0; i < size; i++)
+		hash = (hash ^ bytes[i]) * 16777619u;
+	return hash;
+}
+
+static uint32
+CalcPathSourceHash(void)
+{
+	int i;
+	uint32 hash = 2166136261u;
+
+	hash = HashPathSourceData(hash, InfoForTileCars, 12*PATHNODESIZE*sizeof(CPathInfoForObject));
+	hash = HashPathSourceData(hash, InfoForTilePeds, 12*PATHNODESIZE*sizeof(CPathInfoForObject));
+	hash = HashPathSourceData(hash, &NumDetachedCarNodeGroups, sizeof(NumDetachedCarNodeGroups));
+	hash = HashPathSourceData(hash, DetachedInfoForTileCars, 12*NumDetachedCarNodeGroups*sizeof(CPathInfoForObject));
+	hash = HashPathSourceData(hash, &NumDetachedPedNodeGroups, sizeof(NumDetachedPedNodeGroups));
+	hash = HashPathSourceData(hash, DetachedInfoForTilePeds, 12*NumDetachedPedNodeGroups*sizeof(CPathInfoForObject));
+	hash = HashPathSourceData(hash, &ThePaths.m_numMapObjects, sizeof(ThePaths.m_numMapObjects));
+	for(i = 0; i < ThePaths.m_numMapObjects; i++){
+		int32 mi = ThePaths.m_mapObjects[i]->GetModelIndex();
+		CMatrix &mat = ThePaths.m_mapObjects[i]->GetMatrix();
+		hash = HashPathSourceData(hash, &mi, sizeof(mi));
+		hash = HashPathSourceData(hash, &mat.GetRight(), sizeof(CVector));
+		hash = HashPathSourceData(hash, &mat.GetForward(), sizeof(CVector));
+		hash = HashPathSourceData(hash, &mat.GetUp(), sizeof(CVector));
+		hash = HashPathSourceData(hash, &mat.GetPosition(), sizeof(CVector));
+	}
+	return hash;
+}
+#endif
+
 bool
 CPathFind::LoadPathFindData(void)
 {
 	CFileMgr::SetDir("");
+#ifdef PATHFIND_CACHE
+	if(InfoForTileCars == nil || InfoForTilePeds == nil ||
+	   DetachedInfoForTileCars == nil || DetachedInfoForTilePeds == nil)
+		return false;
+	nPathSourceHash = CalcPathSourceHash();
+
+	int fd = CFileMgr::OpenFile(PathFindCacheFilename, "rb");
+	if(fd == 0)
+		return false;
+	tPathFindCacheHeader header;
+	bool result = CFileMgr::Read(fd, (char*)&header, sizeof(header)) == sizeof(header) &&
+		header.nMagic == PATHFIND_CACHE_MAGIC &&
+		header.nVersion == PATHFIND_CACHE_VERSION &&
+		header.nSourceHash == nPathSourceHash &&
+		header.nNodeSize == sizeof(CPathNode) &&
+		header.nCarPathLinkSize == sizeof(CCarPathLink) &&
+		header.numPathNodes >= 0 && header.numPathNodes <= NUM_PATHNODES &&
+		header.numCarPathNodes >= 0 && header.numCarPathNodes <= header.numPathNodes &&
+		header.numConnections >= 0 && header.numConnections <= NUM_PATHCONNECTIONS &&
+		header.numCarPathLinks >= 0 && header.numCarPathLinks <= NUM_CARPATHLINKS;
+	// a short read leaves the counts alone and PreparePathData overwrites the arrays again
+	result = result &&
+		CFileMgr::Read(fd, (char*)m_pathNodes, header.numPathNodes*sizeof(CPathNode)) == header.numPathNodes*sizeof(CPathNode) &&
+		CFileMgr::Read(fd, (char*)m_carPathLinks, header.numCarPathLinks*sizeof(CCarPathLink)) == header.numCarPathLinks*sizeof(CCarPathLink) &&
+		CFileMgr::Read(fd, (char*)m_connections, header.numConnections*sizeof(uint16)) == header.numConnections*sizeof(uint16) &&
+		CFileMgr::Read(fd, (char*)m_distances, header.numConnections*sizeof(uint8)) == header.numConnections*sizeof(uint8) &&
+		CFileMgr::Read(fd, (char*)m_carPathConnections, header.numConnections*sizeof(int16)) == header.numConnections*sizeof(int16);
+	CFileMgr::CloseFile(fd);
+	if(!result)
+		return false;
+
+	m_numPathNodes = header.numPathNodes;
+	m_numCarPathNodes = header.numCarPathNodes;
+	m_numPedPathNodes = header.numPathNodes - header.numCarPathNodes;
+	m_numConnections = header.numConnections;
+	m_numCarPathLinks = header.numCarPathLinks;
+	m_numGroups[PATH_CAR] = header.numGroups[PATH_CAR];
+	m_numGroups[PATH_PED] = header.numGroups[PATH_PED];
+	return true;
+#else
 	return false;
+#endif
+}
+
+#ifdef PATHFIND_CACHE
+void
+CPathFind::SavePathFindData(void)
+{
+	tPathFindCacheHeader header;
+	header.nMagic = PATHFIND_CACHE_MAGIC;
+	header.nVersion = PATHFIND_CACHE_VERSION;
+	header.nSourceHash = nPathSourceHash;
+	header.nNodeSize = sizeof(CPathNode);
+	header.nCarPathLinkSize = sizeof(CCarPathLink);
+	header.numPathNodes = m_numPathNodes;
+	header.numCarPathNodes = m_numCarPathNodes;
+	header.numConnections = m_numConnections;
+	header.numCarPathLinks = m_numCarPathLinks;
+	header.numGroups[PATH_CAR] = m_numGroups[PATH_CAR];
+	header.numGroups[PATH_PED] = m_numGroups[PATH_PED];
+
+	CFileMgr::SetDir("");
+	int fd = CFileMgr::OpenFileForWriting(PathFindCacheFilename);
+	if(fd == 0)
+		return;
+	CFileMgr::Write(fd, (char*)&header, sizeof(header));
+	CFileMgr::Write(fd, (char*)m_pathNodes, m_numPathNodes*sizeof(CPathNode));
+	CFileMgr::Write(fd, (char*)m_carPathLinks, m_numCarPathLinks*sizeof(CCarPathLink));
+	CFileMgr::Write(fd, (char*)m_connections, m_numConnections*sizeof(uint16));
+	CFileMgr::Write(fd, (char*)m_distances, m_numConnections*sizeof(uint8));
+	CFileMgr::Write(fd, (char*)m_carPathConnections, m_numConnections*sizeof(int16));
+	CFileMgr::CloseFile(fd);
 }
+#endif
 
 void
 CPathFind::PreparePathData(void)
@@ -447,6 +704,10 @@ CPathFind::PreparePathData(void)
 	CTempNode *tempNodes;
 
 	printf("PreparePathData\n");
+#ifdef PATHFIND_CACHE
+	uint32 nStartTime = CTimer::GetCurrentTimeInCycles();
+	bool bCacheLoaded = false;
+#endif
 	if(!CPathFind::LoadPathFindData() &&	// empty
 	   InfoForTileCars && InfoForTilePeds &&
 	   DetachedInfoForTileCars && DetachedInfoForTilePeds && TempExternalNodes){
@@ -513,7 +774,25 @@ CPathFind::PreparePathData(void)
 
 		CountFloodFillGroups(PATH_CAR);
 		CountFloodFillGroups(PATH_PED);
+#ifdef PATHFIND_CACHE
+		SavePathFindData();
+#endif
+
+		delete[] InfoForTileCars;
+		InfoForTileCars = nil;
+		delete[] InfoForTilePeds;
+		InfoForTilePeds = nil;
 
+		delete[] DetachedInfoForTileCars;
+		DetachedInfoForTileCars = nil;
+		delete[] DetachedInfoForTilePeds;
+		DetachedInfoForTilePeds = nil;
+		delete[] TempExternalNodes;
+		TempExternalNodes = nil;
+#ifdef PATHFIND_CACHE
+	}else if(InfoForTileCars){
+		// the graph came from the cache, the file data isn't needed anymore either
+		bCacheLoaded = true;
 		delete[] InfoForTileCars;
 		InfoForTileCars = nil;
 		delete[] InfoForTilePeds;
@@ -525,10 +804,177 @@ CPathFind::PreparePathData(void)
 		DetachedInfoForTilePeds = nil;
 		delete[] TempExternalNodes;
 		TempExternalNodes = nil;
+#endif
 	}
+#ifdef PATHFIND_CACHE
+	uint32 nGraphTime = CTimer::GetCurrentTimeInCycles();
+#endif
+#ifdef PATHFIND_NODE_INDEX
+	BuildNodeIndex();
+#endif
+#ifdef PATHFIND_ASTAR
+	BuildLandmarks();
+#endif
+#ifdef PATHFIND_CACHE
+	uint32 nEndTime = CTimer::GetCurrentTimeInCycles();
+	uint32 cyclesPerMs = Max(CTimer::GetCyclesPerMillisecond(), 1u);
+	debug("PreparePathData: graph %s in %dms, index and landmarks %dms\n", bCacheLoaded ? "loaded from cache" : "built",
+		(nGraphTime - nStartTime) / cyclesPerMs, (nEndTime - nGraphTime) / cyclesPerMs);
+#endif
 	printf("Done with PreparePathData\n");
 }
 
+#ifdef PATHFIND_NODE_INDEX
+void
+CPathFind::BuildNodeIndex(void)
+{
+	int i, cell;
+	int firstNode, lastNode;
+	uint8 type;
+
+	for(type = PATH_CAR; type <= PATH_PED; type++){
+		tPathNodeIndex &index = PathNodeIndex[type];
+		if(type == PATH_CAR){
+			firstNode = 0;
+			lastNode = m_numCarPathNodes;
+		}else{
+			firstNode = m_numCarPathNodes;
+			lastNode = m_numPathNodes;
+		}
+
+		float minX = 0.0f, maxX = 0.0f, minY = 0.0f, maxY = 0.0f;
+		for(i = firstNode; i < lastNode; i++){
+			float x = m_pathNodes[i].GetX();
+			float y = m_pathNodes[i].GetY();
+			if(i == firstNode || x < minX) minX = x;
+			if(i == firstNode || x > maxX) maxX = x;
+			if(i == firstNode || y < minY) minY = y;
+			if(i == firstNode || y > maxY) maxY = y;
+		}
+		index.minX = minX;
+		index.minY = minY;
+		index.cellSize = Max(NODEINDEX_CELL_SIZE, Max(maxX - minX, maxY - minY) / (NODEINDEX_MAX_CELLS - 1));
+		index.numCellsX = Min((int32)((maxX - minX) / index.cellSize) + 1, NODEINDEX_MAX_CELLS);
+		index.numCellsY = Min((int32)((maxY - minY) / index.cellSize) + 1, NODEINDEX_MAX_CELLS);
+
+		// counting sort by cell, which keeps the nodes of a cell in ascending order
+		int numCells = index.numCellsX * index.numCellsY;
+		for(cell = 0; cell <= numCells; cell++)
+			index.cellStart[cell] = 0;
+		for(i = firstNode; i < lastNode; i++)
+			index.cellStart[index.GetCellY(m_pathNodes[i].GetY())*index.numCellsX + index.GetCellX(m_pathNodes[i].GetX()) + 1]++;
+		index.cellStart[0] = firstNode;
+		for(cell = 1; cell <= numCells; cell++)
+			index.cellStart[cell] += index.cellStart[cell-1];
+		// cellStart[cell] is used as the insertion point and ends up as the start of the next cell
+		for(i = firstNode; i < lastNode; i++){
+			cell = index.GetCellY(m_pathNodes[i].GetY())*index.numCellsX + index.GetCellX(m_pathNodes[i].GetX());
+			aIndexedPathNodes[index.cellStart[cell]++] = i;
+		}
+		for(cell = numCells; cell > 0; cell--)
+			index.cellStart[cell] = index.cellStart[cell-1];
+		index.cellStart[0] = firstNode;
+	}
+	bPathNodeIndexBuilt = true;
+}
+
+// Same distance, filters and tie break (lowest index) as the linear scans, but only cells that
+// could hold something closer than the best node so far are visited. In pair mode a node only
+// counts if it has a link passing the filters that is longer than minPairDist, and the last
+// such link is returned in pConnectedNode, like FindNodePairClosestToCoors does.
+// Returns -1 if no node is closer than maxDist.
+int32
+CPathFind::FindNodeClosestToCoorsIndexed(CVector coors, uint8 type, float maxDist, bool ignoreDisabled, bool ignoreBetweenLevels, bool ignoreSelected, bool bWaterPath,
+	float minPairDist, int32 *pConnectedNode, float *pDist)
+{
+	int i, j, n, r, x, y;
+	int connectedNode;
+	float dist;
+	float closestDist = maxDist;
+	int closestNode = -1;
+
+	tPathNodeIndex &index = PathNodeIndex[type];
+	int cx = index.GetCellX(coors.x);
+	int cy = index.GetCellY(coors.y);
+
+	for(r = 0; ; r++){
+		if(r > 0){
+			// everything that's left is outside the block of cells of radius r-1 around the start
+			bool cellsLeft = false;
+			float bound = closestDist + 2*NODEINDEX_SLACK;
+			if(cx - r >= 0){
+				cellsLeft = true;
+				bound = Min(bound, coors.x - (index.minX + (cx-r+1)*index.cellSize));
+			}
+			if(cx + r < index.numCellsX){
+				cellsLeft = true;
+				bound = Min(bound, index.minX + (cx+r)*index.cellSize - coors.x);
+			}
+			if(cy - r >= 0){
+				cellsLeft = true;
+				bound = Min(bound, coors.y - (index.minY + (cy-r+1)*index.cellSize));
+			}
+			if(cy + r < index.numCellsY){
+				cellsLeft = true;
+				bound = Min(bound, index.minY + (cy+r)*index.cellSize - coors.y);
+			}
+			if(!cellsLeft || bound > closestDist + NODEINDEX_SLACK)
+				break;
+		}
+
+		for(y = cy - r; y <= cy + r; y++){
+			if(y < 0 || y >= index.numCellsY)
+				continue;
+			// only the outline of the ring, the inside has been done already
+			int step = (r == 0 || y == cy - r || y == cy + r) ? 1 : 2*r;
+			for(x = cx - r; x <= cx + r; x += step){
+				if(x < 0 || x >= index.numCellsX)
+					continue;
+
+				float cellMinX = index.minX + x*index.cellSize;
+				float cellMinY = index.minY + y*index.cellSize;
+				float dX = Max(0.0f, Max(cellMinX - coors.x, coors.x - (cellMinX + index.cellSize)));
+				float dY = Max(0.0f, Max(cellMinY - coors.y, coors.y - (cellMinY + index.cellSize)));
+				if(dX + dY > closestDist + NODEINDEX_SLACK)
+					continue;
+
+				int cell = y*index.numCellsX + x;
+				for(n = index.cellStart[cell]; n < index.cellStart[cell+1]; n++){
+					i = aIndexedPathNodes[n];
+					if(ignoreDisabled && m_pathNodes[i].bDisabled) continue;
+					if(ignoreBetweenLevels && m_pathNodes[i].bBetweenLevels) continue;
+					if(ignoreSelected && m_pathNodes[i].bSelected) continue;
+					if(bWaterPath != m_pathNodes[i].bWaterPath) continue;
+					dist = Abs(m_pathNodes[i].GetX() - coors.x) +
+					       Abs(m_pathNodes[i].GetY() - coors.y) +
+					       3.0f*Abs(m_pathNodes[i].GetZ() - coors.z);
+					if(dist > closestDist || (dist == closestDist && (closestNode == -1 || i > closestNode)))
+						continue;
+					if(pConnectedNode){
+						connectedNode = -1;
+						for(j = 0; j < m_pathNodes[i].numLinks; j++){
+							int next = ConnectedNode(m_pathNodes[i].firstLink + j);
+							if(ignoreDisabled && m_pathNodes[next].bDisabled) continue;
+							if(ignoreBetweenLevels && m_pathNodes[next].bBetweenLevels) continue;
+							if(bWaterPath != m_pathNodes[next].bWaterPath) continue;
+							if((m_pathNodes[next].GetPosition() - m_pathNodes[i].GetPosition()).Magnitude() > minPairDist)
+								connectedNode = next;
+						}
+						if(connectedNode == -1)
+							continue;
+						*pConnectedNode = connectedNode;
+					}
+					closestDist = dist;
+					closestNode = i;
+				}
+			}
+		}
+	}
+	*pDist = closestDist;
+	return closestNode;
+}
+#endif
+
 /* String together connected nodes in a list by a flood fill algorithm */
 void
 CPathFind::CountFloodFillGroups(uint8 type)
@@ -1114,6 +1560,9 @@ CPathFind::SwitchOffNodeAndNeighbours(int32 nodeId, bool disable)
 	int i, next;
 
 	m_pathNodes[nodeId].bDisabled = disable;
+#ifdef PATHFIND_ROUTE_CACHE
+	nRouteCacheGeneration++;
+#endif
 	if(m_pathNodes[nodeId].numLinks < 3)
 		for(i = 0; i < m_pathNodes[nodeId].numLinks; i++){
 			next = ConnectedNode(m_pathNodes[nodeId].firstLink + i);
@@ -1267,6 +1716,21 @@ CPathFind::FindNodeClosestToCoors(CVector coors, uint8 type, float distLimit, bo
 		break;
 	}
 
+#ifdef PATHFIND_NODE_INDEX
+#ifdef DEBUGMENU
+	RecordNodeQuery(coors, type, false, distLimit, 0.0f, ignoreDisabled, ignoreBetweenLevels, ignoreSelected, bWaterPath);
+#endif
+	if(bPathNodeIndexBuilt && gbUsePathNodeIndex){
+		// nothing past closestDist can win anyway, and not finding anything leaves node 0 like the scan
+		i = FindNodeClosestToCoorsIndexed(coors, type, Min(distLimit, closestDist), ignoreDisabled, ignoreBetweenLevels, ignoreSelected, bWaterPath, 0.0f, nil, &dist);
+		if(i >= 0){
+			closestDist = dist;
+			closestNode = i;
+		}
+		return closestDist < distLimit ? closestNode : -1;
+	}
+#endif
+
 	for(i = firstNode; i < lastNode; i++){
 		if(ignoreDisabled && m_pathNodes[i].bDisabled) continue;
 		if(ignoreBetweenLevels && m_pathNodes[i].bBetweenLevels) continue;
@@ -1341,6 +1805,19 @@ CPathFind::FindNodePairClosestToCoors(CVector coors, uint8 type, int* node1, int
 		break;
 	}
 
+#ifdef PATHFIND_NODE_INDEX
+#ifdef DEBUGMENU
+	RecordNodeQuery(coors, type, true, maxDist, minDist, ignoreDisabled, ignoreBetweenLevels, false, bWaterPath);
+#endif
+	if (bPathNodeIndexBuilt && gbUsePathNodeIndex) {
+		i = FindNodeClosestToCoorsIndexed(coors, type, Min(maxDist, closestDist), ignoreDisabled, ignoreBetweenLevels, false, bWaterPath, minDist, &connectedNode, &dist);
+		if (i >= 0) {
+			closestDist = dist;
+			closestNode = i;
+			closestConnectedNode = connectedNode;
+		}
+	} else
+#endif
 	for (i = firstNode; i < lastNode; i++) {
 		if (ignoreDisabled && m_pathNodes[i].bDisabled) continue;
 		if (ignoreBetweenLevels && m_pathNodes[i].bBetweenLevels) continue;
@@ -1666,6 +2143,161 @@ CPathFind::FindNextNodeWandering(uint8 type, CVector coors, CPathNode **lastNode
 	}
 }
 
+#ifdef PATHFIND_ASTAR
+// Plain Dijkstra from one node over everything reachable, with the same bucket lists as
+// DoPathSearch. Unreachable nodes end up with MAX_DIST.
+void
+CPathFind::CalcDistancesFromNode(int32 sourceNode, int16 *distances, int32 firstNode, int32 lastNode)
+{
+	int i, j;
+	int numNodesInLists;
+
+	for(i = 0; i < ARRAY_SIZE(m_searchNodes); i++)
+		m_searchNodes[i].SetNext(nil);
+	AddNodeToList(&m_pathNodes[sourceNode], 0);
+	numNodesInLists = 1;
+
+	for(i = 0; numNodesInLists > 0; i = (i+1) & 0x1FF){
+		// zero length links add to the current list, so keep taking from the head until it's empty
+		CPathNode *node;
+		while((node = m_searchNodes[i].GetNext()) != nil){
+			RemoveNodeFromList(node);
+			numNodesInLists--;
+			for(j = 0; j < node->numLinks; j++){
+				int next = ConnectedNode(node->firstLink + j);
+				int dist = node->distance + m_distances[node->firstLink + j];
+				if(dist < m_pathNodes[next].distance){
+					if(m_pathNodes[next].distance != MAX_DIST){
+						RemoveNodeFromList(&m_pathNodes[next]);
+						numNodesInLists--;
+					}
+					AddNodeToList(&m_pathNodes[next], dist);
+					numNodesInLists++;
+				}
+			}
+		}
+	}
+
+	for(i = firstNode; i < lastNode; i++){
+		distances[i] = m_pathNodes[i].distance;
+		m_pathNodes[i].distance = MAX_DIST;
+	}
+}
+
+// Landmarks are picked farthest first inside the biggest group: the first is the node farthest
+// from an arbitrary one, each next one the node farthest from all landmarks so far. Nodes in
+// other groups get no bound, DoPathSearch rejects searches between groups anyway.
+void
+CPathFind::BuildLandmarks(void)
+{
+	int i, k;
+	int firstNode, lastNode;
+	uint8 type;
+	static int16 minDistances[NUM_PATHNODES];
+	int32 groupSizes[256];
+
+	for(type = PATH_CAR; type <= PATH_PED; type++){
+		if(type == PATH_CAR){
+			firstNode = 0;
+			lastNode = m_numCarPathNodes;
+		}else{
+			firstNode = m_numCarPathNodes;
+			lastNode = m_numPathNodes;
+		}
+		NumPathLandmarks[type] = 0;
+		if(firstNode == lastNode)
+			continue;
+
+		for(i = 0; i < 256; i++)
+			groupSizes[i] = 0;
+		for(i = firstNode; i < lastNode; i++)
+			groupSizes[(uint8)m_pathNodes[i].group]++;
+		int32 seed = firstNode;
+		for(i = firstNode; i < lastNode; i++)
+			if(groupSizes[(uint8)m_pathNodes[i].group] > groupSizes[(uint8)m_pathNodes[seed].group])
+				seed = i;
+
+		CalcDistancesFromNode(seed, minDistances, firstNode, lastNode);
+		for(k = 0; k < NUM_PATH_LANDMARKS; k++){
+			int32 landmark = -1;
+			for(i = firstNode; i < lastNode; i++)
+				if(minDistances[i] != MAX_DIST && (landmark < 0 || minDistances[i] > minDistances[landmark]))
+					landmark = i;
+			if(landmark < 0 || minDistances[landmark] == 0)
+				break;	// every node is a landmark already
+
+			int16 *distances = aLandmarkDistances[NumPathLandmarks[type]++];
+			CalcDistancesFromNode(landmark, distances, firstNode, lastNode);
+			for(i = firstNode; i < lastNode; i++)
+				if(k == 0 || distances[i] < minDistances[i])
+					minDistances[i] = distances[i];
+		}
+	}
+}
+
+static int32
+LandmarkLowerBound(int32 node, const int16 *startDistances, int32 numLandmarks)
+{
+	int32 k;
+	int32 bound = 0;
+	for(k = 0; k < numLandmarks; k++){
+		int32 dist = aLandmarkDistances[k][node];
+		if(dist == MAX_DIST || startDistances[k] == MAX_DIST)
+			continue;
+		bound = Max(bound, Abs(startDistances[k] - dist));
+	}
+	return bound;
+}
+
+// Like AddNodeToList but sorted by an estimate of the whole route instead of the distance so far
+void
+CPathFind::AddNodeToListEstimated(CPathNode *node, int32 dist, int32 estimate)
+{
+	AddNodeToList(node, estimate);
+	node->distance = dist;
+}
+#endif
+
+#ifdef PATHFIND_ROUTE_CACHE
+static tCachedRoute*
+FindCachedRoute(int32 startNode, int32 targetNode)
+{
+	int i;
+	for(i = 0; i < NUM_CACHED_ROUTES; i++)
+		if(aCachedRoutes[i].startNode == startNode && aCachedRoutes[i].targetNode == targetNode &&
+		   aCachedRoutes[i].nGeneration == nRouteCacheGeneration)
+			return &aCachedRoutes[i];
+	return nil;
+}
+
+static void
+StoreCachedRoute(int32 startNode, int32 targetNode, CPathNode **nodes, int16 numNodes, bool bComplete, float dist)
+{
+	int i;
+	if(numNodes > CACHED_ROUTE_MAX_NODES)
+		return;
+	tCachedRoute *route = FindCachedRoute(startNode, targetNode);
+	for(i = 0; route == nil && i < NUM_CACHED_ROUTES; i++)
+		if(aCachedRoutes[i].nGeneration != nRouteCacheGeneration)
+			route = &aCachedRoutes[i];
+	if(route == nil){
+		route = &aCachedRoutes[0];
+		for(i = 1; i < NUM_CACHED_ROUTES; i++)
+			if(aCachedRoutes[i].nLastUsed < route->nLastUsed)
+				route = &aCachedRoutes[i];
+	}
+	route->startNode = startNode;
+	route->targetNode = targetNode;
+	route->nGeneration = nRouteCacheGeneration;
+	route->nLastUsed = ++nRouteCacheClock;
+	route->fDist = dist;
+	route->numNodes = numNodes;
+	route->bComplete = bComplete;
+	for(i = 0; i < numNodes; i++)
+		route->aNodes[i] = nodes[i] - ThePaths.m_pathNodes;
+}
+#endif
+
 static CPathNode *apNodesToBeCleared[6525];
 
 void
@@ -1701,10 +2333,65 @@ CPathFind::DoPathSearch(uint8 type, CVector start, int32 startNodeId, CVector ta
 		return;
 	}
 
+	gnPathSearches++;
+#ifdef PATHFIND_ROUTE_CACHE
+	tCachedRoute *route = FindCachedRoute(startNodeId, targetNodeId);
+	if(route && (route->bComplete || route->numNodes >= Max((int)maxNumNodes, 1))){
+		*pNumNodes = Min((int)route->numNodes, Max((int)maxNumNodes, 1));
+		for(i = 0; i < *pNumNodes; i++)
+			nodes[i] = &m_pathNodes[route->aNodes[i]];
+		if(pDist)
+			*pDist = route->fDist;
+		route->nLastUsed = ++nRouteCacheClock;
+		gnPathSearchCacheHits++;
+		return;
+	}
+#endif
+
 	for(i = 0; i < ARRAY_SIZE(m_searchNodes); i++)
 		m_searchNodes[i].SetNext(nil);
-	AddNodeToList(&m_pathNodes[targetNodeId], 0);
 	int numNodesToBeCleared = 0;
+	gnPathSearchNodesExpanded = 0;
+
+#ifdef PATHFIND_ASTAR
+	// We search from the target, so the lower bounds are of the distance left to the start
+	int16 startDistances[NUM_PATH_LANDMARKS];
+	int numLandmarks = gbUsePathSearchHeuristic ? NumPathLandmarks[type] : 0;
+	for(i = 0; i < numLandmarks; i++)
+		startDistances[i] = aLandmarkDistances[i][startNodeId];
+	int estimate = LandmarkLowerBound(targetNodeId, startDistances, numLandmarks);
+	AddNodeToListEstimated(&m_pathNodes[targetNodeId], 0, estimate);
+	apNodesToBeCleared[numNodesToBeCleared++] = &m_pathNodes[targetNodeId];
+
+	// A*, the lists are indexed by distance so far plus lower bound.
+	// Once the start comes off a list its distance is final and we can stop.
+	bool bFoundStart = false;
+	for(i = estimate & 0x1FF; !bFoundStart; i = (i+1) & 0x1FF){
+		CPathNode *node;
+		// links that don't change the estimate add to the current list, so keep taking from the head
+		while(!bFoundStart && (node = m_searchNodes[i].GetNext()) != nil){
+			RemoveNodeFromList(node);
+			gnPathSearchNodesExpanded++;
+			if(node == &m_pathNodes[startNodeId]){
+				bFoundStart = true;
+				break;
+			}
+
+			for(j = 0; j < node->numLinks; j++){
+				int next = ConnectedNode(node->firstLink + j);
+				int dist = node->distance + m_distances[node->firstLink + j];
+				if(dist < m_pathNodes[next].distance){
+					if(m_pathNodes[next].distance != MAX_DIST)
+						RemoveNodeFromList(&m_pathNodes[next]);
+					if(m_pathNodes[next].distance == MAX_DIST)
+						apNodesToBeCleared[numNodesToBeCleared++] = &m_pathNodes[next];
+					AddNodeToListEstimated(&m_pathNodes[next], dist, dist + LandmarkLowerBound(next, startDistances, numLandmarks));
+				}
+			}
+		}
+	}
+#else
+	AddNodeToList(&m_pathNodes[targetNodeId], 0);
 	apNodesToBeCleared[numNodesToBeCleared++] = &m_pathNodes[targetNodeId];
 
 	// Dijkstra's algorithm
@@ -1715,6 +2402,7 @@ CPathFind::DoPathSearch(uint8 type, CVector start, int32 startNodeId, CVector ta
 		for(node = m_searchNodes[i].GetNext(); node; node = node->GetNext()){
 			if(node == &m_pathNodes[startNodeId])
 				numPathsFound = 1;
+			gnPathSearchNodesExpanded++;
 
 			for(j = 0; j < node->numLinks; j++){
 				int next = ConnectedNode(node->firstLink + j);
@@ -1731,6 +2419,7 @@ CPathFind::DoPathSearch(uint8 type, CVector start, int32 startNodeId, CVector ta
 			RemoveNodeFromList(node);
 		}
 	}
+#endif
 
 	// Find out whence to start tracing back
 	CPathNode *curNode;
@@ -1751,6 +2440,10 @@ CPathFind::DoPathSearch(uint8 type, CVector start, int32 startNodeId, CVector ta
 			}
 		}
 
+#ifdef PATHFIND_ROUTE_CACHE
+	StoreCachedRoute(startNodeId, targetNodeId, nodes, *pNumNodes, curNode == &m_pathNodes[targetNodeId], m_pathNodes[startNodeId].distance);
+#endif
+
 	for(i = 0; i < numNodesToBeCleared; i++)
 		apNodesToBeCleared[i]->distance = MAX_DIST;
 }
@@ -1809,6 +2502,9 @@ CPathFind::Load(uint8 *buf, uint32 size)
 	int i;
 	int n = m_numPathNodes/8 + 1;
 
+#ifdef PATHFIND_ROUTE_CACHE
+	nRouteCacheGeneration++;
+#endif
 	for(i = 0; i < m_numPathNodes; i++)
 		if(buf[i/8] & (1 << i%8))
 			m_pathNodes[i].bDisabled = true;
@@ -1832,6 +2528,12 @@ CPathFind::DisplayPathData(void)
 	CVector pos = TheCamera.GetPosition();
 	const float maxDist = 50.0f;
 
+	if(gbShowPathSearchStats){
+		char str[128];
+		sprintf(str, "PATH SEARCHES %d CACHE HITS %d LAST EXPANDED %d", gnPathSearches, gnPathSearchCacheHits, gnPathSearchNodesExpanded);
+		CDebug::PrintAt(str, 2, 23);
+	}
+
 	// Render car path nodes
 	if(gbShowCarPaths)
 	for(i = 0; i < m_numCarPathNodes; i++){
@@ -1983,3 +2685,52 @@ CPathFind::GetIndex(CPathNode *node)
 	else
 		return (node - ThePaths.m_pathNodes) + ARRAY_SIZE(ThePaths.m_searchNodes);
 }
+
+#if defined PATHFIND_NODE_INDEX && defined DEBUGMENU
+// Replays the recorded queries through the linear scans and the index, compares the results
+// and prints how long each took.
+void
+BenchmarkPathNodeIndex(void)
+{
+	int i, pass;
+	int numQueries = Min(NumRecordedNodeQueries, NUM_RECORDED_NODE_QUERIES);
+	static int32 results[2][NUM_RECORDED_NODE_QUERIES][2];
+	uint32 times[2];
+
+	if(!bPathNodeIndexBuilt || numQueries == 0){
+		debug("Path node index benchmark: nothing to replay\n");
+		return;
+	}
+
+	bool bWasUsingIndex = gbUsePathNodeIndex;
+	bRecordNodeQueries = false;
+	for(pass = 0; pass < 2; pass++){
+		gbUsePathNodeIndex = pass == 1;
+		uint32 startTime = CTimer::GetCurrentTimeInCycles();
+		for(i = 0; i < numQueries; i++){
+			tRecordedNodeQuery &query = aRecordedNodeQueries[i];
+			if(query.bPair){
+				float angle;
+				ThePaths.FindNodePairClosestToCoors(query.coors, query.type, &results[pass][i][0], &results[pass][i][1], &angle,
+					query.minDist, query.distLimit, query.ignoreDisabled, query.ignoreBetweenLevels, query.bWaterPath);
+			}else{
+				results[pass][i][0] = ThePaths.FindNodeClosestToCoors(query.coors, query.type, query.distLimit,
+					query.ignoreDisabled, query.ignoreBetweenLevels, query.ignoreSelected, query.bWaterPath);
+				results[pass][i][1] = -1;
+			}
+		}
+		times[pass] = CTimer::GetCurrentTimeInCycles() - startTime;
+	}
+	gbUsePathNodeIndex = bWasUsingIndex;
+	bRecordNodeQueries = true;
+
+	int mismatches = 0;
+	for(i = 0; i < numQueries; i++)
+		if(results[0][i][0] != results[1][i][0] || results[0][i][1] != results[1][i][1])
+			mismatches++;
+
+	uint32 cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+	debug("Path node index benchmark: %d queries, linear %dus, index %dus, %d mismatches\n",
+		numQueries, times[0] / cyclesPerUs, times[1] / cyclesPerUs, mismatches);
+}
+#endif
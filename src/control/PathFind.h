@@ -244,6 +244,11 @@ public:
 	bool TestCrossesRoad(CPathNode *n1, CPathNode *n2);
 	void AddNodeToList(CPathNode *node, int32 listId);
 	void RemoveNodeFromList(CPathNode *node);
+#ifdef PATHFIND_ASTAR
+	void AddNodeToListEstimated(CPathNode *node, int32 dist, int32 estimate);
+	void CalcDistancesFromNode(int32 sourceNode, int16 *distances, int32 firstNode, int32 lastNode);
+	void BuildLandmarks(void);
+#endif
 	void RemoveBadStartNode(CVector pos, CPathNode **nodes, int16 *n);
 	void SetLinksBridgeLights(float, float, float, float, bool);
 	void SwitchOffNodeAndNeighbours(int32 nodeId, bool disable);
@@ -257,6 +262,11 @@ public:
 	int32 FindNodeClosestToCoorsFavourDirection(CVector coors, uint8 type, float dirX, float dirY);
 	void FindNodePairClosestToCoors(CVector coors, uint8 type, int* node1, int* node2, float* angle, float minDist, float maxDist, bool ignoreDisabled = false, bool ignoreBetweenLevels = false, bool bWaterPath = false);
 	int32 FindNthNodeClosestToCoors(CVector coors, uint8 type, float distLimit, bool ignoreDisabled, bool ignoreBetweenLevels, int N, bool bWaterPath = false);
+#ifdef PATHFIND_NODE_INDEX
+	void BuildNodeIndex(void);
+	int32 FindNodeClosestToCoorsIndexed(CVector coors, uint8 type, float maxDist, bool ignoreDisabled, bool ignoreBetweenLevels, bool ignoreSelected, bool bWaterPath,
+		float minPairDist, int32 *pConnectedNode, float *pDist);
+#endif
 	CVector FindNodeCoorsForScript(int32 id);
 	float FindNodeOrientationForCarPlacement(int32 nodeId);
 	float FindNodeOrientationForCarPlacementFacingDestination(int32 nodeId, float x, float y, bool towards);
@@ -302,3 +312,15 @@ inline void CPathNode::SetNext(CPathNode *node) { nextIndex = ThePaths.GetIndex(
 extern bool gbShowPedPaths;
 extern bool gbShowCarPaths;
 extern bool gbShowCarPathsLinks;
+
+extern bool gbShowPathSearchStats;
+#ifdef PATHFIND_ASTAR
+extern bool gbUsePathSearchHeuristic;
+#endif
+
+#ifdef PATHFIND_NODE_INDEX
+extern bool gbUsePathNodeIndex;
+#ifdef DEBUGMENU
+void BenchmarkPathNodeIndex(void);
+#endif
+#endif
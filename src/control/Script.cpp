@@ -50,6 +50,7 @@
 #include "Timecycle.h"
 #include "TxdStore.h"
 #include "Bike.h"
+#include "ScriptProfiler.h"
 #ifdef USE_ADVANCED_SCRIPT_DEBUG_OUTPUT
 #include <stdarg.h>
 #endif
@@ -91,6 +92,19 @@ CUpsideDownCarCheck CTheScripts::UpsideDownCars;
 CStuckCarCheck CTheScripts::StuckCars;
 uint16 CTheScripts::CommandsExecuted;
 uint16 CTheScripts::ScriptsUpdated;
+#ifdef SCRIPT_DECODE_CACHE
+bool CTheScripts::bUseDecodeCache = true;
+bool CTheScripts::bShowStats;
+tDecodedScriptParam aDecodedScriptParams[SCRIPT_DECODE_MAIN_SIZE + SCRIPT_DECODE_MISSION_SIZE];
+int32 aDecodedScriptParamsAt[SIZE_SCRIPT_SPACE];	// 1 + where the block for this ip starts, 0 if not decoded yet
+int32 NumDecodedMainParams;
+int32 NumDecodedMissionParams;
+uint32 ScriptStatsSecondStart;
+uint32 ScriptCommandsThisSecond;
+uint32 ScriptCyclesThisSecond;
+uint32 ScriptCommandsPerSecond;
+uint32 ScriptMicrosecondsPerSecond;
+#endif
 int32 ScriptParams[32];
 uint8 CTheScripts::RiotIntensity;
 uint32 CTheScripts::LastMissionPassedTime;
@@ -2034,8 +2048,123 @@ bool CStuckCarCheck::HasCarBeenStuckForAWhile(int32 id)
 	return false;
 }
 
+#ifdef SCRIPT_DECODE_CACHE
+// The mission part of ScriptSpace is overwritten by every mission, the main part only by CTheScripts::Init
+void CTheScripts::ResetDecodeCache(bool bMainScript)
+{
+	if (bMainScript) {
+		memset(aDecodedScriptParamsAt, 0, SIZE_MAIN_SCRIPT * sizeof(int32));
+		NumDecodedMainParams = 0;
+	}
+	memset(&aDecodedScriptParamsAt[SIZE_MAIN_SCRIPT], 0, SIZE_MISSION_SCRIPT * sizeof(int32));
+	NumDecodedMissionParams = 0;
+}
+
+const tDecodedScriptParam* CTheScripts::GetDecodedParameters(uint32 ip, int16 total)
+{
+	if (!bUseDecodeCache)
+		return nil;
+	if (aDecodedScriptParamsAt[ip] != 0) {
+		const tDecodedScriptParam* pBlock = &aDecodedScriptParams[aDecodedScriptParamsAt[ip] - 1];
+		// some commands read their parameters in more than one go, only use blocks of the same length
+		return pBlock->nType == total ? pBlock : nil;
+	}
+
+	int32 *pNumDecoded, start, size;
+	if (ip < SIZE_MAIN_SCRIPT) {
+		pNumDecoded = &NumDecodedMainParams;
+		start = 0;
+		size = SCRIPT_DECODE_MAIN_SIZE;
+	} else {
+		pNumDecoded = &NumDecodedMissionParams;
+		start = SCRIPT_DECODE_MAIN_SIZE;
+		size = SCRIPT_DECODE_MISSION_SIZE;
+	}
+	if (*pNumDecoded + total + 1 > size)
+		return nil;
+
+	tDecodedScriptParam* pBlock = &aDecodedScriptParams[start + *pNumDecoded];
+	uint32 paramIp = ip;
+	for (int16 i = 1; i <= total; i++) {
+		switch (Read1ByteFromScript(&paramIp)) {
+		case ARGUMENT_INT32:
+		case ARGUMENT_FLOAT:
+			pBlock[i].nType = ARGUMENT_INT32;
+			pBlock[i].nValue = Read4BytesFromScript(&paramIp);
+			break;
+		case ARGUMENT_GLOBALVAR:
+			pBlock[i].nType = ARGUMENT_GLOBALVAR;
+			pBlock[i].nValue = (uint16)Read2BytesFromScript(&paramIp);
+			break;
+		case ARGUMENT_LOCALVAR:
+			pBlock[i].nType = ARGUMENT_LOCALVAR;
+			pBlock[i].nValue = (uint16)Read2BytesFromScript(&paramIp);
+			break;
+		case ARGUMENT_INT8:
+			pBlock[i].nType = ARGUMENT_INT32;
+			pBlock[i].nValue = Read1ByteFromScript(&paramIp);
+			break;
+		case ARGUMENT_INT16:
+			pBlock[i].nType = ARGUMENT_INT32;
+			pBlock[i].nValue = Read2BytesFromScript(&paramIp);
+			break;
+		default:
+			// leave the asserting to CollectParameters
+			return nil;
+		}
+	}
+	pBlock[0].nType = total;
+	pBlock[0].nValue = paramIp;
+	aDecodedScriptParamsAt[ip] = start + *pNumDecoded + 1;
+	*pNumDecoded += total + 1;
+	return pBlock;
+}
+
+const CRunningScript::tCommandHandler CRunningScript::CommandHandlers[] = {
+	&CRunningScript::ProcessCommands0To99,
+	&CRunningScript::ProcessCommands100To199,
+	&CRunningScript::ProcessCommands200To299,
+	&CRunningScript::ProcessCommands300To399,
+	&CRunningScript::ProcessCommands400To499,
+	&CRunningScript::ProcessCommands500To599,
+	&CRunningScript::ProcessCommands600To699,
+	&CRunningScript::ProcessCommands700To799,
+	&CRunningScript::ProcessCommands800To899,
+	&CRunningScript::ProcessCommands900To999,
+	&CRunningScript::ProcessCommands1000To1099,
+	&CRunningScript::ProcessCommands1100To1199,
+	&CRunningScript::ProcessCommands1200To1299,
+	&CRunningScript::ProcessCommands1300To1399,
+	&CRunningScript::ProcessCommands1400To1499
+};
+#endif
+
 void CRunningScript::CollectParameters(uint32* pIp, int16 total)
 {
+#ifdef SCRIPT_DECODE_CACHE
+	const tDecodedScriptParam* pBlock = CTheScripts::GetDecodedParameters(*pIp, total);
+	if (pBlock) {
+		for (int16 i = 0; i < total; i++) {
+			const tDecodedScriptParam& param = pBlock[i + 1];
+			switch (param.nType)
+			{
+			case ARGUMENT_GLOBALVAR:
+				script_assert(param.nValue >= 8 && param.nValue < CTheScripts::GetSizeOfVariableSpace());
+				ScriptParams[i] = *((int32*)&CTheScripts::ScriptSpace[param.nValue]);
+				break;
+			case ARGUMENT_LOCALVAR:
+				script_assert(param.nValue >= 0 && param.nValue < ARRAY_SIZE(m_anLocalVariables));
+				ScriptParams[i] = m_anLocalVariables[param.nValue];
+				break;
+			default:
+				ScriptParams[i] = param.nValue;
+				break;
+			}
+		}
+		*pIp = pBlock[0].nValue;
+		return;
+	}
+#endif
 	for (int16 i = 0; i < total; i++){
 		uint16 varIndex;
 		switch (CTheScripts::Read1ByteFromScript(pIp))
@@ -2250,6 +2379,9 @@ void CTheScripts::Init()
 #endif
 	CFileMgr::Read(mainf, (char*)ScriptSpace, SIZE_MAIN_SCRIPT);
 	CFileMgr::CloseFile(mainf);
+#ifdef SCRIPT_DECODE_CACHE
+	ResetDecodeCache(true);
+#endif
 	CFileMgr::SetDir("");
 	StoreVehicleIndex = -1;
 	StoreVehicleWasRandom = true;
@@ -2432,17 +2564,48 @@ void CTheScripts::Process()
 	PrintToLog("CTheScripts::Process started, CTimer::GetTimeInMilliseconds == %u\n", CTimer::GetTimeInMilliseconds());
 #endif
 
+#ifdef SCRIPT_DECODE_CACHE
+	uint32 startTime = CTimer::GetCurrentTimeInCycles();
+#endif
 	CRunningScript* script = pActiveScripts;
 	while (script != nil){
 		CRunningScript* next = script->GetNext();
 		++ScriptsUpdated;
 		script->UpdateTimers(timeStep);
+#ifdef SCRIPT_PROFILER
+		if (CScriptProfiler::bEnabled) {
+			uint16 commandsBefore = CommandsExecuted;
+			uint32 scriptStart = CTimer::GetCurrentTimeInCycles();
+			script->Process();
+			CScriptProfiler::RecordScript(script, (uint16)(CommandsExecuted - commandsBefore), CTimer::GetCurrentTimeInCycles() - scriptStart);
+		} else
+#endif
 		script->Process();
 		script = next;
 		if (script && !script->m_bIsActive)
 			script = nil;
 	}
+#ifdef SCRIPT_DECODE_CACHE
+	ScriptCyclesThisSecond += CTimer::GetCurrentTimeInCycles() - startTime;
+	ScriptCommandsThisSecond += CommandsExecuted;
+	if (CTimer::GetTimeInMilliseconds() - ScriptStatsSecondStart >= 1000) {
+		ScriptCommandsPerSecond = ScriptCommandsThisSecond;
+		ScriptMicrosecondsPerSecond = ScriptCyclesThisSecond / Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+		ScriptCommandsThisSecond = 0;
+		ScriptCyclesThisSecond = 0;
+		ScriptStatsSecondStart = CTimer::GetTimeInMilliseconds();
+	}
+	if (bShowStats) {
+		char str[128];
+		sprintf(str, "SCRIPT COMMANDS %d/S TIME %dUS/S DECODED MAIN %d MISSION %d", ScriptCommandsPerSecond, ScriptMicrosecondsPerSecond,
+			NumDecodedMainParams, NumDecodedMissionParams);
+		CDebug::PrintAt(str, 2, 29);
+	}
+#endif
 	DbgFlag = false;
+#ifdef SCRIPT_PROFILER
+	CScriptProfiler::EndFrame();
+#endif
 #ifdef USE_ADVANCED_SCRIPT_DEBUG_OUTPUT
 	PrintToLog("Script processing done, ScriptsUpdated: %d, CommandsExecuted: %d\n", ScriptsUpdated, CommandsExecuted);
 #if SCRIPT_LOG_FILE_LEVEL == 1
@@ -2489,6 +2652,17 @@ void CRunningScript::Process()
 		CMessages::BriefMessages[0].m_nStartTime = 0;
 }
 
+#ifdef SCRIPT_PROFILER
+const char* GetScriptCommandName(int32 command)
+{
+#ifdef USE_ADVANCED_SCRIPT_DEBUG_OUTPUT
+	if (command >= 0 && command < ARRAY_SIZE(commands))
+		return commands[command].name;
+#endif
+	return nil;
+}
+#endif
+
 int8 CRunningScript::ProcessOneCommand()
 {
 	int8 retval = -1;
@@ -2531,6 +2705,13 @@ int8 CRunningScript::ProcessOneCommand()
 		ip = t;
 	}
 #endif
+#ifdef SCRIPT_PROFILER
+	uint32 commandStart = CScriptProfiler::bEnabled ? CTimer::GetCurrentTimeInCycles() : 0;
+#endif
+#ifdef SCRIPT_DECODE_CACHE
+	if (command < ARRAY_SIZE(CommandHandlers) * 100)
+		retval = (this->*CommandHandlers[command / 100])(command);
+#else
 	if (command < 100)
 		retval = ProcessCommands0To99(command);
 	else if (command < 200)
@@ -2561,6 +2742,11 @@ int8 CRunningScript::ProcessOneCommand()
 		retval = ProcessCommands1300To1399(command);
 	else if (command < 1500)
 		retval = ProcessCommands1400To1499(command);
+#endif
+#ifdef SCRIPT_PROFILER
+	if (CScriptProfiler::bEnabled)
+		CScriptProfiler::RecordCommand(command, CTimer::GetCurrentTimeInCycles() - commandStart);
+#endif
 #ifdef USE_ADVANCED_SCRIPT_DEBUG_OUTPUT
 	if (command < ARRAY_SIZE(commands)) {
 		if (commands[command].cond || commands[command].output[0] != ARGTYPE_NONE) {
@@ -4851,6 +5037,9 @@ CTheScripts::SwitchToMission(int32 mission)
 	CFileMgr::Seek(handle, offset, 0);
 	CFileMgr::Read(handle, (const char*)&CTheScripts::ScriptSpace[SIZE_MAIN_SCRIPT], SIZE_MISSION_SCRIPT);
 	CFileMgr::CloseFile(handle);
+#ifdef SCRIPT_DECODE_CACHE
+	CTheScripts::ResetDecodeCache(false);
+#endif
 	CRunningScript* pMissionScript = CTheScripts::StartNewScript(SIZE_MAIN_SCRIPT);
 	CTimer::Resume();
 	pMissionScript->m_bIsMissionScript = true;
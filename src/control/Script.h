@@ -276,6 +276,19 @@ enum {
 	MAX_NUM_STORED_LINES = 1024
 };
 
+#ifdef SCRIPT_DECODE_CACHE
+// The parameters of a command the way CollectParameters reads them, decoded the first time the
+// command runs. A block starts with a header holding how many parameters there are and the ip after them.
+struct tDecodedScriptParam
+{
+	int32 nValue;	// literal value or variable index, the ip after the parameters in the header
+	uint8 nType;	// ARGUMENT_INT32 for all literals, ARGUMENT_GLOBALVAR or ARGUMENT_LOCALVAR, number of parameters in the header
+};
+
+#define SCRIPT_DECODE_MAIN_SIZE (96 * 1024)
+#define SCRIPT_DECODE_MISSION_SIZE (16 * 1024)
+#endif
+
 class CTheScripts
 {
 public:
@@ -316,6 +329,12 @@ public:
 	static uint16 ScriptsUpdated;
 	static uint32 LastMissionPassedTime;
 	static uint16 NumberOfExclusiveMissionScripts;
+#ifdef SCRIPT_DECODE_CACHE
+	static bool bUseDecodeCache;
+	static bool bShowStats;
+	static void ResetDecodeCache(bool bMainScript);
+	static const tDecodedScriptParam *GetDecodedParameters(uint32 ip, int16 total);
+#endif
 #if (defined GTA_PC && !defined GTAVC_JP_PATCH || defined GTA_XBOX || defined SUPPORT_XBOX_SCRIPT || defined GTA_MOBILE || defined SUPPORT_MOBILE_SCRIPT)
 #define CARDS_IN_SUIT (13)
 #define NUM_SUITS (4)
@@ -534,6 +553,10 @@ public:
 	int8 ProcessCommands1200To1299(int32);
 	int8 ProcessCommands1300To1399(int32);
 	int8 ProcessCommands1400To1499(int32);
+#ifdef SCRIPT_DECODE_CACHE
+	typedef int8 (CRunningScript::*tCommandHandler)(int32);
+	static const tCommandHandler CommandHandlers[];
+#endif
 
 	void LocatePlayerCommand(int32, uint32*);
 	void LocatePlayerCharCommand(int32, uint32*);
@@ -394,6 +394,9 @@ int8 CRunningScript::ProcessCommands1000To1099(int32 command)
 		CFileMgr::Seek(handle, offset, 0);
 		CFileMgr::Read(handle, (const char*)&CTheScripts::ScriptSpace[SIZE_MAIN_SCRIPT], SIZE_MISSION_SCRIPT);
 		CFileMgr::CloseFile(handle);
+#ifdef SCRIPT_DECODE_CACHE
+		CTheScripts::ResetDecodeCache(false);
+#endif
 		CRunningScript* pMissionScript = CTheScripts::StartNewScript(SIZE_MAIN_SCRIPT);
 		CTimer::Resume();
 		pMissionScript->m_bIsMissionScript = true;
@@ -0,0 +1,154 @@
+#include "common.h"
+#include "crossplatform.h"
+
+#ifdef SCRIPT_PROFILER
+#include "ScriptProfiler.h"
+
+#include "Debug.h"
+#include "FileMgr.h"
+#include "Script.h"
+#include "Timer.h"
+
+struct tScriptProfile
+{
+	char name[8];
+	uint32 nFrames;	// frames it was processed in
+	uint32 nCommands;
+	uint64 nCycles;
+	uint32 nCommandsThisFrame;
+	uint32 nCyclesThisFrame;
+	uint32 nMaxCommandsPerFrame;
+	uint32 nMaxCyclesPerFrame;
+};
+
+bool CScriptProfiler::bEnabled;
+bool CScriptProfiler::bShowStats;
+
+uint32 aScriptCommandCalls[SCRIPT_PROFILER_NUM_COMMANDS];
+uint64 aScriptCommandCycles[SCRIPT_PROFILER_NUM_COMMANDS];
+tScriptProfile aScriptProfiles[SCRIPT_PROFILER_MAX_SCRIPTS];
+int32 NumScriptProfiles;
+uint32 ScriptProfileFrames;
+
+void
+CScriptProfiler::RecordCommand(int32 command, uint32 cycles)
+{
+	if(command >= SCRIPT_PROFILER_NUM_COMMANDS)
+		return;
+	aScriptCommandCalls[command]++;
+	aScriptCommandCycles[command] += cycles;
+}
+
+void
+CScriptProfiler::RecordScript(CRunningScript *pScript, uint32 commands, uint32 cycles)
+{
+	int32 i;
+	for(i = 0; i < NumScriptProfiles; i++)
+		if(strncmp(aScriptProfiles[i].name, pScript->m_abScriptName, sizeof(aScriptProfiles[i].name)) == 0)
+			break;
+	if(i == NumScriptProfiles){
+		if(NumScriptProfiles == SCRIPT_PROFILER_MAX_SCRIPTS)
+			return;
+		memset(&aScriptProfiles[i], 0, sizeof(tScriptProfile));
+		strncpy(aScriptProfiles[i].name, pScript->m_abScriptName, sizeof(aScriptProfiles[i].name));
+		NumScriptProfiles++;
+	}
+	// more than one script can have the same name, they're counted together
+	aScriptProfiles[i].nCommandsThisFrame += commands;
+	aScriptProfiles[i].nCyclesThisFrame += cycles;
+}
+
+// Called at the end of CTheScripts::Process
+void
+CScriptProfiler::EndFrame(void)
+{
+	if(!bEnabled)
+		return;
+
+	int32 worst = -1;
+	ScriptProfileFrames++;
+	for(int32 i = 0; i < NumScriptProfiles; i++){
+		tScriptProfile &profile = aScriptProfiles[i];
+		if(profile.nCommandsThisFrame == 0 && profile.nCyclesThisFrame == 0)
+			continue;
+		profile.nFrames++;
+		profile.nCommands += profile.nCommandsThisFrame;
+		profile.nCycles += profile.nCyclesThisFrame;
+		profile.nMaxCommandsPerFrame = Max(profile.nMaxCommandsPerFrame, profile.nCommandsThisFrame);
+		profile.nMaxCyclesPerFrame = Max(profile.nMaxCyclesPerFrame, profile.nCyclesThisFrame);
+		if(worst < 0 || profile.nCyclesThisFrame > aScriptProfiles[worst].nCyclesThisFrame)
+			worst = i;
+	}
+
+	if(bShowStats && worst >= 0){
+		uint32 cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+		tScriptProfile &profile = aScriptProfiles[worst];
+		char name[9];
+		char str[128];
+		strncpy(name, profile.name, 8);
+		name[8] = '\0';
+		sprintf(str, "SCRIPT PROFILE SLOWEST %s %d CMDS %dUS, WORST FRAME %d CMDS %dUS", name,
+			profile.nCommandsThisFrame, profile.nCyclesThisFrame / cyclesPerUs,
+			profile.nMaxCommandsPerFrame, profile.nMaxCyclesPerFrame / cyclesPerUs);
+		CDebug::PrintAt(str, 2, 30);
+	}
+
+	for(int32 i = 0; i < NumScriptProfiles; i++){
+		aScriptProfiles[i].nCommandsThisFrame = 0;
+		aScriptProfiles[i].nCyclesThisFrame = 0;
+	}
+}
+
+void
+CScriptProfiler::Reset(void)
+{
+	for(int32 i = 0; i < SCRIPT_PROFILER_NUM_COMMANDS; i++){
+		aScriptCommandCalls[i] = 0;
+		aScriptCommandCycles[i] = 0;
+	}
+	NumScriptProfiles = 0;
+	ScriptProfileFrames = 0;
+}
+
+void
+CScriptProfiler::DumpToCSV(void)
+{
+	int32 i;
+	double cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+
+	CFileMgr::SetDirMyDocuments();
+	FILE *f = fcaseopen("scriptprofile.csv", "w");
+	CFileMgr::SetDir("");
+	if(f == nil){
+		debug("Script profiler: couldn't open scriptprofile.csv\n");
+		return;
+	}
+
+	fprintf(f, "frames,%d\n\n", ScriptProfileFrames);
+	fprintf(f, "opcode,name,calls,total us,average us\n");
+	int32 numOpcodes = 0;
+	for(i = 0; i < SCRIPT_PROFILER_NUM_COMMANDS; i++){
+		if(aScriptCommandCalls[i] == 0)
+			continue;
+		numOpcodes++;
+		const char *name = GetScriptCommandName(i);
+		fprintf(f, "%d,%s,%u,%.1f,%.3f\n", i, name ? name : "", aScriptCommandCalls[i],
+			aScriptCommandCycles[i] / cyclesPerUs, aScriptCommandCycles[i] / cyclesPerUs / aScriptCommandCalls[i]);
+	}
+
+	fprintf(f, "\nscript,frames,commands,total us,commands per frame,us per frame,max commands per frame,max us per frame\n");
+	for(i = 0; i < NumScriptProfiles; i++){
+		tScriptProfile &profile = aScriptProfiles[i];
+		char name[9];
+		strncpy(name, profile.name, 8);
+		name[8] = '\0';
+		uint32 frames = Max(profile.nFrames, 1u);
+		fprintf(f, "%s,%u,%u,%.1f,%.1f,%.1f,%u,%.1f\n", name, profile.nFrames, profile.nCommands,
+			profile.nCycles / cyclesPerUs, (double)profile.nCommands / frames, profile.nCycles / cyclesPerUs / frames,
+			profile.nMaxCommandsPerFrame, profile.nMaxCyclesPerFrame / cyclesPerUs);
+	}
+	fclose(f);
+	debug("Script profiler: wrote %d opcodes and %d scripts to scriptprofile.csv\n", numOpcodes, NumScriptProfiles);
+}
+
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+#ifdef SCRIPT_PROFILER
+
+class CRunningScript;
+
+/*
+Optional profiler for the script engine. While it's enabled every command gets timed and
+counted by opcode, and every CRunningScript::Process is timed and counted by script name,
+including the worst frame each script had. A mission script that runs way more commands a
+frame than it should shows up on screen, and everything can be written to scriptprofile.csv.
+When it's disabled the only cost is checking bEnabled once per command and once per script.
+*/
+#define SCRIPT_PROFILER_NUM_COMMANDS 1500
+#define SCRIPT_PROFILER_MAX_SCRIPTS 128
+
+class CScriptProfiler
+{
+public:
+	static bool bEnabled;
+	static bool bShowStats;
+
+	static void RecordCommand(int32 command, uint32 cycles);
+	static void RecordScript(CRunningScript *pScript, uint32 commands, uint32 cycles);
+	static void EndFrame(void);
+	static void Reset(void);
+	static void DumpToCSV(void);
+};
+
+// in Script.cpp, nil if the command table isn't compiled in
+const char *GetScriptCommandName(int32 command);
+
+#endif
@@ -0,0 +1,484 @@
+#include "common.h"
+
+#ifdef TRAFFIC_LOD
+#include "TrafficLod.h"
+
+#include "Automobile.h"
+#include "Bike.h"
+#include "Camera.h"
+#include "CarCtrl.h"
+#include "Curves.h"
+#include "Debug.h"
+#include "General.h"
+#include "ModelInfo.h"
+#include "PathFind.h"
+#include "Pools.h"
+#include "Streaming.h"
+#include "Timer.h"
+#include "VisibilityPlugins.h"
+#include "World.h"
+
+#define TRAFFIC_LOD_SIMPLE_RANGE (60.0f)	// physics cars further away from the camera than this may go back on rails
+#define TRAFFIC_LOD_MAX_RAIL_DISTANCE (1.5f)
+#define TRAFFIC_LOD_VIRTUAL_RANGE (450.0f)	// virtual cars further away than this from the player are forgotten
+#define TRAFFIC_LOD_UPDATE_SLICES (8)
+#define TRAFFIC_LOD_PROMOTE_TESTS (16)
+#define TRAFFIC_LOD_TIME_BEFORE_PROMOTE (3000)
+#define TRAFFIC_LOD_CARS_PER_LANE (3)
+#define TRAFFIC_LOD_ATTEMPTS_TO_FIND_NEXT_NODE (8)
+
+// same ranges as CCarCtrl::GenerateOneRandomCar
+#define TRAFFIC_LOD_MIN_OFFSCREEN_RANGE (25.0f)
+#define TRAFFIC_LOD_MAX_OFFSCREEN_RANGE (40.0f)
+#define TRAFFIC_LOD_MIN_ONSCREEN_RANGE (100.0f)
+#define TRAFFIC_LOD_MAX_ONSCREEN_RANGE (120.0f)
+#define TRAFFIC_LOD_MIN_ONSCREEN_CAMERA_RANGE (82.5f)
+
+enum
+{
+	VIRTUAL_CAR_MOVED,
+	VIRTUAL_CAR_WAITING,
+	VIRTUAL_CAR_STUCK
+};
+
+bool CTrafficLod::bEnabled = true;
+bool CTrafficLod::bShowStats;
+
+tVirtualCar aVirtualCars[TRAFFIC_LOD_MAX_VIRTUAL_CARS];
+uint8 aLinkOccupancy[NUM_CARPATHLINKS];
+int32 NumVirtualCars;
+int32 nNextVirtualCarToPromote;
+
+int32 nVirtualCarsStored;
+int32 nVirtualCarsPromoted;
+int32 nCarsSwitchedToSimple;
+
+static void
+GetLanePosition(int32 link, int8 direction, int8 lane, CVector &position, CVector &forward)
+{
+	CCarPathLink *pLink = &ThePaths.m_carPathLinks[link];
+	float forwardX = pLink->GetDirX() * direction;
+	float forwardY = pLink->GetDirY() * direction;
+	position = CVector(
+		pLink->GetX() + ((lane + pLink->OneWayLaneOffset()) * LANE_WIDTH) * forwardY,
+		pLink->GetY() - ((lane + pLink->OneWayLaneOffset()) * LANE_WIDTH) * forwardX,
+		0.0f);
+	forward = CVector(forwardX, forwardY, 0.0f);
+}
+
+static int32
+GetLinkCapacity(int32 link)
+{
+	CCarPathLink *pLink = &ThePaths.m_carPathLinks[link];
+	return Max(pLink->numLeftLanes + pLink->numRightLanes, 1) * TRAFFIC_LOD_CARS_PER_LANE;
+}
+
+static void
+CalcTimeToSpendOnCurve(tVirtualCar &car)
+{
+	CVector positionCurrent, positionNext, forwardCurrent, forwardNext;
+	GetLanePosition(car.nCurrentLink, car.nCurrentDirection, car.nCurrentLane, positionCurrent, forwardCurrent);
+	GetLanePosition(car.nNextLink, car.nNextDirection, car.nNextLane, positionNext, forwardNext);
+	car.nTimeToSpendOnCurve = CCurves::CalcSpeedScaleFactor(&positionCurrent, &positionNext,
+		forwardCurrent.x, forwardCurrent.y, forwardNext.x, forwardNext.y) * (1000.0f / Max(car.nCruiseSpeed, 1));
+	car.nTimeToSpendOnCurve = Max(10, car.nTimeToSpendOnCurve);
+}
+
+// Rough position on the chord between the two links, good enough for range checks
+static CVector
+GetVirtualCarPosition(tVirtualCar &car)
+{
+	CVector positionCurrent, positionNext, forwardCurrent, forwardNext;
+	GetLanePosition(car.nCurrentLink, car.nCurrentDirection, car.nCurrentLane, positionCurrent, forwardCurrent);
+	GetLanePosition(car.nNextLink, car.nNextDirection, car.nNextLane, positionNext, forwardNext);
+	float f = Min((float)car.nTimeOnCurve / car.nTimeToSpendOnCurve, 1.0f);
+	CVector position = positionCurrent + (positionNext - positionCurrent) * f;
+	position.z = ThePaths.m_pathNodes[car.nCurrentNode].GetZ();
+	return position;
+}
+
+static void
+FreeVirtualCar(int32 i)
+{
+	tVirtualCar &car = aVirtualCars[i];
+	if(aLinkOccupancy[car.nCurrentLink] > 0)
+		aLinkOccupancy[car.nCurrentLink]--;
+	car.nModelIndex = -1;
+	NumVirtualCars--;
+}
+
+// A cheaper CCarCtrl::PickNextNodeRandomly: no lane rules, no traffic lights,
+// but no turning around either. A car that can't go on is dropped.
+static int32
+PickNextNodeForVirtualCar(tVirtualCar &car)
+{
+	int32 prevNode = car.nCurrentNode;
+	int32 curNode = car.nNextNode;
+	CPathNode *pPrevNode = &ThePaths.m_pathNodes[prevNode];
+	CPathNode *pCurNode = &ThePaths.m_pathNodes[curNode];
+	if(pCurNode->numLinks == 0)
+		return VIRTUAL_CAR_STUCK;
+	int32 nextNode = -1;
+	int32 nextConnection = -1;
+	bool bJammed = false;
+	for(int attempt = 0; attempt < TRAFFIC_LOD_ATTEMPTS_TO_FIND_NEXT_NODE; attempt++){
+		int32 i = CGeneral::GetRandomNumber() % pCurNode->numLinks;
+		int32 node = ThePaths.ConnectedNode(i + pCurNode->firstLink);
+		if(node == prevNode)
+			continue;
+		CPathNode *pNode = &ThePaths.m_pathNodes[node];
+		if(pNode->bDeadEnd && !pPrevNode->bDeadEnd ||
+		   pNode->bDisabled && !pPrevNode->bDisabled ||
+		   pNode->bBetweenLevels && !pPrevNode->bBetweenLevels && car.bStayInCurrentLevel)
+			continue;
+		int32 connection = ThePaths.m_carPathConnections[i + pCurNode->firstLink];
+		CCarPathLink *pLink = &ThePaths.m_carPathLinks[connection];
+		bool goingAgainstOneWayRoad = pLink->pathNodeIndex == curNode ? pLink->numRightLanes == 0 : pLink->numLeftLanes == 0;
+		if(goingAgainstOneWayRoad)
+			continue;
+		if(aLinkOccupancy[connection] >= GetLinkCapacity(connection)){
+			bJammed = true;
+			continue;
+		}
+		nextNode = node;
+		nextConnection = connection;
+		break;
+	}
+	if(nextNode < 0)
+		return bJammed ? VIRTUAL_CAR_WAITING : VIRTUAL_CAR_STUCK;
+
+	if(aLinkOccupancy[car.nCurrentLink] > 0)
+		aLinkOccupancy[car.nCurrentLink]--;
+	if(aLinkOccupancy[car.nNextLink] < 255)
+		aLinkOccupancy[car.nNextLink]++;
+	CCarPathLink *pNextLink = &ThePaths.m_carPathLinks[nextConnection];
+	car.nCurrentNode = curNode;
+	car.nNextNode = nextNode;
+	car.nCurrentLink = car.nNextLink;
+	car.nCurrentDirection = car.nNextDirection;
+	car.nCurrentLane = car.nNextLane;
+	car.nNextLink = nextConnection;
+	int8 lanesOnNextNode;
+	if(curNode >= nextNode){
+		car.nNextDirection = 1;
+		lanesOnNextNode = pNextLink->numLeftLanes;
+	}else{
+		car.nNextDirection = -1;
+		lanesOnNextNode = pNextLink->numRightLanes;
+	}
+	car.nNextLane = Max(0, Min(lanesOnNextNode - 1, car.nCurrentLane));
+	CalcTimeToSpendOnCurve(car);
+	return VIRTUAL_CAR_MOVED;
+}
+
+static bool
+AdvanceVirtualCar(tVirtualCar &car)
+{
+	uint32 timeNow = CTimer::GetTimeInMilliseconds();
+	car.nTimeOnCurve += timeNow - car.nLastUpdate;
+	car.nLastUpdate = timeNow;
+	// a few curves at most, the car is only looked at every few frames anyway
+	for(int i = 0; i < 4 && car.nTimeOnCurve >= car.nTimeToSpendOnCurve; i++){
+		uint32 timeOnLastCurve = car.nTimeToSpendOnCurve;
+		switch(PickNextNodeForVirtualCar(car)){
+		case VIRTUAL_CAR_MOVED:
+			car.nTimeOnCurve -= timeOnLastCurve;
+			break;
+		case VIRTUAL_CAR_WAITING:
+			car.nTimeOnCurve = car.nTimeToSpendOnCurve;
+			return true;
+		case VIRTUAL_CAR_STUCK:
+			return false;
+		}
+	}
+	car.nTimeOnCurve = Min(car.nTimeOnCurve, car.nTimeToSpendOnCurve);
+	return true;
+}
+
+static bool
+CreateVehicleForVirtualCar(tVirtualCar &car)
+{
+	CVehicle *pVehicle;
+	if(CModelInfo::IsBikeModel(car.nModelIndex))
+		pVehicle = new CBike(car.nModelIndex, RANDOM_VEHICLE);
+	else
+		pVehicle = new CAutomobile(car.nModelIndex, RANDOM_VEHICLE);
+	pVehicle->m_currentColour1 = car.nColour1;
+	pVehicle->m_currentColour2 = car.nColour2;
+	pVehicle->AutoPilot.m_nPrevRouteNode = 0;
+	pVehicle->AutoPilot.m_nCurrentRouteNode = car.nCurrentNode;
+	pVehicle->AutoPilot.m_nNextRouteNode = car.nNextNode;
+	pVehicle->AutoPilot.m_nPreviousPathNodeInfo = car.nCurrentLink;
+	pVehicle->AutoPilot.m_nCurrentPathNodeInfo = car.nCurrentLink;
+	pVehicle->AutoPilot.m_nNextPathNodeInfo = car.nNextLink;
+	pVehicle->AutoPilot.m_nPreviousDirection = car.nCurrentDirection;
+	pVehicle->AutoPilot.m_nCurrentDirection = car.nCurrentDirection;
+	pVehicle->AutoPilot.m_nNextDirection = car.nNextDirection;
+	pVehicle->AutoPilot.m_nCurrentLane = car.nCurrentLane;
+	pVehicle->AutoPilot.m_nNextLane = car.nNextLane;
+	pVehicle->AutoPilot.m_nTimeToSpendOnCurrentCurve = car.nTimeToSpendOnCurve;
+	pVehicle->AutoPilot.m_nTimeEnteredCurve = CTimer::GetTimeInMilliseconds() - car.nTimeOnCurve;
+	pVehicle->AutoPilot.m_nCruiseSpeed = car.nCruiseSpeed;
+	pVehicle->AutoPilot.m_fMaxTrafficSpeed = car.nCruiseSpeed;
+	pVehicle->AutoPilot.m_nCarMission = MISSION_CRUISE;
+	pVehicle->AutoPilot.m_nTempAction = TEMPACT_NONE;
+	pVehicle->AutoPilot.m_nDrivingStyle = DRIVINGSTYLE_STOP_FOR_CARS;
+	pVehicle->AutoPilot.m_bStayInCurrentLevel = car.bStayInCurrentLevel;
+
+	CVector positionCurrent, positionNext, forwardCurrent, forwardNext;
+	GetLanePosition(car.nCurrentLink, car.nCurrentDirection, car.nCurrentLane, positionCurrent, forwardCurrent);
+	GetLanePosition(car.nNextLink, car.nNextDirection, car.nNextLane, positionNext, forwardNext);
+	CVector positionIncludingCurve;
+	CVector directionIncludingCurve;
+	CCurves::CalcCurvePoint(&positionCurrent, &positionNext, &forwardCurrent, &forwardNext,
+		CCarCtrl::GetPositionAlongCurrentCurve(pVehicle), pVehicle->AutoPilot.m_nTimeToSpendOnCurrentCurve,
+		&positionIncludingCurve, &directionIncludingCurve);
+
+	positionIncludingCurve.z = ThePaths.m_pathNodes[car.nCurrentNode].GetZ();
+	float groundZ = 1000000000.0f;
+	CColPoint colPoint;
+	CEntity *pEntity;
+	if(CWorld::ProcessVerticalLine(positionIncludingCurve, 1000.0f, colPoint, pEntity, true, false, false, false, true, false, nil))
+		groundZ = colPoint.point.z;
+	if(CWorld::ProcessVerticalLine(positionIncludingCurve, -1000.0f, colPoint, pEntity, true, false, false, false, true, false, nil)){
+		if(ABS(colPoint.point.z - positionIncludingCurve.z) < ABS(groundZ - positionIncludingCurve.z))
+			groundZ = colPoint.point.z;
+	}
+	if(ABS(groundZ - positionIncludingCurve.z) > 7.0f){
+		delete pVehicle;
+		return false;
+	}
+	positionIncludingCurve.z = groundZ + pVehicle->GetHeightAboveRoad();
+
+	CVector forward(directionIncludingCurve.x, directionIncludingCurve.y, 0.0f);
+	if(forward.MagnitudeSqr() == 0.0f)
+		forward = forwardNext;
+	forward.Normalise();
+	pVehicle->GetForward() = forward;
+	pVehicle->GetRight() = CVector(forward.y, -forward.x, 0.0f);
+	pVehicle->GetUp() = CVector(0.0f, 0.0f, 1.0f);
+	pVehicle->SetPosition(positionIncludingCurve);
+	pVehicle->SetMoveSpeed(directionIncludingCurve / GAME_SPEED_TO_CARAI_SPEED);
+
+	int16 colliding;
+	CWorld::FindObjectsKindaColliding(pVehicle->GetPosition(), pVehicle->GetModelInfo()->GetColModel()->boundingSphere.radius,
+		true, &colliding, 2, nil, false, true, false, false, false);
+	if(colliding){
+		delete pVehicle;
+		return false;
+	}
+
+	pVehicle->SetStatus(STATUS_SIMPLE);
+	CVisibilityPlugins::SetClumpAlpha(pVehicle->GetClump(), 0);
+	CWorld::Add(pVehicle);
+	pVehicle->SetUpDriver();
+	return true;
+}
+
+void
+CTrafficLod::Init(void)
+{
+	for(int i = 0; i < TRAFFIC_LOD_MAX_VIRTUAL_CARS; i++)
+		aVirtualCars[i].nModelIndex = -1;
+	for(int i = 0; i < NUM_CARPATHLINKS; i++)
+		aLinkOccupancy[i] = 0;
+	NumVirtualCars = 0;
+	nNextVirtualCarToPromote = 0;
+}
+
+void
+CTrafficLod::Update(void)
+{
+	if(!bEnabled){
+		if(NumVirtualCars != 0)
+			Init();
+		return;
+	}
+
+	CVector vecPlayerPos = FindPlayerCentreOfWorld(CWorld::PlayerInFocus);
+	for(int i = CTimer::GetFrameCounter() % TRAFFIC_LOD_UPDATE_SLICES; i < TRAFFIC_LOD_MAX_VIRTUAL_CARS; i += TRAFFIC_LOD_UPDATE_SLICES){
+		tVirtualCar &car = aVirtualCars[i];
+		if(car.nModelIndex == -1)
+			continue;
+		if(!AdvanceVirtualCar(car) ||
+		   (GetVirtualCarPosition(car) - vecPlayerPos).MagnitudeSqr2D() > SQR(TRAFFIC_LOD_VIRTUAL_RANGE))
+			FreeVirtualCar(i);
+	}
+
+	if(bShowStats){
+		int32 numPhysics = 0;
+		int32 numSimple = 0;
+		for(int i = CPools::GetVehiclePool()->GetSize()-1; i >= 0; i--){
+			CVehicle *pVehicle = CPools::GetVehiclePool()->GetSlot(i);
+			if(pVehicle == nil || pVehicle->VehicleCreatedBy != RANDOM_VEHICLE)
+				continue;
+			if(pVehicle->GetStatus() == STATUS_PHYSICS)
+				numPhysics++;
+			else if(pVehicle->GetStatus() == STATUS_SIMPLE)
+				numSimple++;
+		}
+		char str[128];
+		sprintf(str, "TRAFFIC PHYSICS %d SIMPLE %d VIRTUAL %d STORED %d PROMOTED %d BACK ON RAILS %d", numPhysics, numSimple,
+			NumVirtualCars, nVirtualCarsStored, nVirtualCarsPromoted, nCarsSwitchedToSimple);
+		CDebug::PrintAt(str, 2, 25);
+	}
+}
+
+// Called just before a random car is deleted for being too far away
+bool
+CTrafficLod::StoreVehicle(CVehicle *pVehicle)
+{
+	if(!bEnabled || NumVirtualCars >= TRAFFIC_LOD_MAX_VIRTUAL_CARS)
+		return false;
+	if(pVehicle->VehicleCreatedBy != RANDOM_VEHICLE || pVehicle->pDriver == nil ||
+	   pVehicle->GetStatus() != STATUS_SIMPLE && pVehicle->GetStatus() != STATUS_PHYSICS ||
+	   pVehicle->bIsLawEnforcer || pVehicle->bIsAmbulanceOnDuty || pVehicle->bIsFireTruckOnDuty ||
+	   pVehicle->m_fHealth < 300.0f)
+		return false;
+	if(!CModelInfo::IsBikeModel(pVehicle->GetModelIndex()) &&
+	   (!CModelInfo::IsCarModel(pVehicle->GetModelIndex()) || pVehicle->GetVehicleAppearance() != VEHICLE_APPEARANCE_CAR))
+		return false;
+	CAutoPilot &autoPilot = pVehicle->AutoPilot;
+	if(autoPilot.m_nCarMission != MISSION_CRUISE || autoPilot.m_nTempAction != TEMPACT_NONE ||
+	   autoPilot.m_nDrivingStyle != DRIVINGSTYLE_STOP_FOR_CARS && autoPilot.m_nDrivingStyle != DRIVINGSTYLE_STOP_FOR_CARS_IGNORE_LIGHTS ||
+	   autoPilot.m_nCruiseSpeed == 0 || autoPilot.m_nCurrentRouteNode == autoPilot.m_nNextRouteNode ||
+	   autoPilot.m_nCurrentPathNodeInfo >= (uint32)ThePaths.m_numCarPathLinks ||
+	   autoPilot.m_nNextPathNodeInfo >= (uint32)ThePaths.m_numCarPathLinks)
+		return false;
+
+	int32 i = 0;
+	while(aVirtualCars[i].nModelIndex != -1)
+		i++;
+	tVirtualCar &car = aVirtualCars[i];
+	car.nModelIndex = pVehicle->GetModelIndex();
+	car.nColour1 = pVehicle->m_currentColour1;
+	car.nColour2 = pVehicle->m_currentColour2;
+	car.nCurrentNode = autoPilot.m_nCurrentRouteNode;
+	car.nNextNode = autoPilot.m_nNextRouteNode;
+	car.nCurrentLink = autoPilot.m_nCurrentPathNodeInfo;
+	car.nNextLink = autoPilot.m_nNextPathNodeInfo;
+	car.nCurrentDirection = autoPilot.m_nCurrentDirection;
+	car.nNextDirection = autoPilot.m_nNextDirection;
+	car.nCurrentLane = autoPilot.m_nCurrentLane;
+	car.nNextLane = autoPilot.m_nNextLane;
+	car.nCruiseSpeed = autoPilot.m_nCruiseSpeed;
+	car.bStayInCurrentLevel = autoPilot.m_bStayInCurrentLevel;
+	car.nTimeToSpendOnCurve = Max(10, autoPilot.m_nTimeToSpendOnCurrentCurve);
+	int32 timeOnCurve = CTimer::GetTimeInMilliseconds() - autoPilot.m_nTimeEnteredCurve;
+	car.nTimeOnCurve = Min(Max(timeOnCurve, 0), (int32)car.nTimeToSpendOnCurve);
+	car.nLastUpdate = CTimer::GetTimeInMilliseconds();
+	car.nTimeStored = CTimer::GetTimeInMilliseconds();
+	if(aLinkOccupancy[car.nCurrentLink] < 255)
+		aLinkOccupancy[car.nCurrentLink]++;
+	NumVirtualCars++;
+	nVirtualCarsStored++;
+	return true;
+}
+
+// Called by CCarCtrl::GenerateOneRandomCar before it makes up a new car
+bool
+CTrafficLod::PromoteCar(void)
+{
+	if(!bEnabled || NumVirtualCars == 0)
+		return false;
+
+	CVector vecPlayerPos = FindPlayerCentreOfWorld(CWorld::PlayerInFocus);
+	bool bTopDownCamera = TheCamera.GetForward().z < -0.9f;
+	for(int n = 0; n < TRAFFIC_LOD_PROMOTE_TESTS; n++){
+		int32 i = nNextVirtualCarToPromote;
+		nNextVirtualCarToPromote = (nNextVirtualCarToPromote + 1) % TRAFFIC_LOD_MAX_VIRTUAL_CARS;
+		tVirtualCar &car = aVirtualCars[i];
+		if(car.nModelIndex == -1 || CTimer::GetTimeInMilliseconds() < car.nTimeStored + TRAFFIC_LOD_TIME_BEFORE_PROMOTE)
+			continue;
+		if(!CStreaming::HasModelLoaded(car.nModelIndex))
+			continue;
+		if(!AdvanceVirtualCar(car)){
+			FreeVirtualCar(i);
+			continue;
+		}
+		CVector position = GetVirtualCarPosition(car);
+		float distance = (position - vecPlayerPos).Magnitude2D();
+		if(TheCamera.IsSphereVisible(position, 5.0f)){
+			if(bTopDownCamera ||
+			   distance < TRAFFIC_LOD_MIN_ONSCREEN_RANGE * TheCamera.GenerationDistMultiplier ||
+			   distance > TRAFFIC_LOD_MAX_ONSCREEN_RANGE * TheCamera.GenerationDistMultiplier ||
+			   (TheCamera.GetPosition() - position).Magnitude2D() < TRAFFIC_LOD_MIN_ONSCREEN_CAMERA_RANGE * TheCamera.GenerationDistMultiplier)
+				continue;
+		}else{
+			if(distance < TRAFFIC_LOD_MIN_OFFSCREEN_RANGE || distance > TRAFFIC_LOD_MAX_OFFSCREEN_RANGE)
+				continue;
+		}
+		if(!CreateVehicleForVirtualCar(car))
+			continue;
+		FreeVirtualCar(i);
+		nVirtualCarsPromoted++;
+		return true;
+	}
+	return false;
+}
+
+// Mid range: a cruising physics car that is back on its lane is put on rails again
+void
+CTrafficLod::PossiblySwitchToSimple(CVehicle *pVehicle)
+{
+	if(!bEnabled || pVehicle->GetStatus() != STATUS_PHYSICS)
+		return;
+	if(((CTimer::GetFrameCounter() + CPools::GetVehiclePool()->GetJustIndex(pVehicle)) & 0xF) != 0)
+		return;
+	if(pVehicle->VehicleCreatedBy != RANDOM_VEHICLE || pVehicle->pDriver == nil || pVehicle->bIsLawEnforcer ||
+	   pVehicle->bIsAmbulanceOnDuty || pVehicle->bIsFireTruckOnDuty || pVehicle->m_fHealth < 300.0f)
+		return;
+	CAutoPilot &autoPilot = pVehicle->AutoPilot;
+	if(autoPilot.m_nCarMission != MISSION_CRUISE || autoPilot.m_nTempAction != TEMPACT_NONE ||
+	   autoPilot.m_nDrivingStyle != DRIVINGSTYLE_STOP_FOR_CARS && autoPilot.m_nDrivingStyle != DRIVINGSTYLE_STOP_FOR_CARS_IGNORE_LIGHTS)
+		return;
+	if(pVehicle->IsCar()){
+		if(pVehicle->GetVehicleAppearance() != VEHICLE_APPEARANCE_CAR || ((CAutomobile*)pVehicle)->m_nWheelsOnGround < 4)
+			return;
+	}else if(pVehicle->IsBike()){
+		if(((CBike*)pVehicle)->m_nWheelsOnGround < 2)
+			return;
+	}else
+		return;
+	if(pVehicle->GetUp().z < 0.9f || DotProduct(pVehicle->GetMoveSpeed(), pVehicle->GetForward()) < 0.0f)
+		return;
+	if((TheCamera.GetPosition() - pVehicle->GetPosition()).MagnitudeSqr2D() < SQR(TRAFFIC_LOD_SIMPLE_RANGE))
+		return;
+	if(CCarCtrl::IsThisVehicleInteresting(pVehicle))
+		return;
+
+	// Find where on the current curve the car is and only let go of it if it's really there
+	CVector positionCurrent, positionNext, forwardCurrent, forwardNext;
+	GetLanePosition(autoPilot.m_nCurrentPathNodeInfo, autoPilot.m_nCurrentDirection, autoPilot.m_nCurrentLane, positionCurrent, forwardCurrent);
+	GetLanePosition(autoPilot.m_nNextPathNodeInfo, autoPilot.m_nNextDirection, autoPilot.m_nNextLane, positionNext, forwardNext);
+	CVector2D chord = positionNext - positionCurrent;
+	if(chord.MagnitudeSqr() < SQR(0.1f))
+		return;
+	float f = DotProduct2D(CVector2D(pVehicle->GetPosition()) - positionCurrent, chord) / chord.MagnitudeSqr();
+	if(f < 0.0f || f > 1.0f)
+		return;
+	CVector positionIncludingCurve;
+	CVector directionIncludingCurve;
+	CCurves::CalcCurvePoint(&positionCurrent, &positionNext, &forwardCurrent, &forwardNext,
+		f, autoPilot.m_nTimeToSpendOnCurrentCurve, &positionIncludingCurve, &directionIncludingCurve);
+	CVector2D direction = directionIncludingCurve;
+	if(direction.MagnitudeSqr() == 0.0f)
+		return;
+	direction.Normalise();
+	if((CVector2D(pVehicle->GetPosition()) - positionIncludingCurve).MagnitudeSqr() > SQR(TRAFFIC_LOD_MAX_RAIL_DISTANCE) ||
+	   DotProduct2D(direction, pVehicle->GetForward()) < 0.95f)
+		return;
+
+	autoPilot.m_nTimeEnteredCurve = CTimer::GetTimeInMilliseconds() - (uint32)(f * autoPilot.m_nTimeToSpendOnCurrentCurve);
+	pVehicle->SetStatus(STATUS_SIMPLE);
+	pVehicle->SetTurnSpeed(0.0f, 0.0f, 0.0f);
+	nCarsSwitchedToSimple++;
+}
+
+int32
+CTrafficLod::GetLinkOccupancy(int32 link)
+{
+	return aLinkOccupancy[link];
+}
+
+#endif
@@ -0,0 +1,53 @@
+#pragma once
+
+#ifdef TRAFFIC_LOD
+
+class CVehicle;
+
+/*
+Random traffic is kept on three tiers:
+- close to the camera cars drive with full physics as before
+- further out cruising physics cars that are back on their lane get put on rails again (STATUS_SIMPLE)
+- far away, instead of being deleted, cruising cars are turned into virtual cars. These have no
+  CVehicle, they only remember their model, colours and where on the path links they are, and they
+  keep driving around the road network a few times a second. A virtual car coming back into the
+  generation range is turned into a real car on rails again before any new random car is made up.
+*/
+#define TRAFFIC_LOD_MAX_VIRTUAL_CARS 256
+
+struct tVirtualCar
+{
+	int16 nModelIndex;	// -1 if free
+	uint8 nColour1;
+	uint8 nColour2;
+	int16 nCurrentNode;
+	int16 nNextNode;
+	int16 nCurrentLink;	// index into ThePaths.m_carPathLinks
+	int16 nNextLink;
+	int8 nCurrentDirection;
+	int8 nNextDirection;
+	int8 nCurrentLane;
+	int8 nNextLane;
+	uint8 nCruiseSpeed;
+	bool bStayInCurrentLevel;
+	uint32 nTimeOnCurve;
+	uint32 nTimeToSpendOnCurve;
+	uint32 nLastUpdate;
+	uint32 nTimeStored;
+};
+
+class CTrafficLod
+{
+public:
+	static bool bEnabled;
+	static bool bShowStats;
+
+	static void Init(void);
+	static void Update(void);
+	static bool StoreVehicle(CVehicle *pVehicle);
+	static bool PromoteCar(void);
+	static void PossiblySwitchToSimple(CVehicle *pVehicle);
+	static int32 GetLinkOccupancy(int32 link);
+};
+
+#endif
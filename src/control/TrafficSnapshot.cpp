@@ -0,0 +1,267 @@
+#include "common.h"
+
+#ifdef TRAFFIC_SNAPSHOT
+#include "TrafficSnapshot.h"
+
+#include "Debug.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "Vehicle.h"
+#include "World.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define TRAFFIC_GATHER_DISTANCE 24.0f	// the largest area CCarCtrl scans for cars to slow down for or weave around
+#define TRAFFIC_GATHER_MARGIN 5.0f	// cars on rails are dragged along during the frame
+#define TRAFFIC_MAX_OWN_MOVEMENT 1.0f
+#define TRAFFIC_GATHER_BATCH 8
+#define TRAFFIC_MAX_CHECKED 64
+
+bool CTrafficSnapshot::ms_bValid;
+bool CTrafficSnapshot::bEnabled = true;
+bool CTrafficSnapshot::bCheck;
+bool CTrafficSnapshot::bShowStats;
+
+tTrafficNeighbours aTrafficNeighbours[NUMVEHICLES];	// by vehicle pool slot
+int32 aTrafficCars[NUMVEHICLES];
+int32 NumTrafficCars;
+
+std::thread aTrafficWorkers[TRAFFIC_MAX_WORKERS];
+int32 NumTrafficWorkers = -1;	// not started yet
+std::mutex TrafficWorkerMutex;
+std::condition_variable TrafficWorkerWakeUp;
+std::condition_variable TrafficWorkerDone;
+uint32 nTrafficWorkGeneration;
+int32 nTrafficWorkersBusy;
+bool bTrafficWorkersQuit;
+std::atomic<int32> nNextTrafficCar;
+
+int32 nTrafficFallbacks;
+int32 nTrafficMismatches;
+
+static void
+GatherSectorList(tTrafficNeighbours &car, CPtrList &list, int32 sector, float x_inf, float y_inf, float x_sup, float y_sup)
+{
+	for(CPtrNode *node = list.first; node; node = node->next){
+		CVehicle *pVehicle = (CVehicle*)node->item;
+		if(pVehicle == car.pVehicle)
+			continue;
+		CVector centre;
+		pVehicle->GetBoundCentre(centre);
+		if(centre.x < x_inf || centre.x > x_sup || centre.y < y_inf || centre.y > y_sup)
+			continue;
+		if(car.nNumNeighbours == TRAFFIC_MAX_NEIGHBOURS){
+			car.bOverflow = true;
+			return;
+		}
+		car.aNeighbours[car.nNumNeighbours].pVehicle = pVehicle;
+		car.aNeighbours[car.nNumNeighbours].nSector = sector;
+		car.nNumNeighbours++;
+	}
+}
+
+// Same sectors and list order as the scans in CCarCtrl, but without scan codes since several
+// threads run this at once. A vehicle in more than one sector is kept for each of them.
+static void
+GatherNeighbours(tTrafficNeighbours &car)
+{
+	float left = car.vecPosition.x - (TRAFFIC_GATHER_DISTANCE + TRAFFIC_GATHER_MARGIN);
+	float right = car.vecPosition.x + (TRAFFIC_GATHER_DISTANCE + TRAFFIC_GATHER_MARGIN);
+	float top = car.vecPosition.y - (TRAFFIC_GATHER_DISTANCE + TRAFFIC_GATHER_MARGIN);
+	float bottom = car.vecPosition.y + (TRAFFIC_GATHER_DISTANCE + TRAFFIC_GATHER_MARGIN);
+	int xstart = Max(0, CWorld::GetSectorIndexX(left));
+	int xend = Min(NUMSECTORS_X - 1, CWorld::GetSectorIndexX(right));
+	int ystart = Max(0, CWorld::GetSectorIndexY(top));
+	int yend = Min(NUMSECTORS_Y - 1, CWorld::GetSectorIndexY(bottom));
+
+	car.nNumNeighbours = 0;
+	car.bOverflow = false;
+	for(int y = ystart; y <= yend && !car.bOverflow; y++){
+		for(int x = xstart; x <= xend && !car.bOverflow; x++){
+			CSector *s = CWorld::GetSector(x, y);
+			GatherSectorList(car, s->m_lists[ENTITYLIST_VEHICLES], y*NUMSECTORS_X + x, left, top, right, bottom);
+			GatherSectorList(car, s->m_lists[ENTITYLIST_VEHICLES_OVERLAP], y*NUMSECTORS_X + x, left, top, right, bottom);
+		}
+	}
+}
+
+static void
+RunTrafficGatherJobs(void)
+{
+	int32 first;
+	while((first = nNextTrafficCar.fetch_add(TRAFFIC_GATHER_BATCH)) < NumTrafficCars){
+		int32 last = Min(first + TRAFFIC_GATHER_BATCH, NumTrafficCars);
+		for(int32 i = first; i < last; i++)
+			GatherNeighbours(aTrafficNeighbours[aTrafficCars[i]]);
+	}
+}
+
+static void
+TrafficWorkerProc(void)
+{
+	uint32 generation = 0;
+	std::unique_lock<std::mutex> lock(TrafficWorkerMutex);
+	for(;;){
+		while(!bTrafficWorkersQuit && generation == nTrafficWorkGeneration)
+			TrafficWorkerWakeUp.wait(lock);
+		if(bTrafficWorkersQuit)
+			break;
+		generation = nTrafficWorkGeneration;
+		lock.unlock();
+		RunTrafficGatherJobs();
+		lock.lock();
+		if(--nTrafficWorkersBusy == 0)
+			TrafficWorkerDone.notify_one();
+	}
+}
+
+static void
+StartTrafficWorkers(void)
+{
+	int32 numCores = std::thread::hardware_concurrency();
+	NumTrafficWorkers = clamp(numCores - 1, 0, TRAFFIC_MAX_WORKERS);
+	bTrafficWorkersQuit = false;
+	for(int32 i = 0; i < NumTrafficWorkers; i++)
+		aTrafficWorkers[i] = std::thread(TrafficWorkerProc);
+}
+
+void
+CTrafficSnapshot::Build(void)
+{
+	int32 i;
+
+	ms_bValid = false;
+	if(!bEnabled)
+		return;
+	if(NumTrafficWorkers < 0)
+		StartTrafficWorkers();
+
+	uint32 startTime = CTimer::GetCurrentTimeInCycles();
+	CVehiclePool *pool = CPools::GetVehiclePool();
+	NumTrafficCars = 0;
+	for(i = 0; i < pool->GetSize(); i++){
+		CVehicle *pVehicle = pool->GetSlot(i);
+		aTrafficNeighbours[i].pVehicle = nil;
+		if(pVehicle == nil || (pVehicle->GetStatus() != STATUS_SIMPLE && pVehicle->GetStatus() != STATUS_PHYSICS))
+			continue;
+		aTrafficNeighbours[i].pVehicle = pVehicle;
+		aTrafficNeighbours[i].vecPosition = pVehicle->GetPosition();
+		aTrafficCars[NumTrafficCars++] = i;
+	}
+
+	nNextTrafficCar = 0;
+	if(NumTrafficWorkers > 0 && NumTrafficCars > TRAFFIC_GATHER_BATCH){
+		{
+			std::lock_guard<std::mutex> lock(TrafficWorkerMutex);
+			nTrafficWorkGeneration++;
+			nTrafficWorkersBusy = NumTrafficWorkers;
+		}
+		TrafficWorkerWakeUp.notify_all();
+		RunTrafficGatherJobs();
+		std::unique_lock<std::mutex> lock(TrafficWorkerMutex);
+		while(nTrafficWorkersBusy > 0)
+			TrafficWorkerDone.wait(lock);
+	}else
+		RunTrafficGatherJobs();
+	ms_bValid = true;
+
+	if(bShowStats){
+		int32 numNeighbours = 0;
+		for(i = 0; i < NumTrafficCars; i++)
+			numNeighbours += aTrafficNeighbours[aTrafficCars[i]].nNumNeighbours;
+		uint32 cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+		char str[128];
+		sprintf(str, "TRAFFIC CARS %d NEIGHBOURS %d GATHER %dUS THREADS %d FALLBACKS %d MISMATCHES %d", NumTrafficCars, numNeighbours,
+			(CTimer::GetCurrentTimeInCycles() - startTime) / cyclesPerUs, NumTrafficWorkers + 1, nTrafficFallbacks, nTrafficMismatches);
+		CDebug::PrintAt(str, 2, 24);
+	}
+}
+
+void
+CTrafficSnapshot::Shutdown(void)
+{
+	ms_bValid = false;
+	if(NumTrafficWorkers < 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(TrafficWorkerMutex);
+		bTrafficWorkersQuit = true;
+	}
+	TrafficWorkerWakeUp.notify_all();
+	for(int32 i = 0; i < NumTrafficWorkers; i++)
+		if(aTrafficWorkers[i].joinable())
+			aTrafficWorkers[i].join();
+	NumTrafficWorkers = -1;
+}
+
+tTrafficNeighbours*
+CTrafficSnapshot::GetNeighbours(CVehicle *pVehicle)
+{
+	if(!bEnabled)
+		return nil;
+	tTrafficNeighbours &car = aTrafficNeighbours[CPools::GetVehiclePool()->GetJustIndex(pVehicle)];
+	if(!ms_bValid || car.pVehicle != pVehicle || car.bOverflow ||
+	   (pVehicle->GetPosition() - car.vecPosition).MagnitudeSqr() > SQR(TRAFFIC_MAX_OWN_MOVEMENT)){
+		nTrafficFallbacks++;
+		return nil;
+	}
+	return &car;
+}
+
+// Lists the vehicles the sector walk and the snapshot hand to the steering, in the order they
+// come and with the same dedup by scan code, and counts a mismatch if they differ.
+void
+CTrafficSnapshot::CheckNeighbours(tTrafficNeighbours *pNeighbours, CVehicle *pVehicle, CPhysical *pTarget, float x_inf, float y_inf, float x_sup, float y_sup)
+{
+	CVehicle *fromSectors[TRAFFIC_MAX_CHECKED];
+	CVehicle *fromSnapshot[TRAFFIC_MAX_CHECKED];
+	int32 numFromSectors = 0;
+	int32 numFromSnapshot = 0;
+	int xstart = Max(0, CWorld::GetSectorIndexX(x_inf));
+	int xend = Min(NUMSECTORS_X - 1, CWorld::GetSectorIndexX(x_sup));
+	int ystart = Max(0, CWorld::GetSectorIndexY(y_inf));
+	int yend = Min(NUMSECTORS_Y - 1, CWorld::GetSectorIndexY(y_sup));
+	int i, x, y;
+
+	CWorld::AdvanceCurrentScanCode();
+	for(y = ystart; y <= yend; y++)
+		for(x = xstart; x <= xend; x++)
+			for(i = 0; i < 2; i++){
+				CPtrList &list = CWorld::GetSector(x, y)->m_lists[i == 0 ? ENTITYLIST_VEHICLES : ENTITYLIST_VEHICLES_OVERLAP];
+				for(CPtrNode *node = list.first; node; node = node->next){
+					CVehicle *pTestVehicle = (CVehicle*)node->item;
+					if(pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode() || !pTestVehicle->bUsesCollision || pTestVehicle == pTarget)
+						continue;
+					pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
+					CVector centre = pTestVehicle->GetBoundCentre();
+					if(pTestVehicle != pVehicle && centre.x >= x_inf && centre.x <= x_sup && centre.y >= y_inf && centre.y <= y_sup &&
+					   numFromSectors < TRAFFIC_MAX_CHECKED)
+						fromSectors[numFromSectors++] = pTestVehicle;
+				}
+			}
+
+	CWorld::AdvanceCurrentScanCode();
+	int32 cursor = 0;
+	for(y = ystart; y <= yend; y++)
+		for(x = xstart; x <= xend; x++){
+			int32 sector = y*NUMSECTORS_X + x;
+			for(cursor = pNeighbours->SkipToSector(cursor, sector);
+			    cursor < pNeighbours->nNumNeighbours && pNeighbours->aNeighbours[cursor].nSector == sector; cursor++){
+				CVehicle *pTestVehicle = pNeighbours->aNeighbours[cursor].pVehicle;
+				if(pTestVehicle->m_scanCode == CWorld::GetCurrentScanCode() || !pTestVehicle->bUsesCollision || pTestVehicle == pTarget)
+					continue;
+				pTestVehicle->m_scanCode = CWorld::GetCurrentScanCode();
+				CVector centre = pTestVehicle->GetBoundCentre();
+				if(centre.x >= x_inf && centre.x <= x_sup && centre.y >= y_inf && centre.y <= y_sup &&
+				   numFromSnapshot < TRAFFIC_MAX_CHECKED)
+					fromSnapshot[numFromSnapshot++] = pTestVehicle;
+			}
+		}
+
+	if(numFromSectors != numFromSnapshot || memcmp(fromSectors, fromSnapshot, numFromSectors*sizeof(CVehicle*)) != 0)
+		nTrafficMismatches++;
+}
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef TRAFFIC_SNAPSHOT
+
+class CVehicle;
+class CPhysical;
+
+/*
+Before the moving entities get their ProcessControl, the vehicles around every AI car are
+gathered in one go, spread over a few worker threads. The workers only read the sector lists
+and positions, nothing moves or gets added while they run.
+FindMaximumSpeedForThisCarInTraffic and FindAngleToWeaveThroughTraffic then go through a car's
+gathered list instead of the sector vehicle lists. The list holds every vehicle those lists would
+give them, sorted the same way, so the steering itself still runs serially and decides exactly
+as before. A vehicle being added, removed or moved between sectors during the frame throws the
+whole snapshot away and the rest of the cars walk the sectors again.
+*/
+#define TRAFFIC_MAX_NEIGHBOURS 48
+#define TRAFFIC_MAX_WORKERS 3
+
+struct tTrafficNeighbour
+{
+	CVehicle *pVehicle;
+	int32 nSector;	// y*NUMSECTORS_X + x
+};
+
+struct tTrafficNeighbours
+{
+	CVehicle *pVehicle;	// nil if this pool slot wasn't gathered
+	CVector vecPosition;
+	int32 nNumNeighbours;
+	bool bOverflow;
+	tTrafficNeighbour aNeighbours[TRAFFIC_MAX_NEIGHBOURS];
+
+	// returns the first neighbour from start on that isn't in an earlier sector
+	int32 SkipToSector(int32 start, int32 sector) {
+		while(start < nNumNeighbours && aNeighbours[start].nSector < sector)
+			start++;
+		return start;
+	}
+};
+
+class CTrafficSnapshot
+{
+	static bool ms_bValid;
+public:
+	static bool bEnabled;
+	static bool bCheck;
+	static bool bShowStats;
+
+	static void Build(void);
+	static void Clear(void) { ms_bValid = false; }
+	static void Invalidate(void) { ms_bValid = false; }
+	static void Shutdown(void);
+	static tTrafficNeighbours *GetNeighbours(CVehicle *pVehicle);
+	static void CheckNeighbours(tTrafficNeighbours *pNeighbours, CVehicle *pVehicle, CPhysical *pTarget, float x_inf, float y_inf, float x_sup, float y_sup);
+};
+
+#endif
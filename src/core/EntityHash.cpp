@@ -0,0 +1,407 @@
+#include "common.h"
+
+#ifdef WORLD_ENTITY_HASH
+#include "EntityHash.h"
+
+#include "Debug.h"
+#include "Object.h"
+#include "Ped.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "Vehicle.h"
+#include "World.h"
+
+// entities can move a bit without going through RemoveAndAdd (peds put into position in a car, attached peds)
+#define ENTITYHASH_MARGIN 5.0f
+
+bool CEntityHash::ms_bValid;
+bool CEntityHash::bEnabled = true;
+bool CEntityHash::bShowStats;
+
+// the entries of the last build sorted by bucket, then the ones that moved or were added since
+tEntityHashEntry aEntityHashEntries[ENTITYHASH_MAX_ENTRIES + ENTITYHASH_MAX_MOVED];
+int32 nEntityHashEntries;
+int32 nEntityHashMoved;
+int16 aEntityHashBucketStart[ENTITYHASH_NUM_BUCKETS + 1];
+float fEntityHashMaxRadius;
+
+// entry of every pool slot, -1 if not hashed
+int16 aPedHashEntry[NUMPEDS];
+int16 aVehicleHashEntry[NUMVEHICLES];
+int16 aObjectHashEntry[NUMOBJECTS];
+
+uint32 aEntityHashBucketVisited[ENTITYHASH_NUM_BUCKETS];
+uint32 nEntityHashQueryStamp;
+int32 aEntityHashCandidates[ENTITYHASH_MAX_ENTRIES + ENTITYHASH_MAX_MOVED];
+
+int32 nEntityHashQueries;
+int32 nEntityHashOverflows;
+int32 nEntityHashTooMany;
+
+static int32
+GetCellBucket(int32 cellX, int32 cellY)
+{
+	return (((uint32)cellX * 73856093u) ^ ((uint32)cellY * 19349663u)) & (ENTITYHASH_NUM_BUCKETS - 1);
+}
+
+static int32
+GetBucket(float x, float y)
+{
+	return GetCellBucket(Floor(x / ENTITYHASH_CELL_SIZE), Floor(y / ENTITYHASH_CELL_SIZE));
+}
+
+static int16*
+GetEntrySlot(CEntity *pEntity)
+{
+	if(pEntity->IsPed())
+		return &aPedHashEntry[CPools::GetPedPool()->GetJustIndex((CPed*)pEntity)];
+	if(pEntity->IsVehicle())
+		return &aVehicleHashEntry[CPools::GetVehiclePool()->GetJustIndex((CVehicle*)pEntity)];
+	if(pEntity->IsObject())
+		return &aObjectHashEntry[CPools::GetObjectPool()->GetJustIndex((CObject*)pEntity)];
+	return nil;
+}
+
+static void
+FillEntry(tEntityHashEntry &entry, CEntity *pEntity, uint8 types)
+{
+	entry.pEntity = pEntity;
+	entry.vecPosition = pEntity->GetPosition();
+	entry.fRadius = pEntity->GetBoundRadius();
+	entry.nBucket = GetBucket(entry.vecPosition.x, entry.vecPosition.y);
+	entry.nTypes = types;
+	fEntityHashMaxRadius = Max(fEntityHashMaxRadius, entry.fRadius);
+}
+
+static uint8
+GetTypes(CEntity *pEntity)
+{
+	if(pEntity->IsPed())
+		return ENTITYHASH_PEDS;
+	if(pEntity->IsVehicle())
+		return ENTITYHASH_VEHICLES;
+	return ENTITYHASH_OBJECTS;
+}
+
+// Counting sort of everything in the world by bucket
+void
+CEntityHash::Build(void)
+{
+	static tEntityHashEntry aUnsorted[ENTITYHASH_MAX_ENTRIES];
+	int32 numUnsorted = 0;
+	int32 i, n;
+
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "ENTITY HASH %d MOVED %d QUERIES %d TOO MANY %d OVERFLOWS %d", nEntityHashEntries, nEntityHashMoved,
+			nEntityHashQueries, nEntityHashTooMany, nEntityHashOverflows);
+		CDebug::PrintAt(str, 2, 28);
+	}
+	nEntityHashQueries = 0;
+	nEntityHashTooMany = 0;
+
+	ms_bValid = false;
+	if(!bEnabled)
+		return;
+
+	fEntityHashMaxRadius = 0.0f;
+	for(i = 0; i < NUMPEDS; i++)
+		aPedHashEntry[i] = -1;
+	for(i = 0; i < NUMVEHICLES; i++)
+		aVehicleHashEntry[i] = -1;
+	for(i = 0; i < NUMOBJECTS; i++)
+		aObjectHashEntry[i] = -1;
+	for(i = 0; i <= ENTITYHASH_NUM_BUCKETS; i++)
+		aEntityHashBucketStart[i] = 0;
+
+	CPedPool *pedPool = CPools::GetPedPool();
+	for(i = 0, n = pedPool->GetSize(); i < n; i++){
+		CPed *ped = pedPool->GetSlot(i);
+		if(ped && ped->m_entryInfoList.first)
+			FillEntry(aUnsorted[numUnsorted++], ped, ENTITYHASH_PEDS);
+	}
+	CVehiclePool *vehiclePool = CPools::GetVehiclePool();
+	for(i = 0, n = vehiclePool->GetSize(); i < n; i++){
+		CVehicle *vehicle = vehiclePool->GetSlot(i);
+		if(vehicle && vehicle->m_entryInfoList.first)
+			FillEntry(aUnsorted[numUnsorted++], vehicle, ENTITYHASH_VEHICLES);
+	}
+	CObjectPool *objectPool = CPools::GetObjectPool();
+	for(i = 0, n = objectPool->GetSize(); i < n; i++){
+		CObject *object = objectPool->GetSlot(i);
+		if(object && object->m_entryInfoList.first)
+			FillEntry(aUnsorted[numUnsorted++], object, ENTITYHASH_OBJECTS);
+	}
+
+	for(i = 0; i < numUnsorted; i++)
+		aEntityHashBucketStart[aUnsorted[i].nBucket + 1]++;
+	for(i = 0; i < ENTITYHASH_NUM_BUCKETS; i++)
+		aEntityHashBucketStart[i + 1] += aEntityHashBucketStart[i];
+	static int16 fill[ENTITYHASH_NUM_BUCKETS];
+	for(i = 0; i < ENTITYHASH_NUM_BUCKETS; i++)
+		fill[i] = aEntityHashBucketStart[i];
+	for(i = 0; i < numUnsorted; i++){
+		int32 e = fill[aUnsorted[i].nBucket]++;
+		aEntityHashEntries[e] = aUnsorted[i];
+		*GetEntrySlot(aUnsorted[i].pEntity) = e;
+	}
+
+	nEntityHashEntries = numUnsorted;
+	nEntityHashMoved = 0;
+	ms_bValid = true;
+}
+
+// Called whenever the entity has been put into the sector lists again
+void
+CEntityHash::EntityMoved(CEntity *pEntity)
+{
+	// keep it up to date while it's valid, switching bEnabled back on mustn't find it stale
+	if(!ms_bValid)
+		return;
+
+	int16 *slot = GetEntrySlot(pEntity);
+	if(slot == nil)
+		return;
+	if(*slot >= 0){
+		tEntityHashEntry &entry = aEntityHashEntries[*slot];
+		// the moved ones aren't in a bucket, they can go anywhere
+		if(*slot >= nEntityHashEntries || entry.nBucket == GetBucket(pEntity->GetPosition().x, pEntity->GetPosition().y)){
+			FillEntry(entry, pEntity, entry.nTypes);
+			return;
+		}
+		entry.pEntity = nil;
+		*slot = -1;
+	}
+	if(nEntityHashMoved == ENTITYHASH_MAX_MOVED){
+		// too much going on, walk the sectors until the next build
+		nEntityHashOverflows++;
+		ms_bValid = false;
+		return;
+	}
+	*slot = nEntityHashEntries + nEntityHashMoved++;
+	FillEntry(aEntityHashEntries[*slot], pEntity, GetTypes(pEntity));
+}
+
+void
+CEntityHash::EntityRemoved(CEntity *pEntity)
+{
+	if(!ms_bValid)
+		return;
+
+	int16 *slot = GetEntrySlot(pEntity);
+	if(slot == nil || *slot < 0)
+		return;
+	aEntityHashEntries[*slot].pEntity = nil;
+	*slot = -1;
+}
+
+// Entries of the right types whose hashed position is in the rectangle
+static int32
+CollectCandidates(float left, float top, float right, float bottom, uint8 types)
+{
+	int32 numCandidates = 0;
+	int32 i;
+	int32 cellLeft = Floor(left / ENTITYHASH_CELL_SIZE);
+	int32 cellRight = Floor(right / ENTITYHASH_CELL_SIZE);
+	int32 cellTop = Floor(top / ENTITYHASH_CELL_SIZE);
+	int32 cellBottom = Floor(bottom / ENTITYHASH_CELL_SIZE);
+
+	nEntityHashQueries++;
+	if((cellRight - cellLeft + 1) * (cellBottom - cellTop + 1) >= ENTITYHASH_NUM_BUCKETS){
+		// covers the whole hash anyway
+		for(i = 0; i < nEntityHashEntries; i++){
+			tEntityHashEntry &entry = aEntityHashEntries[i];
+			if(entry.pEntity && (entry.nTypes & types) &&
+			   entry.vecPosition.x >= left && entry.vecPosition.x <= right &&
+			   entry.vecPosition.y >= top && entry.vecPosition.y <= bottom)
+				aEntityHashCandidates[numCandidates++] = i;
+		}
+	}else{
+		// two cells can share a bucket, only look at each bucket once
+		if(++nEntityHashQueryStamp == 0){
+			for(i = 0; i < ENTITYHASH_NUM_BUCKETS; i++)
+				aEntityHashBucketVisited[i] = 0;
+			nEntityHashQueryStamp = 1;
+		}
+		for(int32 y = cellTop; y <= cellBottom; y++)
+			for(int32 x = cellLeft; x <= cellRight; x++){
+				int32 bucket = GetCellBucket(x, y);
+				if(aEntityHashBucketVisited[bucket] == nEntityHashQueryStamp)
+					continue;
+				aEntityHashBucketVisited[bucket] = nEntityHashQueryStamp;
+				for(i = aEntityHashBucketStart[bucket]; i < aEntityHashBucketStart[bucket + 1]; i++){
+					tEntityHashEntry &entry = aEntityHashEntries[i];
+					if(entry.pEntity && (entry.nTypes & types) &&
+					   entry.vecPosition.x >= left && entry.vecPosition.x <= right &&
+					   entry.vecPosition.y >= top && entry.vecPosition.y <= bottom)
+						aEntityHashCandidates[numCandidates++] = i;
+				}
+			}
+	}
+	for(i = nEntityHashEntries; i < nEntityHashEntries + nEntityHashMoved; i++){
+		tEntityHashEntry &entry = aEntityHashEntries[i];
+		if(entry.pEntity && (entry.nTypes & types) &&
+		   entry.vecPosition.x >= left && entry.vecPosition.x <= right &&
+		   entry.vecPosition.y >= top && entry.vecPosition.y <= bottom)
+			aEntityHashCandidates[numCandidates++] = i;
+	}
+	return numCandidates;
+}
+
+// Entities whose position is closer than radius, same test as CWorld::FindObjectsInRange.
+// -1 if there are more than maxResults of them.
+int32
+CEntityHash::QueryRadius(const CVector &centre, float radius, bool ignoreZ, uint8 types, CEntity **results, int32 maxResults)
+{
+	float range = radius + ENTITYHASH_MARGIN;
+	int32 numCandidates = CollectCandidates(centre.x - range, centre.y - range, centre.x + range, centre.y + range, types);
+	int32 numFound = 0;
+	float radiusSqr = sq(radius);
+
+	for(int32 i = 0; i < numCandidates; i++){
+		CEntity *pEntity = aEntityHashEntries[aEntityHashCandidates[i]].pEntity;
+		CVector diff = centre - pEntity->GetPosition();
+		float distSqr = ignoreZ ? diff.MagnitudeSqr2D() : diff.MagnitudeSqr();
+		if(distSqr < radiusSqr){
+			if(numFound == maxResults){
+				nEntityHashTooMany++;
+				return -1;
+			}
+			if(results)
+				results[numFound] = pEntity;
+			numFound++;
+		}
+	}
+	return numFound;
+}
+
+// Entities whose bounding sphere touches the box
+int32
+CEntityHash::QueryAABB(const CVector &vecMin, const CVector &vecMax, uint8 types, CEntity **results, int32 maxResults)
+{
+	float range = fEntityHashMaxRadius + ENTITYHASH_MARGIN;
+	int32 numCandidates = CollectCandidates(vecMin.x - range, vecMin.y - range, vecMax.x + range, vecMax.y + range, types);
+	int32 numFound = 0;
+
+	for(int32 i = 0; i < numCandidates && numFound < maxResults; i++){
+		tEntityHashEntry &entry = aEntityHashEntries[aEntityHashCandidates[i]];
+		const CVector &pos = entry.pEntity->GetPosition();
+		CVector closest(clamp(pos.x, vecMin.x, vecMax.x), clamp(pos.y, vecMin.y, vecMax.y), clamp(pos.z, vecMin.z, vecMax.z));
+		if((closest - pos).MagnitudeSqr() <= sq(entry.fRadius)){
+			if(results)
+				results[numFound] = entry.pEntity;
+			numFound++;
+		}
+	}
+	return numFound;
+}
+
+// The k entities closest to centre within maxRadius, nearest first
+int32
+CEntityHash::KNearest(const CVector &centre, float maxRadius, bool ignoreZ, uint8 types, CEntity **results, int32 k)
+{
+	float range = maxRadius + ENTITYHASH_MARGIN;
+	int32 numCandidates = CollectCandidates(centre.x - range, centre.y - range, centre.x + range, centre.y + range, types);
+	float aDistSqr[ENTITYHASH_MAX_NEAREST];
+	int32 numFound = 0;
+
+	k = Min(k, ENTITYHASH_MAX_NEAREST);
+	for(int32 i = 0; i < numCandidates; i++){
+		CEntity *pEntity = aEntityHashEntries[aEntityHashCandidates[i]].pEntity;
+		CVector diff = centre - pEntity->GetPosition();
+		float distSqr = ignoreZ ? diff.MagnitudeSqr2D() : diff.MagnitudeSqr();
+		if(distSqr >= sq(maxRadius))
+			continue;
+		if(numFound == k && distSqr >= aDistSqr[k - 1])
+			continue;
+		// insert sorted, dropping the furthest if full
+		int32 j = numFound < k ? numFound++ : k - 1;
+		for(; j > 0 && aDistSqr[j - 1] > distSqr; j--){
+			aDistSqr[j] = aDistSqr[j - 1];
+			results[j] = results[j - 1];
+		}
+		aDistSqr[j] = distSqr;
+		results[j] = pEntity;
+	}
+	return numFound;
+}
+
+static int
+CompareEntityPointers(const void *a, const void *b)
+{
+	uintptr pa = (uintptr)*(CEntity**)a;
+	uintptr pb = (uintptr)*(CEntity**)b;
+	return pa < pb ? -1 : pa > pb ? 1 : 0;
+}
+
+#define NUM_BENCHMARK_QUERIES 1024
+#define MAX_BENCHMARK_RESULTS 64
+
+// what the game asks for, peds look for 6 entities, weapons for 15
+static const int16 aBenchmarkCaps[] = { 6, 15, MAX_BENCHMARK_RESULTS };
+
+// Runs the same range queries around the player through the sector lists and through the hash
+void
+BenchmarkEntityHash(void)
+{
+	static CVector aCentres[NUM_BENCHMARK_QUERIES];
+	static float aRadii[NUM_BENCHMARK_QUERIES];
+	static CEntity *results[2][NUM_BENCHMARK_QUERIES][MAX_BENCHMARK_RESULTS];
+	static int16 numResults[2][NUM_BENCHMARK_QUERIES];
+	uint32 times[2];
+	int i, pass, cap;
+
+	if(!CEntityHash::IsValid()){
+		debug("Entity hash benchmark: hash not built\n");
+		return;
+	}
+
+	// own random numbers so the game's don't change
+	uint32 seed = 12345;
+	CVector playerPos = FindPlayerCoors();
+	for(i = 0; i < NUM_BENCHMARK_QUERIES; i++){
+		seed = seed * 1103515245 + 12345;
+		aCentres[i].x = playerPos.x + ((seed >> 16) % 300) - 150.0f;
+		seed = seed * 1103515245 + 12345;
+		aCentres[i].y = playerPos.y + ((seed >> 16) % 300) - 150.0f;
+		aCentres[i].z = playerPos.z;
+		seed = seed * 1103515245 + 12345;
+		aRadii[i] = 5.0f + (seed >> 16) % 46;
+	}
+
+	uint32 cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+	for(cap = 0; cap < ARRAY_SIZE(aBenchmarkCaps); cap++){
+		int16 maxResults = aBenchmarkCaps[cap];
+		int32 tooManyBefore = nEntityHashTooMany;
+		for(pass = 0; pass < 2; pass++){
+			CEntityHash::bEnabled = pass == 1;
+			uint32 startTime = CTimer::GetCurrentTimeInCycles();
+			for(i = 0; i < NUM_BENCHMARK_QUERIES; i++)
+				CWorld::FindObjectsInRange(aCentres[i], aRadii[i], true, &numResults[pass][i], maxResults,
+					results[pass][i], false, true, true, true, false);
+			times[pass] = CTimer::GetCurrentTimeInCycles() - startTime;
+		}
+		CEntityHash::bEnabled = true;
+
+		int mismatches = 0;
+		int found = 0;
+		for(i = 0; i < NUM_BENCHMARK_QUERIES; i++){
+			found += numResults[0][i];
+			if(numResults[0][i] != numResults[1][i]){
+				mismatches++;
+				continue;
+			}
+			// same entities, order doesn't matter, a cut off result came from the sectors anyway
+			qsort(results[0][i], numResults[0][i], sizeof(CEntity*), CompareEntityPointers);
+			qsort(results[1][i], numResults[1][i], sizeof(CEntity*), CompareEntityPointers);
+			if(memcmp(results[0][i], results[1][i], numResults[0][i] * sizeof(CEntity*)) != 0)
+				mismatches++;
+		}
+
+		debug("Entity hash benchmark: %d queries of up to %d, %d entities found, sectors %dus, hash %dus, %d walked the sectors, %d mismatches\n",
+			NUM_BENCHMARK_QUERIES, maxResults, found, times[0] / cyclesPerUs, times[1] / cyclesPerUs,
+			nEntityHashTooMany - tooManyBefore, mismatches);
+	}
+}
+
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#ifdef WORLD_ENTITY_HASH
+
+class CEntity;
+
+/*
+All peds, vehicles and objects that are in the world are kept in a spatial hash next to the
+sector lists. It's rebuilt at the end of CWorld::Process, with the entries of a cell next to
+each other so a query only touches a few small arrays. Between rebuilds it's kept up to date from
+CPhysical::Add, Remove and RemoveAndAdd, the same places the sector lists change: an entity
+staying in its cell just gets its position updated, one changing cells or new to the world is
+put at the end where every query looks at it. Queries check the hashed position first and then
+the real one, so they find the same entities a walk over the sector lists would, though not in
+the same order. When more are found than the caller has room for, FindObjectsInRange walks the
+sectors instead so the ones that get cut off are the same as before.
+*/
+#define ENTITYHASH_CELL_SIZE 20.0f
+#define ENTITYHASH_NUM_BUCKETS 1024	// power of two
+#define ENTITYHASH_MAX_ENTRIES (NUMPEDS + NUMVEHICLES + NUMOBJECTS)
+#define ENTITYHASH_MAX_MOVED 128
+#define ENTITYHASH_MAX_NEAREST 32
+
+enum
+{
+	ENTITYHASH_VEHICLES = 1,
+	ENTITYHASH_PEDS = 2,
+	ENTITYHASH_OBJECTS = 4,
+	ENTITYHASH_ALL = ENTITYHASH_VEHICLES | ENTITYHASH_PEDS | ENTITYHASH_OBJECTS
+};
+
+struct tEntityHashEntry
+{
+	CEntity *pEntity;	// nil if it's been removed or moved to another cell since
+	CVector vecPosition;
+	float fRadius;
+	int16 nBucket;
+	uint8 nTypes;
+};
+
+class CEntityHash
+{
+	static bool ms_bValid;
+public:
+	static bool bEnabled;
+	static bool bShowStats;
+
+	static void Build(void);
+	static void Invalidate(void) { ms_bValid = false; }
+	static bool IsValid(void) { return ms_bValid && bEnabled; }
+	static void EntityMoved(CEntity *pEntity);
+	static void EntityRemoved(CEntity *pEntity);
+
+	// all of these return how many entities were found, at most maxResults,
+	// QueryRadius returns -1 if there were more
+	static int32 QueryRadius(const CVector &centre, float radius, bool ignoreZ, uint8 types, CEntity **results, int32 maxResults);
+	static int32 QueryAABB(const CVector &vecMin, const CVector &vecMax, uint8 types, CEntity **results, int32 maxResults);
+	static int32 KNearest(const CVector &centre, float maxRadius, bool ignoreZ, uint8 types, CEntity **results, int32 k);
+};
+
+void BenchmarkEntityHash(void);
+
+#endif
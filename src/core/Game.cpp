@@ -76,6 +76,8 @@
 #include "TempColModels.h"
 #include "Timecycle.h"
 #include "TrafficLights.h"
+#include "TrafficLod.h"
+#include "TrafficSnapshot.h"
 #include "Train.h"
 #include "TxdStore.h"
 #include "User.h"
@@ -586,6 +588,9 @@ bool CGame::ShutDown(void)
 	CReplay::EmptyReplayBuffer();
 	CPlane::Shutdown();
 	CTrain::Shutdown();
+#ifdef TRAFFIC_SNAPSHOT
+	CTrafficSnapshot::Shutdown();
+#endif
 	CScriptPaths::Shutdown();
 	CWaterCreatures::RemoveAll();
 	CSpecialFX::Shutdown();
@@ -935,6 +940,9 @@ void CGame::Process(void)
 				CCarCtrl::GenerateRandomCars();
 			CRoadBlocks::GenerateRoadBlocks();
 			CCarCtrl::RemoveDistantCars();
+#ifdef TRAFFIC_LOD
+			CTrafficLod::Update();
+#endif
 			CCarCtrl::RemoveCarsIfThePoolGetsFull();
 			POP_MEMID();
 		}
@@ -4,6 +4,7 @@
 #include "CopPed.h"
 #include "CutsceneMgr.h"
 #include "DMAudio.h"
+#include "EntityHash.h"
 #include "Entity.h"
 #include "EventList.h"
 #include "Explosion.h"
@@ -15,6 +16,7 @@
 #include "Object.h"
 #include "ParticleObject.h"
 #include "Ped.h"
+#include "PedPerception.h"
 #include "Pickups.h"
 #include "PlayerPed.h"
 #include "Population.h"
@@ -25,6 +27,7 @@
 #include "RpAnimBlend.h"
 #include "Shadows.h"
 #include "TempColModels.h"
+#include "TrafficSnapshot.h"
 #include "Vehicle.h"
 #include "WaterLevel.h"
 #include "World.h"
@@ -715,6 +718,21 @@ CWorld::FindObjectsInRange(Const CVector &centre, float radius, bool ignoreZ, in
                            CEntity **objects, bool checkBuildings, bool checkVehicles, bool checkPeds,
                            bool checkObjects, bool checkDummies)
 {
+#ifdef WORLD_ENTITY_HASH
+	if(!checkBuildings && !checkDummies && CEntityHash::IsValid()) {
+		uint8 types = 0;
+		if(checkVehicles) types |= ENTITYHASH_VEHICLES;
+		if(checkPeds) types |= ENTITYHASH_PEDS;
+		if(checkObjects) types |= ENTITYHASH_OBJECTS;
+		// if they don't all fit, walk the sectors so callers get the same ones in the same order as before
+		int32 numFound = CEntityHash::QueryRadius(centre, radius, ignoreZ, types, objects, lastObject);
+		if(numFound >= 0) {
+			*numObjects = numFound;
+			return;
+		}
+	}
+#endif
+
 	int minX = GetSectorIndexX(centre.x - radius);
 	if(minX <= 0) minX = 0;
 
@@ -1668,6 +1686,9 @@ CWorld::AddParticles(void)
 void
 CWorld::ShutDown(void)
 {
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::Invalidate();
+#endif
 	for(int i = 0; i < NUMSECTORS_X * NUMSECTORS_Y; i++) {
 		CSector *pSector = GetSector(i % NUMSECTORS_X, i / NUMSECTORS_Y);
 		for(CPtrNode *pNode = pSector->m_lists[ENTITYLIST_BUILDINGS].first; pNode; pNode = pNode->next) {
@@ -1753,6 +1774,9 @@ CWorld::ShutDown(void)
 void
 CWorld::ClearForRestart(void)
 {
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::Invalidate();
+#endif
 	if(CCutsceneMgr::HasLoaded()) CCutsceneMgr::DeleteCutsceneData();
 	CProjectileInfo::RemoveAllProjectiles();
 	CObject::DeleteAllTempObjects();
@@ -1966,6 +1990,12 @@ CWorld::Process(void)
 				}
 			}
 		}
+#ifdef TRAFFIC_SNAPSHOT
+		CTrafficSnapshot::Build();
+#endif
+#ifdef PED_PERCEPTION_SCHEDULER
+		CPedPerception::Build();
+#endif
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CPhysical *movingEnt = (CPhysical *)node->item;
 			if(movingEnt->bRemoveFromWorld) {
@@ -1988,6 +2018,9 @@ CWorld::Process(void)
 			}
 		}
 		bForceProcessControl = false;
+#ifdef TRAFFIC_SNAPSHOT
+		CTrafficSnapshot::Clear();
+#endif
 		if(CReplay::IsPlayingBack()) {
 			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 				CEntity *movingEnt = (CEntity *)node->item;
@@ -2104,6 +2137,9 @@ CWorld::Process(void)
 			RemoveFallenCars();
 		}
 	}
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::Build();
+#endif
 }
 
 void
@@ -269,20 +269,34 @@ enum Config {
 //#define EXTENDED_PIPELINES		// custom render pipelines (includes Neo)
 //#define SCREEN_DROPLETS			// neo water droplets
 //#define NEW_RENDERER		// leeds-like world rendering, needs librw
+#define SHADOW_MAPS		// real-time sun shadows for peds and vehicles instead of blobs, gl3 only, needs EXTENDED_PIPELINES
 #endif
 
 #define FIX_SPRITES	// fix sprites aspect ratio(moon, coronas, particle etc)
+#define CLUSTERED_POINT_LIGHTS	// only light objects with the point lights near them, allows more lights
+#define CORONA_BATCHING	// draw coronas sorted by texture in a few batches, stagger their line of sight checks, allows more coronas
+#define FONT_BATCHING	// text of every font style is buffered separately, so switching styles doesn't draw
+#define TIMECYCLE_CACHE	// timecycle is packed into float keyframes and only blended again when the minute or weather changes
 
 #ifndef EXTENDED_COLOURFILTER
 #undef SCREEN_DROPLETS		// we need the backbuffer for this effect
 #endif
 
+#if !defined(EXTENDED_PIPELINES) || !defined(RW_GL3)
+#undef SHADOW_MAPS
+#endif
+
 // Water & Particle
 // #define PC_WATER
 #define WATER_CHEATS
+#define WATER_SAMPLE_CACHE // reuse water heights and normals sampled this frame, don't refill unchanged wavy water
+#define BATCHED_BUOYANCY // get the water under all of a floater's points in one call
+#define PARTICLE_SOA_UPDATE // update simple particle systems in batches
+#define PARTICLE_BATCHING // fewer, bigger sprite batches for particles
 
 //#define USE_CUTSCENE_SHADOW_FOR_PED
 #define DISABLE_CUTSCENE_SHADOWS
+#define SHADOW_RECEIVER_CACHE // remember which building triangles a shadow can fall on
 
 // Pad
 #if !defined(RW_GL3) && defined(_WIN32)
@@ -331,6 +345,8 @@ enum Config {
 #define USE_MEASUREMENTS_IN_METERS // makes game use meters instead of feet in script
 #define USE_PRECISE_MEASUREMENT_CONVERTION // makes game convert feet to meeters more precisely
 #define SUPPORT_JAPANESE_SCRIPT
+#define SCRIPT_DECODE_CACHE // decode command parameters once and dispatch commands through a table
+#define SCRIPT_PROFILER // time script commands by opcode and by script, see the debug menu
 //#define SUPPORT_XBOX_SCRIPT
 //#define SUPPORT_MOBILE_SCRIPT
 #if (defined SUPPORT_XBOX_SCRIPT && defined SUPPORT_MOBILE_SCRIPT)
@@ -356,6 +372,19 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 //#define DONT_FIX_REPLAY_BUGS // keeps various bugs in CReplay, some of which are fairly cool!
 //#define USE_BETA_REPLAY_MODE // adds another replay mode, a few seconds slomo (caution: buggy!)
 
+// World
+#define WORLD_ENTITY_HASH // spatial hash of the peds, vehicles and objects in the world for range queries
+
+// Paths
+#define PATHFIND_NODE_INDEX // grid index for the closest path node queries
+#define PATHFIND_ASTAR // landmark guided A* in DoPathSearch
+#define PATHFIND_ROUTE_CACHE // reuse recent DoPathSearch routes
+#define PATHFIND_CACHE // load the prepared path graph from data\paths.cache
+
+// Traffic
+#define TRAFFIC_SNAPSHOT // gather the vehicles around every AI car once per frame on worker threads
+#define TRAFFIC_LOD // put distant cruising cars back on rails and keep far away ones as virtual cars on the path links
+
 // Vehicles
 #define EXPLODING_AIRTRAIN	// can blow up jumbo jet with rocket launcher
 #define CPLANE_ROTORS		// make the rotors of the NPC police heli rotate
@@ -366,6 +395,8 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 
 // Peds
 #define CANCELLABLE_CAR_ENTER
+#define PED_CROWD // keep far away wandering peds as a crowd on the ped paths instead of deleting them
+#define PED_PERCEPTION_SCHEDULER // build near ped lists in one pass and spread out threat scans by priority
 
 // Camera
 #define IMPROVED_CAMERA		// Better Debug cam, and maybe more in the future
@@ -373,9 +404,16 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 
 // Audio
 #define AUDIO_CACHE // cache sound lengths to speed up the cold boot
+#define AUDIO_ENTITY_CULLING // skip audio entities that are out of earshot and update far vehicles at a reduced rate
 //#define PS2_AUDIO_PATHS // changes audio paths for cutscenes and radio to PS2 paths (needs vbdec on MSS builds)
 //#define AUDIO_OAL_USE_SNDFILE // use libsndfile to decode WAVs instead of our internal decoder
 #define AUDIO_OAL_USE_MPG123 // use mpg123 to support mp3 files
+#ifdef AUDIO_OAL
+#define AUDIO_MIXER_THREAD // run OpenAL calls and stream decoding on a separate thread fed by a command queue
+#define AUDIO_STREAM_PREFETCH // decode streams ahead on a worker thread and keep the next radio stations ready
+#define AUDIO_MAPPED_SFX // map sfx.RAW into memory instead of reading sample banks and ped comments from disk
+#define AUDIO_SAMPLE_BUFFER_CACHE // keep recently played samples in their OpenAL buffers
+#endif
 
 #ifdef AUDIO_OPUS
 #define AUDIO_OAL_USE_OPUS // enable support of opus files
@@ -389,6 +427,10 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 
 #endif
 
+#ifdef OPUS_SFX
+#undef AUDIO_MAPPED_SFX // compressed samples have to be decoded anyway
+#endif
+
 #ifdef LIBRW
 // these are not supported with librw yet
 #endif
@@ -1510,6 +1510,10 @@ Idle(void *arg)
 				goto popret;
 		}
 
+#ifdef SHADOW_MAPS
+		CustomPipes::ShadowMapRender();
+#endif
+
 		DefinedState();
 
 #ifndef FIX_BUGS
@@ -29,11 +29,25 @@
 #include "WaterLevel.h"
 #include "main.h"
 #include "Script.h"
+#include "ScriptProfiler.h"
 #include "MBlur.h"
 #include "postfx.h"
 #include "custompipes.h"
 #include "MemoryHeap.h"
 #include "FileMgr.h"
+#include "sampman.h"
+#include "AudioManager.h"
+#include "TrafficLod.h"
+#include "Crowd.h"
+#include "PedPerception.h"
+#include "TrafficSnapshot.h"
+#include "EntityHash.h"
+#include "Particle.h"
+#include "Shadows.h"
+#include "Floater.h"
+#include "PointLights.h"
+#include "Coronas.h"
+#include "Font.h"
 
 #ifdef DONT_TRUST_RECOGNIZED_JOYSTICKS
 #include "ControllerConfig.h"
@@ -681,10 +695,95 @@ extern bool gbRenderWorld2;
 		DebugMenuAddVar("Render", "Mult", &CustomPipes::LightmapMult, nil, 0.1f, 0, 1.0f);
 		DebugMenuAddVarBool8("Render", "Neo Road Gloss enable", &CustomPipes::GlossEnable, nil);
 		DebugMenuAddVar("Render", "Mult", &CustomPipes::GlossMult, nil, 0.1f, 0, 1.0f);
+#ifdef SHADOW_MAPS
+		DebugMenuAddVarBool8("Render", "Shadow Maps enable", &CustomPipes::ShadowMapEnable, nil);
+		DebugMenuAddVar("Render", "Mult", &CustomPipes::ShadowMapMult, nil, 0.1f, 0, 1.0f);
+#endif
 #endif
 		DebugMenuAddVarBool8("Render", "Show Ped Paths", &gbShowPedPaths, nil);
 		DebugMenuAddVarBool8("Render", "Show Car Paths", &gbShowCarPaths, nil);
 		DebugMenuAddVarBool8("Render", "Show Car Path Links", &gbShowCarPathsLinks, nil);
+#ifdef PATHFIND_NODE_INDEX
+		DebugMenuAddVarBool8("Debug", "Use Path Node Index", &gbUsePathNodeIndex, nil);
+		DebugMenuAddCmd("Debug", "Benchmark Path Node Index", BenchmarkPathNodeIndex);
+#endif
+#ifdef PATHFIND_ASTAR
+		DebugMenuAddVarBool8("Debug", "Use Path Search Heuristic", &gbUsePathSearchHeuristic, nil);
+#endif
+		DebugMenuAddVarBool8("Debug", "Show Path Search Stats", &gbShowPathSearchStats, nil);
+#ifdef SCRIPT_DECODE_CACHE
+		DebugMenuAddVarBool8("Debug", "Use Script Decode Cache", &CTheScripts::bUseDecodeCache, nil);
+		DebugMenuAddVarBool8("Debug", "Show Script Stats", &CTheScripts::bShowStats, nil);
+#endif
+#ifdef SCRIPT_PROFILER
+		DebugMenuAddVarBool8("Debug", "Profile Scripts", &CScriptProfiler::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Show Script Profile", &CScriptProfiler::bShowStats, nil);
+		DebugMenuAddCmd("Debug", "Dump Script Profile", CScriptProfiler::DumpToCSV);
+		DebugMenuAddCmd("Debug", "Reset Script Profile", CScriptProfiler::Reset);
+#endif
+#ifdef WORLD_ENTITY_HASH
+		DebugMenuAddVarBool8("Debug", "Use Entity Hash", &CEntityHash::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Show Entity Hash Stats", &CEntityHash::bShowStats, nil);
+		DebugMenuAddCmd("Debug", "Benchmark Entity Hash", BenchmarkEntityHash);
+#endif
+#ifdef TRAFFIC_SNAPSHOT
+		DebugMenuAddVarBool8("Debug", "Use Traffic Snapshot", &CTrafficSnapshot::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Check Traffic Snapshot", &CTrafficSnapshot::bCheck, nil);
+		DebugMenuAddVarBool8("Debug", "Show Traffic Snapshot Stats", &CTrafficSnapshot::bShowStats, nil);
+#endif
+#ifdef TRAFFIC_LOD
+		DebugMenuAddVarBool8("Debug", "Use Traffic LOD", &CTrafficLod::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Show Traffic LOD Stats", &CTrafficLod::bShowStats, nil);
+#endif
+#ifdef PED_CROWD
+		DebugMenuAddVarBool8("Debug", "Use Ped Crowd", &CCrowd::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Show Ped Crowd Stats", &CCrowd::bShowStats, nil);
+		DebugMenuAddVar("Debug", "Max Crowd Peds", &CCrowd::MaxNumberOfCrowdPeds, nil, 10, 0, MAX_CROWD_PEDS, nil);
+		DebugMenuAddVar("Debug", "Crowd Promote Distance", &CCrowd::fPromoteDistance, nil, 5.0f, 25.0f, 100.0f);
+#endif
+#ifdef PED_PERCEPTION_SCHEDULER
+		DebugMenuAddVarBool8("Debug", "Use Perception Scheduler", &CPedPerception::bEnabled, nil);
+		DebugMenuAddVarBool8("Debug", "Show Perception Stats", &CPedPerception::bShowStats, nil);
+		DebugMenuAddVar("Debug", "Max Perception Scans", &CPedPerception::MaxScansPerFrame, nil, 4, 0, NUMPEDS, nil);
+#endif
+#ifdef PARTICLE_SOA_UPDATE
+		DebugMenuAddVarBool8("Debug", "Use SoA Particle Update", &CParticle::bUseSoAUpdate, nil);
+		DebugMenuAddVarBool8("Debug", "Show Particle Stats", &CParticle::bShowStats, nil);
+		DebugMenuAddCmd("Debug", "Benchmark Particles", BenchmarkParticles);
+#endif
+#ifdef PARTICLE_BATCHING
+		DebugMenuAddVarBool8("Debug", "Batch Particle Rendering", &CParticle::bBatchRender, nil);
+		DebugMenuAddVarBool8("Debug", "Show Particle Render Stats", &CParticle::bShowRenderStats, nil);
+#endif
+#ifdef SHADOW_RECEIVER_CACHE
+		DebugMenuAddVarBool8("Debug", "Use Shadow Receiver Cache", &CShadows::bUseReceiverCache, nil);
+		DebugMenuAddVarBool8("Debug", "Show Shadow Stats", &CShadows::bShowStats, nil);
+#endif
+#ifdef WATER_SAMPLE_CACHE
+		DebugMenuAddVarBool8("Debug", "Use Water Sample Cache", &CWaterLevel::bUseSampleCache, nil);
+		DebugMenuAddVarBool8("Debug", "Show Water Stats", &CWaterLevel::bShowStats, nil);
+#endif
+#ifdef BATCHED_BUOYANCY
+		DebugMenuAddVarBool8("Debug", "Use Batched Buoyancy", &cBuoyancy::bBatchWaterLevels, nil);
+		DebugMenuAddCmd("Debug", "Benchmark Buoyancy", BenchmarkBuoyancy);
+#endif
+#ifdef CLUSTERED_POINT_LIGHTS
+		DebugMenuAddVarBool8("Debug", "Use Clustered Point Lights", &CPointLights::bUseClusters, nil);
+		DebugMenuAddVarBool8("Debug", "Show Point Light Stats", &CPointLights::bShowStats, nil);
+#endif
+#ifdef CORONA_BATCHING
+		DebugMenuAddVarBool8("Debug", "Batch Corona Rendering", &CCoronas::bBatchRender, nil);
+		DebugMenuAddVarBool8("Debug", "Stagger Corona LOS Checks", &CCoronas::bStaggerLOSChecks, nil);
+		DebugMenuAddVarBool8("Debug", "Show Corona Stats", &CCoronas::bShowStats, nil);
+#endif
+#ifdef FONT_BATCHING
+		DebugMenuAddVarBool8("Debug", "Batch Font Styles", &CFont::bBatchFonts, nil);
+		DebugMenuAddVarBool8("Debug", "Show Font Stats", &CFont::bShowStats, nil);
+#endif
+#ifdef TIMECYCLE_CACHE
+		DebugMenuAddVarBool8("Debug", "Cache Timecycle Blend", &CTimeCycle::bCacheBlend, nil);
+		DebugMenuAddVarBool8("Debug", "Show Timecycle Stats", &CTimeCycle::bShowStats, nil);
+#endif
 		DebugMenuAddVarBool8("Render", "Show Collision Lines", &gbShowCollisionLines, nil);
 		DebugMenuAddVarBool8("Render", "Show Collision Polys", &gbShowCollisionPolys, nil);
 		DebugMenuAddVarBool8("Render", "Don't render Buildings", &gbDontRenderBuildings, nil);
@@ -693,6 +792,12 @@ extern bool gbRenderWorld2;
 		DebugMenuAddVarBool8("Render", "Don't render Vehicles", &gbDontRenderVehicles, nil);
 		DebugMenuAddVarBool8("Render", "Don't render Objects", &gbDontRenderObjects, nil);
 		DebugMenuAddVarBool8("Render", "Don't Render Water", &gbDontRenderWater, nil);
+#ifdef AUDIO_MIXER_THREAD
+		DebugMenuAddVarBool8("Debug", "Show Audio Thread Stats", &gbShowAudioThreadStats, nil);
+#endif
+#ifdef AUDIO_ENTITY_CULLING
+		DebugMenuAddVarBool8("Debug", "Show Audio Entity Stats", &gbShowAudioEntityStats, nil);
+#endif
 		
 #ifdef PROPER_SCALING	
 		DebugMenuAddVarBool8("Draw", "Proper Scaling", &CDraw::ms_bProperScaling, nil);
@@ -25,6 +25,9 @@
 #include "Ped.h"
 #include "Dummy.h"
 #include "WindModifiers.h"
+#ifdef SHADOW_MAPS
+#include "custompipes.h"
+#endif
 
 //--MIAMI: file done
 
@@ -371,6 +374,11 @@ CEntity::PreRender(void)
 				GetPosition() - 0.07f * TheCamera.GetRight(),
 				GetPosition() + 0.07f * TheCamera.GetRight());
 		}else if(GetModelIndex() == MI_BEACHBALL){
+#ifdef SHADOW_MAPS
+			// rendered into the shadow maps instead
+			if(CustomPipes::ShadowMapsActive())
+				break;
+#endif
 			CVector pos = GetPosition();
 			CShadows::StoreShadowToBeRendered(SHADOWTYPE_DARK,
 				gpShadowPedTex, &pos,
@@ -20,6 +20,8 @@
 #include "Bike.h"
 #include "Pickups.h"
 #include "Physical.h"
+#include "EntityHash.h"
+#include "TrafficSnapshot.h"
 
 //--MIAMI: file done
 
@@ -99,6 +101,12 @@ CPhysical::Add(void)
 	CSector *s;
 	CPtrList *list;
 
+#ifdef TRAFFIC_SNAPSHOT
+	// the sector lists change under the gathered neighbours
+	if(IsVehicle())
+		CTrafficSnapshot::Invalidate();
+#endif
+
 	CRect bounds = GetBoundRect();
 	xstart = CWorld::GetSectorIndexX(bounds.left);
 	xend   = CWorld::GetSectorIndexX(bounds.right);
@@ -143,12 +151,23 @@ CPhysical::Add(void)
 			assert(node);
 			m_entryInfoList.InsertItem(list, node, s);
 		}
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::EntityMoved(this);
+#endif
 }
 
 void
 CPhysical::Remove(void)
 {
 	CEntryInfoNode *node, *next;
+
+#ifdef TRAFFIC_SNAPSHOT
+	if(IsVehicle())
+		CTrafficSnapshot::Invalidate();
+#endif
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::EntityRemoved(this);
+#endif
 	for(node = m_entryInfoList.first; node; node = next){
 		next = node->next;
 		node->list->DeleteNode(node->listnode);
@@ -204,6 +223,18 @@ CPhysical::RemoveAndAdd(void)
 				break;
 			}
 			if(next){
+#ifdef TRAFFIC_SNAPSHOT
+				// Helis and trains do this during the ProcessControl loop every frame.
+				// A vehicle staying in the same list is left where it is so the
+				// gathered neighbours, which are in list order, stay valid.
+				if(IsVehicle()){
+					if(next->list == list){
+						next = next->next;
+						continue;
+					}
+					CTrafficSnapshot::Invalidate();
+				}
+#endif
 				// If we still have old nodes, use them
 				next->list->RemoveNode(next->listnode);
 				list->InsertNode(next->listnode);
@@ -211,6 +242,10 @@ CPhysical::RemoveAndAdd(void)
 				next->sector = s;
 				next = next->next;
 			}else{
+#ifdef TRAFFIC_SNAPSHOT
+				if(IsVehicle())
+					CTrafficSnapshot::Invalidate();
+#endif
 				CPtrNode *node = list->InsertItem(this);
 				m_entryInfoList.InsertItem(list, node, s);
 			}
@@ -218,11 +253,18 @@ CPhysical::RemoveAndAdd(void)
 
 	// Remove old nodes we no longer need
 	CEntryInfoNode *node;
+#ifdef TRAFFIC_SNAPSHOT
+	if(next && IsVehicle())
+		CTrafficSnapshot::Invalidate();
+#endif
 	for(node = next; node; node = next){
 		next = node->next;
 		node->list->DeleteNode(node->listnode);
 		m_entryInfoList.DeleteNode(node);
 	}
+#ifdef WORLD_ENTITY_HASH
+	CEntityHash::EntityMoved(this);
+#endif
 }
 
 CRect
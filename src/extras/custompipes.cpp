@@ -90,7 +90,7 @@ CreateEnvMapCam(rw::World *world)
 	return nil;
 }
 
-static void
+void
 DestroyCam(rw::Camera *cam)
 {
 	if(cam == nil)
@@ -476,6 +476,9 @@ CustomPipeInit(void)
 	}
 
 	EnvMapInit();
+#ifdef SHADOW_MAPS
+	ShadowMapInit();
+#endif
 
 	CreateVehiclePipe();
 	CreateWorldPipe();
@@ -492,6 +495,9 @@ CustomPipeShutdown(void)
 	DestroyRimLightPipes();
 
 	EnvMapShutdown();
+#ifdef SHADOW_MAPS
+	ShadowMapShutdown();
+#endif
 
 	if(neoTxd){
 		neoTxd->destroy();
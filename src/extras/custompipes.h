@@ -81,6 +81,20 @@ extern rw::Camera *EnvMapCam;
 extern rw::Texture *EnvMapTex;
 extern rw::Texture *EnvMaskTex;
 void EnvMapRender(void);
+void DestroyCam(rw::Camera *cam);
+
+#ifdef SHADOW_MAPS
+#define NUM_SHADOW_CASCADES 2
+extern bool ShadowMapEnable;
+extern int32 ShadowMapSize;
+extern float ShadowMapMult;
+extern rw::Camera *ShadowMapCam[NUM_SHADOW_CASCADES];
+extern rw::Texture *ShadowMapTex[NUM_SHADOW_CASCADES];
+void ShadowMapInit(void);
+void ShadowMapShutdown(void);
+void ShadowMapRender(void);
+bool ShadowMapsActive(void);
+#endif
 
 enum {
 	VEHICLEPIPE_MATFX,
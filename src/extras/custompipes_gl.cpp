@@ -10,7 +10,11 @@
 #include "Weather.h"
 #include "TxdStore.h"
 #include "Renderer.h"
+#include "VisibilityPlugins.h"
 #include "World.h"
+#include "Entity.h"
+#include "Camera.h"
+#include "Timer.h"
 #include "custompipes.h"
 
 #ifdef EXTENDED_PIPELINES
@@ -33,6 +37,12 @@ static int32 u_reflProps;
 static int32 u_specDir;
 static int32 u_specColor;
 
+#ifdef SHADOW_MAPS
+static int32 u_lightMatrix;
+static int32 u_shadowMatrix;
+static int32 u_shadowParams;
+#endif
+
 #define U(i) currentShader->uniformLocations[i]
 
 /*
@@ -188,11 +198,264 @@ DestroyVehiclePipe(void)
 
 
 
+#ifdef SHADOW_MAPS
+/*
+ * Shadow maps
+ */
+
+// Peds, vehicles and objects that are visible this frame are rendered into two
+// cascades around the camera, looking along the sun, with their depth packed
+// into RGBA. The world pipe samples them, so CShadows doesn't have to clip blobs
+// for these on the CPU anymore.
+
+bool ShadowMapEnable = true;
+int32 ShadowMapSize = 1024;
+float ShadowMapMult = 1.0f;
+rw::Camera *ShadowMapCam[NUM_SHADOW_CASCADES];
+rw::Texture *ShadowMapTex[NUM_SHADOW_CASCADES];
+
+static float CascadeRadius[NUM_SHADOW_CASCADES] = { 15.0f, 60.0f };
+static float ShadowMapDepth = 100.0f;	// half the depth range along the sun
+static float ShadowMapBias = 0.05f;	// in metres, for the first cascade
+static float ShadowMatrix[NUM_SHADOW_CASCADES][16];
+static uint32 ShadowMapFrame = ~0u;
+static int32 CurrentCascade;
+
+rw::gl3::Shader *shadowCasterShader;
+rw::gl3::Shader *shadowCasterSkinShader;
+
+static rw::Camera*
+CreateShadowMapCam(rw::World *world, rw::Texture **tex)
+{
+	rw::Raster *fbuf = rw::Raster::create(ShadowMapSize, ShadowMapSize, 0, rw::Raster::CAMERATEXTURE);
+	if(fbuf){
+		rw::Raster *zbuf = rw::Raster::create(ShadowMapSize, ShadowMapSize, 0, rw::Raster::ZBUFFER);
+		if(zbuf){
+			rw::Frame *frame = rw::Frame::create();
+			if(frame){
+				rw::Camera *cam = rw::Camera::create();
+				if(cam){
+					cam->frameBuffer = fbuf;
+					cam->zBuffer = zbuf;
+					cam->setFrame(frame);
+					world->addCamera(cam);
+					*tex = rw::Texture::create(fbuf);
+					(*tex)->setFilter(rw::Texture::NEAREST);
+					(*tex)->setAddressU(rw::Texture::CLAMP);
+					(*tex)->setAddressV(rw::Texture::CLAMP);
+					return cam;
+				}
+				frame->destroy();
+			}
+			zbuf->destroy();
+		}
+		fbuf->destroy();
+	}
+	return nil;
+}
+
+void
+ShadowMapInit(void)
+{
+	using namespace rw::gl3;
+
+	for(int i = 0; i < NUM_SHADOW_CASCADES; i++)
+		ShadowMapCam[i] = CreateShadowMapCam(Scene.world, &ShadowMapTex[i]);
+
+	{
+#include "shaders/shadowCaster_fs_gl.inc"
+#include "shaders/shadowCaster_gl.inc"
+	const char *vs[] = { shaderDecl, header_vert_src, shadowCaster_vert_src, nil };
+	const char *fs[] = { shaderDecl, header_frag_src, shadowCaster_frag_src, nil };
+	shadowCasterShader = Shader::create(vs, fs);
+	assert(shadowCasterShader);
+	}
+
+	{
+#include "shaders/shadowCaster_fs_gl.inc"
+#include "shaders/shadowCasterSkin_gl.inc"
+	const char *vs[] = { shaderDecl, header_vert_src, shadowCasterSkin_vert_src, nil };
+	const char *fs[] = { shaderDecl, header_frag_src, shadowCaster_frag_src, nil };
+	shadowCasterSkinShader = Shader::create(vs, fs);
+	assert(shadowCasterSkinShader);
+	}
+}
+
+void
+ShadowMapShutdown(void)
+{
+	shadowCasterShader->destroy();
+	shadowCasterShader = nil;
+
+	shadowCasterSkinShader->destroy();
+	shadowCasterSkinShader = nil;
+
+	for(int i = 0; i < NUM_SHADOW_CASCADES; i++){
+		if(ShadowMapTex[i]){
+			ShadowMapTex[i]->raster = nil;
+			ShadowMapTex[i]->destroy();
+			ShadowMapTex[i] = nil;
+		}
+		DestroyCam(ShadowMapCam[i]);
+		ShadowMapCam[i] = nil;
+	}
+}
+
+// Decided before anything is rendered so CShadows knows whether to store blob shadows
+bool
+ShadowMapsActive(void)
+{
+	if(!ShadowMapEnable || ShadowMapCam[0] == nil || ShadowMapCam[1] == nil)
+		return false;
+	// no sun, the blobs do a better job at night
+	return CTimeCycle::GetSunDirection().z > 0.1f && CTimeCycle::GetShadowStrength() != 0;
+}
+
+static bool
+ShadowMapsRendered(void)
+{
+	return ShadowMapFrame == CTimer::GetFrameCounter() && !bRenderingEnvMap;
+}
+
+// Orthographic world to light clip space matrix around centre, column major
+static void
+CalcShadowMatrix(float *m, const CVector &centre, float radius)
+{
+	CVector fwd = CTimeCycle::GetSunDirection() * -1.0f;
+	fwd.Normalise();
+	CVector right = CrossProduct(fwd, CVector(0.0f, 0.0f, 1.0f));
+	if(right.MagnitudeSqr() < 0.0001f)
+		right = CVector(1.0f, 0.0f, 0.0f);
+	right.Normalise();
+	CVector up = CrossProduct(right, fwd);
+
+	// snap to whole texels, otherwise the edges crawl when the camera moves
+	float texel = 2.0f*radius/ShadowMapSize;
+	float x = Floor(DotProduct(right, centre)/texel)*texel;
+	float y = Floor(DotProduct(up, centre)/texel)*texel;
+	float z = DotProduct(fwd, centre);
+
+	m[0] = right.x/radius;	m[4] = right.y/radius;	m[8] = right.z/radius;	m[12] = -x/radius;
+	m[1] = up.x/radius;	m[5] = up.y/radius;	m[9] = up.z/radius;	m[13] = -y/radius;
+	m[2] = fwd.x/ShadowMapDepth;	m[6] = fwd.y/ShadowMapDepth;	m[10] = fwd.z/ShadowMapDepth;	m[14] = -z/ShadowMapDepth;
+	m[3] = 0.0f;	m[7] = 0.0f;	m[11] = 0.0f;	m[15] = 1.0f;
+}
+
+static RpAtomic*
+RenderShadowCasterCB(RpAtomic *atomic, void *data)
+{
+	using namespace rw;
+	using namespace rw::gl3;
+
+	if(!(atomic->getFlags() & Atomic::RENDER))
+		return atomic;
+	// only the LOD the camera sees, otherwise vehicles cast both hi and low detail
+	if(!CVisibilityPlugins::IsAtomicVisibleAtLod(atomic))
+		return atomic;
+
+	atomic->getPipeline()->instance(atomic);
+	InstanceDataHeader *header = (InstanceDataHeader*)atomic->geometry->instData;
+	if(header == nil || header->platform != PLATFORM_GL3)
+		return atomic;
+
+	bool skinned = Skin::get(atomic->geometry) != nil;
+	if(skinned){
+		shadowCasterSkinShader->use();
+		uploadSkinMatrices(atomic);
+	}else
+		shadowCasterShader->use();
+	glUniformMatrix4fv(U(u_lightMatrix), 1, GL_FALSE, ShadowMatrix[CurrentCascade]);
+
+	setWorldMatrix(atomic->getFrame()->getLTM());
+
+#ifdef RW_GL_USE_VAOS
+	glBindVertexArray(header->vao);
+#else
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, header->ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, header->vbo);
+	setAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+
+	InstanceData *inst = header->inst;
+	rw::int32 n = header->numMeshes;
+	while(n--){
+		// texture alpha is needed to cut out fences, foliage and such
+		setTexture(0, inst->material->texture);
+		drawInst(header, inst);
+		inst++;
+	}
+#ifndef RW_GL_USE_VAOS
+	disableAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+	return atomic;
+}
+
+// Called before the scene is rendered, the world pipe uses the maps in the same frame
+void
+ShadowMapRender(void)
+{
+	if(!ShadowMapsActive())
+		return;
+
+	CVector camPos = TheCamera.GetPosition();
+	CVector camFwd = TheCamera.GetForward();
+
+	RwCameraEndUpdate(Scene.camera);
+
+	rw::RGBA white = { 255, 255, 255, 255 };
+	for(CurrentCascade = 0; CurrentCascade < NUM_SHADOW_CASCADES; CurrentCascade++){
+		float radius = CascadeRadius[CurrentCascade];
+		float *m = ShadowMatrix[CurrentCascade];
+		CalcShadowMatrix(m, camPos + camFwd*radius*0.75f, radius);
+
+		ShadowMapCam[CurrentCascade]->clear(&white, rwCAMERACLEARZ|rwCAMERACLEARIMAGE);
+		RwCameraBeginUpdate(ShadowMapCam[CurrentCascade]);
+		rw::SetRenderState(rw::VERTEXALPHA, FALSE);
+		rw::SetRenderState(rw::ZTESTENABLE, TRUE);
+		rw::SetRenderState(rw::ZWRITEENABLE, TRUE);
+		rw::SetRenderState(rw::CULLMODE, rw::CULLNONE);
+		// textures with alpha turn blending on, which would mix the packed depth
+		rw::SetRenderState(rw::SRCBLEND, rw::BLENDONE);
+		rw::SetRenderState(rw::DESTBLEND, rw::BLENDZERO);
+
+		for(int i = 0; i < CRenderer::GetNumVisibleEntities(); i++){
+			CEntity *e = CRenderer::GetVisibleEntity(i);
+			if(!e->IsPed() && !e->IsVehicle() && !e->IsObject())
+				continue;
+			if(e->m_rwObject == nil)
+				continue;
+			// skip what's outside the cascade
+			const CVector &pos = e->GetPosition();
+			float r = e->GetBoundRadius()/radius;
+			float x = m[0]*pos.x + m[4]*pos.y + m[8]*pos.z + m[12];
+			float y = m[1]*pos.x + m[5]*pos.y + m[9]*pos.z + m[13];
+			if(Abs(x) > 1.0f + r || Abs(y) > 1.0f + r)
+				continue;
+			if(RwObjectGetType(e->m_rwObject) == rpATOMIC)
+				RenderShadowCasterCB((RpAtomic*)e->m_rwObject, nil);
+			else
+				RpClumpForAllAtomics((RpClump*)e->m_rwObject, RenderShadowCasterCB, nil);
+		}
+
+		RwCameraEndUpdate(ShadowMapCam[CurrentCascade]);
+	}
+	rw::SetRenderState(rw::SRCBLEND, rw::BLENDSRCALPHA);
+	rw::SetRenderState(rw::DESTBLEND, rw::BLENDINVSRCALPHA);
+
+	RwCameraBeginUpdate(Scene.camera);
+	ShadowMapFrame = CTimer::GetFrameCounter();
+}
+#endif
+
+
 /*
  * Neo World pipe
  */
 
 rw::gl3::Shader *neoWorldShader;
+#ifdef SHADOW_MAPS
+rw::gl3::Shader *neoWorldShadowShader;
+#endif
 
 static void
 worldRenderCB(rw::Atomic *atomic, rw::gl3::InstanceDataHeader *header)
@@ -200,7 +463,12 @@ worldRenderCB(rw::Atomic *atomic, rw::gl3::InstanceDataHeader *header)
 	using namespace rw;
 	using namespace rw::gl3;
 
+#ifdef SHADOW_MAPS
+	bool shadows = ShadowMapsRendered();
+	if(!LightmapEnable && !shadows){
+#else
 	if(!LightmapEnable){
+#endif
 		gl3::defaultRenderCB(atomic, header);
 		return;
 	}
@@ -221,6 +489,20 @@ worldRenderCB(rw::Atomic *atomic, rw::gl3::InstanceDataHeader *header)
 	InstanceData *inst = header->inst;
 	rw::int32 n = header->numMeshes;
 
+#ifdef SHADOW_MAPS
+	if(shadows){
+		neoWorldShadowShader->use();
+		glUniformMatrix4fv(U(u_shadowMatrix), NUM_SHADOW_CASCADES, GL_FALSE, (float*)ShadowMatrix);
+		float shadowParams[4];
+		shadowParams[0] = CTimeCycle::GetShadowStrength()/255.0f * ShadowMapMult;
+		shadowParams[1] = ShadowMapBias/(2.0f*ShadowMapDepth);
+		shadowParams[2] = shadowParams[1]*CascadeRadius[1]/CascadeRadius[0];	// bigger texels
+		shadowParams[3] = 1.0f/ShadowMapSize;
+		glUniform4fv(U(u_shadowParams), 1, shadowParams);
+		setTexture(2, ShadowMapTex[0]);
+		setTexture(3, ShadowMapTex[1]);
+	}else
+#endif
 	neoWorldShader->use();
 
 	float lightfactor[4];
@@ -228,6 +510,22 @@ worldRenderCB(rw::Atomic *atomic, rw::gl3::InstanceDataHeader *header)
 	while(n--){
 		m = inst->material;
 
+#ifdef SHADOW_MAPS
+		if(!LightmapEnable){
+			// what the default pipe does, just with the shadows
+			setTexture(1, nil);
+			lightfactor[0] = lightfactor[1] = lightfactor[2] = 0.0f;
+			lightfactor[3] = 1.0f;
+			glUniform4fv(U(u_lightMap), 1, lightfactor);
+			setMaterial(m->color, m->surfaceProps);
+			setTexture(0, m->texture);
+			rw::SetRenderState(VERTEXALPHA, inst->vertexAlpha || m->color.alpha != 0xFF);
+			drawInst(header, inst);
+			inst++;
+			continue;
+		}
+#endif
+
 		if(MatFX::getEffects(m) == MatFX::DUAL){
 			MatFX *matfx = MatFX::get(m);
 			Texture *dualtex = matfx->getDualTexture();
@@ -254,6 +552,12 @@ worldRenderCB(rw::Atomic *atomic, rw::gl3::InstanceDataHeader *header)
 		inst++;
 	}
 	setTexture(1, nil);
+#ifdef SHADOW_MAPS
+	if(shadows){
+		setTexture(2, nil);
+		setTexture(3, nil);
+	}
+#endif
 #ifndef RW_GL_USE_VAOS
 	disableAttribPointers(header->attribDesc, header->numAttribs);
 #endif
@@ -279,6 +583,17 @@ CreateWorldPipe(void)
 	assert(neoWorldShader);
 	}
 
+#ifdef SHADOW_MAPS
+	{
+#include "shaders/neoWorldShadow_fs_gl.inc"
+#include "shaders/neoWorldShadow_vs_gl.inc"
+	const char *vs[] = { shaderDecl, header_vert_src, neoWorldShadow_vert_src, nil };
+	const char *fs[] = { shaderDecl, header_frag_src, neoWorldShadow_frag_src, nil };
+	neoWorldShadowShader = Shader::create(vs, fs);
+	assert(neoWorldShadowShader);
+	}
+#endif
+
 
 	rw::gl3::ObjPipeline *pipe = rw::gl3::ObjPipeline::create();
 	pipe->instanceCB = rw::gl3::defaultInstanceCB;
@@ -292,6 +607,10 @@ DestroyWorldPipe(void)
 {
 	neoWorldShader->destroy();
 	neoWorldShader = nil;
+#ifdef SHADOW_MAPS
+	neoWorldShadowShader->destroy();
+	neoWorldShadowShader = nil;
+#endif
 
 	((rw::gl3::ObjPipeline*)worldPipe)->destroy();
 	worldPipe = nil;
@@ -609,6 +928,12 @@ CustomPipeRegisterGL(void)
 	u_reflProps = rw::gl3::registerUniform("u_reflProps");
 	u_specDir = rw::gl3::registerUniform("u_specDir");
 	u_specColor = rw::gl3::registerUniform("u_specColor");
+
+#ifdef SHADOW_MAPS
+	u_lightMatrix = rw::gl3::registerUniform("u_lightMatrix");
+	u_shadowMatrix = rw::gl3::registerUniform("u_shadowMatrix");
+	u_shadowParams = rw::gl3::registerUniform("u_shadowParams");
+#endif
 }
 
 
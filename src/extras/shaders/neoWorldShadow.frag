@@ -0,0 +1,61 @@
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform sampler2D tex2;
+uniform sampler2D tex3;
+
+uniform vec4 u_lightMap;
+uniform vec4 u_shadowParams;	// strength, bias near, bias far, texel size
+
+FSIN vec4 v_color;
+FSIN vec2 v_tex0;
+FSIN vec2 v_tex1;
+FSIN vec3 v_shadow0;
+FSIN vec3 v_shadow1;
+FSIN float v_fog;
+
+float
+ShadowTap(sampler2D map, vec2 uv, float depth)
+{
+	float d = dot(texture(map, uv), vec4(1.0, 1.0/255.0, 1.0/65025.0, 1.0/16581375.0));
+	return depth > d ? 1.0 : 0.0;
+}
+
+float
+Shadow(sampler2D map, vec3 p, float bias)
+{
+	float depth = p.z - bias;
+	float t = u_shadowParams.w*0.5;
+	return (ShadowTap(map, p.xy + vec2(-t, -t), depth) +
+		ShadowTap(map, p.xy + vec2( t, -t), depth) +
+		ShadowTap(map, p.xy + vec2(-t,  t), depth) +
+		ShadowTap(map, p.xy + vec2( t,  t), depth)) * 0.25;
+}
+
+bool
+InCascade(vec3 p)
+{
+	return all(greaterThan(p, vec3(0.0))) && all(lessThan(p, vec3(1.0)));
+}
+
+void
+main(void)
+{
+	vec4 t0 = texture(tex0, vec2(v_tex0.x, 1.0-v_tex0.y));
+	vec4 t1 = texture(tex1, vec2(v_tex1.x, 1.0-v_tex1.y));
+
+	vec4 color;
+	color = t0*v_color*(1.0 + u_lightMap*(t1-1.0));
+	color.a = v_color.a*t0.a*u_lightMap.a;
+
+	float shadow = 0.0;
+	if(InCascade(v_shadow0))
+		shadow = Shadow(tex2, v_shadow0, u_shadowParams.y);
+	else if(InCascade(v_shadow1))
+		shadow = Shadow(tex3, v_shadow1, u_shadowParams.z);
+	color.rgb *= 1.0 - shadow*u_shadowParams.x;
+
+	color.rgb = mix(u_fogColor.rgb, color.rgb, v_fog);
+	DoAlphaTest(color.a);
+
+	FRAGCOLOR(color);
+}
@@ -0,0 +1,32 @@
+uniform mat4 u_shadowMatrix[2];
+
+VSIN(ATTRIB_POS)	vec3 in_pos;
+
+VSOUT vec4 v_color;
+VSOUT vec2 v_tex0;
+VSOUT vec2 v_tex1;
+VSOUT vec3 v_shadow0;
+VSOUT vec3 v_shadow1;
+VSOUT float v_fog;
+
+void
+main(void)
+{
+	vec4 Vertex = u_world * vec4(in_pos, 1.0);
+	gl_Position = u_proj * u_view * Vertex;
+	vec3 Normal = mat3(u_world) * in_normal;
+
+	v_tex0 = in_tex0;
+	v_tex1 = in_tex1;
+
+	v_shadow0 = (u_shadowMatrix[0] * Vertex).xyz*0.5 + 0.5;
+	v_shadow1 = (u_shadowMatrix[1] * Vertex).xyz*0.5 + 0.5;
+
+	v_color = in_color;
+	v_color.rgb += u_ambLight.rgb*surfAmbient;
+	v_color.rgb += DoDynamicLight(Vertex.xyz, Normal)*surfDiffuse;
+	v_color = clamp(v_color, 0.0, 1.0);
+	v_color *= u_matColor;
+
+	v_fog = DoFog(gl_Position.w);
+}
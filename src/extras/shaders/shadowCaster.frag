@@ -0,0 +1,17 @@
+uniform sampler2D tex0;
+
+FSIN vec2 v_tex0;
+FSIN float v_depth;
+
+void
+main(void)
+{
+	DoAlphaTest(texture(tex0, vec2(v_tex0.x, 1.0-v_tex0.y)).a);
+
+	// depth in all four channels so it survives an RGBA8 target
+	float d = clamp(v_depth, 0.0, 0.999);
+	vec4 color = fract(d * vec4(1.0, 255.0, 65025.0, 16581375.0));
+	color -= color.yzww * vec4(1.0/255.0, 1.0/255.0, 1.0/255.0, 0.0);
+
+	FRAGCOLOR(color);
+}
@@ -0,0 +1,14 @@
+uniform mat4 u_lightMatrix;
+
+VSIN(ATTRIB_POS)	vec3 in_pos;
+
+VSOUT vec2 v_tex0;
+VSOUT float v_depth;
+
+void
+main(void)
+{
+	gl_Position = u_lightMatrix * u_world * vec4(in_pos, 1.0);
+	v_depth = gl_Position.z*0.5 + 0.5;
+	v_tex0 = in_tex0;
+}
@@ -0,0 +1,19 @@
+uniform mat4 u_boneMatrices[64];
+uniform mat4 u_lightMatrix;
+
+VSIN(ATTRIB_POS)	vec3 in_pos;
+
+VSOUT vec2 v_tex0;
+VSOUT float v_depth;
+
+void
+main(void)
+{
+	vec3 SkinVertex = vec3(0.0, 0.0, 0.0);
+	for(int i = 0; i < 4; i++)
+		SkinVertex += (u_boneMatrices[int(in_indices[i])] * vec4(in_pos, 1.0)).xyz * in_weights[i];
+
+	gl_Position = u_lightMatrix * u_world * vec4(SkinVertex, 1.0);
+	v_depth = gl_Position.z*0.5 + 0.5;
+	v_tex0 = in_tex0;
+}
@@ -0,0 +1,293 @@
+#include "common.h"
+
+#ifdef PED_CROWD
+#include "Crowd.h"
+
+#include "Camera.h"
+#include "Debug.h"
+#include "Game.h"
+#include "General.h"
+#include "ModelInfo.h"
+#include "PathFind.h"
+#include "Ped.h"
+#include "PedPlacement.h"
+#include "Population.h"
+#include "Streaming.h"
+#include "Timer.h"
+#include "VisibilityPlugins.h"
+#include "World.h"
+#include "Zones.h"
+
+#define CROWD_WALK_SPEED (1.3f)	// metres per second, about what PEDMOVE_WALK does
+#define CROWD_OFFSCREEN_PROMOTE_DIST (25.0f)	// same as the offscreen removal range of CPopulation::ManagePopulation
+#define CROWD_RANGE (150.0f)	// crowd peds further away than this are forgotten
+#define CROWD_MAX_PROMOTED_PER_FRAME (2)
+#define CROWD_ATTEMPTS_TO_FIND_NEXT_NODE (4)
+
+enum
+{
+	CROWD_AT_NODE = 1,
+	CROWD_NEAR = 2,
+	CROWD_FAR = 4
+};
+
+bool CCrowd::bEnabled = true;
+bool CCrowd::bShowStats;
+int32 CCrowd::MaxNumberOfCrowdPeds = 200;
+float CCrowd::fPromoteDistance = 45.0f;
+
+// Everything the per frame loop touches is in its own array
+float aCrowdPosX[MAX_CROWD_PEDS];
+float aCrowdPosY[MAX_CROWD_PEDS];
+float aCrowdDirX[MAX_CROWD_PEDS];
+float aCrowdDirY[MAX_CROWD_PEDS];
+float aCrowdTargetX[MAX_CROWD_PEDS];
+float aCrowdTargetY[MAX_CROWD_PEDS];
+uint8 aCrowdState[MAX_CROWD_PEDS];
+// and the rest is only looked at when a ped reaches a node or gets promoted
+float aCrowdTargetZ[MAX_CROWD_PEDS];
+int16 aCrowdLastNode[MAX_CROWD_PEDS];
+int16 aCrowdNextNode[MAX_CROWD_PEDS];
+int16 aCrowdModel[MAX_CROWD_PEDS];
+uint8 aCrowdPedType[MAX_CROWD_PEDS];
+int32 NumCrowdPeds;
+
+int32 nCrowdPromoted;
+int32 nCrowdDemoted;
+int32 nCrowdPromotedPerSecond;
+int32 nCrowdDemotedPerSecond;
+uint32 nCrowdStatsSecond;
+
+static void
+SetCrowdTarget(int32 i, int32 lastNode, int32 nextNode)
+{
+	CPathNode *pNode = &ThePaths.m_pathNodes[nextNode];
+	aCrowdLastNode[i] = lastNode;
+	aCrowdNextNode[i] = nextNode;
+	aCrowdTargetX[i] = pNode->GetX();
+	aCrowdTargetY[i] = pNode->GetY();
+	aCrowdTargetZ[i] = pNode->GetZ();
+	CVector2D dir(aCrowdTargetX[i] - aCrowdPosX[i], aCrowdTargetY[i] - aCrowdPosY[i]);
+	dir.Normalise();
+	aCrowdDirX[i] = dir.x;
+	aCrowdDirY[i] = dir.y;
+}
+
+static int32
+AddCrowdPed(float x, float y, int32 lastNode, int32 nextNode, int32 model, int32 pedType)
+{
+	if(NumCrowdPeds >= MAX_CROWD_PEDS)
+		return -1;
+	int32 i = NumCrowdPeds++;
+	aCrowdPosX[i] = x;
+	aCrowdPosY[i] = y;
+	aCrowdModel[i] = model;
+	aCrowdPedType[i] = pedType;
+	aCrowdState[i] = 0;
+	SetCrowdTarget(i, lastNode, nextNode);
+	return i;
+}
+
+// Order doesn't matter, so the last one just takes the free place
+static void
+RemoveCrowdPed(int32 i)
+{
+	int32 last = --NumCrowdPeds;
+	if(i == last)
+		return;
+	aCrowdPosX[i] = aCrowdPosX[last];
+	aCrowdPosY[i] = aCrowdPosY[last];
+	aCrowdDirX[i] = aCrowdDirX[last];
+	aCrowdDirY[i] = aCrowdDirY[last];
+	aCrowdTargetX[i] = aCrowdTargetX[last];
+	aCrowdTargetY[i] = aCrowdTargetY[last];
+	aCrowdState[i] = aCrowdState[last];
+	aCrowdTargetZ[i] = aCrowdTargetZ[last];
+	aCrowdLastNode[i] = aCrowdLastNode[last];
+	aCrowdNextNode[i] = aCrowdNextNode[last];
+	aCrowdModel[i] = aCrowdModel[last];
+	aCrowdPedType[i] = aCrowdPedType[last];
+}
+
+static bool
+PickNextNodeForCrowdPed(int32 i)
+{
+	int32 curNode = aCrowdNextNode[i];
+	CPathNode *pNode = &ThePaths.m_pathNodes[curNode];
+	if(pNode->numLinks == 0)
+		return false;
+	for(int attempt = 0; attempt < CROWD_ATTEMPTS_TO_FIND_NEXT_NODE; attempt++){
+		int32 link = pNode->firstLink + CGeneral::GetRandomNumber() % pNode->numLinks;
+		int32 nextNode = ThePaths.ConnectedNode(link);
+		// only turn around at dead ends
+		if(nextNode == aCrowdLastNode[i] && pNode->numLinks > 1)
+			continue;
+		if(ThePaths.m_pathNodes[nextNode].bDisabled || ThePaths.ConnectionCrossesRoad(link))
+			continue;
+		SetCrowdTarget(i, curNode, nextNode);
+		return true;
+	}
+	return false;
+}
+
+static bool
+PromoteCrowdPed(int32 i, const CVector &playerPos)
+{
+	CVector pos(aCrowdPosX[i], aCrowdPosY[i], aCrowdTargetZ[i]);
+	// Offscreen peds at this range would be taken away again right away
+	if(!TheCamera.IsSphereVisible(pos, 2.0f) &&
+	   (pos - playerPos).MagnitudeSqr2D() > SQR(CPopulation::PedCreationDistMultiplier() * CROWD_OFFSCREEN_PROMOTE_DIST))
+		return false;
+	if(CPopulation::ms_nTotalPeds >= (uint32)CPopulation::MaxNumberOfPedsInUse)
+		return false;
+	if(!CStreaming::HasModelLoaded(aCrowdModel[i]))
+		return false;
+	bool foundGround;
+	float groundZ = CWorld::FindGroundZFor3DCoord(pos.x, pos.y, pos.z + 2.0f, &foundGround);
+	if(!foundGround)
+		return false;
+	pos.z = groundZ + 1.0f;
+	if(!CPedPlacement::IsPositionClearForPed(pos))
+		return false;
+
+	CPed *ped = CPopulation::AddPed((ePedType)aCrowdPedType[i], aCrowdModel[i], pos);
+	float heading = CVector2D(aCrowdDirX[i], aCrowdDirY[i]).Heading();
+	ped->m_fRotationCur = heading;
+	ped->m_fRotationDest = heading;
+	ped->SetHeading(heading);
+	ped->SetWanderPath(CGeneral::GetNodeHeadingFromVector(aCrowdDirX[i], aCrowdDirY[i]));
+	CVisibilityPlugins::SetClumpAlpha(ped->GetClump(), 0);
+	return true;
+}
+
+static void
+AddFarAwayCrowdPed(const CVector &playerPos, float minDist)
+{
+	CZoneInfo zoneInfo;
+	CTheZones::GetZoneInfoForTimeOfDay(&playerPos, &zoneInfo);
+	// Same density as CPopulation::AddToPopulation, scaled up to the crowd
+	float density = (zoneInfo.pedDensity + zoneInfo.carDensity) * CWorld::Players[CWorld::PlayerInFocus].m_fRoadDensity *
+		CPopulation::PedDensityMultiplier / Max(CPopulation::MaxNumberOfPedsInUse, 1);
+	if(NumCrowdPeds >= CCrowd::MaxNumberOfCrowdPeds * Min(density, 1.0f))
+		return;
+
+	CVector pos;
+	int32 node1, node2;
+	float positionBetweenNodes;
+	if(!ThePaths.GeneratePedCreationCoors(playerPos.x, playerPos.y, minDist, CROWD_RANGE, minDist, CROWD_RANGE,
+	     &pos, &node1, &node2, &positionBetweenNodes, nil))
+		return;
+	int32 model = CPopulation::ChooseCivilianOccupation(zoneInfo.pedGroup);
+	if(model == -1)
+		return;
+	AddCrowdPed(pos.x, pos.y, node1, node2, model, ((CPedModelInfo*)CModelInfo::GetModelInfo(model))->m_pedType);
+}
+
+void
+CCrowd::Init(void)
+{
+	NumCrowdPeds = 0;
+	nCrowdPromoted = 0;
+	nCrowdDemoted = 0;
+	nCrowdPromotedPerSecond = 0;
+	nCrowdDemotedPerSecond = 0;
+}
+
+void
+CCrowd::Update(void)
+{
+	if(!bEnabled || CGame::IsInInterior()){
+		NumCrowdPeds = 0;
+		return;
+	}
+
+	CVector playerPos = FindPlayerCentreOfWorld(CWorld::PlayerInFocus);
+	float step = CROWD_WALK_SPEED * CTimer::GetTimeStepInSeconds();
+	float promoteDist = fPromoteDistance * CPopulation::PedCreationDistMultiplier() * TheCamera.GenerationDistMultiplier;
+	float promoteDistSqr = SQR(promoteDist);
+	float removeDistSqr = SQR(CROWD_RANGE + 20.0f);
+
+	// Walk everyone towards their next node
+	for(int32 i = 0; i < NumCrowdPeds; i++){
+		float remaining = (aCrowdTargetX[i] - aCrowdPosX[i]) * aCrowdDirX[i] + (aCrowdTargetY[i] - aCrowdPosY[i]) * aCrowdDirY[i];
+		float move = Min(step, Max(remaining, 0.0f));
+		aCrowdPosX[i] += aCrowdDirX[i] * move;
+		aCrowdPosY[i] += aCrowdDirY[i] * move;
+		float dx = aCrowdPosX[i] - playerPos.x;
+		float dy = aCrowdPosY[i] - playerPos.y;
+		float distSqr = dx*dx + dy*dy;
+		aCrowdState[i] = (remaining <= step ? CROWD_AT_NODE : 0) |
+			(distSqr < promoteDistSqr ? CROWD_NEAR : 0) |
+			(distSqr > removeDistSqr ? CROWD_FAR : 0);
+	}
+
+	// Backwards, RemoveCrowdPed moves the last one into the free place
+	int32 numPromoted = 0;
+	for(int32 i = NumCrowdPeds-1; i >= 0; i--){
+		uint8 state = aCrowdState[i];
+		if(state == 0)
+			continue;
+		if(state & CROWD_FAR || state & CROWD_AT_NODE && !PickNextNodeForCrowdPed(i)){
+			RemoveCrowdPed(i);
+			continue;
+		}
+		if(state & CROWD_NEAR && numPromoted < CROWD_MAX_PROMOTED_PER_FRAME && PromoteCrowdPed(i, playerPos)){
+			RemoveCrowdPed(i);
+			numPromoted++;
+			nCrowdPromoted++;
+		}
+	}
+
+	if((CTimer::GetFrameCounter() & 3) == 0)
+		AddFarAwayCrowdPed(playerPos, promoteDist + 10.0f);
+
+	if(CTimer::GetTimeInMilliseconds()/1000 != nCrowdStatsSecond){
+		nCrowdStatsSecond = CTimer::GetTimeInMilliseconds()/1000;
+		nCrowdPromotedPerSecond = nCrowdPromoted;
+		nCrowdDemotedPerSecond = nCrowdDemoted;
+		nCrowdPromoted = 0;
+		nCrowdDemoted = 0;
+	}
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "CROWD PEDS %d REAL PEDS %d PROMOTED %d/S DEMOTED %d/S", NumCrowdPeds, CPopulation::ms_nTotalPeds,
+			nCrowdPromotedPerSecond, nCrowdDemotedPerSecond);
+		CDebug::PrintAt(str, 2, 26);
+	}
+}
+
+// Called by CPopulation::ManagePopulation just before a ped is removed for being too far away
+bool
+CCrowd::StorePed(CPed *ped)
+{
+	if(!bEnabled || CGame::IsInInterior() || NumCrowdPeds >= MaxNumberOfCrowdPeds)
+		return false;
+	if(ped->CharCreatedBy != RANDOM_CHAR || ped->m_nPedState != PED_WANDER_PATH || ped->m_objective != OBJECTIVE_NONE ||
+	   ped->bIsLeader || ped->m_leader || ped->m_fHealth <= 0.0f)
+		return false;
+	switch(ped->m_nPedType){
+	case PEDTYPE_CIVMALE:
+	case PEDTYPE_CIVFEMALE:
+	case PEDTYPE_CRIMINAL:
+	case PEDTYPE_PROSTITUTE:
+		break;
+	default:
+		return false;
+	}
+	if(ped->m_pLastPathNode == nil || ped->m_pNextPathNode == nil)
+		return false;
+	if(AddCrowdPed(ped->GetPosition().x, ped->GetPosition().y,
+	     ped->m_pLastPathNode - ThePaths.m_pathNodes, ped->m_pNextPathNode - ThePaths.m_pathNodes,
+	     ped->GetModelIndex(), ped->m_nPedType) < 0)
+		return false;
+	nCrowdDemoted++;
+	return true;
+}
+
+int32
+CCrowd::GetNumPeds(void)
+{
+	return NumCrowdPeds;
+}
+
+#endif
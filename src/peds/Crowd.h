@@ -0,0 +1,32 @@
+#pragma once
+
+#ifdef PED_CROWD
+
+class CPed;
+
+/*
+Wandering peds beyond the ped creation range are kept as a crowd instead of being deleted.
+A crowd ped has no CPed, it's only a position, a direction and the two ped path nodes it
+walks between, kept in plain arrays so moving all of them is one tight loop. When the camera
+gets close enough a crowd ped is turned into a real one with CPopulation::AddPed, and real
+peds CPopulation::ManagePopulation takes away for being too far go back into the crowd.
+The crowd is also topped up far away from the player, so the city can be busier than
+MaxNumberOfPedsInUse allows without more peds running their AI.
+*/
+#define MAX_CROWD_PEDS 512
+
+class CCrowd
+{
+public:
+	static bool bEnabled;
+	static bool bShowStats;
+	static int32 MaxNumberOfCrowdPeds;
+	static float fPromoteDistance;
+
+	static void Init(void);
+	static void Update(void);
+	static bool StorePed(CPed *ped);
+	static int32 GetNumPeds(void);
+};
+
+#endif
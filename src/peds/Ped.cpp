@@ -14,6 +14,7 @@
 #include "HandlingMgr.h"
 #include "Replay.h"
 #include "Radar.h"
+#include "PedPerception.h"
 #include "PedPlacement.h"
 #include "Shadows.h"
 #include "Weather.h"
@@ -468,7 +469,12 @@ CPed::DeleteRwObject()
 void
 CPed::BuildPedLists(void)
 {
+#ifdef PED_PERCEPTION_SCHEDULER
+	// CPedPerception::Build has already rebuilt the list if it was due
+	if (!CPedPerception::IsActive() && ((CTimer::GetFrameCounter() + m_randomSeed) % 16) == 0) {
+#else
 	if (((CTimer::GetFrameCounter() + m_randomSeed) % 16) == 0) {
+#endif
 		CVector centre = CEntity::GetBoundCentre();
 		int deadsRegistered = 0;
 		CRect rect(centre.x - 20.f * nThreatReactionRangeMultiplier,
@@ -983,6 +989,10 @@ CPed::ScanForDelayedResponseThreats(void)
 	if (m_threatFlags)
 		return;
 
+#ifdef PED_PERCEPTION_SCHEDULER
+	if (!CPedPerception::ShouldScan(this, PERCEPTION_SCAN_THREATS))
+		return;
+#endif
 	m_threatEntity = nil;
 	m_pEventEntity = nil;
 	m_threatFlags = ScanForThreats();
@@ -1293,14 +1303,33 @@ CPed::ScanForInterestingStuff(void)
 	if (CharCreatedBy == MISSION_CHAR)
 		return;
 
+#ifdef PED_PERCEPTION_SCHEDULER
+	if (!CPedPerception::ShouldScan(this, PERCEPTION_SCAN_INTERESTING))
+		return;
+#endif
 	LookForSexyPeds();
 	LookForSexyCars();
 	if (LookForInterestingNodes())
 		return;
 
 	if (m_nPedType == PEDTYPE_CRIMINAL && m_carJackTimer < CTimer::GetTimeInMilliseconds()) {
+#ifdef PED_PERCEPTION_SCHEDULER
+		// this scan can stand for a few frames, roll for each of them until something comes up
+		int scanFrames = CPedPerception::GetScanFrames(this, PERCEPTION_SCAN_INTERESTING);
+		bool stealCar = false;
+		bool mugChar = false;
+		for (int i = 0; i < scanFrames && !stealCar && !mugChar; i++) {
+			if (CGeneral::GetRandomNumber() % 100 < 10)
+				stealCar = true;
+			else if (m_objective != OBJECTIVE_MUG_CHAR && !(CGeneral::GetRandomNumber() & 7))
+				mugChar = true;
+		}
+		// Find a car to steal or a ped to mug if we haven't already decided to steal a car
+		if (stealCar) {
+#else
 		// Find a car to steal or a ped to mug if we haven't already decided to steal a car
 		if (CGeneral::GetRandomNumber() % 100 < 10) {
+#endif
 			int mostExpensiveVehAround = -1;
 			int bestMonetaryValue = 0;
 
@@ -1326,7 +1355,11 @@ CPed::ScanForInterestingStuff(void)
 				return;
 			}
 			m_carJackTimer = CTimer::GetTimeInMilliseconds() + 5000;
+#ifdef PED_PERCEPTION_SCHEDULER
+		} else if (mugChar) {
+#else
 		} else if (m_objective != OBJECTIVE_MUG_CHAR && !(CGeneral::GetRandomNumber() & 7)) {
+#endif
 			CPed *charToMug = nil;
 			for (int i = 0; i < m_numNearPeds; ++i) {
 				CPed *nearPed = m_nearPeds[i];
@@ -7966,7 +7999,13 @@ CPed::LookForInterestingNodes(void)
 	C2dEffect *effect;
 	CMatrix *objMat;
 
+#ifdef PED_PERCEPTION_SCHEDULER
+	// every 8th frame, or if one of the frames since the last scan was
+	if (((CTimer::GetFrameCounter() + (m_randomSeed % 256)) & 7) >= CPedPerception::GetScanFrames(this, PERCEPTION_SCAN_INTERESTING) ||
+		CTimer::GetTimeInMilliseconds() <= m_chatTimer) {
+#else
 	if ((CTimer::GetFrameCounter() + (m_randomSeed % 256)) & 7 || CTimer::GetTimeInMilliseconds() <= m_chatTimer) {
+#endif
 		return false;
 	}
 	bool found = false;
@@ -0,0 +1,317 @@
+#include "common.h"
+
+#ifdef PED_PERCEPTION_SCHEDULER
+#include "PedPerception.h"
+
+#include "Debug.h"
+#include "Ped.h"
+#include "PlayerInfo.h"
+#include "Pools.h"
+#include "Timer.h"
+#include "Vehicle.h"
+
+#define PERCEPTION_CELL_SIZE 30.0f	// the near ped range of CPed::BuildPedLists, so 3x3 cells always cover it
+#define PERCEPTION_HASH_SIZE 256	// power of two
+#define PERCEPTION_MAX_CANDIDATES 48
+#define PERCEPTION_HIGH_DISTANCE 20.0f
+#define PERCEPTION_MEDIUM_DISTANCE 50.0f
+#define PERCEPTION_MAX_SCAN_FRAMES 8	// longest gap a scan makes up for
+
+bool CPedPerception::bEnabled = true;
+bool CPedPerception::bShowStats;
+int32 CPedPerception::MaxScansPerFrame = 32;
+uint32 CPedPerception::ms_nBuiltFrame = 0xFFFFFFFF;
+
+// how many frames between near ped list rebuilds, it used to be 16 for everybody
+static const uint32 aListInterval[NUM_PERCEPTION_PRIORITIES] = { 8, 16, 32 };
+// and between threat and interesting stuff scans, which used to run every frame
+static const uint32 aScanInterval[NUM_PERCEPTION_PRIORITIES] = { 1, 2, 4 };
+
+// by ped pool slot
+CPed *aPerceptionPeds[NUMPEDS];	// what was in the slot when the hash was built
+uint8 aPerceptionPriority[NUMPEDS];
+int16 aPerceptionBucket[NUMPEDS];	// -1 if not hashed
+uint32 aPerceptionLastScan[NUMPEDS][NUM_PERCEPTION_SCANS];
+uint8 aPerceptionGranted[NUMPEDS];	// scans this ped got from this frame's budget, a bit per scan
+uint8 aPerceptionScanFrames[NUMPEDS][NUM_PERCEPTION_SCANS];	// how many frames the last scan stood for
+
+// the hash, peds sorted by bucket
+int16 aPerceptionBucketStart[PERCEPTION_HASH_SIZE + 1];
+CPed *aPerceptionSortedPeds[NUMPEDS];
+
+int32 nPerceptionLists;
+int32 nPerceptionScans[NUM_PERCEPTION_SCANS];
+int32 nPerceptionBudgetUsed;
+int32 nPerceptionDeferred;
+int32 nPerceptionPedsOfPriority[NUM_PERCEPTION_PRIORITIES];
+
+static int32
+GetBucket(int32 cellX, int32 cellY)
+{
+	return (((uint32)cellX * 73856093u) ^ ((uint32)cellY * 19349663u)) & (PERCEPTION_HASH_SIZE - 1);
+}
+
+static uint8
+WorkOutPriority(CPed *ped, CPed *player, const CVector &playerPos)
+{
+	if(ped == player || ped->CharCreatedBy == MISSION_CHAR)
+		return PERCEPTION_HIGH;
+
+	switch(ped->m_nPedState){
+	case PED_FLEE_POS:
+	case PED_FLEE_ENTITY:
+	case PED_ATTACK:
+	case PED_FIGHT:
+	case PED_AIM_GUN:
+		return PERCEPTION_HIGH;
+	default: break;
+	}
+	switch(ped->m_objective){
+	case OBJECTIVE_FLEE_ON_FOOT_TILL_SAFE:
+	case OBJECTIVE_KILL_CHAR_ON_FOOT:
+	case OBJECTIVE_KILL_CHAR_ANY_MEANS:
+	case OBJECTIVE_FLEE_CHAR_ON_FOOT_TILL_SAFE:
+	case OBJECTIVE_FLEE_CHAR_ON_FOOT_ALWAYS:
+	case OBJECTIVE_GUARD_ATTACK:
+		return PERCEPTION_HIGH;
+	default: break;
+	}
+
+	float distSqr = (ped->GetPosition() - playerPos).MagnitudeSqr2D();
+	if(distSqr < sq(PERCEPTION_HIGH_DISTANCE))
+		return PERCEPTION_HIGH;
+	if(distSqr < sq(PERCEPTION_MEDIUM_DISTANCE))
+		return PERCEPTION_MEDIUM;
+	return PERCEPTION_LOW;
+}
+
+// Does what the rebuild in CPed::BuildPedLists does, but only looks at the hash cells around the ped
+static void
+BuildNearPedList(CPed *ped, float cellSize)
+{
+	CPed *candidates[PERCEPTION_MAX_CANDIDATES];
+	float candidateDists[PERCEPTION_MAX_CANDIDATES];	// same distance SortPeds uses
+	int32 numCandidates = 0;
+	int32 deadsRegistered = 0;
+	int32 visitedBuckets[9];
+	int32 numVisited = 0;
+	float range = CPed::nThreatReactionRangeMultiplier * 30.0f;
+	const CVector &pos = ped->GetPosition();
+	int32 cellX = Floor(pos.x / cellSize);
+	int32 cellY = Floor(pos.y / cellSize);
+
+	for(int32 y = cellY - 1; y <= cellY + 1; y++)
+		for(int32 x = cellX - 1; x <= cellX + 1; x++){
+			// with the hash two cells can end up in the same bucket, don't add peds twice
+			int32 bucket = GetBucket(x, y);
+			int32 i;
+			for(i = 0; i < numVisited; i++)
+				if(visitedBuckets[i] == bucket)
+					break;
+			if(i < numVisited)
+				continue;
+			visitedBuckets[numVisited++] = bucket;
+
+			for(i = aPerceptionBucketStart[bucket]; i < aPerceptionBucketStart[bucket + 1]; i++){
+				CPed *other = aPerceptionSortedPeds[i];
+				if(other == ped)
+					continue;
+				if(range <= (other->GetPosition() - pos).Magnitude2D())
+					continue;
+				if(other->m_nPedState == PED_DEAD){
+					if(deadsRegistered > 3)
+						continue;
+					deadsRegistered++;
+				}
+				// in a crowd keep the closest ones, only those can make it into the list
+				float dist = (other->GetPosition() - pos).Magnitude();
+				if(numCandidates < PERCEPTION_MAX_CANDIDATES){
+					candidates[numCandidates] = other;
+					candidateDists[numCandidates] = dist;
+					numCandidates++;
+				}else{
+					int32 furthest = 0;
+					for(int32 j = 1; j < numCandidates; j++)
+						if(candidateDists[j] > candidateDists[furthest])
+							furthest = j;
+					if(dist < candidateDists[furthest]){
+						candidates[furthest] = other;
+						candidateDists[furthest] = dist;
+					}
+				}
+			}
+		}
+
+	ped->SortPeds(candidates, 0, numCandidates - 1);
+	for(ped->m_numNearPeds = 0; ped->m_numNearPeds < ARRAY_SIZE(ped->m_nearPeds) && ped->m_numNearPeds < numCandidates; ped->m_numNearPeds++)
+		ped->m_nearPeds[ped->m_numNearPeds] = candidates[ped->m_numNearPeds];
+	for(int32 i = ped->m_numNearPeds; i < ARRAY_SIZE(ped->m_nearPeds); i++)
+		ped->m_nearPeds[i] = nil;
+}
+
+// Hands this frame's budget out to the medium and low priority peds that are due, the ones
+// that have waited longest first so nobody is starved by where they are in the ped lists
+static void
+GrantScans(int32 poolSize, uint32 frame)
+{
+	int16 due[NUMPEDS];
+	int32 i, j;
+
+	for(int32 scan = 0; scan < NUM_PERCEPTION_SCANS; scan++){
+		int32 numDue = 0;
+		for(i = 0; i < poolSize; i++){
+			if(aPerceptionPeds[i] == nil || aPerceptionPriority[i] == PERCEPTION_HIGH)
+				continue;
+			uint32 age = frame - aPerceptionLastScan[i][scan];
+			if(age < aScanInterval[aPerceptionPriority[i]])
+				continue;
+			// insertion sort, oldest first
+			for(j = numDue; j > 0 && frame - aPerceptionLastScan[due[j-1]][scan] < age; j--)
+				due[j] = due[j-1];
+			due[j] = i;
+			numDue++;
+		}
+		for(i = 0; i < numDue && i < CPedPerception::MaxScansPerFrame; i++)
+			aPerceptionGranted[due[i]] |= 1 << scan;
+	}
+}
+
+// Called by CWorld::Process before the moving entities are processed
+void
+CPedPerception::Build(void)
+{
+	int32 i;
+
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "PERCEPTION H/M/L %d/%d/%d LISTS %d THREAT SCANS %d INTEREST SCANS %d DEFERRED %d",
+			nPerceptionPedsOfPriority[PERCEPTION_HIGH], nPerceptionPedsOfPriority[PERCEPTION_MEDIUM], nPerceptionPedsOfPriority[PERCEPTION_LOW],
+			nPerceptionLists, nPerceptionScans[PERCEPTION_SCAN_THREATS], nPerceptionScans[PERCEPTION_SCAN_INTERESTING], nPerceptionDeferred);
+		CDebug::PrintAt(str, 2, 27);
+	}
+	nPerceptionLists = 0;
+	nPerceptionScans[PERCEPTION_SCAN_THREATS] = 0;
+	nPerceptionScans[PERCEPTION_SCAN_INTERESTING] = 0;
+	nPerceptionBudgetUsed = 0;
+	nPerceptionDeferred = 0;
+	nPerceptionPedsOfPriority[PERCEPTION_HIGH] = 0;
+	nPerceptionPedsOfPriority[PERCEPTION_MEDIUM] = 0;
+	nPerceptionPedsOfPriority[PERCEPTION_LOW] = 0;
+
+	if(!bEnabled)
+		return;
+
+	uint32 frame = CTimer::GetFrameCounter();
+	float cellSize = PERCEPTION_CELL_SIZE * CPed::nThreatReactionRangeMultiplier;
+	CPed *player = FindPlayerPed();
+	CVector playerPos = FindPlayerCoors();
+	CPedPool *pool = CPools::GetPedPool();
+	int32 poolSize = pool->GetSize();
+	assert(poolSize <= NUMPEDS);
+
+	// Count the peds in every bucket...
+	for(i = 0; i <= PERCEPTION_HASH_SIZE; i++)
+		aPerceptionBucketStart[i] = 0;
+	for(i = 0; i < poolSize; i++){
+		CPed *ped = pool->GetSlot(i);
+		if(ped != aPerceptionPeds[i]){
+			// new ped in the slot, don't go by when the last one scanned
+			aPerceptionLastScan[i][PERCEPTION_SCAN_THREATS] = frame;
+			aPerceptionLastScan[i][PERCEPTION_SCAN_INTERESTING] = frame;
+		}
+		aPerceptionPeds[i] = ped;
+		aPerceptionBucket[i] = -1;
+		aPerceptionGranted[i] = 0;
+		if(ped == nil)
+			continue;
+		aPerceptionPriority[i] = WorkOutPriority(ped, player, playerPos);
+		nPerceptionPedsOfPriority[aPerceptionPriority[i]]++;
+		// same peds the sector walk would have picked
+		if(ped->bInVehicle && !(ped->m_pMyVehicle && ped->m_pMyVehicle->IsBike()))
+			continue;
+		aPerceptionBucket[i] = GetBucket(Floor(ped->GetPosition().x / cellSize), Floor(ped->GetPosition().y / cellSize));
+		aPerceptionBucketStart[aPerceptionBucket[i] + 1]++;
+	}
+	// ...turn the counts into where each bucket starts...
+	for(i = 0; i < PERCEPTION_HASH_SIZE; i++)
+		aPerceptionBucketStart[i + 1] += aPerceptionBucketStart[i];
+	// ...and put them in place
+	int16 fill[PERCEPTION_HASH_SIZE];
+	for(i = 0; i < PERCEPTION_HASH_SIZE; i++)
+		fill[i] = aPerceptionBucketStart[i];
+	for(i = 0; i < poolSize; i++)
+		if(aPerceptionBucket[i] >= 0)
+			aPerceptionSortedPeds[fill[aPerceptionBucket[i]]++] = aPerceptionPeds[i];
+
+	GrantScans(poolSize, frame);
+
+	for(i = 0; i < poolSize; i++){
+		CPed *ped = aPerceptionPeds[i];
+		if(ped == nil)
+			continue;
+		if((frame + ped->m_randomSeed) % aListInterval[aPerceptionPriority[i]] != 0)
+			continue;
+		BuildNearPedList(ped, cellSize);
+		nPerceptionLists++;
+	}
+
+	ms_nBuiltFrame = frame;
+}
+
+// The near ped lists for this frame were built here, CPed::BuildPedLists only has to prune them
+bool
+CPedPerception::IsActive(void)
+{
+	return bEnabled && ms_nBuiltFrame == CTimer::GetFrameCounter();
+}
+
+ePerceptionPriority
+CPedPerception::GetPriority(CPed *ped)
+{
+	if(!IsActive())
+		return PERCEPTION_HIGH;
+	int32 i = CPools::GetPedPool()->GetJustIndex(ped);
+	if(aPerceptionPeds[i] != ped)
+		return PERCEPTION_HIGH;	// new this frame
+	return (ePerceptionPriority)aPerceptionPriority[i];
+}
+
+bool
+CPedPerception::ShouldScan(CPed *ped, ePerceptionScan scan)
+{
+	if(!IsActive())
+		return true;
+
+	int32 i = CPools::GetPedPool()->GetJustIndex(ped);
+	ePerceptionPriority priority = GetPriority(ped);
+	uint32 frame = CTimer::GetFrameCounter();
+	if(priority != PERCEPTION_HIGH){
+		if(frame - aPerceptionLastScan[i][scan] < aScanInterval[priority])
+			return false;
+		// didn't get any of the budget, it'll be older and further up next frame
+		if(!(aPerceptionGranted[i] & (1 << scan))){
+			nPerceptionDeferred++;
+			return false;
+		}
+		nPerceptionBudgetUsed++;
+	}
+	aPerceptionScanFrames[i][scan] = clamp(frame - aPerceptionLastScan[i][scan], 1u, (uint32)PERCEPTION_MAX_SCAN_FRAMES);
+	aPerceptionLastScan[i][scan] = frame;
+	nPerceptionScans[scan]++;
+	return true;
+}
+
+// How many frames the scan ShouldScan just allowed stands for, 1 when it runs every frame.
+// Scans that roll dice every frame use this to keep their chances per frame the same.
+int32
+CPedPerception::GetScanFrames(CPed *ped, ePerceptionScan scan)
+{
+	if(!IsActive())
+		return 1;
+	int32 i = CPools::GetPedPool()->GetJustIndex(ped);
+	if(aPerceptionPeds[i] != ped)
+		return 1;
+	return aPerceptionScanFrames[i][scan];
+}
+
+#endif
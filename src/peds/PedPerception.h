@@ -0,0 +1,47 @@
+#pragma once
+
+#ifdef PED_PERCEPTION_SCHEDULER
+
+class CPed;
+
+/*
+Peds used to look for other peds on their own: every 16 frames each ped walked the world
+sectors around it to rebuild its near ped list, and every frame it scanned that list for threats
+and things to look at. Now once per frame, before the peds get their ProcessControl, all peds are
+put into a spatial hash in one pass and the near ped lists that are due are built from it.
+Every ped also gets a priority from its distance to the player and whether it's fighting or
+fleeing. Close and busy peds rebuild their lists and scan every frame as before (or more often),
+the ones further away less often, and there's a budget for how many low priority scans run a frame,
+given to the peds that have waited longest.
+*/
+enum ePerceptionPriority
+{
+	PERCEPTION_HIGH,
+	PERCEPTION_MEDIUM,
+	PERCEPTION_LOW,
+	NUM_PERCEPTION_PRIORITIES
+};
+
+enum ePerceptionScan
+{
+	PERCEPTION_SCAN_THREATS,
+	PERCEPTION_SCAN_INTERESTING,
+	NUM_PERCEPTION_SCANS
+};
+
+class CPedPerception
+{
+	static uint32 ms_nBuiltFrame;
+public:
+	static bool bEnabled;
+	static bool bShowStats;
+	static int32 MaxScansPerFrame;
+
+	static void Build(void);
+	static bool IsActive(void);
+	static bool ShouldScan(CPed *ped, ePerceptionScan scan);
+	static ePerceptionPriority GetPriority(CPed *ped);
+	static int32 GetScanFrames(CPed *ped, ePerceptionScan scan);
+};
+
+#endif
@@ -28,6 +28,7 @@
 #include "Streaming.h"
 #include "Clock.h"
 #include "WaterLevel.h"
+#include "Crowd.h"
 
 // --MIAMI: File done
 
@@ -102,6 +103,9 @@ CPopulation::Initialise()
 	m_AllRandomPedsThisType = -1;
 	PedDensityMultiplier = 1.0f;
 	
+#ifdef PED_CROWD
+	CCrowd::Init();
+#endif
 
 	LoadPedGroups();
 
@@ -377,6 +381,9 @@ CPopulation::Update(bool addPeds)
 			ms_nTotalPeds = ms_nNumDummy + ms_nNumEmergency + ms_nNumCop
 				+ ms_nTotalGangPeds + ms_nNumCivFemale + ms_nNumCivMale;
 			ms_nTotalPeds -= ms_nTotalCarPassengerPeds;
+#ifdef PED_CROWD
+			CCrowd::Update();
+#endif
 			if (!CCutsceneMgr::IsRunning() && addPeds) {
 				float pcdm = PedCreationDistMultiplier();
 				AddToPopulation(pcdm * (MIN_CREATION_DIST * TheCamera.GenerationDistMultiplier),
@@ -1090,6 +1097,9 @@ CPopulation::ManagePopulation(void)
 				ped->bFadeOut = true;
 
 			if (ped->bFadeOut && CVisibilityPlugins::GetClumpAlpha(ped->GetClump()) == 0) {
+#ifdef PED_CROWD
+				CCrowd::StorePed(ped);
+#endif
 				RemovePed(ped);
 				continue;
 			}
@@ -1151,8 +1161,12 @@ CPopulation::ManagePopulation(void)
 			}
 			if (ped->GetIsOnScreen())
 				ped->bFadeOut = true;
-			else
+			else {
+#ifdef PED_CROWD
+				CCrowd::StorePed(ped);
+#endif
 				RemovePed(ped);
+			}
 		}
 	}
 }
@@ -17,6 +17,9 @@
 #include "Shadows.h"
 #include "Clock.h"
 #include "Bridge.h"
+#ifdef CORONA_BATCHING
+#include "Debug.h"
+#endif
 
 //--MIAMI: file done
 
@@ -65,7 +68,50 @@ int CCoronas::MoonSize;
 bool CCoronas::SunBlockedByClouds;
 int CCoronas::bChangeBrightnessImmediately;
 
-CRegisteredCorona CCoronas::aCoronas[NUMCORONAS];
+CRegisteredCorona CCoronas::aCoronas[MAX_CORONAS];
+
+#ifdef CORONA_BATCHING
+#define CORONA_HASH_BITS 9
+#define CORONA_HASH_SIZE (1<<CORONA_HASH_BITS)	// at least twice MAX_CORONAS
+#define CORONA_LOS_INTERVAL 4	// frames between the line of sight checks of a corona
+#define MAX_CORONA_SPRITES (MAX_CORONAS*2)
+#define MAX_CORONA_BATCHES 32
+
+bool CCoronas::bBatchRender = true;
+bool CCoronas::bStaggerLOSChecks = true;
+bool CCoronas::bShowStats;
+
+// Slots by id, open addressing. Entries aren't removed when a corona goes away,
+// so the id in the slot has to be checked. Rebuilt every frame in Update.
+int16 aCoronaHash[CORONA_HASH_SIZE];	// slot+1, 0 is empty
+int32 NumCoronaHashEntries;
+
+// What Render draws when batching, collected and then drawn one batch per z test and texture
+struct tCoronaSprite
+{
+	float x, y, z;
+	float w, h;
+	float recipz;
+	float rotation;
+	int16 intens;
+	uint8 r, g, b;
+	uint8 a;
+	bool bRotate;
+	uint8 nBatch;
+};
+tCoronaSprite aCoronaSprites[MAX_CORONA_SPRITES];
+int32 NumCoronaSprites;
+RwRaster *aCoronaBatchRasters[MAX_CORONA_BATCHES];
+bool aCoronaBatchZTest[MAX_CORONA_BATCHES];
+int32 NumCoronaBatches;
+RwRaster *pCoronaRaster;
+bool bCoronaZTest;
+
+int32 nCoronasActive;
+int32 nCoronaSpritesDrawn;
+int32 nCoronaBatchesDrawn;
+int32 nCoronaLOSChecks;
+#endif
 
 const char aCoronaSpriteNames[][32] = {
 	"coronastar",
@@ -93,8 +139,11 @@ CCoronas::Init(void)
 
 	CTxdStore::PopCurrentTxd();
 
-	for(i = 0; i < NUMCORONAS; i++)
+	for(i = 0; i < MAX_CORONAS; i++)
 		aCoronas[i].id = 0;
+#ifdef CORONA_BATCHING
+	RebuildHash();
+#endif
 }
 
 void
@@ -129,11 +178,82 @@ CCoronas::Update(void)
 		bChangeBrightnessImmediately = Max(bChangeBrightnessImmediately-1, 0);
 	LastCamLook = CamLook;
 
-	for(i = 0; i < NUMCORONAS; i++)
-		if(aCoronas[i].id != 0)
+#ifdef CORONA_BATCHING
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "CORONAS %d SPRITES %d BATCHES %d LOS CHECKS %d",
+			nCoronasActive, nCoronaSpritesDrawn, nCoronaBatchesDrawn, nCoronaLOSChecks);
+		CDebug::PrintAt(str, 2, 36);
+	}
+	nCoronasActive = 0;
+	nCoronaSpritesDrawn = 0;
+	nCoronaBatchesDrawn = 0;
+	nCoronaLOSChecks = 0;
+#endif
+
+	for(i = 0; i < MAX_CORONAS; i++)
+		if(aCoronas[i].id != 0){
+#ifdef CORONA_BATCHING
+			// coronas take turns doing the expensive check, new ones do it right away.
+			// it only fades the corona in and out, so being a few frames late doesn't show
+			if(bStaggerLOSChecks && aCoronas[i].LOScheck &&
+			   (aCoronas[i].firstUpdate || (CTimer::GetFrameCounter() + i) % CORONA_LOS_INTERVAL == 0)){
+				aCoronas[i].LOSblocked = !CWorld::GetIsLineOfSightClear(aCoronas[i].coors, TheCamera.GetPosition(), true, false, false, false, false, false);
+				nCoronaLOSChecks++;
+			}
+			nCoronasActive++;
+#endif
 			aCoronas[i].Update();
+		}
+
+#ifdef CORONA_BATCHING
+	RebuildHash();
+#endif
+}
+
+#ifdef CORONA_BATCHING
+static uint32
+GetCoronaHashBucket(uint32 id)
+{
+	return (id * 2654435761u) >> (32 - CORONA_HASH_BITS);
+}
+
+int32
+CCoronas::FindCorona(uint32 id)
+{
+	for(uint32 h = GetCoronaHashBucket(id); aCoronaHash[h] != 0; h = (h+1) & (CORONA_HASH_SIZE-1))
+		if(aCoronas[aCoronaHash[h]-1].id == id)
+			return aCoronaHash[h]-1;
+	return -1;
 }
 
+void
+CCoronas::AddToHash(int32 slot)
+{
+	// too many stale entries, throw them out. this adds the new slot too
+	if(NumCoronaHashEntries >= CORONA_HASH_SIZE*3/4){
+		RebuildHash();
+		return;
+	}
+	uint32 h;
+	for(h = GetCoronaHashBucket(aCoronas[slot].id); aCoronaHash[h] != 0; h = (h+1) & (CORONA_HASH_SIZE-1));
+	aCoronaHash[h] = slot+1;
+	NumCoronaHashEntries++;
+}
+
+void
+CCoronas::RebuildHash(void)
+{
+	int32 i;
+	for(i = 0; i < CORONA_HASH_SIZE; i++)
+		aCoronaHash[i] = 0;
+	NumCoronaHashEntries = 0;
+	for(i = 0; i < MAX_CORONAS; i++)
+		if(aCoronas[i].id != 0)
+			AddToHash(i);
+}
+#endif
+
 void
 CCoronas::RegisterCorona(uint32 id, uint8 red, uint8 green, uint8 blue, uint8 alpha,
 	const CVector &coors, float size, float drawDist, RwTexture *tex,
@@ -153,19 +273,30 @@ CCoronas::RegisterCorona(uint32 id, uint8 red, uint8 green, uint8 blue, uint8 al
 			alpha *= (dist - 35.0f)/(50.0f - 35.0f);
 	}
 
-	for(i = 0; i < NUMCORONAS; i++)
+#ifdef CORONA_BATCHING
+	bool bNew = false;
+	i = FindCorona(id);
+	if(i < 0)
+		i = MAX_CORONAS;
+#else
+	for(i = 0; i < MAX_CORONAS; i++)
 		if(aCoronas[i].id == id)
 			break;
+#endif
 
-	if(i == NUMCORONAS){
+	if(i == MAX_CORONAS){
 		// add a new one
 
 		// find empty slot
-		for(i = 0; i < NUMCORONAS; i++)
+		for(i = 0; i < MAX_CORONAS; i++)
 			if(aCoronas[i].id == 0)
 				break;
-		if(i == NUMCORONAS)
+		if(i == MAX_CORONAS)
 			return;		// no space
+#ifdef CORONA_BATCHING
+		bNew = true;
+		aCoronas[i].LOSblocked = false;
+#endif
 
 		aCoronas[i].fadeAlpha = 0;
 		aCoronas[i].offScreen = true;
@@ -207,6 +338,10 @@ CCoronas::RegisterCorona(uint32 id, uint8 red, uint8 green, uint8 blue, uint8 al
 	aCoronas[i].drawStreak = drawStreak;
 	aCoronas[i].useNearDist = useNearDist;
 	aCoronas[i].nearDist = nearDist;
+#ifdef CORONA_BATCHING
+	if(bNew)
+		AddToHash(i);
+#endif
 }
 
 void
@@ -228,12 +363,18 @@ CCoronas::UpdateCoronaCoors(uint32 id, const CVector &coors, float drawDist, flo
 	if(sq(drawDist) < (TheCamera.GetPosition() - coors).MagnitudeSqr2D())
 		return;
 
-	for(i = 0; i < NUMCORONAS; i++)
+#ifdef CORONA_BATCHING
+	i = FindCorona(id);
+	if(i < 0)
+		return;
+#else
+	for(i = 0; i < MAX_CORONAS; i++)
 		if(aCoronas[i].id == id)
 			break;
 
-	if(i == NUMCORONAS)
+	if(i == MAX_CORONAS)
 		return;
+#endif
 
 	if(aCoronas[i].fadeAlpha == 0)
 		aCoronas[i].id = 0;	// faded out, remove
@@ -245,6 +386,163 @@ CCoronas::UpdateCoronaCoors(uint32 id, const CVector &coors, float drawDist, flo
 
 static RwIm2DVertex vertexbufferX[2];
 
+#ifdef CORONA_BATCHING
+// Coronas and flares are all added with z writes off, so the order they're drawn in doesn't matter.
+// These take the place of the state changes and sprite calls in Render and collect them.
+static void
+SetCoronaZTest(bool zTest)
+{
+	if(CCoronas::bBatchRender)
+		bCoronaZTest = zTest;
+	else
+		RwRenderStateSet(rwRENDERSTATEZTESTENABLE, zTest ? (void*)TRUE : (void*)FALSE);
+}
+
+static void
+SetCoronaRaster(RwRaster *raster)
+{
+	if(CCoronas::bBatchRender)
+		pCoronaRaster = raster;
+	else
+		RwRenderStateSet(rwRENDERSTATETEXTURERASTER, raster);
+}
+
+static tCoronaSprite*
+AddCoronaSprite(void)
+{
+	int32 i;
+	if(NumCoronaSprites >= MAX_CORONA_SPRITES)
+		return nil;
+	for(i = 0; i < NumCoronaBatches; i++)
+		if(aCoronaBatchRasters[i] == pCoronaRaster && aCoronaBatchZTest[i] == bCoronaZTest)
+			break;
+	if(i == NumCoronaBatches){
+		if(NumCoronaBatches >= MAX_CORONA_BATCHES)
+			return nil;
+		aCoronaBatchRasters[i] = pCoronaRaster;
+		aCoronaBatchZTest[i] = bCoronaZTest;
+		NumCoronaBatches++;
+	}
+	tCoronaSprite *sprite = &aCoronaSprites[NumCoronaSprites++];
+	sprite->nBatch = i;
+	return sprite;
+}
+
+static void
+RenderCoronaSprite(float x, float y, float z, float w, float h, uint8 r, uint8 g, uint8 b, int16 intens, float recipz, uint8 a)
+{
+	if(!CCoronas::bBatchRender){
+		CSprite::RenderOneXLUSprite(x, y, z, w, h, r, g, b, intens, recipz, a);
+		return;
+	}
+	tCoronaSprite *sprite = AddCoronaSprite();
+	if(sprite == nil){
+		// no more room, draw it now
+		RwRenderStateSet(rwRENDERSTATEZTESTENABLE, bCoronaZTest ? (void*)TRUE : (void*)FALSE);
+		RwRenderStateSet(rwRENDERSTATETEXTURERASTER, pCoronaRaster);
+		CSprite::RenderOneXLUSprite(x, y, z, w, h, r, g, b, intens, recipz, a);
+		return;
+	}
+	sprite->x = x;
+	sprite->y = y;
+	sprite->z = z;
+	sprite->w = w;
+	sprite->h = h;
+	sprite->r = r;
+	sprite->g = g;
+	sprite->b = b;
+	sprite->intens = intens;
+	sprite->recipz = recipz;
+	sprite->rotation = 0.0f;
+	sprite->a = a;
+	sprite->bRotate = false;
+}
+
+static void
+RenderCoronaSprite_Rotate_Aspect(float x, float y, float z, float w, float h, uint8 r, uint8 g, uint8 b, int16 intens, float recipz, float rotation, uint8 a)
+{
+	if(!CCoronas::bBatchRender){
+		CSprite::RenderOneXLUSprite_Rotate_Aspect(x, y, z, w, h, r, g, b, intens, recipz, rotation, a);
+		return;
+	}
+	// the unbuffered version fades out when too near, the buffered one doesn't
+	if(z < 1.3f)
+		return;
+	tCoronaSprite *sprite = AddCoronaSprite();
+	if(sprite == nil){
+		RwRenderStateSet(rwRENDERSTATEZTESTENABLE, bCoronaZTest ? (void*)TRUE : (void*)FALSE);
+		RwRenderStateSet(rwRENDERSTATETEXTURERASTER, pCoronaRaster);
+		CSprite::RenderOneXLUSprite_Rotate_Aspect(x, y, z, w, h, r, g, b, intens, recipz, rotation, a);
+		return;
+	}
+	if(z < 2.3f){
+		int f = (z - 1.3f)/(2.3f-1.3f) * 255;
+		r = f*r >> 8;
+		g = f*g >> 8;
+		b = f*b >> 8;
+		intens = f*intens >> 8;
+	}
+	sprite->x = x;
+	sprite->y = y;
+	sprite->z = z;
+	sprite->w = w;
+	sprite->h = h;
+	sprite->r = r;
+	sprite->g = g;
+	sprite->b = b;
+	sprite->intens = intens;
+	sprite->recipz = recipz;
+	sprite->rotation = rotation;
+	sprite->a = a;
+	sprite->bRotate = true;
+}
+
+static void
+FlushCoronaSprites(void)
+{
+	int32 i, j;
+	int16 aBatchStart[MAX_CORONA_BATCHES + 1];
+	int16 fill[MAX_CORONA_BATCHES];
+	static int16 aSorted[MAX_CORONA_SPRITES];
+
+	// sort by batch, counts first...
+	for(i = 0; i <= NumCoronaBatches; i++)
+		aBatchStart[i] = 0;
+	for(i = 0; i < NumCoronaSprites; i++)
+		aBatchStart[aCoronaSprites[i].nBatch + 1]++;
+	for(i = 0; i < NumCoronaBatches; i++){
+		aBatchStart[i + 1] += aBatchStart[i];
+		fill[i] = aBatchStart[i];
+	}
+	// ...then put them in place
+	for(i = 0; i < NumCoronaSprites; i++)
+		aSorted[fill[aCoronaSprites[i].nBatch]++] = i;
+
+	for(i = 0; i < NumCoronaBatches; i++){
+		if(aBatchStart[i] == aBatchStart[i + 1])
+			continue;
+		RwRenderStateSet(rwRENDERSTATEZTESTENABLE, aCoronaBatchZTest[i] ? (void*)TRUE : (void*)FALSE);
+		RwRenderStateSet(rwRENDERSTATETEXTURERASTER, aCoronaBatchRasters[i]);
+		CSprite::InitSpriteBuffer();
+		for(j = aBatchStart[i]; j < aBatchStart[i + 1]; j++){
+			tCoronaSprite &sprite = aCoronaSprites[aSorted[j]];
+			if(sprite.bRotate)
+				CSprite::RenderBufferedOneXLUSprite_Rotate_Aspect(sprite.x, sprite.y, sprite.z, sprite.w, sprite.h,
+					sprite.r, sprite.g, sprite.b, sprite.intens, sprite.recipz, sprite.rotation, sprite.a);
+			else
+				CSprite::RenderBufferedOneXLUSprite(sprite.x, sprite.y, sprite.z, sprite.w, sprite.h,
+					sprite.r, sprite.g, sprite.b, sprite.intens, sprite.recipz, sprite.a);
+		}
+		CSprite::FlushSpriteBuffer();
+		nCoronaBatchesDrawn++;
+	}
+	nCoronaSpritesDrawn += NumCoronaSprites;
+
+	NumCoronaSprites = 0;
+	NumCoronaBatches = 0;
+}
+#endif
+
 void
 CCoronas::Render(void)
 {
@@ -259,7 +557,7 @@ CCoronas::Render(void)
 	RwRenderStateSet(rwRENDERSTATESRCBLEND, (void*)rwBLENDONE);
 	RwRenderStateSet(rwRENDERSTATEDESTBLEND, (void*)rwBLENDONE);
 
-	for(i = 0; i < NUMCORONAS; i++){
+	for(i = 0; i < MAX_CORONAS; i++){
 		for(j = 5; j > 0; j--){
 			aCoronas[i].prevX[j] = aCoronas[i].prevX[j-1];
 			aCoronas[i].prevY[j] = aCoronas[i].prevY[j-1];
@@ -319,17 +617,25 @@ CCoronas::Render(void)
 				float distanceFade = spriteCoors.z < fadeDistance ? 1.0f : 1.0f - (spriteCoors.z - fadeDistance)/fadeDistance;
 				int totalFade = aCoronas[i].fadeAlpha * distanceFade;
 
+#ifdef CORONA_BATCHING
+				SetCoronaZTest(!aCoronas[i].LOScheck);
+#else
 				if(aCoronas[i].LOScheck)
 					RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)FALSE);
 				else
 					RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)TRUE);
+#endif
 
 				// render corona itself
 				if(aCoronas[i].texture){
 					float fogscale = CWeather::Foggyness*Min(spriteCoors.z, 40.0f)/40.0f + 1.0f;
 					if(CCoronas::aCoronas[i].id == SUN_CORE)
 						spriteCoors.z = 0.95f * RwCameraGetFarClipPlane(Scene.camera);
+#ifdef CORONA_BATCHING
+					SetCoronaRaster(RwTextureGetRaster(aCoronas[i].texture));
+#else
 					RwRenderStateSet(rwRENDERSTATETEXTURERASTER, RwTextureGetRaster(aCoronas[i].texture));
+#endif
 					spriteCoors.z -= aCoronas[i].nearDist;
 
 					if(aCoronas[i].texture == gpCoronaTexture[8]){
@@ -339,7 +645,11 @@ CCoronas::Render(void)
 						float hscale = 0.35f - (wscale - 0.5f) * 0.06f;
 						hscale = Max(hscale, 0.15f);
 
+#ifdef CORONA_BATCHING
+						RenderCoronaSprite(spriteCoors.x, spriteCoors.y, spriteCoors.z,
+#else
 						CSprite::RenderOneXLUSprite(spriteCoors.x, spriteCoors.y, spriteCoors.z,
+#endif
 							spritew * aCoronas[i].size * wscale,
 							spriteh * aCoronas[i].size * fogscale * hscale,
 							CCoronas::aCoronas[i].red / fogscale,
@@ -349,7 +659,11 @@ CCoronas::Render(void)
 							recipz,
 							255);
 					}else{
+#ifdef CORONA_BATCHING
+						RenderCoronaSprite_Rotate_Aspect(
+#else
 						CSprite::RenderOneXLUSprite_Rotate_Aspect(
+#endif
 							spriteCoors.x, spriteCoors.y, spriteCoors.z,
 							spritew * aCoronas[i].size * fogscale,
 							spriteh * aCoronas[i].size * fogscale,
@@ -374,8 +688,13 @@ CCoronas::Render(void)
 					}
 
 					for(; flare->texture; flare++){
+#ifdef CORONA_BATCHING
+						SetCoronaRaster(RwTextureGetRaster(gpCoronaTexture[flare->texture + 4]));
+						RenderCoronaSprite(
+#else
 						RwRenderStateSet(rwRENDERSTATETEXTURERASTER, RwTextureGetRaster(gpCoronaTexture[flare->texture + 4]));
 						CSprite::RenderOneXLUSprite(
+#endif
 							(spriteCoors.x - (screenw/2)) * flare->position + (screenw/2),
 							(spriteCoors.y - (screenh/2)) * flare->position + (screenh/2),
 							spriteCoors.z,
@@ -392,6 +711,10 @@ CCoronas::Render(void)
 		}
 	}
 
+#ifdef CORONA_BATCHING
+	FlushCoronaSprites();
+#endif
+
 	RwRenderStateSet(rwRENDERSTATEZWRITEENABLE, (void*)FALSE);
 	RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)FALSE);
 	RwRenderStateSet(rwRENDERSTATEVERTEXALPHAENABLE, (void*)TRUE);
@@ -400,7 +723,7 @@ CCoronas::Render(void)
 	RwRenderStateSet(rwRENDERSTATETEXTURERASTER, nil);
 
 	// streaks
-	for(i = 0; i < NUMCORONAS; i++){
+	for(i = 0; i < MAX_CORONAS; i++){
 		if(aCoronas[i].id == 0 || !aCoronas[i].drawStreak)
 			continue;
 
@@ -454,7 +777,7 @@ CCoronas::RenderReflections(void)
 		RwRenderStateSet(rwRENDERSTATEDESTBLEND, (void*)rwBLENDONE);
 		RwRenderStateSet(rwRENDERSTATETEXTURERASTER, RwTextureGetRaster(gpCoronaTexture[3]));
 
-		for(i = 0; i < NUMCORONAS; i++){
+		for(i = 0; i < MAX_CORONAS; i++){
 			if(aCoronas[i].id == 0 ||
 			   aCoronas[i].fadeAlpha == 0 && aCoronas[i].alpha == 0 ||
 			   aCoronas[i].reflection == 0)
@@ -466,6 +789,11 @@ CCoronas::RenderReflections(void)
 				   CWorld::ProcessVerticalLine(aCoronas[i].coors, -1000.0f, point, entity, true, false, false, false, true, false, nil))
 					aCoronas[i].heightAboveRoad = aCoronas[i].coors.z - point.point.z;
 			}else{
+#ifdef CORONA_BATCHING
+				// no ground found yet, don't try every frame
+				if(bStaggerLOSChecks && (CTimer::GetFrameCounter() + i) % CORONA_LOS_INTERVAL != 0)
+					continue;
+#endif
 				if(CWorld::ProcessVerticalLine(aCoronas[i].coors, -1000.0f, point, entity, true, false, false, false, true, false, nil)){
 					aCoronas[i].heightAboveRoad = aCoronas[i].coors.z - point.point.z;
 					aCoronas[i].renderReflection = true;
@@ -520,7 +848,7 @@ CCoronas::RenderReflections(void)
 		RwRenderStateSet(rwRENDERSTATEZWRITEENABLE, (void*)TRUE);
 		RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)TRUE);
 	}else{
-		for(i = 0; i < NUMCORONAS; i++)
+		for(i = 0; i < MAX_CORONAS; i++)
 			aCoronas[i].renderReflection = false;
 	}
 }
@@ -689,9 +1017,17 @@ CRegisteredCorona::Update(void)
 	if(!registeredThisFrame)
 		alpha = 0;
 
+#ifdef CORONA_BATCHING
+	// with staggered checks CCoronas::Update has done the test, maybe a few frames ago
+	bool blocked = LOScheck &&
+	   (CCoronas::SunBlockedByClouds && id == CCoronas::SUN_CORONA ||
+	    (CCoronas::bStaggerLOSChecks ? LOSblocked : !CWorld::GetIsLineOfSightClear(coors, TheCamera.GetPosition(), true, false, false, false, false, false)));
+	if(blocked){
+#else
 	if(LOScheck &&
 	   (CCoronas::SunBlockedByClouds && id == CCoronas::SUN_CORONA ||
 	    !CWorld::GetIsLineOfSightClear(coors, TheCamera.GetPosition(), true, false, false, false, false, false))){
+#endif
 		// Corona is blocked, fade out
 		fadeAlpha = Max(fadeAlpha - 15.0f*CTimer::GetTimeStep(), 0.0f);
 	}else if(offScreen){
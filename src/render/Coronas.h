@@ -1,5 +1,12 @@
 #pragma once
 
+#ifdef CORONA_BATCHING
+// registering is a hash lookup and drawing is batched, so there can be many more coronas
+#define MAX_CORONAS 256
+#else
+#define MAX_CORONAS NUMCORONAS
+#endif
+
 extern RwTexture *gpCoronaTexture[9];
 
 struct CRegisteredCorona
@@ -29,6 +36,9 @@ struct CRegisteredCorona
 	uint8 sightClear : 1;
 	uint8 useNearDist : 1;
 	uint8 renderReflection : 1;
+#ifdef CORONA_BATCHING
+	uint8 LOSblocked : 1;	// result of the last staggered line of sight check
+#endif
 
 	int16 prevX[6];
 	int16 prevY[6];
@@ -44,7 +54,12 @@ VALIDATE_SIZE(CRegisteredCorona, 0x68);
 
 class CCoronas
 {
-	static CRegisteredCorona aCoronas[NUMCORONAS];
+	static CRegisteredCorona aCoronas[MAX_CORONAS];
+#ifdef CORONA_BATCHING
+	static int32 FindCorona(uint32 id);
+	static void AddToHash(int32 slot);
+	static void RebuildHash(void);
+#endif
 public:
 	enum {
 		SUN_CORE = 1,
@@ -85,6 +100,11 @@ public:
 	static int MoonSize;
 	static bool SunBlockedByClouds;
 	static int bChangeBrightnessImmediately;
+#ifdef CORONA_BATCHING
+	static bool bBatchRender;
+	static bool bStaggerLOSChecks;
+	static bool bShowStats;
+#endif
 
 	static void Init(void);
 	static void Shutdown(void);
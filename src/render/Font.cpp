@@ -7,6 +7,9 @@
 #include "FileMgr.h"
 #endif
 #include "Timer.h"
+#ifdef FONT_BATCHING
+#include "Debug.h"
+#endif
 
 void
 AsciiToUnicode(const char *src, wchar *dst)
@@ -225,7 +228,42 @@ union tFontRenderStatePointer
 };
 
 tFontRenderStatePointer FontRenderStatePointer;
+#ifdef FONT_BATCHING
+// Every style has its own buffer, FontRenderStateBuf and FontRenderStatePointer are the one
+// of the current style and the others wait in aFontRenderStatePointers. All of them are
+// only drawn in DrawFonts, or when one is full.
+#define FONT_BUFFER_SIZE 4096
+uint8 aFontRenderStateBufs[MAX_FONTS][FONT_BUFFER_SIZE];
+tFontRenderStatePointer aFontRenderStatePointers[MAX_FONTS];
+uint8 *FontRenderStateBuf = aFontRenderStateBufs[0];
+int16 FontRenderStateBufStyle;
+
+bool CFont::bBatchFonts = true;
+bool CFont::bShowStats;
+int32 nFontDraws;
+int32 nFontDrawsSaved;	// style switches that didn't have to draw
+
+static void
+SelectFontBuffer(int16 style)
+{
+	if (style < 0 || style == FontRenderStateBufStyle)
+		return;
+	aFontRenderStatePointers[FontRenderStateBufStyle] = FontRenderStatePointer;
+	FontRenderStateBufStyle = style;
+	FontRenderStateBuf = aFontRenderStateBufs[style];
+	FontRenderStatePointer = aFontRenderStatePointers[style];
+}
+
+static bool
+IsFontBufferEmpty(int16 style)
+{
+	if (style == FontRenderStateBufStyle)
+		return FontRenderStatePointer.pRenderState == (CFontRenderState*)FontRenderStateBuf;
+	return aFontRenderStatePointers[style].pRenderState == (CFontRenderState*)aFontRenderStateBufs[style];
+}
+#else
 uint8 FontRenderStateBuf[1024];
+#endif
 
 #ifdef BUTTON_ICONS
 CSprite2d CFont::ButtonSprite[MAX_BUTTON_ICONS];
@@ -388,6 +426,19 @@ CFont::InitPerFrame(void)
 {
 	RenderState.style = -1;
 	Details.anonymous_25 = 0;
+#ifdef FONT_BATCHING
+	if (bShowStats) {
+		char str[128];
+		sprintf(str, "FONT DRAWS %d, %d WITHOUT BATCHING", nFontDraws, nFontDraws + nFontDrawsSaved);
+		CDebug::PrintAt(str, 2, 37);
+	}
+	nFontDraws = 0;
+	nFontDrawsSaved = 0;
+	for (int16 i = 0; i < MAX_FONTS; i++)
+		aFontRenderStatePointers[i].pRenderState = (CFontRenderState*)aFontRenderStateBufs[i];
+	FontRenderStateBufStyle = 0;
+	FontRenderStateBuf = aFontRenderStateBufs[0];
+#endif
 	FontRenderStatePointer.pRenderState = (CFontRenderState*)FontRenderStateBuf;
 	SetDropShadowPosition(0);
 	NewLine = 0;
@@ -943,7 +994,15 @@ CFont::PrintString(float x, float y, uint32, wchar *start, wchar *end, float spw
 	wchar *s;
 
 	if (RenderState.style != Details.style) {
+#ifdef FONT_BATCHING
+		if (!bBatchFonts)
+			RenderFontBuffer();
+		else if (RenderState.style >= 0 && !IsFontBufferEmpty(RenderState.style))
+			nFontDrawsSaved++;
+		SelectFontBuffer(Details.style);
+#else
 		RenderFontBuffer();
+#endif
 		RenderState.style = Details.style;
 	}
 
@@ -966,7 +1025,11 @@ CFont::PrintString(float x, float y, uint32, wchar *start, wchar *end, float spw
 		Details.dropShadowPosition = dropShadowPosition;
 		Details.bIsShadow = false;
 	}
+#ifdef FONT_BATCHING
+	if (FontRenderStatePointer.pStr >= (wchar*)&FontRenderStateBuf[FONT_BUFFER_SIZE] - (end - start + 26))
+#else
 	if (FontRenderStatePointer.pStr >= (wchar*)&FontRenderStateBuf[ARRAY_SIZE(FontRenderStateBuf)] - (end - start + 26)) // why 26?
+#endif
 		RenderFontBuffer();
 	CFontRenderState *pRenderState = FontRenderStatePointer.pRenderState;
 	pRenderState->fTextPosX = x;
@@ -1539,6 +1602,20 @@ CFont::ParseToken(wchar* str, CRGBA &color, bool &flash, bool &bold)
 void
 CFont::DrawFonts(void)
 {
+#ifdef FONT_BATCHING
+	// the other styles first, so the current one is drawn last and RenderState ends up as it would have
+	int16 style = RenderState.style;
+	CFontRenderState state = RenderState;
+	for (int16 i = 0; i < MAX_FONTS; i++) {
+		if (i == style || IsFontBufferEmpty(i))
+			continue;
+		SelectFontBuffer(i);
+		RenderState.style = i;
+		RenderFontBuffer();
+	}
+	RenderState = state;
+	SelectFontBuffer(style);
+#endif
 	RenderFontBuffer();
 }
 
@@ -1624,6 +1701,9 @@ CFont::RenderFontBuffer()
 	}
 	CSprite2d::RenderVertexBuffer();
 	FontRenderStatePointer.pRenderState = (CFontRenderState*)FontRenderStateBuf;
+#ifdef FONT_BATCHING
+	nFontDraws++;
+#endif
 }
 
 
@@ -130,6 +130,10 @@ public:
 	static CSprite2d Sprite[MAX_FONTS];
 	static CFontDetails Details;
 	static CFontRenderState RenderState;
+#ifdef FONT_BATCHING
+	static bool bBatchFonts;
+	static bool bShowStats;
+#endif
 
 #ifdef BUTTON_ICONS
 	static int32 ButtonsSlot;
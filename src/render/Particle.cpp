@@ -18,6 +18,7 @@
 #include "ParticleObject.h"
 #include "Particle.h"
 #include "soundlist.h"
+#include "Debug.h"
 
 
 #define MAX_PARTICLES_ON_SCREEN   (750)
@@ -147,6 +148,25 @@ const char CarsplashFiles[][12+1] =
 
 CParticle gParticleArray[MAX_PARTICLES_ON_SCREEN];
 
+// friction for this frame, worked out by Update for the particle systems
+static float fFricDeccel50;
+static float fFricDeccel80;
+static float fFricDeccel90;
+static float fFricDeccel95;
+static float fFricDeccel96;
+static float fFricDeccel99;
+
+#ifdef PARTICLE_BATCHING
+bool CParticle::bBatchRender = true;
+bool CParticle::bShowRenderStats;
+#endif
+
+#ifdef PARTICLE_SOA_UPDATE
+int32 nSoASystems;
+int32 nSoAParticles;
+int32 nScalarSystems;
+#endif
+
 RwTexture *gpSmokeTex[MAX_SMOKE_FILES];
 RwTexture *gpSmoke2Tex;
 RwTexture *gpRubberTex[MAX_RUBBER_FILES];
@@ -1126,14 +1146,12 @@ void CParticle::Update()
 	if ( CTimer::GetIsPaused() )
 		return;
 
-	CRGBA color(0, 0, 0, 0);
-	
-	float fFricDeccel50 = pow(0.50f, CTimer::GetTimeStep());
-	float fFricDeccel80 = pow(0.80f, CTimer::GetTimeStep());
-	float fFricDeccel90 = pow(0.90f, CTimer::GetTimeStep());
-	float fFricDeccel95 = pow(0.95f, CTimer::GetTimeStep());
-	float fFricDeccel96 = pow(0.96f, CTimer::GetTimeStep());
-	float fFricDeccel99 = pow(0.99f, CTimer::GetTimeStep());
+	fFricDeccel50 = pow(0.50f, CTimer::GetTimeStep());
+	fFricDeccel80 = pow(0.80f, CTimer::GetTimeStep());
+	fFricDeccel90 = pow(0.90f, CTimer::GetTimeStep());
+	fFricDeccel95 = pow(0.95f, CTimer::GetTimeStep());
+	fFricDeccel96 = pow(0.96f, CTimer::GetTimeStep());
+	fFricDeccel99 = pow(0.99f, CTimer::GetTimeStep());
 	
 	CParticleObject::UpdateAll();
 	
@@ -1156,339 +1174,408 @@ void CParticle::Update()
 					1000);
 	}
 
+#ifdef PARTICLE_SOA_UPDATE
+	uint32 nStartCycles = CTimer::GetCurrentTimeInCycles();
+	nSoASystems = 0;
+	nSoAParticles = 0;
+	nScalarSystems = 0;
+#endif
+	
 	for ( int32 i = 0; i < MAX_PARTICLES; i++ )
 	{
 		tParticleSystemData *psystem = &mod_ParticleSystemManager.m_aParticles[i];
-		CParticle *particle = psystem->m_pParticles;
-		CParticle *prevParticle = nil;
-		bool bRemoveParticle;
 		
-		if ( particle == nil )
+		if ( psystem->m_pParticles == nil )
 			continue;
-				
-		for ( ; particle != nil; _Next(particle, prevParticle, psystem, bRemoveParticle) )
+		
+#ifdef PARTICLE_SOA_UPDATE
+		if ( bUseSoAUpdate && CanUseSoAUpdate(psystem) )
 		{
-			CVector vecWind(0.0f, 0.0f, 0.0f);
-			
-			bRemoveParticle = false;
+			UpdateSystemSoA(psystem);
+			continue;
+		}
+		nScalarSystems++;
+#endif
+		UpdateSystem(psystem);
+	}
+	
+#ifdef PARTICLE_SOA_UPDATE
+	if ( bShowStats )
+	{
+		char str[128];
+		sprintf(str, "PARTICLES %dUS, SOA %d SYSTEMS %d PARTICLES, SCALAR %d SYSTEMS",
+			(CTimer::GetCurrentTimeInCycles() - nStartCycles) / Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u),
+			nSoASystems, nSoAParticles, nScalarSystems);
+		CDebug::PrintAt(str, 2, 31);
+	}
+#endif
+}
 
-			CVector vecMoveStep = particle->m_vecVelocity * CTimer::GetTimeStep();
-			CVector vecPos = particle->m_vecPosition;
-			
-			if ( numWaterDropOnScreen == 0 )
-				clearWaterDrop = false;
-			
-			if ( psystem->m_Type == PARTICLE_WATERDROP )
+void CParticle::UpdateSystem(tParticleSystemData *psystem)
+{
+	CRGBA color(0, 0, 0, 0);
+	CParticle *particle = psystem->m_pParticles;
+	CParticle *prevParticle = nil;
+	bool bRemoveParticle;
+	
+	for ( ; particle != nil; _Next(particle, prevParticle, psystem, bRemoveParticle) )
+	{
+		CVector vecWind(0.0f, 0.0f, 0.0f);
+		
+		bRemoveParticle = false;
+
+		CVector vecMoveStep = particle->m_vecVelocity * CTimer::GetTimeStep();
+		CVector vecPos = particle->m_vecPosition;
+		
+		if ( numWaterDropOnScreen == 0 )
+			clearWaterDrop = false;
+		
+		if ( psystem->m_Type == PARTICLE_WATERDROP )
+		{
+			if ( CGame::IsInInterior() || clearWaterDrop == true )
 			{
-				if ( CGame::IsInInterior() || clearWaterDrop == true )
-				{
-					bRemoveParticle = true;
-					continue;
-				}
-				
-				static uint8 nWaterDropCount;
+				bRemoveParticle = true;
+				continue;
+			}
+			
+			static uint8 nWaterDropCount;
 
-				if ( nWaterDropCount == 5 )
-				{
-					vecMoveStep = CVector(0.0f, 0.0f, 0.0f);
-					particle->m_nTimeWhenWillBeDestroyed += 1250;
-					nWaterDropCount = 0;
-				}
-				else
+			if ( nWaterDropCount == 5 )
+			{
+				vecMoveStep = CVector(0.0f, 0.0f, 0.0f);
+				particle->m_nTimeWhenWillBeDestroyed += 1250;
+				nWaterDropCount = 0;
+			}
+			else
+			{
+				if ( TheCamera.m_CameraAverageSpeed > 0.35f )
 				{
-					if ( TheCamera.m_CameraAverageSpeed > 0.35f )
+					if ( vecMoveStep.Magnitude() > 0.5f )
 					{
-						if ( vecMoveStep.Magnitude() > 0.5f )
+						if ( vecMoveStep.Magnitude() > 0.4f && vecMoveStep.Magnitude() < 0.8f )
 						{
-							if ( vecMoveStep.Magnitude() > 0.4f && vecMoveStep.Magnitude() < 0.8f )
-							{
-								vecMoveStep.x += TheCamera.m_CameraAverageSpeed * 1.5f;
-								vecMoveStep.y += TheCamera.m_CameraAverageSpeed * 1.5f;
-							}
-							else if ( vecMoveStep.Magnitude() != 0.0f )
-							{
-								vecMoveStep.x += CGeneral::GetRandomNumberInRange(0.01f, 0.05f);
-								vecMoveStep.y += CGeneral::GetRandomNumberInRange(0.01f, 0.05f);
-							}
+							vecMoveStep.x += TheCamera.m_CameraAverageSpeed * 1.5f;
+							vecMoveStep.y += TheCamera.m_CameraAverageSpeed * 1.5f;
+						}
+						else if ( vecMoveStep.Magnitude() != 0.0f )
+						{
+							vecMoveStep.x += CGeneral::GetRandomNumberInRange(0.01f, 0.05f);
+							vecMoveStep.y += CGeneral::GetRandomNumberInRange(0.01f, 0.05f);
 						}
 					}
-					
-					nWaterDropCount++;
 				}
 				
-				if ( vecPos.z <= 1.5f )
-					vecMoveStep.z = 0.0f;
+				nWaterDropCount++;
 			}
 			
-			if ( psystem->m_Type == PARTICLE_HEATHAZE || psystem->m_Type == PARTICLE_HEATHAZE_IN_DIST )
-			{
+			if ( vecPos.z <= 1.5f )
+				vecMoveStep.z = 0.0f;
+		}
+		
+		if ( psystem->m_Type == PARTICLE_HEATHAZE || psystem->m_Type == PARTICLE_HEATHAZE_IN_DIST )
+		{
 #ifdef FIX_BUGS
-				int32 nSinCosIndex = (int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) + SIN_COS_TABLE_SIZE) % SIN_COS_TABLE_SIZE;
+			int32 nSinCosIndex = (int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) + SIN_COS_TABLE_SIZE) % SIN_COS_TABLE_SIZE;
 #else
-				int32 nSinCosIndex = int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) % SIN_COS_TABLE_SIZE;
+			int32 nSinCosIndex = int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) % SIN_COS_TABLE_SIZE;
 #endif
-				vecMoveStep.x = Sin(nSinCosIndex);
-				vecMoveStep.y = Sin(nSinCosIndex);
-				
-				if ( psystem->m_Type == PARTICLE_HEATHAZE_IN_DIST )
-					particle->m_nRotation = int16((float)particle->m_nRotation + 0.75f);
-				else
-					particle->m_nRotation = int16((float)particle->m_nRotation + 1.0f);
-			}
+			vecMoveStep.x = Sin(nSinCosIndex);
+			vecMoveStep.y = Sin(nSinCosIndex);
 			
-			if ( psystem->m_Type == PARTICLE_BEASTIE )
-			{
+			if ( psystem->m_Type == PARTICLE_HEATHAZE_IN_DIST )
+				particle->m_nRotation = int16((float)particle->m_nRotation + 0.75f);
+			else
+				particle->m_nRotation = int16((float)particle->m_nRotation + 1.0f);
+		}
+		
+		if ( psystem->m_Type == PARTICLE_BEASTIE )
+		{
 #ifdef FIX_BUGS
-				int32 nSinCosIndex = (int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) + SIN_COS_TABLE_SIZE) % SIN_COS_TABLE_SIZE;
+			int32 nSinCosIndex = (int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) + SIN_COS_TABLE_SIZE) % SIN_COS_TABLE_SIZE;
 #else
-				int32 nSinCosIndex = int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) % SIN_COS_TABLE_SIZE;
+			int32 nSinCosIndex = int32(DEGTORAD((float)particle->m_nRotation) * float(SIN_COS_TABLE_SIZE) / TWOPI) % SIN_COS_TABLE_SIZE;
 #endif				
-				particle->m_vecVelocity.x = 0.50f * Cos(nSinCosIndex);
-				particle->m_vecVelocity.y = Cos(nSinCosIndex);
-				particle->m_vecVelocity.z = 0.25f * Sin(nSinCosIndex);
-				
-				if ( particle->m_vecVelocity.Magnitude() > 2.0f
-						|| vecPos.z > 40.0f
-						|| (TheCamera.GetPosition() - vecPos).Magnitude() < 60.0f
-					)
-				{
-					bRemoveParticle = true;
-					continue;
-				}
-			}
-			
-			vecPos += vecMoveStep;
-			
-			if ( psystem->m_Type == PARTICLE_FIREBALL )
+			particle->m_vecVelocity.x = 0.50f * Cos(nSinCosIndex);
+			particle->m_vecVelocity.y = Cos(nSinCosIndex);
+			particle->m_vecVelocity.z = 0.25f * Sin(nSinCosIndex);
+			
+			if ( particle->m_vecVelocity.Magnitude() > 2.0f
+					|| vecPos.z > 40.0f
+					|| (TheCamera.GetPosition() - vecPos).Magnitude() < 60.0f
+				)
 			{
-				  AddParticle(PARTICLE_HEATHAZE, particle->m_vecPosition, CVector(0.0f, 0.0f, 0.0f),
-					nil, particle->m_fSize * 5.0f);
+				bRemoveParticle = true;
+				continue;
 			}
-			
-			if ( psystem->m_Type == PARTICLE_GUNSMOKE2 )
+		}
+		
+		vecPos += vecMoveStep;
+		
+		if ( psystem->m_Type == PARTICLE_FIREBALL )
+		{
+			  AddParticle(PARTICLE_HEATHAZE, particle->m_vecPosition, CVector(0.0f, 0.0f, 0.0f),
+				nil, particle->m_fSize * 5.0f);
+		}
+		
+		if ( psystem->m_Type == PARTICLE_GUNSMOKE2 )
+		{
+			if ( CTimer::GetFrameCounter() & 10 )
 			{
-				if ( CTimer::GetFrameCounter() & 10 )
-				{
 #ifdef FIX_BUGS
-					if ( FindPlayerPed() && FindPlayerPed()->GetWeapon()->m_eWeaponType == WEAPONTYPE_MINIGUN )
+				if ( FindPlayerPed() && FindPlayerPed()->GetWeapon()->m_eWeaponType == WEAPONTYPE_MINIGUN )
 #else
-					if ( FindPlayerPed()->GetWeapon()->m_eWeaponType == WEAPONTYPE_MINIGUN )
+				if ( FindPlayerPed()->GetWeapon()->m_eWeaponType == WEAPONTYPE_MINIGUN )
 #endif
-					{
-						AddParticle(PARTICLE_HEATHAZE, particle->m_vecPosition, CVector(0.0f, 0.0f, 0.0f));
-					}
+				{
+					AddParticle(PARTICLE_HEATHAZE, particle->m_vecPosition, CVector(0.0f, 0.0f, 0.0f));
 				}
 			}
-			
-			if ( CWeather::Wind > 0.0f )
+		}
+		
+		if ( CWeather::Wind > 0.0f )
+		{
+			if ( vecMoveStep.Magnitude() != 0.0f )
 			{
-				if ( vecMoveStep.Magnitude() != 0.0f )
-				{
-					vecWind.x = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
-					vecWind.y = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
-					vecWind *= PARTICLE_WIND_TEST_SCALE * psystem->m_fWindFactor * CTimer::GetTimeStep();
-					particle->m_vecVelocity += vecWind;
-				}
+				vecWind.x = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
+				vecWind.y = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
+				vecWind *= PARTICLE_WIND_TEST_SCALE * psystem->m_fWindFactor * CTimer::GetTimeStep();
+				particle->m_vecVelocity += vecWind;
 			}
+		}
+		
+		if ( psystem->m_Type == PARTICLE_RAINDROP
+			|| psystem->m_Type == PARTICLE_RAINDROP_SMALL
+			|| psystem->m_Type == PARTICLE_RAIN_SPLASH
+			|| psystem->m_Type == PARTICLE_RAIN_SPLASH_BIGGROW
+			|| psystem->m_Type == PARTICLE_CAR_SPLASH
+			|| psystem->m_Type == PARTICLE_BOAT_SPLASH
+			|| psystem->m_Type == PARTICLE_RAINDROP_2D )
+		{
+			int32 nMaxDrops = int32(6.0f * TheCamera.m_CameraAverageSpeed + 1.0f);
+			float fDistToCam = 0.0f;
 			
-			if ( psystem->m_Type == PARTICLE_RAINDROP
-				|| psystem->m_Type == PARTICLE_RAINDROP_SMALL
-				|| psystem->m_Type == PARTICLE_RAIN_SPLASH
-				|| psystem->m_Type == PARTICLE_RAIN_SPLASH_BIGGROW
-				|| psystem->m_Type == PARTICLE_CAR_SPLASH
-				|| psystem->m_Type == PARTICLE_BOAT_SPLASH
-				|| psystem->m_Type == PARTICLE_RAINDROP_2D )
+			if ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
 			{
-				int32 nMaxDrops = int32(6.0f * TheCamera.m_CameraAverageSpeed + 1.0f);
-				float fDistToCam = 0.0f;
+				if ( vecPos.z + particle->m_fSize < 5.0f )
+				{
+					bRemoveParticle = true;
+					continue;
+				}
 				
-				if ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
+				switch ( TheCamera.GetLookDirection() )
 				{
-					if ( vecPos.z + particle->m_fSize < 5.0f )
-					{
-						bRemoveParticle = true;
-						continue;
-					}
-					
-					switch ( TheCamera.GetLookDirection() )
-					{
-						case LOOKING_LEFT:
-						case LOOKING_RIGHT:
-						case LOOKING_FORWARD:
-							nMaxDrops /= 2;
-							break;
-						
-						default:
-							nMaxDrops = 0;
-							break;
-					}
+					case LOOKING_LEFT:
+					case LOOKING_RIGHT:
+					case LOOKING_FORWARD:
+						nMaxDrops /= 2;
+						break;
 					
-					fDistToCam = (TheCamera.GetPosition() - vecPos).Magnitude();
+					default:
+						nMaxDrops = 0;
+						break;
 				}
+				
+				fDistToCam = (TheCamera.GetPosition() - vecPos).Magnitude();
+			}
 
-				if ( numWaterDropOnScreen < nMaxDrops && numWaterDropOnScreen < 63
-					&& fDistToCam < 10.0f
-					&& clearWaterDrop == false
-					&& !CGame::IsInInterior() )
+			if ( numWaterDropOnScreen < nMaxDrops && numWaterDropOnScreen < 63
+				&& fDistToCam < 10.0f
+				&& clearWaterDrop == false
+				&& !CGame::IsInInterior() )
+			{
+				CVector vecWaterdropTarget
+				(
+					CGeneral::GetRandomNumberInRange(-0.25f, 0.25f),
+					CGeneral::GetRandomNumberInRange(0.1f, 0.75f),
+					-0.01f
+				);
+				
+				CVector vecWaterdropPos;
+				
+				if ( TheCamera.m_CameraAverageSpeed < 0.35f )
+					vecWaterdropPos.x = (float)CGeneral::GetRandomNumberInRange(50, int32(SCREEN_WIDTH) - 50);
+				else
+					vecWaterdropPos.x = (float)CGeneral::GetRandomNumberInRange(200, int32(SCREEN_WIDTH) - 200);
+				
+				if ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
+					vecWaterdropPos.y = (float)CGeneral::GetRandomNumberInRange(SCREEN_HEIGHT / 2, SCREEN_HEIGHT);
+				else
 				{
-					CVector vecWaterdropTarget
-					(
-						CGeneral::GetRandomNumberInRange(-0.25f, 0.25f),
-						CGeneral::GetRandomNumberInRange(0.1f, 0.75f),
-						-0.01f
-					);
-					
-					CVector vecWaterdropPos;
-					
 					if ( TheCamera.m_CameraAverageSpeed < 0.35f )
-						vecWaterdropPos.x = (float)CGeneral::GetRandomNumberInRange(50, int32(SCREEN_WIDTH) - 50);
-					else
-						vecWaterdropPos.x = (float)CGeneral::GetRandomNumberInRange(200, int32(SCREEN_WIDTH) - 200);
-					
-					if ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
-						vecWaterdropPos.y = (float)CGeneral::GetRandomNumberInRange(SCREEN_HEIGHT / 2, SCREEN_HEIGHT);
+						vecWaterdropPos.y  = (float)CGeneral::GetRandomNumberInRange(0, int32(SCREEN_HEIGHT));
 					else
-					{
-						if ( TheCamera.m_CameraAverageSpeed < 0.35f )
-							vecWaterdropPos.y  = (float)CGeneral::GetRandomNumberInRange(0, int32(SCREEN_HEIGHT));
-						else
-							vecWaterdropPos.y  = (float)CGeneral::GetRandomNumberInRange(150, int32(SCREEN_HEIGHT) - 200);
-					}
-					
-					vecWaterdropPos.z = 2.0f;
-
-					if ( AddParticle(PARTICLE_WATERDROP,
-										vecWaterdropPos,
-										vecWaterdropTarget,
-										nil,
-										CGeneral::GetRandomNumberInRange(0.1f, 0.15f),
-										0,
-										0,
-										CGeneral::GetRandomNumber() & 1,
-										0) != nil )
-					{
-						numWaterDropOnScreen++;
-					}
+						vecWaterdropPos.y  = (float)CGeneral::GetRandomNumberInRange(150, int32(SCREEN_HEIGHT) - 200);
+				}
+				
+				vecWaterdropPos.z = 2.0f;
+
+				if ( AddParticle(PARTICLE_WATERDROP,
+									vecWaterdropPos,
+									vecWaterdropTarget,
+									nil,
+									CGeneral::GetRandomNumberInRange(0.1f, 0.15f),
+									0,
+									0,
+									CGeneral::GetRandomNumber() & 1,
+									0) != nil )
+				{
+					numWaterDropOnScreen++;
 				}
 			}
+		}
+		
+		if (  CTimer::GetTimeInMilliseconds() > particle->m_nTimeWhenWillBeDestroyed || particle->m_nAlpha == 0 )
+		{
+			bRemoveParticle = true;
+			continue;
+		}
+
+		if ( particle->m_nTimeWhenColorWillBeChanged != 0 )
+		{
+			if ( particle->m_nTimeWhenColorWillBeChanged > CTimer::GetTimeInMilliseconds() )
+			{
+				float colorMul = 1.0f - float(particle->m_nTimeWhenColorWillBeChanged - CTimer::GetTimeInMilliseconds()) / float(psystem->m_ColorFadeTime);
 			
-			if (  CTimer::GetTimeInMilliseconds() > particle->m_nTimeWhenWillBeDestroyed || particle->m_nAlpha == 0 )
+				particle->m_Color.red = clamp(
+					psystem->m_RenderColouring.red + int32(float(psystem->m_FadeDestinationColor.red - psystem->m_RenderColouring.red) * colorMul),
+					0, 255);
+				
+				particle->m_Color.green = clamp(
+					psystem->m_RenderColouring.green + int32(float(psystem->m_FadeDestinationColor.green - psystem->m_RenderColouring.green) * colorMul),
+					0, 255);
+					
+				particle->m_Color.blue = clamp(
+					psystem->m_RenderColouring.blue + int32(float(psystem->m_FadeDestinationColor.blue - psystem->m_RenderColouring.blue) * colorMul),
+					0, 255);
+			}
+			else
+				RwRGBAAssign(&particle->m_Color, psystem->m_FadeDestinationColor);
+		}
+		
+		if ( psystem->Flags & CLIPOUT2D )
+		{
+			if ( particle->m_vecPosition.x < -10.0f || particle->m_vecPosition.x > SCREEN_WIDTH + 10.0f
+				|| particle->m_vecPosition.y < -10.0f || particle->m_vecPosition.y > SCREEN_HEIGHT + 10.0f )
 			{
 				bRemoveParticle = true;
 				continue;
 			}
+		}
+		
+		if ( !(psystem->Flags & SCREEN_TRAIL) )
+		{
+			float size;
 
-			if ( particle->m_nTimeWhenColorWillBeChanged != 0 )
+			if ( particle->m_fExpansionRate > 0.0f )
 			{
-				if ( particle->m_nTimeWhenColorWillBeChanged > CTimer::GetTimeInMilliseconds() )
-				{
-					float colorMul = 1.0f - float(particle->m_nTimeWhenColorWillBeChanged - CTimer::GetTimeInMilliseconds()) / float(psystem->m_ColorFadeTime);
+				float speed = Max(vecWind.Magnitude(), vecMoveStep.Magnitude());
 				
-					particle->m_Color.red = clamp(
-						psystem->m_RenderColouring.red + int32(float(psystem->m_FadeDestinationColor.red - psystem->m_RenderColouring.red) * colorMul),
-						0, 255);
-					
-					particle->m_Color.green = clamp(
-						psystem->m_RenderColouring.green + int32(float(psystem->m_FadeDestinationColor.green - psystem->m_RenderColouring.green) * colorMul),
-						0, 255);
-						
-					particle->m_Color.blue = clamp(
-						psystem->m_RenderColouring.blue + int32(float(psystem->m_FadeDestinationColor.blue - psystem->m_RenderColouring.blue) * colorMul),
-						0, 255);
+				if ( psystem->m_Type == PARTICLE_EXHAUST_FUMES || psystem->m_Type == PARTICLE_ENGINE_STEAM )
+					speed *= 2.0f;
+				
+				if ( ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
+						&& particle->m_fSize > 1.2f )
+				{
+					size = particle->m_fSize - (1.0f + speed) * particle->m_fExpansionRate;
+					particle->m_vecVelocity.z -= 0.15f;
 				}
 				else
-					RwRGBAAssign(&particle->m_Color, psystem->m_FadeDestinationColor);
+					size = particle->m_fSize + (1.0f + speed) * particle->m_fExpansionRate;
 			}
+			else
+				size = particle->m_fSize + particle->m_fExpansionRate;
 			
-			if ( psystem->Flags & CLIPOUT2D )
-			{
-				if ( particle->m_vecPosition.x < -10.0f || particle->m_vecPosition.x > SCREEN_WIDTH + 10.0f
-					|| particle->m_vecPosition.y < -10.0f || particle->m_vecPosition.y > SCREEN_HEIGHT + 10.0f )
-				{
-					bRemoveParticle = true;
-					continue;
-				}
-			}
+			if ( psystem->m_Type == PARTICLE_WATERDROP )
+				size = (size - Abs(vecMoveStep.x) * 0.000150000007f) + (Abs(vecMoveStep.z) * 0.0500000007f); //TODO:
 			
-			if ( !(psystem->Flags & SCREEN_TRAIL) )
+			if ( size < 0.0f )
 			{
-				float size;
-
-				if ( particle->m_fExpansionRate > 0.0f )
-				{
-					float speed = Max(vecWind.Magnitude(), vecMoveStep.Magnitude());
-					
-					if ( psystem->m_Type == PARTICLE_EXHAUST_FUMES || psystem->m_Type == PARTICLE_ENGINE_STEAM )
-						speed *= 2.0f;
-					
-					if ( ( psystem->m_Type == PARTICLE_BOAT_SPLASH || psystem->m_Type == PARTICLE_CAR_SPLASH )
-							&& particle->m_fSize > 1.2f )
-					{
-						size = particle->m_fSize - (1.0f + speed) * particle->m_fExpansionRate;
-						particle->m_vecVelocity.z -= 0.15f;
-					}
-					else
-						size = particle->m_fSize + (1.0f + speed) * particle->m_fExpansionRate;
-				}
-				else
-					size = particle->m_fSize + particle->m_fExpansionRate;
-				
-				if ( psystem->m_Type == PARTICLE_WATERDROP )
-					size = (size - Abs(vecMoveStep.x) * 0.000150000007f) + (Abs(vecMoveStep.z) * 0.0500000007f); //TODO:
-				
-				if ( size < 0.0f )
-				{
-					bRemoveParticle = true;
-					continue;
-				}
-				
-				particle->m_fSize = size;
+				bRemoveParticle = true;
+				continue;
 			}
 			
-			switch ( psystem->m_nFrictionDecceleration )
-			{
-				case 50:
-					particle->m_vecVelocity *= fFricDeccel50;
-					break;
-		
-				case 80:
-					particle->m_vecVelocity *= fFricDeccel80;
-					break;
-		
-				case 90:
-					particle->m_vecVelocity *= fFricDeccel90;
-					break;
-		
-				case 95:
-					particle->m_vecVelocity *= fFricDeccel95;
-					break;
+			particle->m_fSize = size;
+		}
 		
-				case 96:
-					particle->m_vecVelocity *= fFricDeccel96;
-					break;
+		switch ( psystem->m_nFrictionDecceleration )
+		{
+			case 50:
+				particle->m_vecVelocity *= fFricDeccel50;
+				break;
+	
+			case 80:
+				particle->m_vecVelocity *= fFricDeccel80;
+				break;
+	
+			case 90:
+				particle->m_vecVelocity *= fFricDeccel90;
+				break;
+	
+			case 95:
+				particle->m_vecVelocity *= fFricDeccel95;
+				break;
+	
+			case 96:
+				particle->m_vecVelocity *= fFricDeccel96;
+				break;
+	
+			case 99:
+				particle->m_vecVelocity *= fFricDeccel99;
+				break;				
+		}
 		
-				case 99:
-					particle->m_vecVelocity *= fFricDeccel99;
-					break;				
-			}
-			
-			if ( psystem->m_fGravitationalAcceleration > 0.0f )
-			{
-				if ( -50.0f * psystem->m_fGravitationalAcceleration < particle->m_vecVelocity.z )
-					particle->m_vecVelocity.z -= psystem->m_fGravitationalAcceleration * CTimer::GetTimeStep();
+		if ( psystem->m_fGravitationalAcceleration > 0.0f )
+		{
+			if ( -50.0f * psystem->m_fGravitationalAcceleration < particle->m_vecVelocity.z )
+				particle->m_vecVelocity.z -= psystem->m_fGravitationalAcceleration * CTimer::GetTimeStep();
 
-				if ( psystem->Flags & ZCHECK_FIRST )
+			if ( psystem->Flags & ZCHECK_FIRST )
+			{
+				if ( particle->m_vecPosition.z < particle->m_fZGround )
 				{
-					if ( particle->m_vecPosition.z < particle->m_fZGround )
+					switch ( psystem->m_Type )
 					{
-						switch ( psystem->m_Type )
-						{
-							case PARTICLE_RAINDROP:
-							case PARTICLE_RAINDROP_SMALL:
+						case PARTICLE_RAINDROP:
+						case PARTICLE_RAINDROP_SMALL:
+							{
+								bRemoveParticle = true;
+								
+								if ( CGeneral::GetRandomNumber() & 1 )
 								{
-									bRemoveParticle = true;
-									
-									if ( CGeneral::GetRandomNumber() & 1 )
+									AddParticle(PARTICLE_RAIN_SPLASH,
+												CVector
+												(
+													particle->m_vecPosition.x,
+													particle->m_vecPosition.y,
+													0.05f + particle->m_fZGround
+												),
+												CVector(0.0f, 0.0f, 0.0f), nil, 0.0f, 0, 0, 0, 0);
+								}
+								else
+								{
+									AddParticle(PARTICLE_RAIN_SPLASHUP,
+												CVector
+												(
+													particle->m_vecPosition.x,
+													particle->m_vecPosition.y,
+													0.05f + particle->m_fZGround
+												),
+												CVector(0.0f, 0.0f, 0.0f), nil, 0.0f, 0, 0, 0, 0);
+								}
+								
+								continue;
+							}
+							break;
+
+						case PARTICLE_WHEEL_WATER:
+							{
+								bRemoveParticle = true;
+								
+								int32 randVal = CGeneral::GetRandomNumber();
+								
+								if ( randVal & 1 )
+								{
+									if ( (randVal % 5) == 0 )
 									{
 										AddParticle(PARTICLE_RAIN_SPLASH,
 													CVector
@@ -1511,279 +1598,668 @@ void CParticle::Update()
 													CVector(0.0f, 0.0f, 0.0f), nil, 0.0f, 0, 0, 0, 0);
 									}
 									
-									continue;
 								}
-								break;
+								continue;
+							}
+							break;
 
-							case PARTICLE_WHEEL_WATER:
+						case PARTICLE_BLOOD:
+						case PARTICLE_BLOOD_SMALL:
+							{
+								bRemoveParticle = true;
+								
+								CVector vecPosn = particle->m_vecPosition;
+								vecPosn.z += 1.0f;
+								
+								Randomizer++;
+								int32 randVal = int32(Randomizer & 7);
+								
+								if ( randVal == 5 )
 								{
-									bRemoveParticle = true;
-									
-									int32 randVal = CGeneral::GetRandomNumber();
-									
-									if ( randVal & 1 )
-									{
-										if ( (randVal % 5) == 0 )
-										{
-											AddParticle(PARTICLE_RAIN_SPLASH,
-														CVector
-														(
-															particle->m_vecPosition.x,
-															particle->m_vecPosition.y,
-															0.05f + particle->m_fZGround
-														),
-														CVector(0.0f, 0.0f, 0.0f), nil, 0.0f, 0, 0, 0, 0);
-										}
-										else
-										{
-											AddParticle(PARTICLE_RAIN_SPLASHUP,
-														CVector
-														(
-															particle->m_vecPosition.x,
-															particle->m_vecPosition.y,
-															0.05f + particle->m_fZGround
-														),
-														CVector(0.0f, 0.0f, 0.0f), nil, 0.0f, 0, 0, 0, 0);
-										}
-										
-									}
-									continue;
+									CShadows::AddPermanentShadow(SHADOWTYPE_DARK, gpBloodPoolTex, &vecPosn,
+											0.1f, 0.0f, 0.0f, -0.1f,
+											255,
+											255, 0, 0,
+											4.0f, (CGeneral::GetRandomNumber() & 4095) + 2000, 1.0f);
 								}
-								break;
-
-							case PARTICLE_BLOOD:
-							case PARTICLE_BLOOD_SMALL:
+								else if ( randVal == 2 )
 								{
-									bRemoveParticle = true;
-									
-									CVector vecPosn = particle->m_vecPosition;
-									vecPosn.z += 1.0f;
-									
-									Randomizer++;
-									int32 randVal = int32(Randomizer & 7);
-									
-									if ( randVal == 5 )
-									{
-										CShadows::AddPermanentShadow(SHADOWTYPE_DARK, gpBloodPoolTex, &vecPosn,
-												0.1f, 0.0f, 0.0f, -0.1f,
-												255,
-												255, 0, 0,
-												4.0f, (CGeneral::GetRandomNumber() & 4095) + 2000, 1.0f);
-									}
-									else if ( randVal == 2 )
-									{
-										CShadows::AddPermanentShadow(SHADOWTYPE_DARK, gpBloodPoolTex, &vecPosn,
-												0.2f, 0.0f, 0.0f, -0.2f,
-												255,
-												255, 0, 0,
-												4.0f, (CGeneral::GetRandomNumber() & 4095) + 8000, 1.0f);
-									}
-									continue;
+									CShadows::AddPermanentShadow(SHADOWTYPE_DARK, gpBloodPoolTex, &vecPosn,
+											0.2f, 0.0f, 0.0f, -0.2f,
+											255,
+											255, 0, 0,
+											4.0f, (CGeneral::GetRandomNumber() & 4095) + 8000, 1.0f);
 								}
-								break;
-							default: break;
-						}
+								continue;
+							}
+							break;
+						default: break;
 					}
 				}
-				else if ( psystem->Flags & ZCHECK_STEP )
-				{
-					CColPoint point;
-					CEntity *entity;
+			}
+			else if ( psystem->Flags & ZCHECK_STEP )
+			{
+				CColPoint point;
+				CEntity *entity;
 
-					if ( CWorld::ProcessVerticalLine(particle->m_vecPosition, vecPos.z, point, entity, 
-														true, true, false, false, true, false, nil) )
+				if ( CWorld::ProcessVerticalLine(particle->m_vecPosition, vecPos.z, point, entity, 
+													true, true, false, false, true, false, nil) )
+				{
+					if ( vecPos.z <= point.point.z )
 					{
-						if ( vecPos.z <= point.point.z )
+						vecPos.z = point.point.z;
+						if ( psystem->m_Type == PARTICLE_DEBRIS2 )
 						{
-							vecPos.z = point.point.z;
-							if ( psystem->m_Type == PARTICLE_DEBRIS2 )
-							{
-								particle->m_vecVelocity.x *= 0.8f;
-								particle->m_vecVelocity.y *= 0.8f;
-								particle->m_vecVelocity.z *= -0.4f;
-								if ( particle->m_vecVelocity.z < 0.005f )
-									particle->m_vecVelocity.z = 0.0f;
-							}
+							particle->m_vecVelocity.x *= 0.8f;
+							particle->m_vecVelocity.y *= 0.8f;
+							particle->m_vecVelocity.z *= -0.4f;
+							if ( particle->m_vecVelocity.z < 0.005f )
+								particle->m_vecVelocity.z = 0.0f;
 						}
 					}
 				}
-				else if ( psystem->Flags & ZCHECK_BUMP )
+			}
+			else if ( psystem->Flags & ZCHECK_BUMP )
+			{
+				if ( particle->m_vecPosition.z < particle->m_fZGround )
 				{
-					if ( particle->m_vecPosition.z < particle->m_fZGround )
+					switch ( psystem->m_Type )
 					{
-						switch ( psystem->m_Type )
-						{
-							case PARTICLE_GUNSHELL_FIRST:
-							case PARTICLE_GUNSHELL:
-								{
-									bRemoveParticle = true;
-
-									AddParticle(PARTICLE_GUNSHELL_BUMP1,
-												CVector
-												(
-													particle->m_vecPosition.x,
-													particle->m_vecPosition.y,
-													0.05f + particle->m_fZGround
-												),
-												CVector
-												(
-													CGeneral::GetRandomNumberInRange(-0.02f, 0.02f),
-													CGeneral::GetRandomNumberInRange(-0.02f, 0.02f),
-													CGeneral::GetRandomNumberInRange(0.05f, 0.1f)
-												),
-												nil,
-												particle->m_fSize, color, particle->m_nRotationStep, 0, 0, 0);
-									
-									PlayOneShotScriptObject(SCRIPT_SOUND_GUNSHELL_DROP, particle->m_vecPosition);
-								}
-								break;
-							
-							case PARTICLE_GUNSHELL_BUMP1:
-								{
-									bRemoveParticle = true;
-									
-									AddParticle(PARTICLE_GUNSHELL_BUMP2,
-												CVector
-												(
-													particle->m_vecPosition.x,
-													particle->m_vecPosition.y,
-													0.05f + particle->m_fZGround
-												),
-												CVector(0.0f, 0.0f, CGeneral::GetRandomNumberInRange(0.03f, 0.06f)),
-												nil,
-												particle->m_fSize, color, 0, 0, 0, 0);
-									
-									PlayOneShotScriptObject(SCRIPT_SOUND_GUNSHELL_DROP_SOFT, particle->m_vecPosition);
-								}
-								break;
+						case PARTICLE_GUNSHELL_FIRST:
+						case PARTICLE_GUNSHELL:
+							{
+								bRemoveParticle = true;
+
+								AddParticle(PARTICLE_GUNSHELL_BUMP1,
+											CVector
+											(
+												particle->m_vecPosition.x,
+												particle->m_vecPosition.y,
+												0.05f + particle->m_fZGround
+											),
+											CVector
+											(
+												CGeneral::GetRandomNumberInRange(-0.02f, 0.02f),
+												CGeneral::GetRandomNumberInRange(-0.02f, 0.02f),
+												CGeneral::GetRandomNumberInRange(0.05f, 0.1f)
+											),
+											nil,
+											particle->m_fSize, color, particle->m_nRotationStep, 0, 0, 0);
 								
-							case PARTICLE_GUNSHELL_BUMP2:
-								{
-									bRemoveParticle = true;
-									continue;
-								}
-								break;
-							default: break;
-						}
+								PlayOneShotScriptObject(SCRIPT_SOUND_GUNSHELL_DROP, particle->m_vecPosition);
+							}
+							break;
+						
+						case PARTICLE_GUNSHELL_BUMP1:
+							{
+								bRemoveParticle = true;
+								
+								AddParticle(PARTICLE_GUNSHELL_BUMP2,
+											CVector
+											(
+												particle->m_vecPosition.x,
+												particle->m_vecPosition.y,
+												0.05f + particle->m_fZGround
+											),
+											CVector(0.0f, 0.0f, CGeneral::GetRandomNumberInRange(0.03f, 0.06f)),
+											nil,
+											particle->m_fSize, color, 0, 0, 0, 0);
+								
+								PlayOneShotScriptObject(SCRIPT_SOUND_GUNSHELL_DROP_SOFT, particle->m_vecPosition);
+							}
+							break;
+							
+						case PARTICLE_GUNSHELL_BUMP2:
+							{
+								bRemoveParticle = true;
+								continue;
+							}
+							break;
+						default: break;
 					}
 				}
 			}
+		}
+		else
+		{
+			if ( psystem->m_fGravitationalAcceleration < 0.0f )
+			{
+				if ( -5.0f * psystem->m_fGravitationalAcceleration > particle->m_vecVelocity.z )
+					particle->m_vecVelocity.z -= psystem->m_fGravitationalAcceleration * CTimer::GetTimeStep();
+			}
 			else
 			{
-				if ( psystem->m_fGravitationalAcceleration < 0.0f )
+				if ( psystem->Flags & ZCHECK_STEP )
 				{
-					if ( -5.0f * psystem->m_fGravitationalAcceleration > particle->m_vecVelocity.z )
-						particle->m_vecVelocity.z -= psystem->m_fGravitationalAcceleration * CTimer::GetTimeStep();
-				}
-				else
-				{
-					if ( psystem->Flags & ZCHECK_STEP )
+					CColPoint point;
+					CEntity *entity;
+		
+					if ( CWorld::ProcessVerticalLine(particle->m_vecPosition, vecPos.z, point, entity,
+													true, false, false, false, true, false, nil) )
 					{
-						CColPoint point;
-						CEntity *entity;
-			
-						if ( CWorld::ProcessVerticalLine(particle->m_vecPosition, vecPos.z, point, entity,
-														true, false, false, false, true, false, nil) )
+						if ( vecPos.z <= point.point.z )
 						{
-							if ( vecPos.z <= point.point.z )
+							vecPos.z = point.point.z;
+							if ( psystem->m_Type == PARTICLE_HELI_ATTACK )
 							{
-								vecPos.z = point.point.z;
-								if ( psystem->m_Type == PARTICLE_HELI_ATTACK )
-								{
-									bRemoveParticle = true;
-									AddParticle(PARTICLE_STEAM, vecPos, CVector(0.0f, 0.0f, 0.05f), nil, 0.2f, 0, 0, 0, 0);
-									continue;
-								}
+								bRemoveParticle = true;
+								AddParticle(PARTICLE_STEAM, vecPos, CVector(0.0f, 0.0f, 0.05f), nil, 0.2f, 0, 0, 0, 0);
+								continue;
 							}
 						}
 					}
 				}
 			}
+		}
 
-			if ( particle->m_nFadeToBlackTimer != 0 )
-			{
-				particle->m_nColorIntensity = clamp(particle->m_nColorIntensity - particle->m_nFadeToBlackTimer,
-														0, 255);
-			}
+		if ( particle->m_nFadeToBlackTimer != 0 )
+		{
+			particle->m_nColorIntensity = clamp(particle->m_nColorIntensity - particle->m_nFadeToBlackTimer,
+													0, 255);
+		}
 
-			if ( particle->m_nFadeAlphaTimer != 0 )
+		if ( particle->m_nFadeAlphaTimer != 0 )
+		{
+			particle->m_nAlpha = clamp(particle->m_nAlpha - particle->m_nFadeAlphaTimer,
+													0, 255);
+			if ( particle->m_nAlpha == 0 )
 			{
-				particle->m_nAlpha = clamp(particle->m_nAlpha - particle->m_nFadeAlphaTimer,
-														0, 255);
-				if ( particle->m_nAlpha == 0 )
-				{
-					bRemoveParticle = true;
-					continue;
-				}
+				bRemoveParticle = true;
+				continue;
 			}
-			
-			if ( psystem->m_nZRotationAngleChangeAmount != 0 )
+		}
+		
+		if ( psystem->m_nZRotationAngleChangeAmount != 0 )
+		{
+			if ( particle->m_nZRotationTimer >= psystem->m_nZRotationChangeTime )
 			{
-				if ( particle->m_nZRotationTimer >= psystem->m_nZRotationChangeTime )
-				{
-					particle->m_nZRotationTimer = 0;
-					particle->m_nCurrentZRotation += psystem->m_nZRotationAngleChangeAmount;
-				}
-				else
-					++particle->m_nZRotationTimer;
+				particle->m_nZRotationTimer = 0;
+				particle->m_nCurrentZRotation += psystem->m_nZRotationAngleChangeAmount;
 			}
-			
-			if ( psystem->m_fZRadiusChangeAmount != 0.0f )
+			else
+				++particle->m_nZRotationTimer;
+		}
+		
+		if ( psystem->m_fZRadiusChangeAmount != 0.0f )
+		{
+			if ( particle->m_nZRadiusTimer >= psystem->m_nZRadiusChangeTime )
 			{
-				if ( particle->m_nZRadiusTimer >= psystem->m_nZRadiusChangeTime )
-				{
-					particle->m_nZRadiusTimer = 0;
-					particle->m_fCurrentZRadius += psystem->m_fZRadiusChangeAmount;
-				}
-				else
-					++particle->m_nZRadiusTimer;
+				particle->m_nZRadiusTimer = 0;
+				particle->m_fCurrentZRadius += psystem->m_fZRadiusChangeAmount;
 			}
+			else
+				++particle->m_nZRadiusTimer;
+		}
 
-			if ( psystem->m_nAnimationSpeed != 0 )
+		if ( psystem->m_nAnimationSpeed != 0 )
+		{
+			if ( particle->m_nAnimationSpeedTimer > psystem->m_nAnimationSpeed )
 			{
-				if ( particle->m_nAnimationSpeedTimer > psystem->m_nAnimationSpeed )
+				particle->m_nAnimationSpeedTimer = 0;
+				
+				if ( ++particle->m_nCurrentFrame > psystem->m_nFinalAnimationFrame )
 				{
-					particle->m_nAnimationSpeedTimer = 0;
-					
-					if ( ++particle->m_nCurrentFrame > psystem->m_nFinalAnimationFrame )
-					{
-						if ( psystem->Flags & CYCLE_ANIM )
-							particle->m_nCurrentFrame = psystem->m_nStartAnimationFrame;
-						else
-							--particle->m_nCurrentFrame;
-					}	
-				}
-				else
-					++particle->m_nAnimationSpeedTimer;
+					if ( psystem->Flags & CYCLE_ANIM )
+						particle->m_nCurrentFrame = psystem->m_nStartAnimationFrame;
+					else
+						--particle->m_nCurrentFrame;
+				}	
 			}
-			
-			if ( particle->m_nRotationStep != 0 )
+			else
+				++particle->m_nAnimationSpeedTimer;
+		}
+		
+		if ( particle->m_nRotationStep != 0 )
 #ifdef FIX_BUGS
-				particle->m_nRotation = CGeneral::LimitAngle(particle->m_nRotation + particle->m_nRotationStep);
+			particle->m_nRotation = CGeneral::LimitAngle(particle->m_nRotation + particle->m_nRotationStep);
 #else
-				particle->m_nRotation += particle->m_nRotationStep;
+			particle->m_nRotation += particle->m_nRotationStep;
 #endif
+		
+		if ( particle->m_fCurrentZRadius != 0.0f )
+		{
+			int32 nSinCosIndex = particle->m_nCurrentZRotation % SIN_COS_TABLE_SIZE;
+			
+			float fX = (Cos(nSinCosIndex) - Sin(nSinCosIndex)) * particle->m_fCurrentZRadius;
 			
-			if ( particle->m_fCurrentZRadius != 0.0f )
+			float fY = (Sin(nSinCosIndex) + Cos(nSinCosIndex)) * particle->m_fCurrentZRadius;
+
+			vecPos -= particle->m_vecParticleMovementOffset;
+
+			vecPos += CVector(fX, fY, 0.0f);
+			
+			particle->m_vecParticleMovementOffset = CVector(fX, fY, 0.0f);
+		}
+		
+		particle->m_vecPosition = vecPos;
+	}
+}
+
+#ifdef PARTICLE_SOA_UPDATE
+/*
+ Most particle systems don't do anything of their own in Update, every particle just moves, fades,
+ grows and slows down the same way. For those the particles of the system are gathered into
+ arrays of floats, stepped all at once by loops with no branches in them, which the compiler
+ turns into SIMD code, and then written back, with the dead ones taken out of the list in the
+ same pass. Everything is worked out in the same order as UpdateSystem does, so both give the
+ same result. The particles themselves stay in gParticleArray, AddParticle hands out pointers
+ to them.
+*/
+bool CParticle::bUseSoAUpdate = true;
+bool CParticle::bShowStats;
+
+static CParticle *aSoAParticle[MAX_PARTICLES_ON_SCREEN];
+static float aSoAPosX[MAX_PARTICLES_ON_SCREEN];
+static float aSoAPosY[MAX_PARTICLES_ON_SCREEN];
+static float aSoAPosZ[MAX_PARTICLES_ON_SCREEN];
+static float aSoAVelX[MAX_PARTICLES_ON_SCREEN];
+static float aSoAVelY[MAX_PARTICLES_ON_SCREEN];
+static float aSoAVelZ[MAX_PARTICLES_ON_SCREEN];
+static float aSoASpeed[MAX_PARTICLES_ON_SCREEN];
+static float aSoASize[MAX_PARTICLES_ON_SCREEN];
+static float aSoAExpansionRate[MAX_PARTICLES_ON_SCREEN];
+static uint32 aSoATimeWhenWillBeDestroyed[MAX_PARTICLES_ON_SCREEN];
+static int32 aSoAAlpha[MAX_PARTICLES_ON_SCREEN];
+static int32 aSoAFadeAlphaTimer[MAX_PARTICLES_ON_SCREEN];
+static int32 aSoAColorIntensity[MAX_PARTICLES_ON_SCREEN];
+static int32 aSoAFadeToBlackTimer[MAX_PARTICLES_ON_SCREEN];
+static uint8 aSoARemove[MAX_PARTICLES_ON_SCREEN];
+
+bool CParticle::CanUseSoAUpdate(tParticleSystemData *psystem)
+{
+	switch ( psystem->m_Type )
+	{
+		// these have code of their own in UpdateSystem
+		case PARTICLE_WATERDROP:
+		case PARTICLE_HEATHAZE:
+		case PARTICLE_HEATHAZE_IN_DIST:
+		case PARTICLE_BEASTIE:
+		case PARTICLE_FIREBALL:
+		case PARTICLE_GUNSMOKE2:
+		case PARTICLE_RAINDROP:
+		case PARTICLE_RAINDROP_SMALL:
+		case PARTICLE_RAIN_SPLASH:
+		case PARTICLE_RAIN_SPLASH_BIGGROW:
+		case PARTICLE_CAR_SPLASH:
+		case PARTICLE_BOAT_SPLASH:
+		case PARTICLE_RAINDROP_2D:
+			return false;
+		default: break;
+	}
+	
+	// and these hit the ground
+	if ( psystem->Flags & (ZCHECK_FIRST | ZCHECK_STEP | ZCHECK_BUMP) )
+		return false;
+	
+	return true;
+}
+
+void CParticle::UpdateSystemSoA(tParticleSystemData *psystem)
+{
+	int32 i;
+	int32 numParticles = 0;
+	float fTimeStep = CTimer::GetTimeStep();
+	uint32 nTime = CTimer::GetTimeInMilliseconds();
+	
+	if ( numWaterDropOnScreen == 0 )
+		clearWaterDrop = false;
+	
+	for ( CParticle *particle = psystem->m_pParticles; particle != nil; particle = particle->m_pNext )
+	{
+		aSoAParticle[numParticles] = particle;
+		aSoAPosX[numParticles] = particle->m_vecPosition.x;
+		aSoAPosY[numParticles] = particle->m_vecPosition.y;
+		aSoAPosZ[numParticles] = particle->m_vecPosition.z;
+		aSoAVelX[numParticles] = particle->m_vecVelocity.x;
+		aSoAVelY[numParticles] = particle->m_vecVelocity.y;
+		aSoAVelZ[numParticles] = particle->m_vecVelocity.z;
+		aSoASize[numParticles] = particle->m_fSize;
+		aSoAExpansionRate[numParticles] = particle->m_fExpansionRate;
+		aSoATimeWhenWillBeDestroyed[numParticles] = particle->m_nTimeWhenWillBeDestroyed;
+		aSoAAlpha[numParticles] = particle->m_nAlpha;
+		aSoAFadeAlphaTimer[numParticles] = particle->m_nFadeAlphaTimer;
+		aSoAColorIntensity[numParticles] = particle->m_nColorIntensity;
+		aSoAFadeToBlackTimer[numParticles] = particle->m_nFadeToBlackTimer;
+		numParticles++;
+	}
+	
+	nSoASystems++;
+	nSoAParticles += numParticles;
+	
+	// life and old position
+	if ( psystem->Flags & CLIPOUT2D )
+	{
+		float fMaxX = SCREEN_WIDTH + 10.0f;
+		float fMaxY = SCREEN_HEIGHT + 10.0f;
+		for ( i = 0; i < numParticles; i++ )
+			aSoARemove[i] = nTime > aSoATimeWhenWillBeDestroyed[i] || aSoAAlpha[i] == 0
+				|| aSoAPosX[i] < -10.0f || aSoAPosX[i] > fMaxX
+				|| aSoAPosY[i] < -10.0f || aSoAPosY[i] > fMaxY;
+	}
+	else
+	{
+		for ( i = 0; i < numParticles; i++ )
+			aSoARemove[i] = nTime > aSoATimeWhenWillBeDestroyed[i] || aSoAAlpha[i] == 0;
+	}
+	
+	// move
+	for ( i = 0; i < numParticles; i++ )
+	{
+		float fStepX = aSoAVelX[i] * fTimeStep;
+		float fStepY = aSoAVelY[i] * fTimeStep;
+		float fStepZ = aSoAVelZ[i] * fTimeStep;
+		aSoAPosX[i] += fStepX;
+		aSoAPosY[i] += fStepY;
+		aSoAPosZ[i] += fStepZ;
+		aSoASpeed[i] = Sqrt(fStepX*fStepX + fStepY*fStepY + fStepZ*fStepZ);
+	}
+	
+	// wind, this needs random numbers in the same order as UpdateSystem so it stays a plain loop
+	if ( CWeather::Wind > 0.0f )
+	{
+		float fWindMult = PARTICLE_WIND_TEST_SCALE * psystem->m_fWindFactor * fTimeStep;
+		for ( i = 0; i < numParticles; i++ )
+		{
+			if ( aSoASpeed[i] != 0.0f )
 			{
-				int32 nSinCosIndex = particle->m_nCurrentZRotation % SIN_COS_TABLE_SIZE;
+				CVector vecWind;
+				vecWind.x = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
+				vecWind.y = CGeneral::GetRandomNumberInRange(0.75f, 1.25f) * -CWeather::Wind;
+				vecWind.z = 0.0f;
+				vecWind *= fWindMult;
+				aSoAVelX[i] += vecWind.x;
+				aSoAVelY[i] += vecWind.y;
+				aSoAVelZ[i] += vecWind.z;
+				aSoASpeed[i] = Max(vecWind.Magnitude(), aSoASpeed[i]);
+			}
+		}
+	}
+	
+	// size
+	if ( !(psystem->Flags & SCREEN_TRAIL) )
+	{
+		float fSpeedMult = 1.0f;
+		if ( psystem->m_Type == PARTICLE_EXHAUST_FUMES || psystem->m_Type == PARTICLE_ENGINE_STEAM )
+			fSpeedMult = 2.0f;
+		
+		for ( i = 0; i < numParticles; i++ )
+		{
+			float fExpansion = aSoAExpansionRate[i] > 0.0f ? (1.0f + aSoASpeed[i] * fSpeedMult) * aSoAExpansionRate[i] : aSoAExpansionRate[i];
+			aSoASize[i] += fExpansion;
+			aSoARemove[i] |= aSoASize[i] < 0.0f;
+		}
+	}
+	
+	// friction
+	float fFriction;
+	switch ( psystem->m_nFrictionDecceleration )
+	{
+		case 50: fFriction = fFricDeccel50; break;
+		case 80: fFriction = fFricDeccel80; break;
+		case 90: fFriction = fFricDeccel90; break;
+		case 95: fFriction = fFricDeccel95; break;
+		case 96: fFriction = fFricDeccel96; break;
+		case 99: fFriction = fFricDeccel99; break;
+		default: fFriction = 1.0f; break;
+	}
+	if ( fFriction != 1.0f )
+	{
+		for ( i = 0; i < numParticles; i++ )
+		{
+			aSoAVelX[i] *= fFriction;
+			aSoAVelY[i] *= fFriction;
+			aSoAVelZ[i] *= fFriction;
+		}
+	}
+	
+	// gravity, falling particles stop speeding up at 50 times it, rising ones at 5 times
+	float fGravity = psystem->m_fGravitationalAcceleration;
+	float fGravityStep = fGravity * fTimeStep;
+	if ( fGravity > 0.0f )
+	{
+		float fLimit = -50.0f * fGravity;
+		for ( i = 0; i < numParticles; i++ )
+			aSoAVelZ[i] = fLimit < aSoAVelZ[i] ? aSoAVelZ[i] - fGravityStep : aSoAVelZ[i];
+	}
+	else if ( fGravity < 0.0f )
+	{
+		float fLimit = -5.0f * fGravity;
+		for ( i = 0; i < numParticles; i++ )
+			aSoAVelZ[i] = fLimit > aSoAVelZ[i] ? aSoAVelZ[i] - fGravityStep : aSoAVelZ[i];
+	}
+	
+	// fading
+	for ( i = 0; i < numParticles; i++ )
+	{
+		aSoAColorIntensity[i] = clamp(aSoAColorIntensity[i] - aSoAFadeToBlackTimer[i], 0, 255);
+		aSoAAlpha[i] = clamp(aSoAAlpha[i] - aSoAFadeAlphaTimer[i], 0, 255);
+		aSoARemove[i] |= aSoAAlpha[i] == 0;
+	}
+	
+	// Write the survivors back and take the rest out of the list. What's left only
+	// has branches that are the same for the whole system or rarely taken.
+	CParticle *prevParticle = nil;
+	for ( i = 0; i < numParticles; i++ )
+	{
+		CParticle *particle = aSoAParticle[i];
+		
+		if ( aSoARemove[i] )
+		{
+			RemoveParticle(particle, prevParticle, psystem);
+			continue;
+		}
+		prevParticle = particle;
+		
+		if ( particle->m_nTimeWhenColorWillBeChanged != 0 )
+		{
+			if ( particle->m_nTimeWhenColorWillBeChanged > nTime )
+			{
+				float colorMul = 1.0f - float(particle->m_nTimeWhenColorWillBeChanged - nTime) / float(psystem->m_ColorFadeTime);
 				
-				float fX = (Cos(nSinCosIndex) - Sin(nSinCosIndex)) * particle->m_fCurrentZRadius;
+				particle->m_Color.red = clamp(
+					psystem->m_RenderColouring.red + int32(float(psystem->m_FadeDestinationColor.red - psystem->m_RenderColouring.red) * colorMul),
+					0, 255);
 				
-				float fY = (Sin(nSinCosIndex) + Cos(nSinCosIndex)) * particle->m_fCurrentZRadius;
-
-				vecPos -= particle->m_vecParticleMovementOffset;
-
-				vecPos += CVector(fX, fY, 0.0f);
+				particle->m_Color.green = clamp(
+					psystem->m_RenderColouring.green + int32(float(psystem->m_FadeDestinationColor.green - psystem->m_RenderColouring.green) * colorMul),
+					0, 255);
+					
+				particle->m_Color.blue = clamp(
+					psystem->m_RenderColouring.blue + int32(float(psystem->m_FadeDestinationColor.blue - psystem->m_RenderColouring.blue) * colorMul),
+					0, 255);
+			}
+			else
+				RwRGBAAssign(&particle->m_Color, psystem->m_FadeDestinationColor);
+		}
+		
+		particle->m_vecVelocity = CVector(aSoAVelX[i], aSoAVelY[i], aSoAVelZ[i]);
+		particle->m_fSize = aSoASize[i];
+		particle->m_nAlpha = aSoAAlpha[i];
+		particle->m_nColorIntensity = aSoAColorIntensity[i];
+		
+		if ( psystem->m_nZRotationAngleChangeAmount != 0 )
+		{
+			if ( particle->m_nZRotationTimer >= psystem->m_nZRotationChangeTime )
+			{
+				particle->m_nZRotationTimer = 0;
+				particle->m_nCurrentZRotation += psystem->m_nZRotationAngleChangeAmount;
+			}
+			else
+				++particle->m_nZRotationTimer;
+		}
+		
+		if ( psystem->m_fZRadiusChangeAmount != 0.0f )
+		{
+			if ( particle->m_nZRadiusTimer >= psystem->m_nZRadiusChangeTime )
+			{
+				particle->m_nZRadiusTimer = 0;
+				particle->m_fCurrentZRadius += psystem->m_fZRadiusChangeAmount;
+			}
+			else
+				++particle->m_nZRadiusTimer;
+		}
+		
+		if ( psystem->m_nAnimationSpeed != 0 )
+		{
+			if ( particle->m_nAnimationSpeedTimer > psystem->m_nAnimationSpeed )
+			{
+				particle->m_nAnimationSpeedTimer = 0;
 				
-				particle->m_vecParticleMovementOffset = CVector(fX, fY, 0.0f);
+				if ( ++particle->m_nCurrentFrame > psystem->m_nFinalAnimationFrame )
+				{
+					if ( psystem->Flags & CYCLE_ANIM )
+						particle->m_nCurrentFrame = psystem->m_nStartAnimationFrame;
+					else
+						--particle->m_nCurrentFrame;
+				}
 			}
+			else
+				++particle->m_nAnimationSpeedTimer;
+		}
+		
+		if ( particle->m_nRotationStep != 0 )
+#ifdef FIX_BUGS
+			particle->m_nRotation = CGeneral::LimitAngle(particle->m_nRotation + particle->m_nRotationStep);
+#else
+			particle->m_nRotation += particle->m_nRotationStep;
+#endif
+		
+		CVector vecPos(aSoAPosX[i], aSoAPosY[i], aSoAPosZ[i]);
+		
+		if ( particle->m_fCurrentZRadius != 0.0f )
+		{
+			int32 nSinCosIndex = particle->m_nCurrentZRotation % SIN_COS_TABLE_SIZE;
+			
+			float fX = (Cos(nSinCosIndex) - Sin(nSinCosIndex)) * particle->m_fCurrentZRadius;
 			
-			particle->m_vecPosition = vecPos;
+			float fY = (Sin(nSinCosIndex) + Cos(nSinCosIndex)) * particle->m_fCurrentZRadius;
+			
+			vecPos -= particle->m_vecParticleMovementOffset;
+			
+			vecPos += CVector(fX, fY, 0.0f);
+			
+			particle->m_vecParticleMovementOffset = CVector(fX, fY, 0.0f);
 		}
+		
+		particle->m_vecPosition = vecPos;
+	}
+}
+
+#define PARTICLE_BENCHMARK_UPDATES 32
+
+static CParticle aBenchmarkParticles[MAX_PARTICLES_ON_SCREEN];
+static CParticle aBenchmarkStart[MAX_PARTICLES_ON_SCREEN];
+
+static void
+SetUpBenchmarkParticles(tParticleSystemData *psystem, int32 numParticles)
+{
+	for ( int32 i = 0; i < numParticles; i++ )
+	{
+		CParticle *particle = &aBenchmarkStart[i];
+		particle->m_vecPosition = CVector(CGeneral::GetRandomNumberInRange(-50.0f, 50.0f),
+		                                  CGeneral::GetRandomNumberInRange(-50.0f, 50.0f),
+		                                  CGeneral::GetRandomNumberInRange(0.0f, 20.0f));
+		particle->m_vecVelocity = CVector(CGeneral::GetRandomNumberInRange(-0.1f, 0.1f),
+		                                  CGeneral::GetRandomNumberInRange(-0.1f, 0.1f),
+		                                  CGeneral::GetRandomNumberInRange(-0.1f, 0.1f));
+		// nothing may die, it would end up in the unused list of the real particles
+		particle->m_nTimeWhenWillBeDestroyed = CTimer::GetTimeInMilliseconds() + 1000000;
+		particle->m_nTimeWhenColorWillBeChanged = 0;
+		particle->m_fZGround = 0.0f;
+		particle->m_vecParticleMovementOffset = CVector(0.0f, 0.0f, 0.0f);
+		particle->m_nCurrentZRotation = psystem->m_nZRotationInitialAngle;
+		particle->m_nZRotationTimer = 0;
+		particle->m_fCurrentZRadius = psystem->m_fInitialZRadius;
+		particle->m_nZRadiusTimer = 0;
+		particle->m_nColorIntensity = 255;
+		particle->m_nAlpha = 255;
+		particle->m_fSize = 1.0f;
+		particle->m_fExpansionRate = Abs(psystem->m_fExpansionRate);
+		particle->m_nFadeToBlackTimer = 1;
+		particle->m_nFadeAlphaTimer = 0;
+		particle->m_nAnimationSpeedTimer = 0;
+		particle->m_nRotationStep = 1;
+		particle->m_nRotation = 0;
+		particle->m_nCurrentFrame = psystem->m_nStartAnimationFrame;
+		RwRGBAAssign(&particle->m_Color, psystem->m_RenderColouring);
+		particle->m_pNext = i == numParticles - 1 ? nil : &aBenchmarkParticles[i + 1];
+	}
+}
+
+static uint32
+RunParticleBenchmark(tParticleSystemData *psystem, int32 numParticles, bool bSoA)
+{
+	for ( int32 i = 0; i < numParticles; i++ )
+		aBenchmarkParticles[i] = aBenchmarkStart[i];
+	psystem->m_pParticles = aBenchmarkParticles;
+	
+	uint32 nStart = CTimer::GetCurrentTimeInCycles();
+	for ( int32 i = 0; i < PARTICLE_BENCHMARK_UPDATES; i++ )
+	{
+		if ( bSoA )
+			CParticle::UpdateSystemSoA(psystem);
+		else
+			CParticle::UpdateSystem(psystem);
 	}
+	return CTimer::GetCurrentTimeInCycles() - nStart;
 }
 
+// Times both updates on a copy of a particle system with more and more particles in it
+void BenchmarkParticles(void)
+{
+	static const int32 aCounts[] = { 50, 100, 200, 400, MAX_PARTICLES_ON_SCREEN };
+	tParticleSystemData *pSource = nil;
+	
+	for ( int32 i = 0; i < MAX_PARTICLES; i++ )
+	{
+		tParticleSystemData *psystem = &mod_ParticleSystemManager.m_aParticles[i];
+		if ( !CParticle::CanUseSoAUpdate(psystem) )
+			continue;
+		// prefer one that falls and slows down, so every kernel has work to do
+		if ( pSource == nil )
+			pSource = psystem;
+		if ( psystem->m_fGravitationalAcceleration != 0.0f && psystem->m_nFrictionDecceleration != 0 )
+		{
+			pSource = psystem;
+			break;
+		}
+	}
+	if ( pSource == nil )
+		return;
+	
+	tParticleSystemData system = *pSource;
+	system.Flags &= ~CLIPOUT2D;
+	
+	// wind takes random numbers, the two updates wouldn't get the same ones
+	float fWind = CWeather::Wind;
+	CWeather::Wind = 0.0f;
+	
+	uint32 nCyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+	debug("Particle benchmark: %s, %d updates\n", system.m_aName, PARTICLE_BENCHMARK_UPDATES);
+	for ( int32 i = 0; i < ARRAY_SIZE(aCounts); i++ )
+	{
+		int32 numParticles = aCounts[i];
+		SetUpBenchmarkParticles(&system, numParticles);
+		
+		uint32 nScalarCycles = RunParticleBenchmark(&system, numParticles, false);
+		static CParticle aScalarResult[MAX_PARTICLES_ON_SCREEN];
+		for ( int32 j = 0; j < numParticles; j++ )
+			aScalarResult[j] = aBenchmarkParticles[j];
+		
+		uint32 nSoACycles = RunParticleBenchmark(&system, numParticles, true);
+		
+		float fMaxError = 0.0f;
+		for ( int32 j = 0; j < numParticles; j++ )
+			fMaxError = Max(fMaxError, (aScalarResult[j].m_vecPosition - aBenchmarkParticles[j].m_vecPosition).Magnitude());
+		
+		debug("%4d particles: scalar %6dus, SoA %6dus, largest difference %f\n", numParticles,
+			nScalarCycles / nCyclesPerUs, nSoACycles / nCyclesPerUs, fMaxError);
+	}
+	
+	CWeather::Wind = fWind;
+}
+#endif
+
 void CParticle::Render()
 {
 	RwRenderStateSet(rwRENDERSTATETEXTUREADDRESS, (void *)rwTEXTUREADDRESSWRAP);
@@ -1800,6 +2276,13 @@ void CParticle::Render()
 	
 	RwRaster *prevFrame = nil;
 	
+#ifdef PARTICLE_BATCHING
+	bool bPrevTop2D = false;
+	int32 nStartDraws = CSprite::ms_nNumSpriteDraws;
+	int32 nStartSprites = CSprite::ms_nNumSpritesDrawn;
+	int32 nTextureChanges = 0;
+#endif
+	
 	for ( int32 i = 0; i < MAX_PARTICLES; i++ )
 	{
 		tParticleSystemData *psystem = &mod_ParticleSystemManager.m_aParticles[i];
@@ -1823,6 +2306,14 @@ void CParticle::Render()
 
 		if ( particle )
 		{
+#ifdef PARTICLE_BATCHING
+			// 2D and 3D sprites are flushed with different z test, they can't share a batch
+			if ( bPrevTop2D != !!(psystem->Flags & DRAWTOP2D) )
+			{
+				CSprite::FlushSpriteBuffer();
+				bPrevTop2D = !!(psystem->Flags & DRAWTOP2D);
+			}
+#endif
 			if ( (flags & DRAW_OPAQUE) != (psystem->Flags & DRAW_OPAQUE)
 				|| (flags & DRAW_DARK) != (psystem->Flags & DRAW_DARK) )
 			{
@@ -1854,10 +2345,22 @@ void CParticle::Render()
 					CSprite::FlushSpriteBuffer();
 					RwRenderStateSet(rwRENDERSTATETEXTURERASTER, (void *)curFrame);
 					prevFrame = curFrame;
+#ifdef PARTICLE_BATCHING
+					nTextureChanges++;
+#endif
 				}
 			}
 		}
 		
+#ifdef PARTICLE_BATCHING
+		// Additive particles can be drawn in any order, so an animated system is drawn
+		// one frame at a time instead of switching textures from particle to particle
+		int32 nPass = 0;
+		int32 nLastPass = 0;
+		if ( bBatchRender && !(psystem->Flags & DRAW_OPAQUE) && psystem->m_nFinalAnimationFrame != 0 && frames != nil )
+			nLastPass = psystem->m_nFinalAnimationFrame;
+#endif
+		
 		while ( particle != nil )
 		{
 			bool canDraw = true;
@@ -1865,6 +2368,11 @@ void CParticle::Render()
 			if ( particle->m_nAlpha == 0 )
 				canDraw = false;
 			
+#ifdef PARTICLE_BATCHING
+			if ( nLastPass != 0 && Min(particle->m_nCurrentFrame, nLastPass) != nPass )
+				canDraw = false;
+#endif
+			
 			if ( canDraw && psystem->m_nFinalAnimationFrame != 0 && frames != nil )
 			{
 				RwRaster *curFrame = frames[particle->m_nCurrentFrame];
@@ -1873,6 +2381,9 @@ void CParticle::Render()
 					CSprite::FlushSpriteBuffer();
 					RwRenderStateSet(rwRENDERSTATETEXTURERASTER, (void *)curFrame);
 					prevFrame = curFrame;
+#ifdef PARTICLE_BATCHING
+					nTextureChanges++;
+#endif
 				}
 			}
 			
@@ -2272,12 +2783,37 @@ void CParticle::Render()
 			}
 			
 			particle = particle->m_pNext;
+#ifdef PARTICLE_BATCHING
+			if ( particle == nil && nPass < nLastPass )
+			{
+				nPass++;
+				particle = psystem->m_pParticles;
+			}
+#endif
 		}
 
+#ifdef PARTICLE_BATCHING
+		// whatever changes state next flushes first, until then the next system goes in the same batch
+		if ( !bBatchRender )
+			CSprite::FlushSpriteBuffer();
+#else
 		CSprite::FlushSpriteBuffer();
+#endif
 
 	}
 	
+#ifdef PARTICLE_BATCHING
+	CSprite::FlushSpriteBuffer();
+	
+	if ( bShowRenderStats )
+	{
+		char str[128];
+		sprintf(str, "PARTICLE RENDER %d SPRITES %d DRAWS %d TEXTURE CHANGES",
+			CSprite::ms_nNumSpritesDrawn - nStartSprites, CSprite::ms_nNumSpriteDraws - nStartDraws, nTextureChanges);
+		CDebug::PrintAt(str, 2, 32);
+	}
+#endif
+	
 	RwRenderStateSet(rwRENDERSTATEVERTEXALPHAENABLE, (void *)FALSE);
 	RwRenderStateSet(rwRENDERSTATEZWRITEENABLE, (void *)TRUE);
 	RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void *)TRUE);
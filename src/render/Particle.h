@@ -66,7 +66,18 @@ public:
 	static CParticle *AddParticle(tParticleType type, CVector const &vecPos, CVector const &vecDir, CEntity *pEntity,       float fSize, RwRGBA const &color, int32 nRotationSpeed = 0, int32 nRotation = 0, int32 nCurFrame = 0, int32 nLifeSpan = 0);
 
 	static void Update();
+	static void UpdateSystem(tParticleSystemData *psystem);
+#ifdef PARTICLE_SOA_UPDATE
+	static bool bUseSoAUpdate;
+	static bool bShowStats;
+	static bool CanUseSoAUpdate(tParticleSystemData *psystem);
+	static void UpdateSystemSoA(tParticleSystemData *psystem);
+#endif
 	static void Render();
+#ifdef PARTICLE_BATCHING
+	static bool bBatchRender;
+	static bool bShowRenderStats;
+#endif
 
 	static void RemovePSystem(tParticleType type);
 	static void RemoveParticle(CParticle *pParticle, CParticle *pPrevParticle, tParticleSystemData *pPSystemData);
@@ -105,4 +116,8 @@ extern RwRaster *gpDotRaster;
 extern RwRaster *gpRainDripRaster[];
 extern RwRaster *gpRainDripDarkRaster[];
 
+#ifdef PARTICLE_SOA_UPDATE
+void BenchmarkParticles(void);
+#endif
+
 VALIDATE_SIZE(CParticle, 0x58);
@@ -10,15 +10,40 @@
 #include "Sprite.h"
 #include "Timer.h"
 #include "PointLights.h"
+#ifdef CLUSTERED_POINT_LIGHTS
+#include "Debug.h"
+#endif
 
 //--MIAMI: file done
 
 int16 CPointLights::NumLights;
-CRegisteredPointLight CPointLights::aLights[NUMPOINTLIGHTS];
+CRegisteredPointLight CPointLights::aLights[MAX_POINTLIGHTS];
 CVector CPointLights::aCachedMapReads[32];
 float CPointLights::aCachedMapReadResults[32];
 int32 CPointLights::NextCachedValue;
 
+#ifdef CLUSTERED_POINT_LIGHTS
+// A grid of cells around the camera, every cell has a bit for each light that reaches into it.
+// Lights only get added within MAX_DIST of the camera, so the grid covers those plus
+// their radius. Lights that still reach out of it are tested everywhere.
+#define LIGHTCLUSTER_CELL_SIZE 8.0f
+#define LIGHTCLUSTER_NUM_CELLS 12	// per side
+#define LIGHTMASK_WORDS ((MAX_POINTLIGHTS + 31) / 32)
+
+bool CPointLights::bUseClusters = true;
+bool CPointLights::bShowStats;
+
+uint32 aLightClusterMasks[LIGHTCLUSTER_NUM_CELLS][LIGHTCLUSTER_NUM_CELLS][LIGHTMASK_WORDS];
+uint32 aLightsOutsideClusters[LIGHTMASK_WORDS];
+float LightClusterMinX, LightClusterMinY;
+int16 NumClusteredLights = -1;	// NumLights when the grid was built, -1 if it has to be built again
+
+int32 nLitObjects;
+int32 nLightTests;
+int32 nLightTestsWithoutClusters;
+int32 nFogLightsCulled;
+#endif
+
 void
 CPointLights::Init(void)
 {
@@ -33,6 +58,20 @@ void
 CPointLights::InitPerFrame(void)
 {
 	NumLights = 0;
+#ifdef CLUSTERED_POINT_LIGHTS
+	NumClusteredLights = -1;
+
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "POINT LIGHTS OBJECTS LIT %d LIGHT TESTS %d (%d WITHOUT CLUSTERS) FOG CULLED %d",
+			nLitObjects, nLightTests, nLightTestsWithoutClusters, nFogLightsCulled);
+		CDebug::PrintAt(str, 2, 35);
+	}
+	nLitObjects = 0;
+	nLightTests = 0;
+	nLightTestsWithoutClusters = 0;
+	nFogLightsCulled = 0;
+#endif
 }
 
 #define MAX_DIST 22.0f
@@ -45,7 +84,7 @@ CPointLights::AddLight(uint8 type, CVector coors, CVector dir, float radius, flo
 
 	// The check is done in some weird way in the game
 	// we're doing it a bit better here
-	if(NumLights >= NUMPOINTLIGHTS)
+	if(NumLights >= MAX_POINTLIGHTS)
 		return;
 
 	dist = coors - TheCamera.GetPosition();
@@ -82,7 +121,33 @@ CPointLights::GenerateLightsAffectingObject(Const CVector *objCoors)
 	float radius, distance;
 
 	ret = 1.0f;
+#ifdef CLUSTERED_POINT_LIGHTS
+	// lights are added while the game is processed, build the grid once they're all in
+	uint32 mask[LIGHTMASK_WORDS];
+	if(bUseClusters){
+		if(NumClusteredLights != NumLights)
+			BuildClusters();
+		int32 cellX = Floor((objCoors->x - LightClusterMinX) / LIGHTCLUSTER_CELL_SIZE);
+		int32 cellY = Floor((objCoors->y - LightClusterMinY) / LIGHTCLUSTER_CELL_SIZE);
+		bool bInGrid = cellX >= 0 && cellX < LIGHTCLUSTER_NUM_CELLS && cellY >= 0 && cellY < LIGHTCLUSTER_NUM_CELLS;
+		for(i = 0; i < LIGHTMASK_WORDS; i++)
+			mask[i] = aLightsOutsideClusters[i] | (bInGrid ? aLightClusterMasks[cellY][cellX][i] : 0);
+	}
+	nLitObjects++;
+	nLightTestsWithoutClusters += NumLights;
+#endif
 	for(i = 0; i < NumLights; i++){
+#ifdef CLUSTERED_POINT_LIGHTS
+		if(bUseClusters){
+			if(mask[i>>5] == 0){
+				i |= 31;	// none in this word
+				continue;
+			}
+			if((mask[i>>5] & (1u<<(i&31))) == 0)
+				continue;
+		}
+		nLightTests++;
+#endif
 		if(aLights[i].type == LIGHT_FOGONLY || aLights[i].type == LIGHT_FOGONLY_ALWAYS)
 			continue;
 
@@ -129,6 +194,40 @@ CPointLights::GenerateLightsAffectingObject(Const CVector *objCoors)
 	return ret;
 }
 
+#ifdef CLUSTERED_POINT_LIGHTS
+void
+CPointLights::BuildClusters(void)
+{
+	int i, x, y;
+
+	memset(aLightClusterMasks, 0, sizeof(aLightClusterMasks));
+	memset(aLightsOutsideClusters, 0, sizeof(aLightsOutsideClusters));
+	LightClusterMinX = TheCamera.GetPosition().x - LIGHTCLUSTER_NUM_CELLS*LIGHTCLUSTER_CELL_SIZE/2.0f;
+	LightClusterMinY = TheCamera.GetPosition().y - LIGHTCLUSTER_NUM_CELLS*LIGHTCLUSTER_CELL_SIZE/2.0f;
+
+	for(i = 0; i < NumLights; i++){
+		// these don't light anything
+		if(aLights[i].type == LIGHT_FOGONLY || aLights[i].type == LIGHT_FOGONLY_ALWAYS)
+			continue;
+
+		float radius = aLights[i].radius;
+		int32 minX = Floor((aLights[i].coors.x - radius - LightClusterMinX) / LIGHTCLUSTER_CELL_SIZE);
+		int32 minY = Floor((aLights[i].coors.y - radius - LightClusterMinY) / LIGHTCLUSTER_CELL_SIZE);
+		int32 maxX = Floor((aLights[i].coors.x + radius - LightClusterMinX) / LIGHTCLUSTER_CELL_SIZE);
+		int32 maxY = Floor((aLights[i].coors.y + radius - LightClusterMinY) / LIGHTCLUSTER_CELL_SIZE);
+		if(minX < 0 || minY < 0 || maxX >= LIGHTCLUSTER_NUM_CELLS || maxY >= LIGHTCLUSTER_NUM_CELLS){
+			aLightsOutsideClusters[i>>5] |= 1u<<(i&31);
+			continue;
+		}
+		for(y = minY; y <= maxY; y++)
+			for(x = minX; x <= maxX; x++)
+				aLightClusterMasks[y][x][i>>5] |= 1u<<(i&31);
+	}
+
+	NumClusteredLights = NumLights;
+}
+#endif
+
 extern RwRaster *gpPointlightRaster;
 
 void
@@ -142,6 +241,10 @@ CPointLights::RemoveLightsAffectingObject(void)
 #define FOG_AREA_WIDTH 5.0f
 // for pointlight fog
 #define FOG_AREA_RADIUS 9.0f
+#ifdef CLUSTERED_POINT_LIGHTS
+// the sprites go down to the ground, up to 20 units below the light
+#define FOG_CULL_RADIUS 20.0f
+#endif
 
 float FogSizes[8] = { 1.3f, 2.0f, 1.7f, 2.0f, 1.4f, 2.1f, 1.5f, 2.3f };
 
@@ -254,6 +357,13 @@ CPointLights::RenderFogEffect(void)
 			}
 
 		}else if(aLights[i].type == LIGHT_POINT || aLights[i].type == LIGHT_FOGONLY || aLights[i].type == LIGHT_FOGONLY_ALWAYS){
+#ifdef CLUSTERED_POINT_LIGHTS
+			// don't look for the ground under fog nobody can see
+			if(bUseClusters && !TheCamera.IsSphereVisible(aLights[i].coors - CVector(0.0f, 0.0f, 10.0f), FOG_CULL_RADIUS)){
+				nFogLightsCulled++;
+				continue;
+			}
+#endif
 			float groundZ;
 			if(ProcessVerticalLineUsingCache(aLights[i].coors, &groundZ)){
 				xmin = aLights[i].coors.x - FOG_AREA_RADIUS;
@@ -1,5 +1,12 @@
 #pragma once
 
+#ifdef CLUSTERED_POINT_LIGHTS
+// lights are looked up in a grid around the camera, so there can be many more of them
+#define MAX_POINTLIGHTS 128
+#else
+#define MAX_POINTLIGHTS NUMPOINTLIGHTS
+#endif
+
 class CRegisteredPointLight
 {
 public:
@@ -19,7 +26,7 @@ class CPointLights
 {
 public:
 	static int16 NumLights;
-	static CRegisteredPointLight aLights[NUMPOINTLIGHTS];
+	static CRegisteredPointLight aLights[MAX_POINTLIGHTS];
 	static CVector aCachedMapReads[32];
 	static float aCachedMapReadResults[32];
 	static int32 NextCachedValue;
@@ -47,4 +54,9 @@ public:
 	static void RemoveLightsAffectingObject(void);
 	static void RenderFogEffect(void);
 	static bool ProcessVerticalLineUsingCache(CVector coors, float *groundZ);
+#ifdef CLUSTERED_POINT_LIGHTS
+	static bool bUseClusters;
+	static bool bShowStats;
+	static void BuildClusters(void);
+#endif
 };
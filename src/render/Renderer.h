@@ -92,6 +92,9 @@ public:
 
 	static void RemoveVehiclePedLights(CEntity *ent, bool reset);
 
+	static int32 GetNumVisibleEntities(void) { return ms_nNoOfVisibleEntities; }
+	static CEntity *GetVisibleEntity(int32 i) { return ms_aVisibleEntityPtrs[i]; }
+
 
 #ifdef NEW_RENDERER
 	static void ClearForFrame(void);
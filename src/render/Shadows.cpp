@@ -26,6 +26,10 @@
 #include "CutsceneShadow.h"
 #include "Clock.h"
 #include "VarConsole.h"
+#include "Debug.h"
+#ifdef SHADOW_MAPS
+#include "custompipes.h"
+#endif
 
 #ifdef DEBUGMENU
 SETTWEAKPATH("Shadows");
@@ -34,6 +38,115 @@ TWEAKBOOL(gbPrintShite);
 
 RwImVertexIndex ShadowIndexList[24];
 
+#ifdef SHADOW_RECEIVER_CACHE
+/*
+ A shadow only falls on the few collision triangles of a building that are under it, but
+ CastShadowEntityXY used to look at all of them for every shadow every frame. The triangles
+ facing up inside the shadow's box, made bigger by SHADOWCACHE_MARGIN, are remembered for
+ the building, and while the shadow stays inside that box only those are looked at. They
+ still get tested against the real box, so the polys come out the same.
+*/
+#define SHADOWCACHE_SIZE 256	// power of two
+#define SHADOWCACHE_WAYS 4	// entries a building can go in
+#define SHADOWCACHE_MAX_TRIANGLES 64
+#define SHADOWCACHE_MARGIN 2.0f
+
+struct tShadowReceiverCache
+{
+	CEntity *pEntity;
+	CVector vecEntityPos;	// a new building can end up at the same address
+	int16 nModelIndex;
+	int16 nNumColTriangles;
+	int16 nNumTriangles;	// -1 if there were too many to remember
+	uint32 nLastUsedFrame;
+	CVector vecMin;	// in the space of the building
+	CVector vecMax;
+	uint16 aTriangles[SHADOWCACHE_MAX_TRIANGLES];
+};
+
+tShadowReceiverCache aShadowReceiverCache[SHADOWCACHE_SIZE];
+
+bool CShadows::bUseReceiverCache = true;
+bool CShadows::bShowStats;
+
+int32 nShadowCacheHits;
+int32 nShadowCacheMisses;
+int32 nShadowTrianglesTested;
+int32 nShadowPolysGenerated;
+
+static tShadowReceiverCache *
+GetShadowReceiverCache(CEntity *pEntity, CColModel *pCol, const CVector &vecMin, const CVector &vecMax)
+{
+	int32 first = (((uintptr)pEntity >> 4) & (SHADOWCACHE_SIZE/SHADOWCACHE_WAYS - 1)) * SHADOWCACHE_WAYS;
+	tShadowReceiverCache *pOldest = nil;
+	const CVector &pos = pEntity->GetPosition();
+
+	for ( int32 i = first; i < first + SHADOWCACHE_WAYS; i++ )
+	{
+		tShadowReceiverCache *pCache = &aShadowReceiverCache[i];
+
+		if ( pCache->pEntity == pEntity
+			&& pCache->nModelIndex == pEntity->GetModelIndex()
+			&& pCache->nNumColTriangles == pCol->numTriangles
+			&& pCache->vecEntityPos.x == pos.x && pCache->vecEntityPos.y == pos.y && pCache->vecEntityPos.z == pos.z
+			&& pCache->vecMin.x <= vecMin.x && pCache->vecMin.y <= vecMin.y && pCache->vecMin.z <= vecMin.z
+			&& pCache->vecMax.x >= vecMax.x && pCache->vecMax.y >= vecMax.y && pCache->vecMax.z >= vecMax.z )
+		{
+			nShadowCacheHits++;
+			pCache->nLastUsedFrame = CTimer::GetFrameCounter();
+			return pCache->nNumTriangles < 0 ? nil : pCache;
+		}
+
+		if ( pOldest == nil || (pOldest->pEntity != nil && (pCache->pEntity == nil || pCache->nLastUsedFrame < pOldest->nLastUsedFrame)) )
+			pOldest = pCache;
+	}
+
+	nShadowCacheMisses++;
+
+	tShadowReceiverCache *pCache = pOldest;
+	pCache->pEntity = pEntity;
+	pCache->vecEntityPos = pos;
+	pCache->nModelIndex = pEntity->GetModelIndex();
+	pCache->nNumColTriangles = pCol->numTriangles;
+	pCache->nNumTriangles = 0;
+	pCache->nLastUsedFrame = CTimer::GetFrameCounter();
+	pCache->vecMin = vecMin - CVector(SHADOWCACHE_MARGIN, SHADOWCACHE_MARGIN, SHADOWCACHE_MARGIN);
+	pCache->vecMax = vecMax + CVector(SHADOWCACHE_MARGIN, SHADOWCACHE_MARGIN, SHADOWCACHE_MARGIN);
+
+	// the same tests as CastShadowEntityXY, with the bigger box
+	for ( int32 i = 0; i < pCol->numTriangles; i++ )
+	{
+		CVector normal;
+		pCol->trianglePlanes[i].GetNormal(normal);
+		if ( Abs(normal.z) <= 0.1f )
+			continue;
+
+		CVector PointA, PointB, PointC;
+		pCol->GetTrianglePoint(PointA, pCol->triangles[i].a);
+		pCol->GetTrianglePoint(PointB, pCol->triangles[i].b);
+		pCol->GetTrianglePoint(PointC, pCol->triangles[i].c);
+
+		if (   (PointA.x > pCache->vecMin.x || PointB.x > pCache->vecMin.x || PointC.x > pCache->vecMin.x)
+			&& (PointA.x < pCache->vecMax.x || PointB.x < pCache->vecMax.x || PointC.x < pCache->vecMax.x)
+			&& (PointA.y > pCache->vecMin.y || PointB.y > pCache->vecMin.y || PointC.y > pCache->vecMin.y)
+			&& (PointA.y < pCache->vecMax.y || PointB.y < pCache->vecMax.y || PointC.y < pCache->vecMax.y)
+			&& (PointA.z < pCache->vecMax.z || PointB.z < pCache->vecMax.z || PointC.z < pCache->vecMax.z)
+			&& (PointA.z > pCache->vecMin.z || PointB.z > pCache->vecMin.z || PointC.z > pCache->vecMin.z) )
+		{
+			if ( pCache->nNumTriangles == SHADOWCACHE_MAX_TRIANGLES )
+			{
+				// don't try again every frame, just look at all of them
+				pCache->nNumTriangles = -1;
+				return nil;
+			}
+			pCache->aTriangles[pCache->nNumTriangles++] = i;
+		}
+	}
+
+	return pCache;
+}
+#endif
+
 RwTexture *gpShadowCarTex;
 RwTexture *gpShadowPedTex;
 RwTexture *gpShadowHeliTex;
@@ -490,6 +603,12 @@ CShadows::StoreShadowForVehicle(CVehicle *pCar, VEH_SHD_TYPE type)
 {
 	ASSERT(pCar != nil);
 
+#ifdef SHADOW_MAPS
+	// rendered into the shadow maps instead
+	if ( CustomPipes::ShadowMapsActive() )
+		return;
+#endif
+
 	if ( CTimeCycle::GetShadowStrength() != 0 )
 	{
 		CVector CarPos = pCar->GetPosition();
@@ -857,6 +976,12 @@ CShadows::StoreShadowForPed(CPed *pPed, float fDisplacementX, float fDisplacemen
 {
 	ASSERT(pPed != nil);
 
+#ifdef SHADOW_MAPS
+	// rendered into the shadow maps instead
+	if ( CustomPipes::ShadowMapsActive() )
+		return;
+#endif
+
 	if ( pPed->bIsVisible )
 	{
 		if ( !(pPed->bInVehicle && pPed->m_nPedState != PED_DRAG_FROM_CAR && pPed->m_nPedState != PED_EXIT_CAR) )
@@ -1011,6 +1136,12 @@ CShadows::StoreShadowForPole(CEntity *pPole, float fOffsetX, float fOffsetY, flo
 {
 	ASSERT(pPole != nil);
 
+#ifdef SHADOW_MAPS
+	// rendered into the shadow maps instead
+	if ( CustomPipes::ShadowMapsActive() )
+		return;
+#endif
+
 	if ( CTimeCycle::GetShadowStrength() != 0 )
 	{
 		if ( pPole->GetUp().z < 0.5f )
@@ -1068,6 +1199,21 @@ CShadows::SetRenderModeForShadowType(uint8 ShadowType)
 void
 CShadows::RenderStoredShadows(void)
 {
+#ifdef SHADOW_RECEIVER_CACHE
+	// static shadows are generated during the frame, so this is the whole of the last one
+	if ( bShowStats )
+	{
+		char str[128];
+		sprintf(str, "SHADOW RECEIVERS HITS %d MISSES %d TRIANGLES TESTED %d POLYS %d",
+			nShadowCacheHits, nShadowCacheMisses, nShadowTrianglesTested, nShadowPolysGenerated);
+		CDebug::PrintAt(str, 2, 33);
+	}
+	nShadowCacheHits = 0;
+	nShadowCacheMisses = 0;
+	nShadowTrianglesTested = 0;
+	nShadowPolysGenerated = 0;
+#endif
+
 	RenderBuffer::ClearRenderBuffer();
 
 	RwRenderStateSet(rwRENDERSTATEZWRITEENABLE,      (void *)FALSE);
@@ -1593,8 +1739,21 @@ CShadows::CastShadowEntityXY(CEntity *pEntity,  float fStartX, float fStartY, fl
 	float MaxZ = pPosn->z - pEntity->GetPosition().z;
 	float MinZ = MaxZ - fZDistance;
 
+#ifdef SHADOW_RECEIVER_CACHE
+	tShadowReceiverCache *pCache = nil;
+	if ( bUseReceiverCache )
+		pCache = GetShadowReceiverCache(pEntity, pCol, CVector(MinX, MinY, MinZ), CVector(MaxX, MaxY, MaxZ));
+
+	int32 numTriangles = pCache ? pCache->nNumTriangles : pCol->numTriangles;
+	nShadowTrianglesTested += numTriangles;
+
+	for ( int32 t = 0; t < numTriangles; t++ )
+	{
+		int32 i = pCache ? pCache->aTriangles[t] : t;
+#else
 	for ( int32 i = 0; i < pCol->numTriangles; i++ )
 	{
+#endif
 		CColTrianglePlane *pColTriPlanes = pCol->trianglePlanes;
 		ASSERT(pColTriPlanes != nil);
 
@@ -1978,6 +2137,9 @@ CShadows::CastShadowEntityXY(CEntity *pEntity,  float fStartX, float fStartY, fl
 					
 				if ( numVerts3 >= 3 )
 				{
+#ifdef SHADOW_RECEIVER_CACHE
+					nShadowPolysGenerated++;
+#endif
 					CVector norm;
 
 					pColTriPlanes[i].GetNormal(norm);
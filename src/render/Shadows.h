@@ -150,6 +150,10 @@ public:
 	static CStaticShadow    aStaticShadows   [MAX_STATICSHADOWS];
 	static CPolyBunch      *pEmptyBunchList;
 	static CPermanentShadow aPermanentShadows[MAX_PERMAMENTSHADOWS];
+#ifdef SHADOW_RECEIVER_CACHE
+	static bool bUseReceiverCache;
+	static bool bShowStats;
+#endif
 
 	static void Init                           (void);
 	static void Shutdown                       (void);
@@ -9,6 +9,10 @@ float CSprite::m_f2DNearScreenZ;
 float CSprite::m_f2DFarScreenZ;
 float CSprite::m_fRecipNearClipPlane;
 int32 CSprite::m_bFlushSpriteBufferSwitchZTest;
+#ifdef PARTICLE_BATCHING
+int32 CSprite::ms_nNumSpriteDraws;
+int32 CSprite::ms_nNumSpritesDrawn;
+#endif
 
 float 
 CSprite::CalcHorizonCoors(void)
@@ -43,7 +47,11 @@ CSprite::CalcScreenCoors(const RwV3d &in, RwV3d *out, float *outw, float *outh,
 	return true;
 }
 
+#ifdef PARTICLE_BATCHING
+#define SPRITEBUFFERSIZE 256	// particles of a whole system usually fit in one draw
+#else
 #define SPRITEBUFFERSIZE 64
+#endif
 static int32 nSpriteBufferIndex;
 static RwIm2DVertex SpriteBufferVerts[SPRITEBUFFERSIZE*6];
 static RwIm2DVertex verts[4];
@@ -72,6 +80,10 @@ CSprite::FlushSpriteBuffer(void)
 			RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)TRUE);
 		}else
 			RwIm2DRenderPrimitive(rwPRIMTYPETRILIST, SpriteBufferVerts, nSpriteBufferIndex*6);
+#ifdef PARTICLE_BATCHING
+		ms_nNumSpriteDraws++;
+		ms_nNumSpritesDrawn += nSpriteBufferIndex;
+#endif
 		nSpriteBufferIndex = 0;
 	}
 }
@@ -7,6 +7,10 @@ class CSprite
 	static float m_fRecipNearClipPlane;
 	static int32 m_bFlushSpriteBufferSwitchZTest;
 public:
+#ifdef PARTICLE_BATCHING
+	static int32 ms_nNumSpriteDraws;
+	static int32 ms_nNumSpritesDrawn;
+#endif
 	static float GetNearScreenZ(void) { return m_f2DNearScreenZ; }
 	static float GetFarScreenZ(void) { return m_f2DFarScreenZ; }
 
@@ -8,6 +8,7 @@
 #include "ZoneCull.h"
 #include "CutsceneMgr.h"
 #include "FileMgr.h"
+#include "Debug.h"
 #include "Timecycle.h"
 
 //--MIAMI: done
@@ -136,6 +137,97 @@ float CTimeCycle::m_fShadowSideY[16];
 float CTimeCycle::m_fShadowDisplacementX[16];
 float CTimeCycle::m_fShadowDisplacementY[16];
 
+#ifdef TIMECYCLE_CACHE
+// every table above, a keyframe has one float for each
+#define TIMECYCLE_VALUES \
+	TIMECYCLE_VALUE(m_nAmbientRed) \
+	TIMECYCLE_VALUE(m_nAmbientGreen) \
+	TIMECYCLE_VALUE(m_nAmbientBlue) \
+	TIMECYCLE_VALUE(m_nAmbientRed_Obj) \
+	TIMECYCLE_VALUE(m_nAmbientGreen_Obj) \
+	TIMECYCLE_VALUE(m_nAmbientBlue_Obj) \
+	TIMECYCLE_VALUE(m_nAmbientRed_Bl) \
+	TIMECYCLE_VALUE(m_nAmbientGreen_Bl) \
+	TIMECYCLE_VALUE(m_nAmbientBlue_Bl) \
+	TIMECYCLE_VALUE(m_nAmbientRed_Obj_Bl) \
+	TIMECYCLE_VALUE(m_nAmbientGreen_Obj_Bl) \
+	TIMECYCLE_VALUE(m_nAmbientBlue_Obj_Bl) \
+	TIMECYCLE_VALUE(m_nDirectionalRed) \
+	TIMECYCLE_VALUE(m_nDirectionalGreen) \
+	TIMECYCLE_VALUE(m_nDirectionalBlue) \
+	TIMECYCLE_VALUE(m_nSkyTopRed) \
+	TIMECYCLE_VALUE(m_nSkyTopGreen) \
+	TIMECYCLE_VALUE(m_nSkyTopBlue) \
+	TIMECYCLE_VALUE(m_nSkyBottomRed) \
+	TIMECYCLE_VALUE(m_nSkyBottomGreen) \
+	TIMECYCLE_VALUE(m_nSkyBottomBlue) \
+	TIMECYCLE_VALUE(m_nSunCoreRed) \
+	TIMECYCLE_VALUE(m_nSunCoreGreen) \
+	TIMECYCLE_VALUE(m_nSunCoreBlue) \
+	TIMECYCLE_VALUE(m_nSunCoronaRed) \
+	TIMECYCLE_VALUE(m_nSunCoronaGreen) \
+	TIMECYCLE_VALUE(m_nSunCoronaBlue) \
+	TIMECYCLE_VALUE(m_fSunSize) \
+	TIMECYCLE_VALUE(m_fSpriteSize) \
+	TIMECYCLE_VALUE(m_fSpriteBrightness) \
+	TIMECYCLE_VALUE(m_nShadowStrength) \
+	TIMECYCLE_VALUE(m_nLightShadowStrength) \
+	TIMECYCLE_VALUE(m_nPoleShadowStrength) \
+	TIMECYCLE_VALUE(m_fFogStart) \
+	TIMECYCLE_VALUE(m_fFarClip) \
+	TIMECYCLE_VALUE(m_fLightsOnGroundBrightness) \
+	TIMECYCLE_VALUE(m_nLowCloudsRed) \
+	TIMECYCLE_VALUE(m_nLowCloudsGreen) \
+	TIMECYCLE_VALUE(m_nLowCloudsBlue) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsTopRed) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsTopGreen) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsTopBlue) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsBottomRed) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsBottomGreen) \
+	TIMECYCLE_VALUE(m_nFluffyCloudsBottomBlue) \
+	TIMECYCLE_VALUE(m_fBlurRed) \
+	TIMECYCLE_VALUE(m_fBlurGreen) \
+	TIMECYCLE_VALUE(m_fBlurBlue) \
+	TIMECYCLE_VALUE(m_fWaterRed) \
+	TIMECYCLE_VALUE(m_fWaterGreen) \
+	TIMECYCLE_VALUE(m_fWaterBlue) \
+	TIMECYCLE_VALUE(m_fWaterAlpha)
+
+enum
+{
+#define TIMECYCLE_VALUE(v) TIMECYCLE_##v,
+	TIMECYCLE_VALUES
+#undef TIMECYCLE_VALUE
+	TIMECYCLE_NUM_VALUES
+};
+#define TIMECYCLE_NUM_FLOATS ((TIMECYCLE_NUM_VALUES + 3) & ~3)	// padded to whole vectors of 4
+
+struct tTimeCycleKeyframe
+{
+	float values[TIMECYCLE_NUM_FLOATS];
+};
+
+bool CTimeCycle::bCacheBlend = true;
+bool CTimeCycle::bShowStats;
+
+tTimeCycleKeyframe aTimeCycleKeyframes[MAX_TIMECYCLE_KEYFRAMES][NUMWEATHERS];
+int16 aTimeCycleKeyframeTimes[MAX_TIMECYCLE_KEYFRAMES];	// minute of the day, in order
+int32 NumTimeCycleKeyframes;
+int32 CurrentTimeCycleKeyframe;
+
+// what the last blend was done for, the minute is -1 if it has to be done again
+float aTimeCycleBlend[TIMECYCLE_NUM_FLOATS];
+int32 TimeCycleBlendMinute = -1;
+int32 TimeCycleBlendOldWeather;
+int32 TimeCycleBlendNewWeather;
+float TimeCycleBlendInterpolation;
+
+int32 nTimeCycleBlends;
+int32 nTimeCycleUpdates;
+int32 nTimeCycleLastBlends;
+int32 nTimeCycleLastUpdates;
+#endif
+
 void
 CTimeCycle::Initialise(void)
 {
@@ -263,6 +355,22 @@ CTimeCycle::Initialise(void)
 			m_fWaterAlpha[h][w] = waterA;
 		}
 
+#ifdef TIMECYCLE_CACHE
+	// one keyframe per hour and weather
+	NumTimeCycleKeyframes = NUMHOURS;
+	for(h = 0; h < NUMHOURS; h++){
+		aTimeCycleKeyframeTimes[h] = h*60;
+		for(w = 0; w < NUMWEATHERS; w++){
+			float *values = aTimeCycleKeyframes[h][w].values;
+#define TIMECYCLE_VALUE(v) values[TIMECYCLE_##v] = v[h][w];
+			TIMECYCLE_VALUES
+#undef TIMECYCLE_VALUE
+		}
+	}
+	CurrentTimeCycleKeyframe = 0;
+	TimeCycleBlendMinute = -1;
+#endif
+
 	m_FogReduction = 0;
 
 	debug("CTimeCycle ready\n");
@@ -270,6 +378,40 @@ CTimeCycle::Initialise(void)
 
 static float interp_c0, interp_c1, interp_c2, interp_c3;
 
+#ifdef TIMECYCLE_CACHE
+// Keyframe the minute of the day is after, time mostly goes forward so start with the last one
+static int32
+FindTimeCycleKeyframe(int32 minute)
+{
+	for(int32 i = 0; i < NumTimeCycleKeyframes; i++){
+		int32 k = (CurrentTimeCycleKeyframe + i) % NumTimeCycleKeyframes;
+		int32 start = aTimeCycleKeyframeTimes[k];
+		int32 end = aTimeCycleKeyframeTimes[(k+1) % NumTimeCycleKeyframes];
+		bool inside;
+		if(end > start)
+			inside = minute >= start && minute < end;
+		else	// goes past midnight
+			inside = minute >= start || minute < end;
+		if(inside){
+			CurrentTimeCycleKeyframe = k;
+			break;
+		}
+	}
+	return CurrentTimeCycleKeyframe;
+}
+
+// Same sum as Interpolate, for all values of the keyframes at once
+static void
+BlendTimeCycleKeyframes(float *out, const float *a1, const float *b1, const float *a2, const float *b2)
+{
+	for(int32 i = 0; i < TIMECYCLE_NUM_FLOATS; i++)
+		out[i] = a1[i] * interp_c0 +
+			b1[i] * interp_c1 +
+			a2[i] * interp_c2 +
+			b2[i] * interp_c3;
+}
+#endif
+
 float CTimeCycle::Interpolate(int8 *a, int8 *b)
 {
 	return a[CWeather::OldWeatherType] * interp_c0 +
@@ -316,6 +458,58 @@ CTimeCycle::StopExtraColour(bool fade)
 void
 CTimeCycle::Update(void)
 {
+#ifdef TIMECYCLE_CACHE
+	if(bShowStats){
+		char str[128];
+		sprintf(str, "TIMECYCLE KEYFRAMES %d, BLENDED %d OF LAST %d UPDATES", NumTimeCycleKeyframes, nTimeCycleLastBlends, nTimeCycleLastUpdates);
+		CDebug::PrintAt(str, 2, 38);
+	}
+	if(++nTimeCycleUpdates == 60){
+		nTimeCycleLastBlends = nTimeCycleBlends;
+		nTimeCycleLastUpdates = nTimeCycleUpdates;
+		nTimeCycleBlends = 0;
+		nTimeCycleUpdates = 0;
+	}
+
+	int32 minute = CClock::GetHours()*60 + CClock::GetMinutes();
+	int32 w1 = CWeather::OldWeatherType;
+	int32 w2 = CWeather::NewWeatherType;
+	float weatherInterp = CWeather::InterpolationValue;
+	// without the seconds the blend stays the same for a whole minute, nobody can see the difference
+	if(bCacheBlend)
+		weatherInterp = Floor(weatherInterp*60.0f)/60.0f;
+	if(!bCacheBlend || minute != TimeCycleBlendMinute ||
+	   w1 != TimeCycleBlendOldWeather || w2 != TimeCycleBlendNewWeather || weatherInterp != TimeCycleBlendInterpolation){
+		int32 k1 = FindTimeCycleKeyframe(minute);
+		int32 k2 = (k1+1) % NumTimeCycleKeyframes;
+		int32 elapsed = minute - aTimeCycleKeyframeTimes[k1];
+		int32 span = aTimeCycleKeyframeTimes[k2] - aTimeCycleKeyframeTimes[k1];
+		if(elapsed < 0)
+			elapsed += 24*60;
+		if(span <= 0)
+			span += 24*60;
+		float timeInterp;
+		if(bCacheBlend)
+			timeInterp = elapsed/(float)span;
+		else
+			timeInterp = (elapsed + CClock::GetSeconds()/60.0f)/(float)span;
+		// coefficients for a bilinear interpolation
+		interp_c0 = (1.0f-timeInterp) * (1.0f-weatherInterp);
+		interp_c1 = timeInterp * (1.0f-weatherInterp);
+		interp_c2 = (1.0f-timeInterp) * weatherInterp;
+		interp_c3 = timeInterp * weatherInterp;
+		BlendTimeCycleKeyframes(aTimeCycleBlend,
+			aTimeCycleKeyframes[k1][w1].values, aTimeCycleKeyframes[k2][w1].values,
+			aTimeCycleKeyframes[k1][w2].values, aTimeCycleKeyframes[k2][w2].values);
+		nTimeCycleBlends++;
+		TimeCycleBlendMinute = minute;
+		TimeCycleBlendOldWeather = w1;
+		TimeCycleBlendNewWeather = w2;
+		TimeCycleBlendInterpolation = weatherInterp;
+	}
+
+#define INTERP(v) aTimeCycleBlend[TIMECYCLE_##v]
+#else
 	int h1 = CClock::GetHours();
 	int h2 = (h1+1)%24;
 	int w1 = CWeather::OldWeatherType;
@@ -328,6 +522,7 @@ CTimeCycle::Update(void)
 	interp_c3 = timeInterp * CWeather::InterpolationValue;
 
 #define INTERP(v) Interpolate(v[h1], v[h2])
+#endif
 
 	m_nCurrentSkyTopRed = INTERP(m_nSkyTopRed);
 	m_nCurrentSkyTopGreen = INTERP(m_nSkyTopGreen);
@@ -1,5 +1,10 @@
 #pragma once
 
+#ifdef TIMECYCLE_CACHE
+// TIMECYC.DAT has one line per hour, but keyframes can be at any minute of the day
+#define MAX_TIMECYCLE_KEYFRAMES NUMHOURS
+#endif
+
 class CTimeCycle
 {
 	static uint8 m_nAmbientRed[NUMHOURS][NUMWEATHERS];
@@ -125,6 +130,10 @@ public:
 	static float m_fShadowSideY[16];
 	static float m_fShadowDisplacementX[16];
 	static float m_fShadowDisplacementY[16];
+#ifdef TIMECYCLE_CACHE
+	static bool bCacheBlend;
+	static bool bShowStats;
+#endif
 
 	static float GetAmbientRed(void) { return m_fCurrentAmbientRed; }
 	static float GetAmbientGreen(void) { return m_fCurrentAmbientGreen; }
@@ -30,6 +30,9 @@
 #include "WaterLevel.h"
 #include "SurfaceTable.h"
 #include "WaterCreatures.h"
+#ifdef WATER_SAMPLE_CACHE
+#include "Debug.h"
+#endif
 
 #define RwIm3DVertexSet_RGBA(vert, rgba) RwIm3DVertexSetRGBA(vert, rgba.red, rgba.green, rgba.blue, rgba.alpha) // (RwRGBAAssign(&(_dst)->color, &_src))
 
@@ -58,6 +61,70 @@ int32 CWaterLevel::m_nRenderWaterLayers;
 
 RpAtomic *CWaterLevel::ms_pWavyAtomic;
 RpAtomic *CWaterLevel::ms_pMaskAtomic;
+
+#ifdef WATER_SAMPLE_CACHE
+// Buoyancy, boat splashes and the camera ask for the water at the same points many times a
+// frame. The waves only depend on the point, the time and the wind, so what was sampled is
+// kept until one of the latter two changes.
+#define WATER_SAMPLE_CACHE_BITS 9
+#define WATER_SAMPLE_CACHE_SIZE (1 << WATER_SAMPLE_CACHE_BITS)
+
+struct tWaterLevelSample
+{
+	float fX;
+	float fY;
+	uint32 nStamp;
+	float fWave;
+};
+
+struct tWaterNormalSample
+{
+	float fX;
+	float fY;
+	uint32 nStamp;
+	CVector vecNormal;
+};
+
+bool CWaterLevel::bUseSampleCache = true;
+bool CWaterLevel::bShowStats;
+
+tWaterLevelSample aWaterLevelSamples[WATER_SAMPLE_CACHE_SIZE];
+tWaterNormalSample aWaterNormalSamples[WATER_SAMPLE_CACHE_SIZE];
+uint32 nWaterSampleStamp = 1;
+uint32 nWaterSampleTime;
+float fWaterSampleWind;
+
+int32 nWaterSampleHits;
+int32 nWaterSampleMisses;
+int32 nWavyUpdates;
+int32 nWavyColourUpdates;
+
+// the wavy sector's prelight only has to be filled in again when the colour changes
+bool bWavyColourValid;
+RwRGBA WavyColour;
+
+static uint32
+GetWaterSampleStamp(void)
+{
+	uint32 time = CTimer::GetTimeInMilliseconds() & 4095;
+	if ( time != nWaterSampleTime || CWeather::WindClipped != fWaterSampleWind )
+	{
+		nWaterSampleTime = time;
+		fWaterSampleWind = CWeather::WindClipped;
+		nWaterSampleStamp++;
+	}
+	return nWaterSampleStamp;
+}
+
+static int32
+GetWaterSampleSlot(float fX, float fY)
+{
+	uint32 x, y;
+	memcpy(&x, &fX, sizeof(x));
+	memcpy(&y, &fY, sizeof(y));
+	return ((x * 73856093u) ^ (y * 19349663u)) >> (32 - WATER_SAMPLE_CACHE_BITS);
+}
+#endif
 //"Custom" Don't Render Water Toggle
 bool gbDontRenderWater;
 
@@ -494,6 +561,9 @@ CWaterLevel::CreateWavyAtomic()
 		wavyFrame = RwFrameCreate();
 		ms_pWavyAtomic = RpAtomicCreate();
 		RpAtomicSetGeometry(ms_pWavyAtomic, wavyGeometry, 0);
+#ifdef WATER_SAMPLE_CACHE
+		bWavyColourValid = false;
+#endif
 		RpAtomicSetFrame(ms_pWavyAtomic, wavyFrame);
 		RpMaterialDestroy(wavyMaterial);
 		RpGeometryDestroy(wavyGeometry);
@@ -722,19 +792,41 @@ CWaterLevel::GetWaterLevel(float fX, float fY, float fZ, float *pfOutLevel, bool
 	ASSERT( pfOutLevel != nil );
 	*pfOutLevel = ms_aWaterZs[nBlock];
 
-	float fAngle = (CTimer::GetTimeInMilliseconds() & 4095) * (TWOPI / 4096.0f);
+#ifdef WATER_SAMPLE_CACHE
+	tWaterLevelSample &sample = aWaterLevelSamples[GetWaterSampleSlot(fX, fY)];
+	if ( bUseSampleCache && sample.nStamp == GetWaterSampleStamp() && sample.fX == fX && sample.fY == fY )
+	{
+		*pfOutLevel += sample.fWave;
+		nWaterSampleHits++;
+	}
+	else
+#endif
+	{
+		float fAngle = (CTimer::GetTimeInMilliseconds() & 4095) * (TWOPI / 4096.0f);
 	
-	float fWave = Sin
-	(
-		( WATER_UNSIGN_Y(fY)                  - y*SMALL_SECTOR_SIZE
-		+ WATER_UNSIGN_X(fX + WATER_X_OFFSET) - x*SMALL_SECTOR_SIZE )
+		float fWave = Sin
+		(
+			( WATER_UNSIGN_Y(fY)                  - y*SMALL_SECTOR_SIZE
+			+ WATER_UNSIGN_X(fX + WATER_X_OFFSET) - x*SMALL_SECTOR_SIZE )
 		
-		* (TWOPI / SMALL_SECTOR_SIZE ) + fAngle
-	);
+			* (TWOPI / SMALL_SECTOR_SIZE ) + fAngle
+		);
 
-	float fWindFactor = CWeather::WindClipped * 0.4f + 0.2f;
+		float fWindFactor = CWeather::WindClipped * 0.4f + 0.2f;
 	
-	*pfOutLevel += fWave * fWindFactor;
+		*pfOutLevel += fWave * fWindFactor;
+
+#ifdef WATER_SAMPLE_CACHE
+		if ( bUseSampleCache )
+		{
+			sample.fX = fX;
+			sample.fY = fY;
+			sample.nStamp = nWaterSampleStamp;
+			sample.fWave = fWave * fWindFactor;
+			nWaterSampleMisses++;
+		}
+#endif
+	}
 
 	if ( bDontCheckZ == false && (*pfOutLevel - fZ) > 3.0f )
 	{
@@ -786,6 +878,15 @@ CWaterLevel::GetWaterNormal(float fX, float fY)
 	
 	int32 x = WATER_TO_SMALL_SECTOR_X(fX);
 	int32 y = WATER_TO_SMALL_SECTOR_Y(fY);
+
+#ifdef WATER_SAMPLE_CACHE
+	tWaterNormalSample &sample = aWaterNormalSamples[GetWaterSampleSlot(fX, fY)];
+	if ( bUseSampleCache && sample.nStamp == GetWaterSampleStamp() && sample.fX == fX && sample.fY == fY )
+	{
+		nWaterSampleHits++;
+		return sample.vecNormal;
+	}
+#endif
 	
 	float fAngle = (CTimer::GetTimeInMilliseconds() & 4095) * (TWOPI / 4096.0f);
 	float fWindFactor = CWeather::WindClipped * 0.4f + 0.2f;
@@ -799,11 +900,121 @@ CWaterLevel::GetWaterNormal(float fX, float fY)
 	CVector norm = CrossProduct(vA, vB);
 	
 	norm.Normalise();
+
+#ifdef WATER_SAMPLE_CACHE
+	if ( bUseSampleCache )
+	{
+		sample.fX = fX;
+		sample.fY = fY;
+		sample.nStamp = nWaterSampleStamp;
+		sample.vecNormal = norm;
+		nWaterSampleMisses++;
+	}
+#endif
 	
 	return norm;
 }
 
 
+#ifdef BATCHED_BUOYANCY
+#define WATER_BATCH_SIZE 32
+
+// The same maths as GetWaterLevel, but the time and wind only once and the sectors,
+// wave phases and sines each in their own loop over arrays, so they can be vectorised
+int32
+CWaterLevel::GetWaterLevelBatch(const float *pfX, const float *pfY, float *pfOutLevels, int32 num)
+{
+	float aPhase[WATER_BATCH_SIZE];
+	float aWave[WATER_BATCH_SIZE];
+	int16 aBlock[WATER_BATCH_SIZE];
+	int32 numFound = 0;
+
+	float fAngle = (CTimer::GetTimeInMilliseconds() & 4095) * (TWOPI / 4096.0f);
+	float fWindFactor = CWeather::WindClipped * 0.4f + 0.2f;
+
+	for ( int32 start = 0; start < num; start += WATER_BATCH_SIZE )
+	{
+		int32 n = Min(num - start, WATER_BATCH_SIZE);
+		const float *pX = &pfX[start];
+		const float *pY = &pfY[start];
+		int32 i;
+
+		for ( i = 0; i < n; i++ )
+		{
+			int32 x = WATER_TO_SMALL_SECTOR_X(pX[i] + WATER_X_OFFSET);
+			int32 y = WATER_TO_SMALL_SECTOR_Y(pY[i]);
+
+			aPhase[i] = ( WATER_UNSIGN_Y(pY[i])                  - y*SMALL_SECTOR_SIZE
+					+ WATER_UNSIGN_X(pX[i] + WATER_X_OFFSET) - x*SMALL_SECTOR_SIZE )
+				* (TWOPI / SMALL_SECTOR_SIZE ) + fAngle;
+
+#ifdef FIX_BUGS
+			if ( x < 0 || x >= MAX_SMALL_SECTORS || y < 0 || y >= MAX_SMALL_SECTORS )
+			{
+				aBlock[i] = 0x80;
+				continue;
+			}
+#endif
+			aBlock[i] = (uint8)aWaterFineBlockList[x][y];
+		}
+
+		for ( i = 0; i < n; i++ )
+			aWave[i] = Sin(aPhase[i]);
+
+		for ( i = 0; i < n; i++ )
+		{
+			if ( aBlock[i] == 0x80 )
+				continue;
+			pfOutLevels[start + i] = ms_aWaterZs[aBlock[i]];
+			pfOutLevels[start + i] += aWave[i] * fWindFactor;
+			numFound++;
+		}
+	}
+
+	return numFound;
+}
+
+void
+CWaterLevel::GetWaterNormalBatch(const float *pfX, const float *pfY, CVector *pOutNormals, int32 num)
+{
+	float aCos[WATER_BATCH_SIZE];
+
+	float fAngle = (CTimer::GetTimeInMilliseconds() & 4095) * (TWOPI / 4096.0f);
+	float fWindFactor = CWeather::WindClipped * 0.4f + 0.2f;
+
+	for ( int32 start = 0; start < num; start += WATER_BATCH_SIZE )
+	{
+		int32 n = Min(num - start, WATER_BATCH_SIZE);
+		const float *pX = &pfX[start];
+		const float *pY = &pfY[start];
+		int32 i;
+
+		// no x offset, same as GetWaterNormal
+		for ( i = 0; i < n; i++ )
+		{
+			int32 x = WATER_TO_SMALL_SECTOR_X(pX[i]);
+			int32 y = WATER_TO_SMALL_SECTOR_Y(pY[i]);
+
+			aCos[i] = (WATER_UNSIGN_Y(pY[i]) - y*SMALL_SECTOR_SIZE + WATER_UNSIGN_X(pX[i]) - x*SMALL_SECTOR_SIZE)
+				* (TWOPI / SMALL_SECTOR_SIZE ) + fAngle;
+		}
+
+		for ( i = 0; i < n; i++ )
+			aCos[i] = Cos(aCos[i]);
+
+		for ( i = 0; i < n; i++ )
+		{
+			CVector vA(1.0f, 0.0f, fWindFactor * (TWOPI / SMALL_SECTOR_SIZE ) * aCos[i]);
+			CVector vB(0.0f, 1.0f, fWindFactor * (TWOPI / SMALL_SECTOR_SIZE ) * aCos[i]);
+
+			CVector norm = CrossProduct(vA, vB);
+			norm.Normalise();
+			pOutNormals[start + i] = norm;
+		}
+	}
+}
+#endif
+
 inline float
 _GetWaterDrawDist()
 {
@@ -906,6 +1117,20 @@ CWaterLevel::RenderWater()
 	bool bUseCamStartX = false;
 	bool bUseCamEndY   = false;
 	
+#ifdef WATER_SAMPLE_CACHE
+	if ( bShowStats )
+	{
+		char str[128];
+		sprintf(str, "WATER SAMPLES %d HITS %d MISSES, WAVY UPDATES %d COLOUR %d",
+			nWaterSampleHits, nWaterSampleMisses, nWavyUpdates, nWavyColourUpdates);
+		CDebug::PrintAt(str, 2, 34);
+	}
+	nWaterSampleHits = 0;
+	nWaterSampleMisses = 0;
+	nWavyUpdates = 0;
+	nWavyColourUpdates = 0;
+#endif
+
 	if ( !CGame::CanSeeWaterFromCurrArea() )
 		return;
 	
@@ -1691,7 +1916,23 @@ CWaterLevel::RenderOneWavySector(float fX, float fY, float fZ, RwRGBA const &col
 		RwV3d *wavyMorphVerts = RpMorphTargetGetVertices(wavyMorph);
 		RwV3d *wavyMorphNormals = RpMorphTargetGetVertexNormals(wavyMorph);
 
+#ifdef WATER_SAMPLE_CACHE
+		bool bUpdateColour = !bUseSampleCache || !bWavyColourValid
+			|| WavyColour.red != color.red || WavyColour.green != color.green
+			|| WavyColour.blue != color.blue || WavyColour.alpha != color.alpha;
+		if ( bUpdateColour )
+		{
+			WavyColour = color;
+			bWavyColourValid = true;
+			nWavyColourUpdates++;
+		}
+		nWavyUpdates++;
+
+		RpGeometryLock(wavyGeometry, rpGEOMETRYLOCKVERTICES | rpGEOMETRYLOCKNORMALS | rpGEOMETRYLOCKTEXCOORDS
+			| (bUpdateColour ? rpGEOMETRYLOCKPRELIGHT : 0));
+#else
 		RpGeometryLock(wavyGeometry, rpGEOMETRYLOCKVERTICES | rpGEOMETRYLOCKNORMALS | rpGEOMETRYLOCKPRELIGHT | rpGEOMETRYLOCKTEXCOORDS);
+#endif
 
 		RwMatrix *camMat = RwFrameGetLTM(RwCameraGetFrame(RwCameraGetCurrentCamera())); //or curWorld
 
@@ -1721,6 +1962,9 @@ CWaterLevel::RenderOneWavySector(float fX, float fY, float fZ, RwRGBA const &col
 				wavyTexCoords->u = float(i) * move + TEXTURE_ADDV;
 				wavyTexCoords->v = float(j) * move + TEXTURE_ADDU;
 
+#ifdef WATER_SAMPLE_CACHE
+				if ( bUpdateColour )
+#endif
 				RwRGBAAssign(wavyPreLight, &color);
 
 				if (i > 0 && i < 16 && j > 0 && j < 16)
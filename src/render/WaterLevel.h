@@ -116,6 +116,11 @@ public:
 	static RpAtomic    *ms_pWavyAtomic;
 	static RpAtomic    *ms_pMaskAtomic;
 
+#ifdef WATER_SAMPLE_CACHE
+	static bool        bUseSampleCache;
+	static bool        bShowStats;
+#endif
+
 	static void    Initialise(Const char *pWaterDat); // out of class in III PC and later because of SecuROM
 	static void    Shutdown();
 
@@ -132,6 +137,12 @@ public:
 	static bool    GetWaterLevelNoWaves(float fX, float fY, float fZ, float *pfOutLevel);
 	static float   GetWaterWavesOnly(short x, short y);	// unused
 	static CVector GetWaterNormal(float fX, float fY);
+#ifdef BATCHED_BUOYANCY
+	// GetWaterLevel with bDontCheckZ and GetWaterNormal for many points at once,
+	// levels where there's no water are left alone. Returns how many points have water.
+	static int32   GetWaterLevelBatch(const float *pfX, const float *pfY, float *pfOutLevels, int32 num);
+	static void    GetWaterNormalBatch(const float *pfX, const float *pfY, CVector *pOutNormals, int32 num);
+#endif
 
 	static void    RenderWater();
 	static void    RenderTransparentWater(void);
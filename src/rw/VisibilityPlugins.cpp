@@ -673,6 +673,48 @@ CVisibilityPlugins::GetDistanceSquaredFromCamera(RwFrame *frame)
 	return RwV3dDotProduct(&dist, &dist);
 }
 
+// Only the distance part of the render callbacks, without culling against the view direction.
+// For passes that don't look through the camera but must draw the same LOD, like the shadow maps.
+bool
+CVisibilityPlugins::IsAtomicVisibleAtLod(RpAtomic *atomic)
+{
+	RpAtomicCallBackRender cb;
+	RpClump *clump;
+	float distsq, maxdist;
+
+	cb = RpAtomicGetRenderCallBack(atomic);
+	if(cb == RenderPedCB)
+		return GetDistanceSquaredFromCamera(RpAtomicGetFrame(atomic)) < ms_pedLod1Dist;
+	if(cb == RenderWeaponCB){
+		maxdist = GetAtomicModelInfo(atomic)->GetLodDistance(0);
+		return GetDistanceSquaredFromCamera(RpAtomicGetFrame(atomic)) < maxdist*maxdist;
+	}
+
+	// vehicle callbacks go by the distance of the whole clump
+	clump = RpAtomicGetClump(atomic);
+	if(clump == nil)
+		return true;
+	distsq = GetDistanceSquaredFromCamera(RpClumpGetFrame(clump));
+	if(cb == RenderWheelAtomicCB)
+		return GetAtomicModelInfo(atomic)->GetAtomicFromDistance(Sqrt(distsq) * TheCamera.LODDistMultiplier / VEHICLE_LODDIST_MULTIPLIER) != nil;
+	if(cb == RenderVehicleHiDetailCB || cb == RenderVehicleHiDetailAlphaCB ||
+	   cb == RenderVehicleHiDetailAlphaCB_Boat)
+		return distsq < ms_vehicleLod0Dist;
+	if(cb == RenderVehicleHiDetailCB_BigVehicle || cb == RenderVehicleHiDetailAlphaCB_BigVehicle ||
+	   cb == RenderVehicleTailRotorAlphaCB)
+		return distsq < ms_bigVehicleLod0Dist;
+	if(cb == RenderVehicleHiDetailCB_Boat || cb == RenderTrainHiDetailCB || cb == RenderTrainHiDetailAlphaCB ||
+	   cb == RenderVehicleRotorAlphaCB)
+		return distsq < ms_bigVehicleLod1Dist;
+	if(cb == RenderVehicleLowDetailCB_BigVehicle || cb == RenderVehicleLowDetailAlphaCB_BigVehicle)
+		return distsq >= ms_bigVehicleLod0Dist && distsq < ms_bigVehicleLod1Dist;
+	if(cb == RenderVehicleReallyLowDetailCB)
+		return distsq >= ms_vehicleLod0Dist;
+	if(cb == RenderVehicleReallyLowDetailCB_BigVehicle)
+		return distsq >= ms_bigVehicleLod1Dist;
+	return true;
+}
+
 float
 CVisibilityPlugins::GetDotProductWithCameraVector(RwMatrix *atomicMat, RwMatrix *clumpMat, uint32 flags)
 {
@@ -89,6 +89,7 @@ public:
 	static float GetDistanceSquaredFromCamera(RwV3d *pos);
 	static float GetDistanceSquaredFromCamera(RwFrame *frame);
 	static float GetDotProductWithCameraVector(RwMatrix *atomicMat, RwMatrix *clumpMat, uint32 flags);
+	static bool IsAtomicVisibleAtLod(RpAtomic *atomic);
 
 	//
 	// RW Plugins
@@ -6,11 +6,18 @@
 #include "Physical.h"
 #include "Vehicle.h"
 #include "Floater.h"
+#ifdef BATCHED_BUOYANCY
+#include "World.h"
+#endif
 
 //--MIAMI: done
 
 cBuoyancy mod_Buoyancy;
 
+#ifdef BATCHED_BUOYANCY
+bool cBuoyancy::bBatchWaterLevels = true;
+#endif
+
 float fVolMultiplier = 1.0f;
 // amount of boat volume in bounding box
 // 1.0-volume is the empty space in the bbox
@@ -74,6 +81,13 @@ cBuoyancy::ProcessBuoyancyBoat(CVehicle *veh, float buoyancy, CVector *point, CV
 	int ix, i;
 	tWaterLevel waterPosition;
 	CVector waterNormal;
+#ifdef BATCHED_BUOYANCY
+	CVector waterLevels[BUOYANCY_MAX_POINTS];
+	tWaterLevel waterPositions[BUOYANCY_MAX_POINTS];
+	CVector waterNormals[BUOYANCY_MAX_POINTS];
+	int32 numBatched = bBatchWaterLevels ? FindWaterLevelsBatch(m_positionZ, waterLevels, waterPositions, waterNormals) : -1;
+	int32 k = 0;
+#endif
 
 	// Floater is divided into 3x3 parts. Process and sum each of them
 	float volDiv = 1.0f/((m_dimMax.z - m_dimMin.z)*sq(m_numSteps+1.0f));
@@ -82,6 +96,14 @@ cBuoyancy::ProcessBuoyancyBoat(CVehicle *veh, float buoyancy, CVector *point, CV
 		i = ix;
 		for(y = m_dimMin.y; y <= m_dimMax.y; y += m_step.y){
 			CVector waterLevel(x, y, 0.0f);
+#ifdef BATCHED_BUOYANCY
+			if(numBatched >= 0){
+				waterLevel = waterLevels[k];
+				waterPosition = waterPositions[k];
+				waterNormal = waterNormals[k];
+				k++;
+			}else
+#endif
 			FindWaterLevelNorm(m_positionZ, &waterLevel, &waterPosition, &waterNormal);
 			switch(veh->GetModelIndex()){
 			case MI_RIO:
@@ -224,6 +246,18 @@ cBuoyancy::SimpleCalcBuoyancy(void)
 	float x, y;
 	tWaterLevel waterPosition;
 
+#ifdef BATCHED_BUOYANCY
+	CVector waterLevels[BUOYANCY_MAX_POINTS];
+	tWaterLevel waterPositions[BUOYANCY_MAX_POINTS];
+	int32 numBatched = bBatchWaterLevels ? FindWaterLevelsBatch(m_positionZ, waterLevels, waterPositions, nil) : -1;
+	if(numBatched >= 0){
+		for(int32 k = 0; k < numBatched; k++){
+			fVolMultiplier = 1.0f;
+			if(waterPositions[k] != FLOATER_ABOVE_WATER)
+				SimpleSumBuoyancyData(waterLevels[k], waterPositions[k]);
+		}
+	}else
+#endif
 	// Floater is divided into 3x3 parts. Process and sum each of them
 	for(x = m_dimMin.x; x <= m_dimMax.x; x += m_step.x){
 		for(y = m_dimMin.y; y <= m_dimMax.y; y += m_step.y){
@@ -324,3 +358,123 @@ cBuoyancy::CalcBuoyancyForce(CPhysical *phys, CVector *point, CVector *impulse)
 	*impulse = CVector(0.0f, 0.0f, m_volumeUnderWater*m_buoyancy*CTimer::GetTimeStep());
 	return true;
 }
+
+#ifdef BATCHED_BUOYANCY
+// Does what FindWaterLevel and FindWaterLevelNorm do for every point of the 3x3 grid,
+// in the order the loops visit them, but gets the water from CWaterLevel in one call.
+// Returns the number of points, or -1 if they don't fit and have to be done one by one.
+int32
+cBuoyancy::FindWaterLevelsBatch(const CVector &zpos, CVector *waterLevels, tWaterLevel *waterPositions, CVector *normals)
+{
+	float worldX[BUOYANCY_MAX_POINTS];
+	float worldY[BUOYANCY_MAX_POINTS];
+	float levels[BUOYANCY_MAX_POINTS];
+	float localZ[BUOYANCY_MAX_POINTS];
+	float x, y;
+	int32 i, n;
+
+	n = 0;
+	for(x = m_dimMin.x; x <= m_dimMax.x; x += m_step.x){
+		for(y = m_dimMin.y; y <= m_dimMax.y; y += m_step.y){
+			if(n == BUOYANCY_MAX_POINTS)
+				return -1;
+			waterLevels[n] = CVector(x, y, 0.0f);
+			CVector xWaterLevel = Multiply3x3(m_matrix, waterLevels[n]);
+			worldX[n] = xWaterLevel.x + m_position.x;
+			worldY[n] = xWaterLevel.y + m_position.y;
+			localZ[n] = xWaterLevel.z;
+			levels[n] = 0.0f;	// stays like this where there's no water
+			n++;
+		}
+	}
+
+	CWaterLevel::GetWaterLevelBatch(worldX, worldY, levels, n);
+	// only used where the point isn't above the water, but cheaper to do them all
+	if(normals)
+		CWaterLevel::GetWaterNormalBatch(worldX, worldY, normals, n);
+
+	for(i = 0; i < n; i++){
+		waterPositions[i] = FLOATER_IN_WATER;
+		waterLevels[i].z = levels[i];
+		waterLevels[i].z -= localZ[i] + zpos.z;	// make local
+		if(waterLevels[i].z > m_dimMax.z){
+			waterLevels[i].z = m_dimMax.z;
+			waterPositions[i] = FLOATER_UNDER_WATER;
+		}else if(waterLevels[i].z < m_dimMin.z){
+			waterLevels[i].z = m_dimMin.z;
+			waterPositions[i] = FLOATER_ABOVE_WATER;
+		}
+	}
+	return n;
+}
+
+#define NUM_BENCHMARK_FLOATERS 50
+#define NUM_BENCHMARK_RUNS 200
+
+// Runs SimpleCalcBuoyancy for 50 floaters spread around the player's vehicle (or the player)
+// one point at a time and batched, and checks both give the same volume and impulse point
+void
+BenchmarkBuoyancy(void)
+{
+	static cBuoyancy floaters[NUM_BENCHMARK_FLOATERS];
+	static float aVolume[2][NUM_BENCHMARK_FLOATERS];
+	static CVector aImpulsePoint[2][NUM_BENCHMARK_FLOATERS];
+	uint32 times[2];
+	int i, run, pass;
+
+	CPhysical *phys = FindPlayerVehicle();
+	if(phys == nil)
+		phys = FindPlayerPed();
+	if(phys == nil)
+		return;
+
+	bool bWasBatched = cBuoyancy::bBatchWaterLevels;
+#ifdef WATER_SAMPLE_CACHE
+	// every run samples the same points, don't let the cache answer for the first pass
+	bool bUsedSampleCache = CWaterLevel::bUseSampleCache;
+	CWaterLevel::bUseSampleCache = false;
+#endif
+
+	int numInWater = 0;
+	for(pass = 0; pass < 2; pass++){
+		cBuoyancy::bBatchWaterLevels = pass == 1;
+		uint32 startTime = CTimer::GetCurrentTimeInCycles();
+		for(run = 0; run < NUM_BENCHMARK_RUNS; run++){
+			for(i = 0; i < NUM_BENCHMARK_FLOATERS; i++){
+				cBuoyancy &floater = floaters[i];
+				floater.m_numSteps = 2.0f;
+				floater.m_waterlevel = 0.0f;
+				floater.m_matrix = phys->GetMatrix();
+				floater.PreCalcSetup(phys, 1.0f);
+				// spread them on a 10x5 grid, all turned differently
+				floater.m_matrix.SetRotateZ(i * 0.7f);
+				floater.m_position = phys->GetPosition() + CVector((i % 10) * 8.0f - 36.0f, (i / 10) * 8.0f - 16.0f, 0.0f);
+				floater.m_positionZ = CVector(0.0f, 0.0f, floater.m_position.z);
+				floater.SimpleCalcBuoyancy();
+				if(run == 0){
+					aVolume[pass][i] = floater.m_volumeUnderWater;
+					aImpulsePoint[pass][i] = floater.m_impulsePoint;
+				}
+			}
+		}
+		times[pass] = CTimer::GetCurrentTimeInCycles() - startTime;
+	}
+
+	cBuoyancy::bBatchWaterLevels = bWasBatched;
+#ifdef WATER_SAMPLE_CACHE
+	CWaterLevel::bUseSampleCache = bUsedSampleCache;
+#endif
+
+	int mismatches = 0;
+	for(i = 0; i < NUM_BENCHMARK_FLOATERS; i++){
+		if(aVolume[0][i] != 0.0f)
+			numInWater++;
+		if(aVolume[0][i] != aVolume[1][i] || aImpulsePoint[0][i] != aImpulsePoint[1][i])
+			mismatches++;
+	}
+
+	uint32 cyclesPerUs = Max(CTimer::GetCyclesPerMillisecond() / 1000, 1u);
+	debug("Buoyancy benchmark: %d floaters x %d runs, %d in water, one by one %dus, batched %dus, %d mismatches\n",
+		NUM_BENCHMARK_FLOATERS, NUM_BENCHMARK_RUNS, numInWater, times[0] / cyclesPerUs, times[1] / cyclesPerUs, mismatches);
+}
+#endif
@@ -2,6 +2,10 @@
 
 class CPhysical;
 
+#ifdef BATCHED_BUOYANCY
+#define BUOYANCY_MAX_POINTS 16	// the 3x3 grid, with room for the float loops taking an extra step
+#endif
+
 enum tWaterLevel
 {
 	FLOATER_ABOVE_WATER,
@@ -43,5 +47,13 @@ public:
 	void FindWaterLevel(const CVector &zpos, CVector *waterLevel, tWaterLevel *waterPosition);
 	void FindWaterLevelNorm(const CVector &zpos, CVector *waterLevel, tWaterLevel *waterPosition, CVector *normal);
 	bool CalcBuoyancyForce(CPhysical *phys, CVector *impulse, CVector *point);
+#ifdef BATCHED_BUOYANCY
+	static bool bBatchWaterLevels;
+	int32 FindWaterLevelsBatch(const CVector &zpos, CVector *waterLevels, tWaterLevel *waterPositions, CVector *normals);
+#endif
 };
 extern cBuoyancy mod_Buoyancy;
+
+#ifdef BATCHED_BUOYANCY
+void BenchmarkBuoyancy(void);
+#endif